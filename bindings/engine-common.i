@@ -56,6 +56,38 @@ AccountList * gnc_accounts_and_all_descendants (AccountList *accounts);
 %ignore gnc_account_get_descendants;
 %ignore gnc_account_get_descendants_sorted;
 %ignore gnc_accounts_and_all_descendants;
+#if defined(SWIGGUILE)
+/* xaccAccountGetBalancesAsOfDates takes a list of dates and returns the
+ * list of balances at them. */
+%typemap(in, numinputs=1) (const time64 *dates, gsize n_dates,
+                           gnc_numeric *balances)
+{
+    for (SCM node = $input; !scm_is_null (node); node = SCM_CDR (node))
+        if (!scm_is_pair (node) ||
+            !scm_is_signed_integer (SCM_CAR (node), INT64_MIN, INT64_MAX))
+            scm_wrong_type_arg ("$symname", $argnum, $input);
+    $2 = scm_to_size_t (scm_length ($input));
+    $1 = g_new (time64, $2);
+    $3 = g_new (gnc_numeric, $2);
+    SCM node = $input;
+    for (gsize i = 0; i < $2; ++i, node = SCM_CDR (node))
+        $1[i] = scm_to_int64 (SCM_CAR (node));
+}
+%typemap(argout) (const time64 *dates, gsize n_dates, gnc_numeric *balances)
+{
+    SCM list = SCM_EOL;
+    for (gsize i = $2; i > 0; --i)
+        list = scm_cons (gnc_numeric_to_scm ($3[i - 1]), list);
+    SWIG_APPEND_VALUE (list);
+}
+%typemap(freearg) (const time64 *dates, gsize n_dates, gnc_numeric *balances)
+{
+    g_free ($1);
+    g_free ($3);
+}
+#else
+%ignore xaccAccountGetBalancesAsOfDates;
+#endif
 %include <Account.h>
 
 %include <Transaction.h>
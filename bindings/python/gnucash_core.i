@@ -101,6 +101,7 @@
 
 %include <qofid.h>
 
+%ignore qof_query_run_foreach;
 %include <qofquery.h>
 
 %include <qofquerycore.h>
@@ -449,11 +449,17 @@
     (gnc:make-gnc-monetary (xaccAccountGetCommodity account) (or bal 0)))
   (define balance 0)
   (map amount->monetary
-       (gnc:account-accumulate-at-dates
-        account dates-list #:split->elt
-        (lambda (s)
-          (if s (set! balance (+ balance (or (split->amount s) 0))))
-          balance))))
+       (if (eq? split->amount xaccSplitGetAmount)
+           ;; the engine looks the plain balances up in its split index;
+           ;; it counts the splits before each date, so ask for the next
+           ;; second to include the ones on it.
+           (xaccAccountGetBalancesAsOfDates
+            account (map 1+ (sort dates-list <)))
+           (gnc:account-accumulate-at-dates
+            account dates-list #:split->elt
+            (lambda (s)
+              (if s (set! balance (+ balance (or (split->amount s) 0))))
+              balance)))))
 
 
 ;; this function will scan through account splitlist, building a list
@@ -32,6 +32,12 @@ static QofLogModule log_module = G_LOG_DOMAIN;
 
 /* Keys used for core preferences */
 #define GNC_PREF_FILE_COMPRESSION    "file-compression"
+#define GNC_PREF_FILE_COMP_LEVEL     "file-compression-level"
+#define GNC_PREF_FILE_COMP_ZSTD      "file-compression-zstd"
+#define GNC_PREF_FILE_JOURNAL        "file-journal"
+#define GNC_PREF_FILE_SNAPSHOT       "file-snapshot"
+#define GNC_PREF_SQL_LOAD_DAYS       "sql-load-days"
+#define GNC_PREF_SQL_WRITE_BEHIND    "sql-write-behind"
 #define GNC_PREF_RETAIN_TYPE_NEVER   "retain-type-never"
 #define GNC_PREF_RETAIN_TYPE_DAYS    "retain-type-days"
 #define GNC_PREF_RETAIN_TYPE_FOREVER "retain-type-forever"
@@ -78,6 +84,66 @@ file_compression_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
     }
 }
 
+static void
+file_compression_level_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
+{
+    if (gnc_prefs_is_set_up())
+    {
+        gint level = gnc_prefs_get_int(GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_COMP_LEVEL);
+        gnc_prefs_set_file_compression_level (level);
+    }
+}
+
+static void
+file_compression_zstd_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
+{
+    if (gnc_prefs_is_set_up())
+    {
+        gboolean zstd = gnc_prefs_get_bool(GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_COMP_ZSTD);
+        gnc_prefs_set_file_compression_zstd (zstd);
+    }
+}
+
+static void
+file_journal_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
+{
+    if (gnc_prefs_is_set_up())
+    {
+        gboolean file_journal = gnc_prefs_get_bool(GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_JOURNAL);
+        gnc_prefs_set_file_save_journal (file_journal);
+    }
+}
+
+static void
+file_snapshot_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
+{
+    if (gnc_prefs_is_set_up())
+    {
+        gboolean file_snapshot = gnc_prefs_get_bool(GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_SNAPSHOT);
+        gnc_prefs_set_file_save_snapshot (file_snapshot);
+    }
+}
+
+static void
+sql_load_days_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
+{
+    if (gnc_prefs_is_set_up())
+    {
+        gint days = gnc_prefs_get_int(GNC_PREFS_GROUP_GENERAL, GNC_PREF_SQL_LOAD_DAYS);
+        gnc_prefs_set_sql_load_days (days);
+    }
+}
+
+static void
+sql_write_behind_changed_cb(gpointer gsettings, gchar *key, gpointer user_data)
+{
+    if (gnc_prefs_is_set_up())
+    {
+        gint depth = gnc_prefs_get_int(GNC_PREFS_GROUP_GENERAL, GNC_PREF_SQL_WRITE_BEHIND);
+        gnc_prefs_set_sql_write_behind (depth);
+    }
+}
+
 
 void gnc_prefs_init (void)
 {
@@ -89,6 +155,12 @@ void gnc_prefs_init (void)
     file_retain_changed_cb (NULL, NULL, NULL);
     file_retain_type_changed_cb (NULL, NULL, NULL);
     file_compression_changed_cb (NULL, NULL, NULL);
+    file_compression_level_changed_cb (NULL, NULL, NULL);
+    file_compression_zstd_changed_cb (NULL, NULL, NULL);
+    file_journal_changed_cb (NULL, NULL, NULL);
+    file_snapshot_changed_cb (NULL, NULL, NULL);
+    sql_load_days_changed_cb (NULL, NULL, NULL);
+    sql_write_behind_changed_cb (NULL, NULL, NULL);
 
     /* Check for invalid retain_type (days)/retain_days (0) combo.
      * This can happen either because a user changed the preferences
@@ -122,6 +194,18 @@ void gnc_prefs_init (void)
                            file_retain_type_changed_cb, NULL);
     gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_COMPRESSION,
                            file_compression_changed_cb, NULL);
+    gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_COMP_LEVEL,
+                           file_compression_level_changed_cb, NULL);
+    gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_COMP_ZSTD,
+                           file_compression_zstd_changed_cb, NULL);
+    gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_JOURNAL,
+                           file_journal_changed_cb, NULL);
+    gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_SNAPSHOT,
+                           file_snapshot_changed_cb, NULL);
+    gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_SQL_LOAD_DAYS,
+                           sql_load_days_changed_cb, NULL);
+    gnc_prefs_register_cb (GNC_PREFS_GROUP_GENERAL, GNC_PREF_SQL_WRITE_BEHIND,
+                           sql_write_behind_changed_cb, NULL);
 
 }
 
@@ -139,4 +223,16 @@ gnc_prefs_remove_registered (void)
                            file_retain_type_changed_cb, NULL);
     gnc_prefs_remove_cb_by_func (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_COMPRESSION,
                            file_compression_changed_cb, NULL);
+    gnc_prefs_remove_cb_by_func (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_COMP_LEVEL,
+                           file_compression_level_changed_cb, NULL);
+    gnc_prefs_remove_cb_by_func (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_COMP_ZSTD,
+                           file_compression_zstd_changed_cb, NULL);
+    gnc_prefs_remove_cb_by_func (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_JOURNAL,
+                           file_journal_changed_cb, NULL);
+    gnc_prefs_remove_cb_by_func (GNC_PREFS_GROUP_GENERAL, GNC_PREF_FILE_SNAPSHOT,
+                           file_snapshot_changed_cb, NULL);
+    gnc_prefs_remove_cb_by_func (GNC_PREFS_GROUP_GENERAL, GNC_PREF_SQL_LOAD_DAYS,
+                           sql_load_days_changed_cb, NULL);
+    gnc_prefs_remove_cb_by_func (GNC_PREFS_GROUP_GENERAL, GNC_PREF_SQL_WRITE_BEHIND,
+                           sql_write_behind_changed_cb, NULL);
 }
@@ -951,6 +951,10 @@ GncDbiBackend<Type>::safe_sync (QofBook* book)
     g_return_if_fail (book != nullptr);
 
     ENTER ("book=%p, primary=%p", book, m_book);
+    /* The tables are rewritten from the book, so it has to be complete,
+     * and changes still waiting to be written can be dropped. */
+    discard_writes();
+    load_deferred_transactions();
     if (!conn->begin_transaction())
     {
         LEAVE("Failed to obtain a transaction.");
@@ -969,6 +973,8 @@ GncDbiBackend<Type>::safe_sync (QofBook* book)
         return;
     }
 
+    /* The renamed tables are dropped afterwards, so write everything. */
+    m_book_in_db = false;
     sync(m_book);
     if (check_error())
     {
@@ -994,6 +1000,10 @@ GncDbiBackend<DbType::DBI_MYSQL>::safe_sync (QofBook* book)
     g_return_if_fail (book != nullptr);
 
     ENTER ("book=%p, primary=%p", book, m_book);
+    /* The tables are rewritten from the book, so it has to be complete,
+     * and changes still waiting to be written can be dropped. */
+    discard_writes();
+    load_deferred_transactions();
     if (!conn->table_operation (TableOpType::backup))
     {
         set_error(ERR_BACKEND_SERVER_ERR);
@@ -1010,6 +1020,8 @@ GncDbiBackend<DbType::DBI_MYSQL>::safe_sync (QofBook* book)
         return;
     }
 
+    /* The renamed tables are dropped afterwards, so write everything. */
+    m_book_in_db = false;
     sync(m_book);
     if (check_error())
     {
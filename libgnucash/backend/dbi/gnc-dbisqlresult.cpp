@@ -27,6 +27,7 @@
 #include <dbi/dbi.h>
 /* For direct access to dbi data structs, sadly needed for datetime */
 #include <dbi/dbi-dev.h>
+#include <algorithm>
 #include <cmath>
 #include <gnc-datetime.hpp>
 #include "gnc-dbisqlresult.hpp"
@@ -82,6 +83,31 @@ GncDbiSqlResult::size() const noexcept
 {
     return dbi_result_get_numrows(m_dbi_result);
 }
+
+const GncDbiSqlResult::Column*
+GncDbiSqlResult::column(const char* col) const
+{
+    auto cached = m_column_cache.find(col);
+    if (cached != m_column_cache.end() && cached->second.first == col)
+        return &m_columns[cached->second.second];
+
+    if (m_dbi_result == nullptr)
+        return nullptr;
+    /* Let libdbi match the name so that its rules for case and table
+     * prefixes still apply. */
+    auto idx = dbi_result_get_field_idx(m_dbi_result, col);
+    if (idx == 0)
+        return nullptr;
+    auto pos = std::find_if(m_columns.begin(), m_columns.end(),
+                            [idx](const Column& c) { return c.idx == idx; })
+        - m_columns.begin();
+    if (static_cast<size_t>(pos) == m_columns.size())
+        m_columns.push_back({idx,
+                dbi_result_get_field_type_idx(m_dbi_result, idx),
+                dbi_result_get_field_attribs_idx(m_dbi_result, idx)});
+    m_column_cache[col] = std::make_pair(std::string{col}, pos);
+    return &m_columns[pos];
+}
 /* --------------------------------------------------------- */
 
 GncSqlRow&
@@ -101,23 +127,22 @@ GncDbiSqlResult::IteratorImpl::operator++()
 std::optional<int64_t>
 GncDbiSqlResult::IteratorImpl::get_int_at_col(const char* col) const
 {
-    auto type = dbi_result_get_field_type (m_inst->m_dbi_result, col);
-    if(type != DBI_TYPE_INTEGER)
+    auto column = m_inst->column(col);
+    if(!column || column->type != DBI_TYPE_INTEGER)
         return std::nullopt;
-    return std::optional<int64_t>{dbi_result_get_longlong (m_inst->m_dbi_result, col)};
+    return std::optional<int64_t>{dbi_result_get_longlong_idx (m_inst->m_dbi_result, column->idx)};
 }
 
 std::optional<double>
 GncDbiSqlResult::IteratorImpl::get_float_at_col(const char* col) const
 {
     constexpr double float_precision = 1000000.0;
-    auto type = dbi_result_get_field_type (m_inst->m_dbi_result, col);
-    auto attrs = dbi_result_get_field_attribs (m_inst->m_dbi_result, col);
-    if(type != DBI_TYPE_DECIMAL ||
-       (attrs & DBI_DECIMAL_SIZEMASK) != DBI_DECIMAL_SIZE4)
+    auto column = m_inst->column(col);
+    if(!column || column->type != DBI_TYPE_DECIMAL ||
+       (column->attribs & DBI_DECIMAL_SIZEMASK) != DBI_DECIMAL_SIZE4)
         return std::nullopt;
     auto locale = gnc_push_locale (LC_NUMERIC, "C");
-    auto interim =  dbi_result_get_float(m_inst->m_dbi_result, col);
+    auto interim =  dbi_result_get_float_idx(m_inst->m_dbi_result, column->idx);
     gnc_pop_locale (LC_NUMERIC, locale);
     double retval = static_cast<double>(round(interim * float_precision)) / float_precision;
     return std::optional<double>{retval};
@@ -126,13 +151,12 @@ GncDbiSqlResult::IteratorImpl::get_float_at_col(const char* col) const
 std::optional<double>
 GncDbiSqlResult::IteratorImpl::get_double_at_col(const char* col) const
 {
-    auto type = dbi_result_get_field_type (m_inst->m_dbi_result, col);
-    auto attrs = dbi_result_get_field_attribs (m_inst->m_dbi_result, col);
-    if(type != DBI_TYPE_DECIMAL ||
-       (attrs & DBI_DECIMAL_SIZEMASK) != DBI_DECIMAL_SIZE8)
+    auto column = m_inst->column(col);
+    if(!column || column->type != DBI_TYPE_DECIMAL ||
+       (column->attribs & DBI_DECIMAL_SIZEMASK) != DBI_DECIMAL_SIZE8)
         return std::nullopt;
     auto locale = gnc_push_locale (LC_NUMERIC, "C");
-    auto retval =  dbi_result_get_double(m_inst->m_dbi_result, col);
+    auto retval =  dbi_result_get_double_idx(m_inst->m_dbi_result, column->idx);
     gnc_pop_locale (LC_NUMERIC, locale);
     return std::optional<double>{retval};
 }
@@ -140,11 +164,10 @@ GncDbiSqlResult::IteratorImpl::get_double_at_col(const char* col) const
 std::optional<std::string>
 GncDbiSqlResult::IteratorImpl::get_string_at_col(const char* col) const
 {
-    auto type = dbi_result_get_field_type (m_inst->m_dbi_result, col);
-    dbi_result_get_field_attribs (m_inst->m_dbi_result, col);
-    if(type != DBI_TYPE_STRING)
+    auto column = m_inst->column(col);
+    if(!column || column->type != DBI_TYPE_STRING)
         return std::nullopt;
-    auto strval = dbi_result_get_string(m_inst->m_dbi_result, col);
+    auto strval = dbi_result_get_string_idx(m_inst->m_dbi_result, column->idx);
     return std::optional<std::string>{strval ? strval : ""};
 }
 
@@ -152,15 +175,14 @@ std::optional<time64>
 GncDbiSqlResult::IteratorImpl::get_time64_at_col (const char* col) const
 {
     auto result = (dbi_result_t*) (m_inst->m_dbi_result);
-    auto type = dbi_result_get_field_type (result, col);
-    dbi_result_get_field_attribs (result, col);
-    if (type != DBI_TYPE_DATETIME)
+    auto column = m_inst->column(col);
+    if (!column || column->type != DBI_TYPE_DATETIME)
         return std::nullopt;
 #if HAVE_LIBDBI_TO_LONGLONG
     /* A less evil hack than the one required by libdbi-0.8, but
      * still necessary to work around the same bug.
      */
-    auto timeval = dbi_result_get_as_longlong(result, col);
+    auto timeval = dbi_result_get_as_longlong_idx(result, column->idx);
 #else
     /* A seriously evil hack to work around libdbi bug #15
      * https://sourceforge.net/p/libdbi/bugs/15/. When libdbi
@@ -169,14 +191,22 @@ GncDbiSqlResult::IteratorImpl::get_time64_at_col (const char* col) const
      * Note: 0.9 is available in Debian Jessie and Fedora 21.
      */
     auto row = dbi_result_get_currow (result);
-    auto idx = dbi_result_get_field_idx (result, col) - 1;
-    time64 timeval = result->rows[row]->field_values[idx].d_datetime;
+    time64 timeval = result->rows[row]->field_values[column->idx - 1].d_datetime;
 #endif //HAVE_LIBDBI_TO_LONGLONG
     if (timeval < MINTIME || timeval > MAXTIME)
         timeval = 0;
     return std::optional<time64>(timeval);
 }
 
+bool
+GncDbiSqlResult::IteratorImpl::is_col_null(const char* col) const noexcept
+{
+    auto column = m_inst->column(col);
+    if (!column)
+        return true;
+    return dbi_result_field_is_null_idx(m_inst->m_dbi_result, column->idx);
+}
+
 
 /* --------------------------------------------------------- */
 
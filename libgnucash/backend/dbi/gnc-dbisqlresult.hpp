@@ -26,6 +26,9 @@
 #define __GNC_DBISQLBACKEND_HPP__
 
 #include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "gnc-backend-dbi.h"
 #include <gnc-sql-result.hpp>
@@ -60,20 +63,33 @@ protected:
         virtual std::optional<double> get_double_at_col (const char* col) const;
         virtual std::optional<std::string> get_string_at_col (const char* col)const;
         virtual std::optional<time64> get_time64_at_col (const char* col) const;
-        virtual bool is_col_null(const char* col) const noexcept
-        {
-            return dbi_result_field_is_null(m_inst->m_dbi_result, col);
-        }
+        virtual bool is_col_null(const char* col) const noexcept;
     private:
         GncDbiSqlResult* m_inst = nullptr;
     };
 
 private:
+    /** A column's index, type and attributes don't change from row to row,
+     * so they're looked up once per result set.  Callers pass the names
+     * from their column tables, so the cache is keyed on the name pointer
+     * and a hit is confirmed by comparing the name.
+     */
+    struct Column
+    {
+        unsigned int idx;
+        unsigned short type;
+        unsigned int attribs;
+    };
+    const Column* column(const char* col) const;
+
     const GncDbiSqlConnection* m_conn = nullptr;
     dbi_result m_dbi_result;
     IteratorImpl m_iter;
     GncSqlRow m_row;
     GncSqlRow m_sentinel;
+    mutable std::vector<Column> m_columns;
+    mutable std::unordered_map<const char*,
+                               std::pair<std::string, size_t>> m_column_cache;
 
 };
 
@@ -34,6 +34,7 @@
 #include <glib/gi18n.h>
 
 #include <qof.h>
+#include <qofinstance-p.h>
 /* For cleaning up the database */
 #include <dbi/dbi.h>
 #include <gnc-uri-utils.h>
@@ -42,6 +43,7 @@
 #include <TransLog.h>
 #include "Transaction.h"
 #include "Split.h"
+#include "gnc-lot.h"
 #include "gnc-commodity.h"
 #include "gncAddress.h"
 #include "gncCustomer.h"
@@ -416,6 +418,655 @@ test_dbi_store_and_reload (Fixture* fixture, gconstpointer pData)
     qof_session_destroy (session_3);
 }
 
+static void
+compare_account_balance (Account* acct, gpointer data)
+{
+    auto other = xaccAccountLookup (xaccAccountGetGUID (acct),
+                                    static_cast<QofBook*> (data));
+    g_assert_nonnull (other);
+    g_assert_true (gnc_numeric_equal (xaccAccountGetBalance (acct),
+                                      xaccAccountGetBalance (other)));
+    g_assert_true (gnc_numeric_equal (xaccAccountGetClearedBalance (acct),
+                                      xaccAccountGetClearedBalance (other)));
+    g_assert_true (gnc_numeric_equal (xaccAccountGetReconciledBalance (acct),
+                                      xaccAccountGetReconciledBalance (other)));
+    auto now = gnc_time (nullptr);
+    g_assert_true (gnc_numeric_equal (
+                       xaccAccountGetNoclosingBalanceAsOfDateInCurrency (
+                           acct, now, nullptr, FALSE),
+                       xaccAccountGetNoclosingBalanceAsOfDateInCurrency (
+                           other, now, nullptr, FALSE)));
+}
+
+static void
+find_earliest_trans (QofInstance* inst, gpointer data)
+{
+    auto earliest = static_cast<Transaction**> (data);
+    auto trans = GNC_TRANSACTION (inst);
+    if (!*earliest || xaccTransGetDate (trans) < xaccTransGetDate (*earliest))
+        *earliest = trans;
+}
+
+static void
+test_dbi_lazy_load (Fixture* fixture, gconstpointer pData)
+{
+    const gchar* url = (const gchar*)pData;
+    auto msg = "[GncDbiSqlConnection::unlock_database()] There was no lock entry in the Lock table";
+    auto log_domain = nullptr;
+    auto loglevel = static_cast<GLogLevelFlags> (G_LOG_LEVEL_WARNING |
+                                                 G_LOG_FLAG_FATAL);
+    TestErrorStruct* check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    if (fixture->filename)
+        url = fixture->filename;
+
+    // Save the session data
+    auto book2{qof_book_new()};
+    auto session_2 = qof_session_new (book2);
+    qof_session_begin (session_2, url, SESSION_NEW_OVERWRITE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_swap_data (fixture->session, session_2);
+    book2 = qof_session_get_book (session_2);
+    // A closing transaction that isn't loaded counts in the balance only.
+    Transaction* closing = nullptr;
+    qof_collection_foreach (qof_book_get_collection (book2, GNC_ID_TRANS),
+                            find_earliest_trans, &closing);
+    g_assert_nonnull (closing);
+    xaccTransBeginEdit (closing);
+    xaccTransSetIsClosingTxn (closing, TRUE);
+    xaccTransCommitEdit (closing);
+    qof_book_mark_session_dirty (qof_session_get_book (session_2));
+    qof_session_save (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    auto book2_trans = qof_collection_count (
+        qof_book_get_collection (book2, GNC_ID_TRANS));
+
+    // Reload only the last day's transactions; the test data are older.
+    gnc_prefs_set_sql_load_days (1);
+    auto book3{qof_book_new()};
+    auto session_3 = qof_session_new (book3);
+    qof_session_begin (session_3, url, SESSION_READ_ONLY);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    gnc_prefs_set_sql_load_days (0);
+
+    g_assert_cmpuint (qof_collection_count (
+                          qof_book_get_collection (book3, GNC_ID_TRANS)),
+                      <, book2_trans);
+    // The balances include what's still in the database.
+    gnc_account_foreach_descendant (gnc_book_get_root_account (book2),
+                                    (AccountCb)compare_account_balance, book3);
+
+    // Running a split query loads the rest.
+    auto query = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (query, book3);
+    qof_query_run (query);
+    qof_query_destroy (query);
+    g_assert_cmpuint (qof_collection_count (
+                          qof_book_get_collection (book3, GNC_ID_TRANS)),
+                      ==, book2_trans);
+    gnc_account_foreach_descendant (gnc_book_get_root_account (book2),
+                                    (AccountCb)compare_account_balance, book3);
+    compare_books (book2, book3);
+
+    qof_session_end (session_2);
+    qof_session_destroy (session_2);
+    qof_session_end (session_3);
+    qof_session_destroy (session_3);
+}
+
+static void
+compare_lot_balance (QofInstance* inst, gpointer data)
+{
+    auto lot = GNC_LOT (inst);
+    auto other = gnc_lot_lookup (qof_instance_get_guid (inst),
+                                 static_cast<QofBook*> (data));
+    g_assert_nonnull (other);
+    g_assert_cmpint (gnc_lot_count_splits (lot), ==,
+                     gnc_lot_count_splits (other));
+    g_assert_true (gnc_numeric_equal (gnc_lot_get_balance (lot),
+                                      gnc_lot_get_balance (other)));
+}
+
+static void
+find_earliest_posted (QofInstance* inst, gpointer data)
+{
+    auto earliest = static_cast<time64*> (data);
+    *earliest = std::min (*earliest,
+                          xaccTransGetDate (GNC_TRANSACTION (inst)));
+}
+
+static void
+count_orphan_split (QofInstance* inst, gpointer data)
+{
+    if (!xaccSplitGetAccount (GNC_SPLIT (inst)))
+        ++*static_cast<guint*> (data);
+}
+
+/* A lazily loaded book has to behave like a whole one where the engine
+ * depends on an account's or a lot's full history. */
+static void
+test_dbi_lazy_load_history (Fixture* fixture, gconstpointer pData)
+{
+    const gchar* url = (const gchar*)pData;
+    auto msg = "[GncDbiSqlConnection::unlock_database()] There was no lock entry in the Lock table";
+    auto log_domain = nullptr;
+    auto loglevel = static_cast<GLogLevelFlags> (G_LOG_LEVEL_WARNING |
+                                                 G_LOG_FLAG_FATAL);
+    TestErrorStruct* check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    if (fixture->filename)
+        url = fixture->filename;
+
+    // Save the session data
+    auto book2{qof_book_new()};
+    auto session_2 = qof_session_new (book2);
+    qof_session_begin (session_2, url, SESSION_NEW_OVERWRITE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_swap_data (fixture->session, session_2);
+    book2 = qof_session_get_book (session_2);
+    qof_book_mark_session_dirty (qof_session_get_book (session_2));
+    qof_session_save (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_end (session_2);
+
+    // Reload only the last day's transactions; the test data are older.
+    gnc_prefs_set_sql_load_days (1);
+    auto book3{qof_book_new()};
+    auto session_3 = qof_session_new (book3);
+    qof_session_begin (session_3, url, SESSION_NORMAL_OPEN);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    gnc_prefs_set_sql_load_days (0);
+
+    // Lots and their splits are loaded whole.
+    qof_collection_foreach (qof_book_get_collection (book2, GNC_ID_LOT),
+                            compare_lot_balance, book3);
+
+    // Deleting an account deletes all of its splits, loaded or not.
+    auto accounts = gnc_account_get_descendants (gnc_book_get_root_account (book2));
+    Account* partial = nullptr;
+    for (auto node = accounts; node && !partial; node = node->next)
+    {
+        auto acct = static_cast<Account*> (node->data);
+        auto other = xaccAccountLookup (xaccAccountGetGUID (acct), book3);
+        if (!gnc_account_n_children (acct) &&
+            g_list_length (xaccAccountGetSplitList (other)) <
+            g_list_length (xaccAccountGetSplitList (acct)))
+            partial = acct;
+    }
+    g_assert_nonnull (partial);
+    auto acct_guid = *xaccAccountGetGUID (partial);
+    auto acct3 = xaccAccountLookup (&acct_guid, book3);
+    xaccAccountBeginEdit (acct3);
+    g_assert_cmpuint (g_list_length (xaccAccountGetSplitList (acct3)), ==,
+                      g_list_length (xaccAccountGetSplitList (partial)));
+    xaccAccountDestroy (acct3);
+
+    // Balances before the loaded window count the splits not loaded.
+    auto earliest = INT64_MAX;
+    qof_collection_foreach (qof_book_get_collection (book2, GNC_ID_TRANS),
+                            find_earliest_posted, &earliest);
+    for (auto node = accounts; node; node = node->next)
+    {
+        auto acct = static_cast<Account*> (node->data);
+        if (acct == partial)
+            continue;
+        auto other = xaccAccountLookup (xaccAccountGetGUID (acct), book3);
+        g_assert_true (gnc_numeric_equal (
+                           xaccAccountGetBalanceAsOfDate (acct, earliest),
+                           xaccAccountGetBalanceAsOfDate (other, earliest)));
+    }
+    g_list_free (accounts);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    qof_session_end (session_3);
+
+    auto book4{qof_book_new()};
+    auto session_4 = qof_session_new (book4);
+    qof_session_begin (session_4, url, SESSION_READ_ONLY);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_4, NULL);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    g_assert_null (xaccAccountLookup (&acct_guid, book4));
+    guint orphans = 0;
+    qof_collection_foreach (qof_book_get_collection (book4, GNC_ID_SPLIT),
+                            count_orphan_split, &orphans);
+    g_assert_cmpuint (orphans, ==, 0);
+
+    qof_session_destroy (session_2);
+    qof_session_destroy (session_3);
+    qof_session_end (session_4);
+    qof_session_destroy (session_4);
+}
+
+/* Commit changes to nested slots of an account in a loaded book, which
+ * writes only the changed rows, and check that they read back the same. */
+static void
+test_dbi_slots_update (Fixture* fixture, gconstpointer pData)
+{
+    const gchar* url = (const gchar*)pData;
+    auto msg = "[GncDbiSqlConnection::unlock_database()] There was no lock entry in the Lock table";
+    auto log_domain = nullptr;
+    auto loglevel = static_cast<GLogLevelFlags> (G_LOG_LEVEL_WARNING |
+                                                 G_LOG_FLAG_FATAL);
+    TestErrorStruct* check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    if (fixture->filename)
+        url = fixture->filename;
+
+    // Save the session data with some nested slots
+    auto book2{qof_book_new()};
+    auto session_2 = qof_session_new (book2);
+    qof_session_begin (session_2, url, SESSION_NEW_OVERWRITE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_swap_data (fixture->session, session_2);
+    auto book = qof_session_get_book (session_2);
+    auto acct = gnc_account_lookup_by_name (gnc_book_get_root_account (book),
+                                            "Bank 1");
+    g_assert_nonnull (acct);
+    auto frame = qof_instance_get_slots (QOF_INSTANCE (acct));
+    frame->set_path ({"nested", "kept"}, new KvpValue (INT64_C (1)));
+    frame->set_path ({"nested", "changed"}, new KvpValue (g_strdup ("old")));
+    frame->set_path ({"nested", "removed"}, new KvpValue (2.5));
+    frame->set ({"list-val"}, new KvpValue (g_list_append (nullptr,
+                                            new KvpValue (INT64_C (3)))));
+    auto acct_guid = *xaccAccountGetGUID (acct);
+    qof_book_mark_session_dirty (book);
+    qof_session_save (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_end (session_2);
+
+    // Change them in a loaded book
+    auto book3{qof_book_new()};
+    auto session_3 = qof_session_new (book3);
+    qof_session_begin (session_3, url, SESSION_NORMAL_OPEN);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    auto acct3 = xaccAccountLookup (&acct_guid, book3);
+    g_assert_nonnull (acct3);
+    auto frame3 = qof_instance_get_slots (QOF_INSTANCE (acct3));
+    g_assert_cmpint (compare (frame, frame3), ==, 0);
+
+    xaccAccountBeginEdit (acct3);
+    delete frame3->set_path ({"nested", "changed"}, new KvpValue (g_strdup ("new")));
+    delete frame3->set_path ({"nested", "removed"}, nullptr);
+    delete frame3->set_path ({"nested", "deeper", "added"},
+                             new KvpValue (gnc_numeric_create (1, 3)));
+    delete frame3->set ({"int64-val"}, nullptr);
+    auto list = g_list_append (nullptr, new KvpValue (INT64_C (3)));
+    list = g_list_append (list, new KvpValue (INT64_C (4)));
+    delete frame3->set ({"list-val"}, new KvpValue (list));
+    xaccAccountSetDescription (acct3, "Slots changed");
+    xaccAccountCommitEdit (acct3);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+
+    // Reload and compare
+    auto book4{qof_book_new()};
+    auto session_4 = qof_session_new (book4);
+    qof_session_begin (session_4, url, SESSION_READ_ONLY);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_4, NULL);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    auto acct4 = xaccAccountLookup (&acct_guid, book4);
+    g_assert_nonnull (acct4);
+    g_assert_cmpint (compare (frame3, qof_instance_get_slots (QOF_INSTANCE (acct4))),
+                     ==, 0);
+
+    qof_session_destroy (session_2);
+    qof_session_end (session_3);
+    qof_session_destroy (session_3);
+    qof_session_end (session_4);
+    qof_session_destroy (session_4);
+}
+
+/* Saving a book that was loaded from the database only writes what its
+ * commits didn't, so it mustn't try to insert everything again. */
+static void
+test_dbi_incremental_save (Fixture* fixture, gconstpointer pData)
+{
+    const gchar* url = (const gchar*)pData;
+    auto msg = "[GncDbiSqlConnection::unlock_database()] There was no lock entry in the Lock table";
+    auto log_domain = nullptr;
+    auto loglevel = static_cast<GLogLevelFlags> (G_LOG_LEVEL_WARNING |
+                                                 G_LOG_FLAG_FATAL);
+    TestErrorStruct* check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    if (fixture->filename)
+        url = fixture->filename;
+
+    // Save the session data
+    auto book2{qof_book_new()};
+    auto session_2 = qof_session_new (book2);
+    qof_session_begin (session_2, url, SESSION_NEW_OVERWRITE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_swap_data (fixture->session, session_2);
+    qof_book_mark_session_dirty (qof_session_get_book (session_2));
+    qof_session_save (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_end (session_2);
+
+    // Load it, change it and save it
+    auto book3{qof_book_new()};
+    auto session_3 = qof_session_new (book3);
+    qof_session_begin (session_3, url, SESSION_NORMAL_OPEN);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    auto acct = gnc_account_lookup_by_name (gnc_book_get_root_account (book3),
+                                            "Bank 1");
+    g_assert_nonnull (acct);
+    xaccAccountBeginEdit (acct);
+    xaccAccountSetName (acct, "Bank 2");
+    xaccAccountCommitEdit (acct);
+    qof_book_mark_session_dirty (book3);
+    qof_session_save (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    g_assert_false (qof_book_session_not_saved (book3));
+
+    // Reload and compare
+    auto book4{qof_book_new()};
+    auto session_4 = qof_session_new (book4);
+    qof_session_begin (session_4, url, SESSION_READ_ONLY);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_4, NULL);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    compare_books (book3, book4);
+
+    qof_session_destroy (session_2);
+    qof_session_end (session_3);
+    qof_session_destroy (session_3);
+    qof_session_end (session_4);
+    qof_session_destroy (session_4);
+}
+
+/* With write-behind, commits in a loaded book are written by the writer
+ * thread; closing the session has to wait until they are in the database. */
+static void
+test_dbi_write_behind (Fixture* fixture, gconstpointer pData)
+{
+    const gchar* url = (const gchar*)pData;
+    auto msg = "[GncDbiSqlConnection::unlock_database()] There was no lock entry in the Lock table";
+    auto log_domain = nullptr;
+    auto loglevel = static_cast<GLogLevelFlags> (G_LOG_LEVEL_WARNING |
+                                                 G_LOG_FLAG_FATAL);
+    TestErrorStruct* check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    if (fixture->filename)
+        url = fixture->filename;
+
+    // Save the session data
+    auto book2{qof_book_new()};
+    auto session_2 = qof_session_new (book2);
+    qof_session_begin (session_2, url, SESSION_NEW_OVERWRITE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_swap_data (fixture->session, session_2);
+    qof_book_mark_session_dirty (qof_session_get_book (session_2));
+    qof_session_save (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_end (session_2);
+
+    // Load it, add to it and change it, and close it without saving
+    gnc_prefs_set_sql_write_behind (10);
+    auto book3{qof_book_new()};
+    auto session_3 = qof_session_new (book3);
+    qof_session_begin (session_3, url, SESSION_NORMAL_OPEN);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    auto root = gnc_book_get_root_account (book3);
+    auto acct = gnc_account_lookup_by_name (root, "Bank 1");
+    g_assert_nonnull (acct);
+    auto new_acct = xaccMallocAccount (book3);
+    xaccAccountBeginEdit (new_acct);
+    xaccAccountSetName (new_acct, "Bank 3");
+    xaccAccountSetType (new_acct, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (new_acct, xaccAccountGetCommodity (acct));
+    gnc_account_append_child (root, new_acct);
+    xaccAccountCommitEdit (new_acct);
+    xaccAccountBeginEdit (acct);
+    xaccAccountSetName (acct, "Bank 2");
+    xaccAccountCommitEdit (acct);
+    g_assert_false (qof_book_session_not_saved (book3));
+    qof_session_end (session_3);
+    gnc_prefs_set_sql_write_behind (0);
+
+    // Reload and compare
+    auto book4{qof_book_new()};
+    auto session_4 = qof_session_new (book4);
+    qof_session_begin (session_4, url, SESSION_READ_ONLY);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_4, NULL);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    compare_books (book3, book4);
+
+    qof_session_destroy (session_2);
+    qof_session_destroy (session_3);
+    qof_session_end (session_4);
+    qof_session_destroy (session_4);
+}
+
+static void
+run_sql (QofBook* book, const char* sql)
+{
+    auto sql_be = static_cast<GncSqlBackend*> (qof_book_get_backend (book));
+    auto stmt = sql_be->create_statement_from_sql (sql);
+    g_assert_nonnull (stmt);
+    g_assert_cmpint (sql_be->execute_nonselect_statement (stmt), !=, -1);
+}
+
+/* With write-behind, a commit that can't be written mustn't keep the
+ * commits queued with it out of the database.  It is kept for the next
+ * save, which reports that it couldn't write it, and written by the save
+ * after the cause has gone. */
+static void
+test_dbi_write_behind_failure (Fixture* fixture, gconstpointer pData)
+{
+    const gchar* url = (const gchar*)pData;
+    auto msg = "[GncDbiSqlConnection::unlock_database()] There was no lock entry in the Lock table";
+    auto log_domain = nullptr;
+    auto loglevel = static_cast<GLogLevelFlags> (G_LOG_LEVEL_WARNING |
+                                                 G_LOG_FLAG_FATAL);
+    TestErrorStruct* check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    if (fixture->filename)
+        url = fixture->filename;
+
+    // Save the session data
+    auto book2{qof_book_new()};
+    auto session_2 = qof_session_new (book2);
+    qof_session_begin (session_2, url, SESSION_NEW_OVERWRITE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_swap_data (fixture->session, session_2);
+    qof_book_mark_session_dirty (qof_session_get_book (session_2));
+    qof_session_save (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_end (session_2);
+
+    gnc_prefs_set_sql_write_behind (10);
+    auto book3{qof_book_new()};
+    auto session_3 = qof_session_new (book3);
+    qof_session_begin (session_3, url, SESSION_NORMAL_OPEN);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    auto root = gnc_book_get_root_account (book3);
+    auto acct = gnc_account_lookup_by_name (root, "Bank 1");
+    g_assert_nonnull (acct);
+    auto acct_guid = *xaccAccountGetGUID (acct);
+
+    /* A row put in the accounts table under the new account's guid keeps
+     * its INSERT out. */
+    auto blocked = xaccMallocAccount (book3);
+    auto blocked_guid = *xaccAccountGetGUID (blocked);
+    char guid_buf[GUID_ENCODING_LENGTH + 1];
+    guid_to_string_buff (&blocked_guid, guid_buf);
+    auto insert_blocker = std::string{"INSERT INTO accounts (guid, name, "
+        "account_type, commodity_scu, non_std_scu) VALUES ('"} + guid_buf
+        + "', 'Blocker', 'BANK', 100, 0)";
+    run_sql (book3, insert_blocker.c_str ());
+
+    /* The writer logs the failed INSERT and the database's error. */
+    g_test_log_set_fatal_handler ((GTestLogFatalFunc)test_null_handler, nullptr);
+    xaccAccountBeginEdit (blocked);
+    xaccAccountSetName (blocked, "Blocked");
+    xaccAccountSetType (blocked, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (blocked, xaccAccountGetCommodity (acct));
+    gnc_account_append_child (root, blocked);
+    xaccAccountCommitEdit (blocked);
+
+    auto new_acct = xaccMallocAccount (book3);
+    xaccAccountBeginEdit (new_acct);
+    xaccAccountSetName (new_acct, "Bank 3");
+    xaccAccountSetType (new_acct, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (new_acct, xaccAccountGetCommodity (acct));
+    gnc_account_append_child (root, new_acct);
+    xaccAccountCommitEdit (new_acct);
+    xaccAccountBeginEdit (acct);
+    xaccAccountSetName (acct, "Bank 2");
+    xaccAccountCommitEdit (acct);
+
+    qof_session_save (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), != , ERR_BACKEND_NO_ERR);
+    g_assert_true (qof_book_session_not_saved (book3));
+
+    /* Changed again while its INSERT is still missing. */
+    xaccAccountBeginEdit (blocked);
+    xaccAccountSetName (blocked, "Unblocked");
+    xaccAccountCommitEdit (blocked);
+    g_assert_true (qof_book_session_not_saved (book3));
+
+    check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    auto delete_blocker = std::string{"DELETE FROM accounts WHERE guid = '"}
+        + guid_buf + "'";
+    run_sql (book3, delete_blocker.c_str ());
+    qof_session_save (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    g_assert_false (qof_book_session_not_saved (book3));
+    qof_session_end (session_3);
+    gnc_prefs_set_sql_write_behind (0);
+
+    // Reload: everything was written, the blocked account as it is now
+    auto book4{qof_book_new()};
+    auto session_4 = qof_session_new (book4);
+    qof_session_begin (session_4, url, SESSION_READ_ONLY);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_4, NULL);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    auto root4 = gnc_book_get_root_account (book4);
+    auto acct4 = xaccAccountLookup (&acct_guid, book4);
+    g_assert_nonnull (acct4);
+    g_assert_cmpstr (xaccAccountGetName (acct4), ==, "Bank 2");
+    g_assert_nonnull (gnc_account_lookup_by_name (root4, "Bank 3"));
+    auto blocked4 = xaccAccountLookup (&blocked_guid, book4);
+    g_assert_nonnull (blocked4);
+    g_assert_cmpstr (xaccAccountGetName (blocked4), ==, "Unblocked");
+    g_assert_true (gnc_account_get_parent (blocked4) == root4);
+
+    qof_session_destroy (session_2);
+    qof_session_destroy (session_3);
+    qof_session_end (session_4);
+    qof_session_destroy (session_4);
+}
+
+/* The engine frees a destroyed object once the backend has taken its
+ * commit, so a write-behind delete that fails has to be sent again by the
+ * next save.  A trigger makes the delete fail; only sqlite3's syntax is
+ * used. */
+static void
+test_dbi_write_behind_failed_delete (Fixture* fixture, gconstpointer pData)
+{
+    const gchar* url = (const gchar*)pData;
+    auto msg = "[GncDbiSqlConnection::unlock_database()] There was no lock entry in the Lock table";
+    auto log_domain = nullptr;
+    auto loglevel = static_cast<GLogLevelFlags> (G_LOG_LEVEL_WARNING |
+                                                 G_LOG_FLAG_FATAL);
+    TestErrorStruct* check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    if (fixture->filename)
+        url = fixture->filename;
+
+    // Save the session data
+    auto book2{qof_book_new()};
+    auto session_2 = qof_session_new (book2);
+    qof_session_begin (session_2, url, SESSION_NEW_OVERWRITE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_swap_data (fixture->session, session_2);
+    qof_book_mark_session_dirty (qof_session_get_book (session_2));
+    qof_session_save (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_end (session_2);
+
+    gnc_prefs_set_sql_write_behind (10);
+    auto book3{qof_book_new()};
+    auto session_3 = qof_session_new (book3);
+    qof_session_begin (session_3, url, SESSION_NORMAL_OPEN);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    auto root = gnc_book_get_root_account (book3);
+    auto acct = gnc_account_lookup_by_name (root, "Bank 1");
+    g_assert_nonnull (acct);
+
+    auto doomed = xaccMallocAccount (book3);
+    xaccAccountBeginEdit (doomed);
+    xaccAccountSetName (doomed, "Doomed");
+    xaccAccountSetType (doomed, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (doomed, xaccAccountGetCommodity (acct));
+    gnc_account_append_child (root, doomed);
+    xaccAccountCommitEdit (doomed);
+    qof_session_save (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+
+    run_sql (book3, "CREATE TRIGGER keep_accounts BEFORE DELETE ON accounts "
+             "BEGIN SELECT RAISE(ABORT, 'kept'); END");
+    /* The writer logs the failed DELETE and the database's error. */
+    g_test_log_set_fatal_handler ((GTestLogFatalFunc)test_null_handler, nullptr);
+    xaccAccountBeginEdit (doomed);
+    xaccAccountDestroy (doomed);
+
+    qof_session_save (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), != , ERR_BACKEND_NO_ERR);
+    g_assert_true (qof_book_session_not_saved (book3));
+
+    check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    run_sql (book3, "DROP TRIGGER keep_accounts");
+    qof_session_save (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    g_assert_false (qof_book_session_not_saved (book3));
+    qof_session_end (session_3);
+    gnc_prefs_set_sql_write_behind (0);
+
+    // Reload: the account stayed deleted
+    auto book4{qof_book_new()};
+    auto session_4 = qof_session_new (book4);
+    qof_session_begin (session_4, url, SESSION_READ_ONLY);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_4, NULL);
+    g_assert_cmpint (qof_session_get_error (session_4), == , ERR_BACKEND_NO_ERR);
+    auto root4 = gnc_book_get_root_account (book4);
+    g_assert_nonnull (gnc_account_lookup_by_name (root4, "Bank 1"));
+    g_assert_null (gnc_account_lookup_by_name (root4, "Doomed"));
+
+    qof_session_destroy (session_2);
+    qof_session_destroy (session_3);
+    qof_session_end (session_4);
+    qof_session_destroy (session_4);
+}
+
 /** Test the safe_save mechanism.  Beware that this test used on its
  * own doesn't ensure that the resave is done safely, only that the
  * database is intact and unchanged after the save. To observe the
@@ -637,6 +1288,22 @@ create_dbi_test_suite (const char* dbm_name, const char* url)
     auto subsuite = g_strdup_printf ("%s/%s", suitename, dbm_name);
     GNC_TEST_ADD (subsuite, "store_and_reload", Fixture, url, setup,
                   test_dbi_store_and_reload, teardown);
+    GNC_TEST_ADD (subsuite, "lazy_load", Fixture, url, setup,
+                  test_dbi_lazy_load, teardown);
+    GNC_TEST_ADD (subsuite, "lazy_load_history", Fixture, url, setup,
+                  test_dbi_lazy_load_history, teardown);
+    GNC_TEST_ADD (subsuite, "slots_update", Fixture, url, setup_memory,
+                  test_dbi_slots_update, teardown);
+    GNC_TEST_ADD (subsuite, "incremental_save", Fixture, url, setup_memory,
+                  test_dbi_incremental_save, teardown);
+    GNC_TEST_ADD (subsuite, "write_behind", Fixture, url, setup_memory,
+                  test_dbi_write_behind, teardown);
+    GNC_TEST_ADD (subsuite, "write_behind_failure", Fixture, url,
+                  setup_memory, test_dbi_write_behind_failure, teardown);
+    if (g_strcmp0 (url, "sqlite3") == 0)
+        GNC_TEST_ADD (subsuite, "write_behind_failed_delete", Fixture, url,
+                      setup_memory, test_dbi_write_behind_failed_delete,
+                      teardown);
     GNC_TEST_ADD (subsuite, "safe_save", Fixture, url, setup_memory,
                   test_dbi_safe_save, teardown);
     GNC_TEST_ADD (subsuite, "version_control", Fixture, url, setup_memory,
@@ -156,6 +156,7 @@ GncSqlCommodityBackend::load_all (GncSqlBackend* sql_be)
             if (qof_instance_is_dirty (QOF_INSTANCE (pCommodity)))
                 sql_be->commodity_for_postload_processing(pCommodity);
             qof_instance_set_guid (QOF_INSTANCE (pCommodity), &guid);
+            sql_be->commodity_loaded (pCommodity);
         }
 
     }
@@ -37,8 +37,13 @@
 #include "splint-defs.h"
 #endif
 
+#include <algorithm>
+#include <memory>
+#include <set>
 #include <string>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 
 #include "gnc-sql-connection.hpp"
 #include "gnc-sql-backend.hpp"
@@ -53,22 +58,12 @@ static QofLogModule log_module = G_LOG_DOMAIN;
 #define TABLE_NAME "slots"
 #define TABLE_VERSION 4
 
-typedef enum
-{
-    NONE,
-    FRAME,
-    LIST
-} context_t;
-
 struct slot_info_t
 {
     GncSqlBackend* be;
     const GncGUID* guid;
     gboolean is_ok;
-    KvpFrame* pKvpFrame;
     KvpValue::Type value_type;
-    GList* pList;
-    context_t context;
     KvpValue* pKvpValue;
     std::string path;
     std::string parent_path;
@@ -96,7 +91,6 @@ static void set_numeric_val (gpointer pObject, gnc_numeric value);
 static GDate* get_gdate_val (gpointer pObject);
 static void set_gdate_val (gpointer pObject, GDate* value);
 static slot_info_t* slot_info_copy (slot_info_t* pInfo, GncGUID* guid);
-static void slots_load_info (slot_info_t* pInfo);
 
 #define SLOT_MAX_PATHNAME_LEN 4096
 #define SLOT_MAX_STRINGVAL_LEN 4096
@@ -183,50 +177,16 @@ GncSqlSlotsBackend::GncSqlSlotsBackend() :
 
 /* ================================================================= */
 
-static std::string
-get_key (slot_info_t* pInfo)
-{
-    if (!pInfo) return "";
-
-    auto path = pInfo->path;
-    path.erase (0, pInfo->parent_path.size());
-    return path;
-}
-
+/* Loading a row leaves its value in pKvpValue; the frames are built once
+ * all of the rows they're made from have been read. */
 static void
 set_slot_from_value (slot_info_t* pInfo, KvpValue* pValue)
 {
     g_return_if_fail (pInfo != NULL);
     g_return_if_fail (pValue != NULL);
 
-    switch (pInfo->context)
-    {
-    case FRAME:
-    {
-        auto key = get_key (pInfo);
-        pInfo->pKvpFrame->set ({key}, pValue);
-        break;
-    }
-    case LIST:
-    {
-        pInfo->pList = g_list_append (pInfo->pList, pValue);
-        break;
-    }
-    case NONE:
-    default:
-    {
-        auto key = get_key (pInfo);
-        auto path = pInfo->parent_path;
-        auto frame = pInfo->pKvpFrame;
-        if (!path.empty())
-        {
-            frame->set_path ({path, key}, pValue);
-        }
-        else
-            frame->set ({key}, pValue);
-        break;
-    }
-    }
+    delete pInfo->pKvpValue;
+    pInfo->pKvpValue = pValue;
 }
 
 static  gpointer
@@ -260,8 +220,6 @@ set_path (gpointer pObject,  gpointer pValue)
 {
     slot_info_t* pInfo = (slot_info_t*)pObject;
     pInfo->path = static_cast<char*>(pValue);
-    if (pInfo->path.find (pInfo->parent_path) != 0)
-        pInfo->parent_path.clear();
 }
 
 static KvpValue::Type
@@ -425,55 +383,16 @@ set_guid_val (gpointer pObject,  gpointer pValue)
     g_return_if_fail (pObject != NULL);
     if (pValue == NULL) return;
 
+    /* Frames and lists keep the guid that their contents are stored
+     * under. */
     switch (pInfo->value_type)
     {
     case KvpValue::Type::GUID:
-    {
-        auto new_guid = guid_copy (static_cast<GncGUID*> (pValue));
-        set_slot_from_value (pInfo, new KvpValue {new_guid});
-        break;
-    }
     case KvpValue::Type::GLIST:
-    {
-        slot_info_t* newInfo = slot_info_copy (pInfo, (GncGUID*)pValue);
-        KvpValue* pValue = NULL;
-        auto key = get_key (pInfo);
-
-        newInfo->context = LIST;
-
-        slots_load_info (newInfo);
-        pValue = new KvpValue {newInfo->pList};
-        pInfo->pKvpFrame->set ({key.c_str()}, pValue);
-	delete newInfo;
-        break;
-    }
     case KvpValue::Type::FRAME:
     {
-        slot_info_t* newInfo = slot_info_copy (pInfo, (GncGUID*)pValue) ;
-        auto newFrame = new KvpFrame;
-        newInfo->pKvpFrame = newFrame;
-
-        switch (pInfo->context)
-        {
-        case LIST:
-        {
-            auto value = new KvpValue {newFrame};
-            newInfo->path = get_key (pInfo);
-            pInfo->pList = g_list_append (pInfo->pList, value);
-            break;
-        }
-        case FRAME:
-        default:
-        {
-            auto key = get_key (pInfo);
-            pInfo->pKvpFrame->set ({key.c_str()}, new KvpValue {newFrame});
-            break;
-        }
-        }
-
-        newInfo->context = FRAME;
-        slots_load_info (newInfo);
-        delete newInfo;
+        auto new_guid = guid_copy (static_cast<GncGUID*> (pValue));
+        set_slot_from_value (pInfo, new KvpValue {new_guid});
         break;
     }
     default:
@@ -548,10 +467,7 @@ slot_info_copy (slot_info_t* pInfo, GncGUID* guid)
     newSlot->be = pInfo->be;
     newSlot->guid = guid == NULL ? pInfo->guid : guid;
     newSlot->is_ok = pInfo->is_ok;
-    newSlot->pKvpFrame = pInfo->pKvpFrame;
     newSlot->value_type = pInfo->value_type;
-    newSlot->pList = pInfo->pList;
-    newSlot->context = pInfo->context;
     newSlot->pKvpValue = pInfo->pKvpValue;
     if (!pInfo->path.empty())
         newSlot->parent_path = pInfo->path + "/";
@@ -629,170 +545,387 @@ save_slot (const char* key, KvpValue* value, slot_info_t & slot_info)
     }
 }
 
-gboolean
-gnc_sql_slots_save (GncSqlBackend* sql_be, const GncGUID* guid, gboolean is_infant,
-                    QofInstance* inst)
+/* ================================================================= */
+/* A frame or list is saved as a row whose guid_val is a new guid, and its
+ * contents as rows with that guid as their obj_guid, so the slots of an
+ * object are a tree of rows.  They're read one level of the tree at a time
+ * for all of the objects at once, sorted by (obj_guid, name), and the
+ * frames are built from them in one pass.
+ */
+struct SlotRow
+{
+    GncGUID obj_guid;
+    int64_t id;
+    std::string name;
+    KvpValue::Type type;
+    /* For frames and lists, the guid of their contents. */
+    std::unique_ptr<KvpValue> value;
+};
+using SlotRows = std::vector<SlotRow>;
+using SlotRowRange = std::pair<SlotRows::iterator, SlotRows::iterator>;
+
+#define MAX_IN_LIST_LEN 500
+
+static  const GncGUID*
+load_obj_guid (const GncSqlBackend* sql_be, GncSqlRow& row)
 {
-    slot_info_t slot_info = { NULL, NULL, TRUE, NULL, KvpValue::Type::INVALID,
-                              NULL, FRAME, NULL, "" };
-    KvpFrame* pFrame = qof_instance_get_slots (inst);
+    static GncGUID guid;
 
-    g_return_val_if_fail (sql_be != NULL, FALSE);
-    g_return_val_if_fail (guid != NULL, FALSE);
-    g_return_val_if_fail (pFrame != NULL, FALSE);
+    g_return_val_if_fail (sql_be != NULL, NULL);
 
-    // If this is not saving into a new db, clear out the old saved slots first
-    if (!sql_be->pristine() && !is_infant)
-    {
-        (void)gnc_sql_slots_delete (sql_be, guid);
-    }
+    gnc_sql_load_object (sql_be, row, NULL, &guid, obj_guid_col_table);
 
-    slot_info.be = sql_be;
-    slot_info.guid = guid;
-    pFrame->for_each_slot_temp (save_slot, slot_info);
+    return &guid;
+}
+
+static SlotRow
+load_slot_row (GncSqlBackend* sql_be, GncSqlRow& row)
+{
+    slot_info_t slot_info = { sql_be, NULL, TRUE, KvpValue::Type::INVALID,
+                              NULL, "" };
 
-    return slot_info.is_ok;
+    gnc_sql_load_object (sql_be, row, TABLE_NAME, &slot_info, col_table);
+    auto id = row.get_int_at_col (col_table[id_col]->name());
+    return {*load_obj_guid (sql_be, row), id.value_or (0),
+            std::move (slot_info.path), slot_info.value_type,
+            std::unique_ptr<KvpValue> {slot_info.pKvpValue}};
 }
 
-gboolean
-gnc_sql_slots_delete (GncSqlBackend* sql_be, const GncGUID* guid)
+static void
+load_slot_rows (GncSqlBackend* sql_be, const std::string& sql, SlotRows& rows)
 {
-    gchar* buf;
-    gchar guid_buf[GUID_ENCODING_LENGTH + 1];
-    slot_info_t slot_info = { NULL, NULL, TRUE, NULL, KvpValue::Type::INVALID,
-                              NULL, FRAME, NULL, "" };
+    auto stmt = sql_be->create_statement_from_sql(sql);
+    if (stmt == nullptr)
+    {
+        PERR ("stmt == NULL, SQL = '%s'\n", sql.c_str());
+        return;
+    }
+    auto result = sql_be->execute_select_statement(stmt);
+    for (auto row : *result)
+        rows.push_back (load_slot_row (sql_be, row));
+    delete result;
+}
 
-    g_return_val_if_fail (sql_be != NULL, FALSE);
-    g_return_val_if_fail (guid != NULL, FALSE);
+static bool
+is_container (const SlotRow& row)
+{
+    return row.value && (row.type == KvpValue::Type::FRAME ||
+                         row.type == KvpValue::Type::GLIST);
+}
 
-    (void)guid_to_string_buff (guid, guid_buf);
+/* Appends the contents of the frames and lists in rows to rows, a level at
+ * a time. */
+static void
+load_contained_slot_rows (GncSqlBackend* sql_be, SlotRows& rows)
+{
+    std::set<std::string> seen;
 
-    buf = g_strdup_printf ("SELECT * FROM %s WHERE obj_guid='%s' and slot_type in ('%d', '%d') and not guid_val is null",
-                           TABLE_NAME, guid_buf, KvpValue::Type::FRAME, KvpValue::Type::GLIST);
-    auto stmt = sql_be->create_statement_from_sql(buf);
-    g_free (buf);
-    if (stmt != nullptr)
+    for (size_t level = 0; level < rows.size ();)
     {
-        auto result = sql_be->execute_select_statement(stmt);
-        for (auto row : *result)
+        std::vector<std::string> containers;
+        auto level_end = rows.size ();
+        for (auto i = level; i < level_end; ++i)
         {
-            const GncSqlColumnTableEntryPtr table_row =
-                    col_table[guid_val_col];
-            GncGUID child_guid;
-            auto val = row.get_string_at_col (table_row->name());
-            if (val && string_to_guid (val->c_str(), &child_guid))
-                gnc_sql_slots_delete (sql_be, &child_guid);
+            if (!is_container (rows[i]))
+                continue;
+            auto guid = gnc::GUID{*rows[i].value->get<GncGUID*> ()}.to_string ();
+            if (seen.insert (guid).second)
+                containers.push_back (guid);
         }
+        for (size_t first = 0; first < containers.size ();
+             first += MAX_IN_LIST_LEN)
+        {
+            auto last = std::min (containers.size (),
+                                  first + MAX_IN_LIST_LEN);
+            std::string sql ("SELECT * FROM " TABLE_NAME " WHERE obj_guid IN (");
+            for (auto i = first; i < last; ++i)
+                sql += (i == first ? "'" : ",'") + containers[i] + "'";
+            sql += ")";
+            load_slot_rows (sql_be, sql, rows);
+        }
+        level = level_end;
     }
+}
 
-    slot_info.be = sql_be;
-    slot_info.guid = guid;
-    slot_info.is_ok = TRUE;
-    slot_info.is_ok = sql_be->do_db_operation(OP_DB_DELETE, TABLE_NAME,
-                                              TABLE_NAME, &slot_info,
-                                              obj_guid_col_table);
+/* Reads the slots of the objects selected by condition and everything in
+ * their frames and lists, ready for slot_rows_for (). */
+static void
+load_slot_tree (GncSqlBackend* sql_be, const std::string& condition,
+                SlotRows& rows)
+{
+    load_slot_rows (sql_be, "SELECT * FROM " TABLE_NAME " WHERE " + condition,
+                    rows);
+    load_contained_slot_rows (sql_be, rows);
+    std::stable_sort (rows.begin (), rows.end (),
+                      [](const SlotRow& a, const SlotRow& b)
+                      {
+                          auto cmp = guid_compare (&a.obj_guid, &b.obj_guid);
+                          return cmp ? cmp < 0 : a.name < b.name;
+                      });
+}
 
-    return slot_info.is_ok;
+static std::string
+guid_condition (const GncGUID* guid)
+{
+    return std::string ("obj_guid='") + gnc::GUID{*guid}.to_string () + "'";
 }
 
+struct SlotRowGuidLess
+{
+    bool operator() (const SlotRow& row, const GncGUID* guid) const
+    {
+        return guid_compare (&row.obj_guid, guid) < 0;
+    }
+    bool operator() (const GncGUID* guid, const SlotRow& row) const
+    {
+        return guid_compare (guid, &row.obj_guid) < 0;
+    }
+};
+
+static SlotRowRange
+slot_rows_for (SlotRows& rows, const GncGUID* guid)
+{
+    return std::equal_range (rows.begin (), rows.end (), guid,
+                             SlotRowGuidLess ());
+}
+
+/* The name of a slot in a frame is the frame's name, a '/' and its key. */
+static std::string
+slot_key (const SlotRow& row, const std::string& prefix)
+{
+    if (row.name.compare (0, prefix.size (), prefix) == 0)
+        return row.name.substr (prefix.size ());
+    return row.name;
+}
+
+static KvpValue* build_slot_value (SlotRows& rows, SlotRow& row);
+
 static void
-load_slot (slot_info_t* pInfo, GncSqlRow& row)
+build_frame (SlotRows& rows, const GncGUID* guid, const std::string& prefix,
+             KvpFrame* frame)
 {
-    slot_info_t* slot_info;
+    auto range = slot_rows_for (rows, guid);
+    for (auto row = range.first; row != range.second; ++row)
+    {
+        auto value = build_slot_value (rows, *row);
+        if (value)
+            delete frame->set ({slot_key (*row, prefix)}, value);
+    }
+}
 
-    g_return_if_fail (pInfo != NULL);
-    g_return_if_fail (pInfo->be != NULL);
-    g_return_if_fail (pInfo->pKvpFrame != NULL);
+/* Takes the values out of rows.  A container's guid is dropped once it's
+ * been built, so a damaged table can't send this round in circles. */
+static KvpValue*
+build_slot_value (SlotRows& rows, SlotRow& row)
+{
+    if (!row.value)
+        return nullptr;
 
-    slot_info = slot_info_copy (pInfo, NULL);
+    switch (row.type)
+    {
+    case KvpValue::Type::FRAME:
+    {
+        std::unique_ptr<KvpValue> contents {std::move (row.value)};
+        auto frame = new KvpFrame;
+        build_frame (rows, contents->get<GncGUID*> (), row.name + "/", frame);
+        return new KvpValue {frame};
+    }
+    case KvpValue::Type::GLIST:
+    {
+        std::unique_ptr<KvpValue> contents {std::move (row.value)};
+        GList* list = NULL;
+        auto range = slot_rows_for (rows, contents->get<GncGUID*> ());
+        for (auto item = range.first; item != range.second; ++item)
+        {
+            auto value = build_slot_value (rows, *item);
+            if (value)
+                list = g_list_prepend (list, value);
+        }
+        return new KvpValue {g_list_reverse (list)};
+    }
+    default:
+        return row.value.release ();
+    }
+}
 
-    gnc_sql_load_object (pInfo->be, row, TABLE_NAME, slot_info, col_table);
+/* Whether the rows starting at row still hold value. */
+static bool
+slot_rows_match (SlotRows& rows, const SlotRow& row, KvpValue* value)
+{
+    if (!row.value || row.type != value->get_type ())
+        return false;
 
-    if (slot_info->pList != pInfo->pList)
+    switch (row.type)
+    {
+    case KvpValue::Type::FRAME:
     {
-        if (pInfo->pList != NULL)
+        auto frame = value->get<KvpFrame*> ();
+        auto range = slot_rows_for (rows, row.value->get<GncGUID*> ());
+        auto prefix = row.name + "/";
+        if (std::distance (range.first, range.second) !=
+            std::distance (frame->begin (), frame->end ()))
+            return false;
+        for (auto child = range.first; child != range.second; ++child)
         {
-            PWARN ("Load slot returned a different list than the original");
+            auto child_value = frame->get_slot ({slot_key (*child, prefix)});
+            if (!child_value || !slot_rows_match (rows, *child, child_value))
+                return false;
         }
-        else
+        return true;
+    }
+    case KvpValue::Type::GLIST:
+    {
+        auto range = slot_rows_for (rows, row.value->get<GncGUID*> ());
+        auto item = range.first;
+        for (auto node = value->get<GList*> (); node; node = node->next, ++item)
         {
-            pInfo->pList = slot_info->pList;
+            if (item == range.second ||
+                !slot_rows_match (rows, *item, static_cast<KvpValue*> (node->data)))
+                return false;
         }
+        return item == range.second;
+    }
+    default:
+        return compare (row.value.get (), value) == 0;
     }
-    delete slot_info;
 }
 
-void
-gnc_sql_slots_load (GncSqlBackend* sql_be, QofInstance* inst)
+static void
+collect_slot_row_ids (SlotRows& rows, SlotRow& row, std::vector<int64_t>& ids)
 {
-    slot_info_t info = { NULL, NULL, TRUE, NULL, KvpValue::Type::INVALID,
-                         NULL, FRAME, NULL, "" };
-    g_return_if_fail (sql_be != NULL);
-    g_return_if_fail (inst != NULL);
-
-    info.be = sql_be;
-    info.guid = qof_instance_get_guid (inst);
-    info.pKvpFrame = qof_instance_get_slots (inst);
-    info.context = NONE;
+    ids.push_back (row.id);
+    if (!is_container (row))
+        return;
+    std::unique_ptr<KvpValue> contents {std::move (row.value)};
+    auto range = slot_rows_for (rows, contents->get<GncGUID*> ());
+    for (auto child = range.first; child != range.second; ++child)
+        collect_slot_row_ids (rows, *child, ids);
+}
 
-    slots_load_info (&info);
+static gboolean
+delete_slot_rows (GncSqlBackend* sql_be, const std::vector<int64_t>& ids)
+{
+    for (size_t first = 0; first < ids.size (); first += MAX_IN_LIST_LEN)
+    {
+        auto last = std::min (ids.size (), first + MAX_IN_LIST_LEN);
+        std::stringstream sql;
+        sql << "DELETE FROM " TABLE_NAME " WHERE id IN (";
+        for (auto i = first; i < last; ++i)
+            sql << (i == first ? "" : ",") << ids[i];
+        sql << ")";
+        auto stmt = sql_be->create_statement_from_sql (sql.str ());
+        if (stmt == nullptr || sql_be->execute_nonselect_statement (stmt) == -1)
+            return FALSE;
+    }
+    return TRUE;
 }
 
+/* Brings the rows of the frame that slot_info describes up to date with
+ * frame, writing the slots that aren't in rows as they are and collecting
+ * the ids of the rows that have to go. */
 static void
-slots_load_info (slot_info_t* pInfo)
+save_frame_changes (slot_info_t& slot_info, SlotRows& rows, KvpFrame* frame,
+                    std::vector<int64_t>& stale)
 {
-    g_return_if_fail (pInfo != NULL);
-    g_return_if_fail (pInfo->be != NULL);
-    g_return_if_fail (pInfo->guid != NULL);
-    g_return_if_fail (pInfo->pKvpFrame != NULL);
+    std::unordered_map<std::string, SlotRow*> saved;
+    auto range = slot_rows_for (rows, slot_info.guid);
+    for (auto row = range.first; row != range.second; ++row)
+    {
+        if (!saved.emplace (slot_key (*row, slot_info.parent_path),
+                            &*row).second)
+            collect_slot_row_ids (rows, *row, stale);
+    }
 
-    gnc::GUID guid(*pInfo->guid);
-    std::string sql("SELECT * FROM " TABLE_NAME " WHERE obj_guid='");
-    sql += guid.to_string() + "'";
-    auto stmt = pInfo->be->create_statement_from_sql(sql);
-    if (stmt != nullptr)
+    for (auto& slot : *frame)
     {
-        auto result = pInfo->be->execute_select_statement (stmt);
-        for (auto row : *result)
-            load_slot (pInfo, row);
-        delete result;
+        auto spot = saved.find (slot.first);
+        if (spot != saved.end ())
+        {
+            auto row = spot->second;
+            saved.erase (spot);
+            if (row->type == KvpValue::Type::FRAME && row->value &&
+                slot.second->get_type () == KvpValue::Type::FRAME)
+            {
+                slot_info_t frame_info = { slot_info.be,
+                                           row->value->get<GncGUID*> (),
+                                           TRUE, KvpValue::Type::INVALID,
+                                           NULL, "", row->name + "/" };
+                save_frame_changes (frame_info, rows,
+                                    slot.second->get<KvpFrame*> (), stale);
+                slot_info.is_ok = slot_info.is_ok && frame_info.is_ok;
+                continue;
+            }
+            if (slot_rows_match (rows, *row, slot.second))
+                continue;
+            collect_slot_row_ids (rows, *row, stale);
+        }
+        save_slot (slot.first, slot.second, slot_info);
     }
+
+    for (auto& unused : saved)
+        collect_slot_row_ids (rows, *unused.second, stale);
 }
 
-static  const GncGUID*
-load_obj_guid (const GncSqlBackend* sql_be, GncSqlRow& row)
+gboolean
+gnc_sql_slots_save (GncSqlBackend* sql_be, const GncGUID* guid, gboolean is_infant,
+                    QofInstance* inst)
 {
-    static GncGUID guid;
+    slot_info_t slot_info = { NULL, NULL, TRUE, KvpValue::Type::INVALID,
+                              NULL, "" };
+    KvpFrame* pFrame = qof_instance_get_slots (inst);
 
-    g_return_val_if_fail (sql_be != NULL, NULL);
+    g_return_val_if_fail (sql_be != NULL, FALSE);
+    g_return_val_if_fail (guid != NULL, FALSE);
+    g_return_val_if_fail (pFrame != NULL, FALSE);
 
-    gnc_sql_load_object (sql_be, row, NULL, &guid, obj_guid_col_table);
+    slot_info.be = sql_be;
+    slot_info.guid = guid;
 
-    return &guid;
+    // A new db or object has no saved slots to compare with.
+    if (sql_be->pristine() || is_infant)
+    {
+        pFrame->for_each_slot_temp (save_slot, slot_info);
+        return slot_info.is_ok;
+    }
+
+    /* Otherwise only write what has changed; most commits don't touch the
+     * slots at all. */
+    SlotRows rows;
+    std::vector<int64_t> stale;
+    load_slot_tree (sql_be, guid_condition (guid), rows);
+    save_frame_changes (slot_info, rows, pFrame, stale);
+
+    return delete_slot_rows (sql_be, stale) && slot_info.is_ok;
 }
 
-static void
-load_slot_for_book_object (GncSqlBackend* sql_be, GncSqlRow& row,
-                           BookLookupFn lookup_fn)
+gboolean
+gnc_sql_slots_delete (GncSqlBackend* sql_be, const GncGUID* guid)
 {
-    slot_info_t slot_info = { NULL, NULL, TRUE, NULL, KvpValue::Type::INVALID,
-                              NULL, FRAME, NULL, "" };
-    const GncGUID* guid;
-    QofInstance* inst;
+    SlotRows rows;
+    std::vector<int64_t> ids;
 
-    g_return_if_fail (sql_be != NULL);
-    g_return_if_fail (lookup_fn != NULL);
+    g_return_val_if_fail (sql_be != NULL, FALSE);
+    g_return_val_if_fail (guid != NULL, FALSE);
 
-    guid = load_obj_guid (sql_be, row);
-    g_return_if_fail (guid != NULL);
-    inst = lookup_fn (guid, sql_be->book());
-    if (inst == NULL) return; /* Silently bail if the guid isn't loaded yet. */
+    load_slot_tree (sql_be, guid_condition (guid), rows);
+    ids.reserve (rows.size ());
+    for (auto& row : rows)
+        ids.push_back (row.id);
 
-    slot_info.be = sql_be;
-    slot_info.pKvpFrame = qof_instance_get_slots (inst);
-    slot_info.path.clear();
+    return delete_slot_rows (sql_be, ids);
+}
 
-    gnc_sql_load_object (sql_be, row, TABLE_NAME, &slot_info, col_table);
+void
+gnc_sql_slots_load (GncSqlBackend* sql_be, QofInstance* inst)
+{
+    SlotRows rows;
+
+    g_return_if_fail (sql_be != NULL);
+    g_return_if_fail (inst != NULL);
+
+    auto guid = qof_instance_get_guid (inst);
+    load_slot_tree (sql_be, guid_condition (guid), rows);
+    build_frame (rows, guid, "", qof_instance_get_slots (inst));
 }
 
 /**
@@ -808,26 +941,27 @@ void gnc_sql_slots_load_for_sql_subquery (GncSqlBackend* sql_be,
                                           const std::string subquery,
                                           BookLookupFn lookup_fn)
 {
+    SlotRows rows;
+
     g_return_if_fail (sql_be != NULL);
+    g_return_if_fail (lookup_fn != NULL);
 
     // Ignore empty subquery
     if (subquery.empty()) return;
 
     std::string pkey(obj_guid_col_table[0]->name());
-    std::string sql("SELECT * FROM " TABLE_NAME " WHERE ");
-    sql += pkey + " IN (" + subquery + ")";
+    load_slot_tree (sql_be, pkey + " IN (" + subquery + ")", rows);
 
-    // Execute the query and load the slots
-    auto stmt = sql_be->create_statement_from_sql(sql);
-    if (stmt == nullptr)
+    /* The rows of the objects themselves are the only ones whose obj_guid
+     * is in the book. */
+    for (auto row = rows.begin (); row != rows.end ();)
     {
-        PERR ("stmt == NULL, SQL = '%s'\n", sql.c_str());
-        return;
+        auto guid = row->obj_guid;
+        auto inst = lookup_fn (&guid, sql_be->book());
+        if (inst != NULL)
+            build_frame (rows, &guid, "", qof_instance_get_slots (inst));
+        row = slot_rows_for (rows, &guid).second;
     }
-    auto result = sql_be->execute_select_statement(stmt);
-    for (auto row : *result)
-        load_slot_for_book_object (sql_be, row, lookup_fn);
-    delete result;
 }
 
 /* ================================================================= */
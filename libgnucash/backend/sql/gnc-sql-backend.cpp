@@ -33,6 +33,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <iterator>
+#include <system_error>
 
 #include "gnc-sql-connection.hpp"
 #include "gnc-sql-backend.hpp"
@@ -93,6 +95,19 @@ GncSqlBackend::~GncSqlBackend()
 void
 GncSqlBackend::connect(GncSqlConnection *conn) noexcept
 {
+    if (m_conn != conn)
+    {
+        /* The writer thread uses the connection, so it has to be done first. */
+        flush_writes();
+        stop_writer();
+        if (take_failed_writes() != ERR_BACKEND_NO_ERR)
+        {
+            PERR ("%zu objects couldn't be written to the database\n",
+                  m_unsaved.size() + m_unsaved_writes.size());
+            if (m_book != nullptr)
+                qof_book_mark_session_dirty(m_book);
+        }
+    }
     if (m_conn != nullptr && m_conn != conn)
         delete m_conn;
     finalize_version_info();
@@ -113,6 +128,23 @@ GncSqlBackend::create_statement_from_sql(const std::string& str) const noexcept
 
 GncSqlResultPtr
 GncSqlBackend::execute_select_statement(const GncSqlStatementPtr& stmt) const noexcept
+{
+    if (m_queued_inserts > 0)
+        flush_inserts();
+    /* Reading has to wait for what is still being written.  Commits that
+     * couldn't be written are kept for the next save and don't stop it. */
+    if (m_deferring)
+    {
+        if (!write_deferred())
+            return nullptr;
+    }
+    else
+        flush_writes();
+    return run_select_statement(stmt);
+}
+
+GncSqlResultPtr
+GncSqlBackend::run_select_statement(const GncSqlStatementPtr& stmt) const noexcept
 {
     auto result = m_conn ? m_conn->execute_select_statement(stmt) : nullptr;
     if (result == nullptr)
@@ -126,6 +158,22 @@ GncSqlBackend::execute_select_statement(const GncSqlStatementPtr& stmt) const no
 int
 GncSqlBackend::execute_nonselect_statement(const GncSqlStatementPtr& stmt) const noexcept
 {
+    if (m_queued_inserts > 0 && !flush_inserts())
+        return -1;
+    if (!m_deferring)
+        flush_writes();
+    return run_nonselect_statement(stmt);
+}
+
+int
+GncSqlBackend::run_nonselect_statement(const GncSqlStatementPtr& stmt) const noexcept
+{
+    /* The number of rows isn't known until the writer thread sends it. */
+    if (m_deferring)
+    {
+        m_deferred.emplace_back(stmt->to_sql());
+        return 0;
+    }
     int result = m_conn ? m_conn->execute_nonselect_statement(stmt) : -1;
     if (result == -1)
     {
@@ -141,6 +189,7 @@ GncSqlBackend::quote_string(const std::string& str) const noexcept
     g_return_val_if_fail (m_conn != nullptr, empty_string);
     if (!m_conn)
         return empty_string;
+    std::lock_guard<std::mutex> lock{m_conn_mutex};
     return m_conn->quote_string(str);
 }
 
@@ -292,6 +341,7 @@ GncSqlBackend::load (QofBook* book, QofBackendLoadType loadType)
         auto num_done = 0;
 
         /* Load any initial stuff. Some of this needs to happen in a certain order */
+        auto load_days = gnc_prefs_get_sql_load_days ();
         for (const auto& type : fixed_load_order)
         {
             num_done++;
@@ -299,7 +349,10 @@ GncSqlBackend::load (QofBook* book, QofBackendLoadType loadType)
             if (obe)
             {
                 update_progress(num_done * 100 / num_types);
-                obe->load_all(this);
+                if (type == GNC_ID_TRANS && load_days > 0)
+                    std::static_pointer_cast<GncSqlTransBackend>(obe)->load_recent(this, load_days);
+                else
+                    obe->load_all(this);
             }
         }
         for (const auto& type : business_fixed_load_order)
@@ -319,8 +372,14 @@ GncSqlBackend::load (QofBook* book, QofBackendLoadType loadType)
 
         m_backend_registry.load_remaining(this);
 
+        auto trans_obe = std::static_pointer_cast<GncSqlTransBackend>(
+            m_backend_registry.get_object_backend(GNC_ID_TRANS));
+        if (!trans_obe->all_loaded())
+            trans_obe->set_starting_balances(this);
+
         gnc_account_foreach_descendant(root, (AccountCb)xaccAccountCommitEdit,
                                        nullptr);
+        m_book_in_db = true;
     }
     else if (loadType == LOAD_TYPE_LOAD_ALL)
     {
@@ -346,6 +405,63 @@ GncSqlBackend::load (QofBook* book, QofBackendLoadType loadType)
     LEAVE ("");
 }
 
+void
+GncSqlBackend::load_for_query (QofQuery* query)
+{
+    g_return_if_fail (query != NULL);
+
+    /* Loading runs queries of its own. */
+    if (m_loading || m_in_query || m_book == nullptr)
+        return;
+
+    auto obe = std::static_pointer_cast<GncSqlTransBackend>(
+        m_backend_registry.get_object_backend(GNC_ID_TRANS));
+    if (obe->all_loaded())
+        return;
+
+    ENTER ("sql_be=%p, query=%p", this, query);
+    m_in_query = true;
+    m_loading = true;
+    obe->load_for_query(this, query);
+    m_loading = false;
+    m_in_query = false;
+    LEAVE ("");
+}
+
+void
+GncSqlBackend::load_history (QofInstance* inst, time64 start)
+{
+    g_return_if_fail (inst != NULL);
+
+    if (m_loading || m_in_query || m_book == nullptr || !GNC_IS_ACCOUNT (inst)
+        || qof_instance_get_infant (inst))
+        return;
+
+    auto obe = std::static_pointer_cast<GncSqlTransBackend>(
+        m_backend_registry.get_object_backend(GNC_ID_TRANS));
+    if (obe->all_loaded())
+        return;
+
+    ENTER ("sql_be=%p, account=%p", this, inst);
+    m_loading = true;
+    obe->load_account_history(this, GNC_ACCOUNT (inst), start);
+    m_loading = false;
+    LEAVE ("");
+}
+
+void
+GncSqlBackend::load_deferred_transactions() noexcept
+{
+    auto obe = std::static_pointer_cast<GncSqlTransBackend>(
+        m_backend_registry.get_object_backend(GNC_ID_TRANS));
+    if (m_book == nullptr || obe->all_loaded())
+        return;
+
+    m_loading = true;
+    obe->load_all(this);
+    m_loading = false;
+}
+
 /* ================================================================= */
 
 bool
@@ -461,6 +577,27 @@ GncSqlBackend::sync(QofBook* book)
     g_return_if_fail (book != NULL);
     g_return_if_fail (m_conn != nullptr);
 
+    /* Saving is the barrier for write-behind: it returns once everything
+     * is in the database.  Commits the writer couldn't write are tried
+     * again with the other unsaved objects. */
+    flush_writes();
+    (void)take_failed_writes();
+    /* Everything else was written when it was committed. */
+    if (m_book_in_db && book == m_book)
+        write_unsaved();
+    else
+        write_book(book);
+    flush_writes();
+    if (auto err = take_failed_writes())
+    {
+        set_error (err);
+        qof_book_mark_session_dirty(book);
+    }
+}
+
+void
+GncSqlBackend::write_book(QofBook* book)
+{
     reset_version_info();
     ENTER ("book=%p, sql_be->book=%p", book, m_book);
     update_progress(101.0);
@@ -471,7 +608,9 @@ GncSqlBackend::sync(QofBook* book)
 
     /* Save all contents */
     m_book = book;
+    m_saved_commodities.clear();
     auto is_ok = m_conn->begin_transaction();
+    m_batch_inserts = true;
 
     // FIXME: should write the set of commodities that are used
     // write_commodities(sql_be, book);
@@ -502,12 +641,20 @@ GncSqlBackend::sync(QofBook* book)
             std::get<1>(entry)->write (this);
     }
     if (is_ok)
+    {
+        is_ok = flush_inserts();
+    }
+    m_batch_inserts = false;
+    if (is_ok)
     {
         is_ok = m_conn->commit_transaction();
     }
     if (is_ok)
     {
         m_is_pristine_db = false;
+        m_book_in_db = true;
+        m_unsaved.clear();
+        m_unsaved_writes.clear();
 
         /* Mark the session as clean -- though it shouldn't ever get
          * marked dirty with this backend
@@ -516,6 +663,7 @@ GncSqlBackend::sync(QofBook* book)
     }
     else
     {
+        discard_inserts();
         set_error (ERR_BACKEND_SERVER_ERR);
         m_conn->rollback_transaction ();
     }
@@ -523,16 +671,333 @@ GncSqlBackend::sync(QofBook* book)
     LEAVE ("book=%p", book);
 }
 
+QofInstance*
+GncSqlBackend::lookup_instance(const std::string& type,
+                               const GncGUID& guid) const noexcept
+{
+    if (type == QOF_ID_BOOK)
+        return QOF_INSTANCE(m_book);
+    return qof_collection_lookup_entity (
+        qof_book_get_collection (m_book, type.c_str()), &guid);
+}
+
+void
+GncSqlBackend::write_unsaved()
+{
+    ENTER ("%zu unsaved, %zu writes", m_unsaved.size(),
+           m_unsaved_writes.size());
+    /* The object was marked clean, and an INSERT is no longer an infant's,
+     * when the write was queued, so committing it again wouldn't do.  The
+     * statements are sent as they were, in order, and the object is then
+     * committed again in case it changed since. */
+    auto writes = std::move(m_unsaved_writes);
+    m_unsaved_writes.clear();
+    for (auto group = writes.cbegin(); group != writes.cend(); ++group)
+    {
+        if (group->destroying)
+        {
+            if (!write_groups(group, group + 1))
+                m_unsaved_writes.push_back(*group);
+            continue;
+        }
+        /* Destroyed since; its delete has been written or is queued. */
+        if (lookup_instance(group->type, group->guid) == nullptr)
+            continue;
+        if (write_groups(group, group + 1))
+            note_unsaved(group->type, group->guid, true);
+        else
+            m_unsaved_writes.push_back(*group);
+    }
+
+    auto unsaved = std::move(m_unsaved);
+    m_unsaved.clear();
+    for (const auto& entry : unsaved)
+    {
+        auto inst = lookup_instance(entry.first, entry.second);
+        if (inst == nullptr)
+            continue;
+        qof_instance_set_dirty_flag (inst, TRUE);
+        commit(inst);
+    }
+    if (m_unsaved.empty() && m_unsaved_writes.empty())
+    {
+        qof_book_mark_session_saved(m_book);
+    }
+    else
+    {
+        qof_book_mark_session_dirty(m_book);
+        set_error (ERR_BACKEND_SERVER_ERR);
+    }
+    LEAVE ("%zu still unsaved, %zu writes", m_unsaved.size(),
+           m_unsaved_writes.size());
+}
+
+void
+GncSqlBackend::note_unsaved(QofInstance* inst, bool unsaved)
+{
+    note_unsaved(inst->e_type, *qof_instance_get_guid (inst), unsaved);
+}
+
+void
+GncSqlBackend::note_unsaved(const std::string& type, const GncGUID& guid,
+                            bool unsaved)
+{
+    auto entry = std::find_if(m_unsaved.begin(), m_unsaved.end(),
+                              [&type, &guid](const auto& e) {
+                                  return e.first == type &&
+                                      guid_equal (&e.second, &guid);
+                              });
+    if (unsaved && entry == m_unsaved.end())
+        m_unsaved.emplace_back(type, guid);
+    else if (!unsaved && entry != m_unsaved.end())
+        m_unsaved.erase(entry);
+}
+
+/* ================================================================= */
+/* Write-behind.  Commits hand their statements to a writer thread, which
+ * sends whatever has queued up in one database transaction.  The engine
+ * already holds the committed objects, so only their durability waits for
+ * the writer; sync() and connect() wait for everything to be written, as
+ * does anything that uses the connection.  When a batch fails the writer
+ * sends its commits again one per transaction, so that one bad commit
+ * doesn't keep the others out of the database.  The commits that still
+ * fail are handed back by take_failed_writes and their statements are
+ * sent again by the next sync: the engine has already marked the objects
+ * clean, and freed the destroyed ones, so they can't simply be committed
+ * again. */
+
+/* The backend whose writer runs on this thread, if any. */
+static thread_local const GncSqlBackend* tls_writer_backend = nullptr;
+
+void
+GncSqlBackend::set_error(QofBackendError err)
+{
+    if (tls_writer_backend != this)
+    {
+        QofBackend::set_error(err);
+        return;
+    }
+    std::lock_guard<std::mutex> lock{m_write_mutex};
+    if (m_writer_error == ERR_BACKEND_NO_ERR)
+        m_writer_error = err;
+}
+
+bool
+GncSqlBackend::start_writer() noexcept
+{
+    if (m_writer.joinable())
+        return true;
+    try
+    {
+        m_writer = std::thread{&GncSqlBackend::run_writer, this};
+    }
+    catch (const std::system_error& err)
+    {
+        PWARN ("Can't start the writer thread: %s", err.what());
+        return false;
+    }
+    return true;
+}
+
+void
+GncSqlBackend::stop_writer() noexcept
+{
+    if (!m_writer.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock{m_write_mutex};
+        m_stop_writer = true;
+    }
+    m_write_cv.notify_all();
+    m_writer.join();
+    m_stop_writer = false;
+    m_write_queue.clear();
+}
+
+void
+GncSqlBackend::run_writer() noexcept
+{
+    tls_writer_backend = this;
+    std::unique_lock<std::mutex> lock{m_write_mutex};
+    while (true)
+    {
+        m_write_cv.wait(lock, [this]{
+                return m_stop_writer || !m_write_queue.empty();
+            });
+        if (m_stop_writer)
+            break;
+        auto batch = std::move(m_write_queue);
+        m_write_queue.clear();
+        m_writing = true;
+        lock.unlock();
+        m_write_cv.notify_all();
+
+        WriteGroupVec failed;
+        if (!write_groups(batch.begin(), batch.end()))
+        {
+            for (auto group = batch.begin(); group != batch.end(); ++group)
+            {
+                if (batch.size() > 1 && write_groups(group, group + 1))
+                    continue;
+                char guid_buf[GUID_ENCODING_LENGTH + 1];
+                guid_to_string_buff (&group->guid, guid_buf);
+                PERR ("The commit of %s %s couldn't be written\n",
+                      group->type.c_str(), guid_buf);
+                failed.push_back(std::move(*group));
+            }
+        }
+
+        lock.lock();
+        m_writing = false;
+        m_failed_writes.insert(m_failed_writes.end(),
+                               std::make_move_iterator(failed.begin()),
+                               std::make_move_iterator(failed.end()));
+        m_write_cv.notify_all();
+    }
+    tls_writer_backend = nullptr;
+}
+
+bool
+GncSqlBackend::write_groups(WriteGroupVec::const_iterator first,
+                            WriteGroupVec::const_iterator last) const noexcept
+{
+    std::unique_lock<std::mutex> lock{m_conn_mutex};
+    if (!m_conn->begin_transaction())
+    {
+        PERR ("begin_transaction failed\n");
+        return false;
+    }
+    lock.unlock();
+    for (auto group = first; group != last; ++group)
+    {
+        for (const auto& sql : group->statements)
+        {
+            lock.lock();
+            auto stmt = m_conn->create_statement_from_sql(sql);
+            if (stmt == nullptr || m_conn->execute_nonselect_statement(stmt) == -1)
+            {
+                PERR ("SQL error: %s\n", sql.c_str());
+                (void)m_conn->rollback_transaction();
+                return false;
+            }
+            lock.unlock();
+        }
+    }
+    lock.lock();
+    if (!m_conn->commit_transaction())
+    {
+        (void)m_conn->rollback_transaction();
+        return false;
+    }
+    return true;
+}
+
+bool
+GncSqlBackend::flush_writes() const noexcept
+{
+    std::unique_lock<std::mutex> lock{m_write_mutex};
+    if (!m_writer.joinable())
+        return m_failed_writes.empty();
+    m_write_cv.wait(lock, [this]{
+            return m_write_queue.empty() && !m_writing;
+        });
+    return m_failed_writes.empty();
+}
+
+QofBackendError
+GncSqlBackend::take_failed_writes() noexcept
+{
+    WriteGroupVec failed;
+    auto err = ERR_BACKEND_NO_ERR;
+    {
+        std::lock_guard<std::mutex> lock{m_write_mutex};
+        failed = std::move(m_failed_writes);
+        m_failed_writes.clear();
+        std::swap(err, m_writer_error);
+    }
+    if (failed.empty())
+        return ERR_BACKEND_NO_ERR;
+    m_unsaved_writes.insert(m_unsaved_writes.end(),
+                            std::make_move_iterator(failed.begin()),
+                            std::make_move_iterator(failed.end()));
+    return err != ERR_BACKEND_NO_ERR ? err : ERR_BACKEND_SERVER_ERR;
+}
+
+void
+GncSqlBackend::discard_writes() noexcept
+{
+    std::unique_lock<std::mutex> lock{m_write_mutex};
+    m_write_cv.wait(lock, [this]{ return !m_writing; });
+    m_write_queue.clear();
+    m_failed_writes.clear();
+    m_writer_error = ERR_BACKEND_NO_ERR;
+}
+
+void
+GncSqlBackend::queue_writes(QofInstance* inst, std::size_t depth) noexcept
+{
+    m_deferring = false;
+    WriteGroup group{inst->e_type, *qof_instance_get_guid (inst),
+                     std::move(m_deferred),
+                     static_cast<bool>(qof_instance_get_destroying (inst))};
+    m_deferred.clear();
+    if (group.statements.empty())
+        return;
+
+    std::unique_lock<std::mutex> lock{m_write_mutex};
+    m_write_cv.wait(lock, [this, depth]{
+            return m_write_queue.size() < depth;
+        });
+    m_write_queue.push_back(std::move(group));
+    lock.unlock();
+    m_write_cv.notify_all();
+}
+
+bool
+GncSqlBackend::write_deferred() const noexcept
+{
+    flush_writes();
+    if (!m_conn->begin_transaction())
+    {
+        PERR ("begin_transaction failed\n");
+        return false;
+    }
+    m_deferring = false;
+    auto deferred = std::move(m_deferred);
+    m_deferred.clear();
+    for (const auto& sql : deferred)
+    {
+        auto stmt = create_statement_from_sql(sql);
+        if (stmt == nullptr || run_nonselect_statement(stmt) == -1)
+            return false;
+    }
+    return true;
+}
+
+void
+GncSqlBackend::cancel_commit() noexcept
+{
+    if (m_deferring)
+    {
+        m_deferring = false;
+        m_deferred.clear();
+    }
+    else
+    {
+        (void)m_conn->rollback_transaction();
+    }
+}
+
 /* ================================================================= */
 /* Routines to deal with the creation of multiple books. */
 
 void
 GncSqlBackend::begin(QofInstance* inst)
 {
-    //g_return_if_fail (inst != NULL);
+    g_return_if_fail (inst != NULL);
 
-    //ENTER (" ");
-    //LEAVE ("");
+    /* Destroying an account or moving its splits has to see all of them. */
+    load_history (inst, INT64_MIN);
 }
 
 void
@@ -550,6 +1015,12 @@ GncSqlBackend::commodity_for_postload_processing(gnc_commodity* commodity)
     m_postload_commodities.push_back(commodity);
 }
 
+void
+GncSqlBackend::commodity_loaded(gnc_commodity* commodity)
+{
+    m_saved_commodities.insert(commodity);
+}
+
 GncSqlObjectBackendPtr
 GncSqlBackend::get_object_backend(const std::string& type) const noexcept
 {
@@ -570,6 +1041,9 @@ GncSqlBackend::commit (QofInstance* inst)
     g_return_if_fail (inst != NULL);
     g_return_if_fail (m_conn != nullptr);
 
+    if (GNC_IS_COMMODITY (inst) && qof_instance_get_destroying (inst))
+        m_saved_commodities.erase (GNC_COMMODITY (inst));
+
     if (qof_book_is_readonly(m_book))
     {
         set_error (ERR_BACKEND_READONLY);
@@ -608,8 +1082,16 @@ GncSqlBackend::commit (QofInstance* inst)
         return;
     }
 
-    if (!m_conn->begin_transaction ())
+    /* With write-behind the statements are collected and handed to the
+     * writer thread instead of being sent here. */
+    auto depth = gnc_prefs_get_sql_write_behind ();
+    m_deferring = depth > 0 && start_writer ();
+    m_new_commodities.clear();
+    if (!m_deferring)
+        flush_writes ();
+    if (!m_deferring && !m_conn->begin_transaction ())
     {
+        note_unsaved (inst, true);
         PERR ("begin_transaction failed\n");
         LEAVE ("Rolled back - database transaction begin error");
         return;
@@ -619,11 +1101,17 @@ GncSqlBackend::commit (QofInstance* inst)
 
     auto obe = m_backend_registry.get_object_backend(std::string{inst->e_type});
     if (obe != nullptr)
-        is_ok = obe->commit(this, inst);
+    {
+        /* An object and its splits and slots are written with as few
+         * statements as possible. */
+        m_batch_inserts = true;
+        is_ok = obe->commit(this, inst) && flush_inserts();
+        m_batch_inserts = false;
+    }
     else
     {
         PERR ("Unknown object type '%s'\n", inst->e_type);
-        (void)m_conn->rollback_transaction ();
+        cancel_commit ();
 
         // Don't let unknown items still mark the book as being dirty
         qof_book_mark_session_saved(m_book);
@@ -634,16 +1122,34 @@ GncSqlBackend::commit (QofInstance* inst)
     if (!is_ok)
     {
         // Error - roll it back
-        (void)m_conn->rollback_transaction();
+        discard_inserts();
+        cancel_commit ();
+        note_unsaved (inst, true);
 
         // This *should* leave things marked dirty
         LEAVE ("Rolled back - database error");
         return;
     }
 
-    (void)m_conn->commit_transaction ();
-
-    qof_book_mark_session_saved(m_book);
+    if (m_deferring)
+        queue_writes (inst, depth);
+    else
+        (void)m_conn->commit_transaction ();
+    if (GNC_IS_COMMODITY (inst) && !is_destroying)
+        m_new_commodities.push_back (GNC_COMMODITY (inst));
+    m_saved_commodities.insert (m_new_commodities.begin(),
+                                m_new_commodities.end());
+
+    /* An object whose commit failed earlier keeps the book unsaved until
+     * it's been written. */
+    note_unsaved (inst, false);
+    if (auto err = take_failed_writes ())
+    {
+        set_error (err);
+        qof_book_mark_session_dirty(m_book);
+    }
+    else if (m_unsaved.empty() && m_unsaved_writes.empty())
+        qof_book_mark_session_saved(m_book);
     qof_instance_mark_clean (inst);
 
     LEAVE ("");
@@ -833,7 +1339,19 @@ GncSqlBackend::object_in_db (const char* table_name, QofIdTypeConst obj_name,
     /* We want only the first item in the table, which should be the PK. */
     values.resize(1);
     stmt->add_where_cond(obj_name, values);
-    auto result = execute_select_statement (stmt);
+    /* Rows queued for other tables can't make a difference here, and
+     * sending them for every commodity check would defeat the batching.
+     * What the writer thread hasn't sent yet does, and the connection is
+     * its until then. */
+    flush_inserts (table_name);
+    if (m_deferring)
+    {
+        if (!write_deferred())
+            return false;
+    }
+    else
+        flush_writes();
+    auto result = run_select_statement (stmt);
     return (result != nullptr && result->size() > 0);
 }
 
@@ -851,6 +1369,8 @@ GncSqlBackend::do_db_operation (E_DB_OPERATION op, const char* table_name,
     switch(op)
     {
         case  OP_DB_INSERT:
+        if (m_batch_inserts)
+            return queue_insert (table_name, obj_name, pObject, table);
         stmt = build_insert_statement (table_name, obj_name, pObject, table);
         break;
         case OP_DB_UPDATE:
@@ -869,10 +1389,14 @@ bool
 GncSqlBackend::save_commodity(gnc_commodity* comm) noexcept
 {
     if (comm == nullptr) return false;
+    if (m_saved_commodities.count(comm))
+        return true;
     QofInstance* inst = QOF_INSTANCE(comm);
     auto obe = m_backend_registry.get_object_backend(std::string(inst->e_type));
-    if (obe && !obe->instance_in_db(this, inst))
-        return obe->commit(this, inst);
+    if (obe && !obe->instance_in_db(this, inst) && !obe->commit(this, inst))
+        return false;
+    /* It's only known to be there once the commit has gone through. */
+    m_new_commodities.push_back(comm);
     return true;
 }
 
@@ -912,6 +1436,87 @@ GncSqlBackend::build_insert_statement (const char* table_name,
     return stmt;
 }
 
+/* Multi-row INSERTs are kept well below the statement size limits of the
+ * databases, of which SQLite's 1,000,000 bytes is the smallest. */
+static const unsigned insert_batch_max_rows = 250;
+static const std::size_t insert_batch_max_length = 256 * 1024;
+
+bool
+GncSqlBackend::queue_insert (const char* table_name, QofIdTypeConst obj_name,
+                             gpointer pObject,
+                             const EntryVec& table) const noexcept
+{
+    PairVec values{get_object_values(obj_name, pObject, table)};
+    std::string head{"INSERT INTO "};
+    std::string row{"("};
+
+    head += table_name;
+    head += "(";
+    for (auto const& col_value : values)
+    {
+        if (col_value != *values.begin())
+        {
+            head += ",";
+            row += ",";
+        }
+        head += col_value.first;
+        row += col_value.second;
+    }
+    head += ") VALUES";
+    row += ")";
+
+    auto& batch = m_insert_batches[head];
+    if (batch.count > 0 &&
+        (batch.count >= insert_batch_max_rows ||
+         batch.rows.size() + row.size() > insert_batch_max_length) &&
+        !send_insert_batch (head, batch))
+        return false;
+
+    if (batch.count > 0)
+        batch.rows += ",";
+    else
+        batch.table = table_name;
+    batch.rows += row;
+    ++batch.count;
+    ++m_queued_inserts;
+    return true;
+}
+
+bool
+GncSqlBackend::send_insert_batch (const std::string& head,
+                                  InsertBatch& batch) const noexcept
+{
+    auto stmt = create_statement_from_sql(head + batch.rows);
+    m_queued_inserts -= batch.count;
+    batch.rows.clear();
+    batch.count = 0;
+    if (stmt == nullptr)
+        return false;
+    return run_nonselect_statement(stmt) != -1;
+}
+
+bool
+GncSqlBackend::flush_inserts (const char* table_name) const noexcept
+{
+    auto is_ok = true;
+    for (auto& [head, batch] : m_insert_batches)
+    {
+        if (batch.count == 0 ||
+            (table_name != nullptr && batch.table != table_name))
+            continue;
+        if (!send_insert_batch (head, batch))
+            is_ok = false;
+    }
+    return is_ok;
+}
+
+void
+GncSqlBackend::discard_inserts () const noexcept
+{
+    m_insert_batches.clear();
+    m_queued_inserts = 0;
+}
+
 GncSqlStatementPtr
 GncSqlBackend::build_update_statement(const gchar* table_name,
                                       QofIdTypeConst obj_name, gpointer pObject,
@@ -27,9 +27,14 @@
 #include <qof.h>
 #include <Account.h>
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <exception>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <qof-backend.hpp>
 
@@ -71,14 +76,39 @@ public:
      * @param book Book to be loaded
      */
     void load(QofBook*, QofBackendLoadType) override;
+    /**
+     * Load the transactions a query might match if the initial load left
+     * them in the database.
+     *
+     * @param query The query about to be run
+     */
+    void load_for_query(QofQuery*) override;
+    /**
+     * Load the transactions of an account posted from start on if the
+     * initial load left them in the database.
+     *
+     * @param inst The account
+     * @param start The earliest posted date needed
+     */
+    void load_history(QofInstance* inst, time64 start) override;
+    /**
+     * Load the transactions the initial load left in the database, if any.
+     */
+    void load_deferred_transactions() noexcept;
     /**
      * Save the contents of a book to an SQL database.
      *
+     * If the database already holds the book, only the objects whose
+     * commits failed are written; otherwise the whole book is written to
+     * the (empty) tables.
+     *
      * @param book Book to be saved
      */
     void sync(QofBook*) override;
     /**
-     * An object is about to be edited.
+     * An object is about to be edited.  An account's whole history is
+     * loaded first, so that deleting it or moving its splits sees all of
+     * them.
      *
      * @param inst Object being edited
      */
@@ -95,6 +125,14 @@ public:
      * @param inst Object being edited
      */
     void rollback(QofInstance*) override;
+    /**
+     * Record an error.  An error raised on the write-behind thread is kept
+     * for the thread that committed, which reports it with the commits
+     * that couldn't be written.
+     *
+     * @param err The error
+     */
+    void set_error(QofBackendError err) override;
     /** Connect the backend to a GncSqlConnection.
      * Sets up version info. Calling with nullptr clears the connection and
      * destroys the version info.
@@ -115,6 +153,10 @@ public:
      * error occurs, an entry is added to the log, an error status is returned
      * to qof and nullptr is returned.
      *
+     * Queued INSERTs are sent first, by this and by
+     * execute_nonselect_statement(), so that statements see the rows that
+     * were written before them.
+     *
      * @param statement Statement
      * @return Results, or nullptr if an error has occurred
      */
@@ -192,6 +234,13 @@ public:
      * @param comm The commodity item to be committed.
      */
     void commodity_for_postload_processing(gnc_commodity*);
+    /**
+     * Note that a commodity was loaded from the database, so that objects
+     * referring to it needn't look for it there.
+     *
+     * @param comm The commodity in the book's commodity table.
+     */
+    void commodity_loaded(gnc_commodity*);
     /**
      * Get the GncSqlObjectBackend for the indicated type.
      *
@@ -246,7 +295,76 @@ protected:
     bool m_is_pristine_db; /**< Are we saving to a new pristine db? */
     const char* m_time_format = nullptr; /**< Server-specific date-time string format */
     VersionVec m_versions;    /**< Version number for each table */
+    bool m_batch_inserts = false; /**< Queue INSERTs into multi-row statements */
+    bool m_book_in_db = false; /**< The database holds m_book, so sync only
+                                * has to write what wasn't committed */
+    /** Waits until the writer thread has sent everything committed so
+     * far.  Returns false if some of it couldn't be written; those commits
+     * wait for take_failed_writes. */
+    bool flush_writes() const noexcept;
+    /** Adds the commits the writer thread couldn't write to
+     * m_unsaved_writes.  Returns the error they raised, or
+     * ERR_BACKEND_NO_ERR if there were none. */
+    QofBackendError take_failed_writes() noexcept;
+    /** Drops what is waiting for the writer thread, for when the whole
+     * book is about to be written anyway. */
+    void discard_writes() noexcept;
 private:
+    /** The statements of one write-behind commit and the object it was
+     * for. */
+    struct WriteGroup
+    {
+        std::string type;
+        GncGUID guid;
+        std::vector<std::string> statements;
+        bool destroying;
+    };
+    using WriteGroupVec = std::vector<WriteGroup>;
+    /** The rows queued for one multi-row INSERT statement. */
+    struct InsertBatch
+    {
+        std::string table;
+        std::string rows;     /**< "(values),(values),..." */
+        unsigned count = 0;
+    };
+    GncSqlResultPtr run_select_statement(const GncSqlStatementPtr& stmt) const noexcept;
+    /** Sends stmt, or adds it to m_deferred during a write-behind commit. */
+    int run_nonselect_statement(const GncSqlStatementPtr& stmt) const noexcept;
+    /** Turns a write-behind commit into an ordinary one because it has to
+     * read from the database: sends what it has collected so far in a
+     * transaction once the writer thread is done. */
+    bool write_deferred() const noexcept;
+    /** Hands the statements of inst's write-behind commit to the writer
+     * thread, waiting while depth commits are ahead of it. */
+    void queue_writes(QofInstance* inst, std::size_t depth) noexcept;
+    /** Throws away the statements of the current commit. */
+    void cancel_commit() noexcept;
+    bool start_writer() noexcept;
+    void stop_writer() noexcept;
+    void run_writer() noexcept;
+    /** Sends the groups from first to last in one database transaction. */
+    bool write_groups(WriteGroupVec::const_iterator first,
+                      WriteGroupVec::const_iterator last) const noexcept;
+    bool queue_insert (const char* table_name, QofIdTypeConst obj_name,
+                       gpointer pObject, const EntryVec& table) const noexcept;
+    bool send_insert_batch (const std::string& head,
+                            InsertBatch& batch) const noexcept;
+    /** Sends the queued INSERTs, only those into table_name if it isn't
+     * nullptr. */
+    bool flush_inserts (const char* table_name = nullptr) const noexcept;
+    void discard_inserts () const noexcept;
+    /** Writes all of book to the tables, which must be empty. */
+    void write_book(QofBook*);
+    /** Sends the statements in m_unsaved_writes again and commits the
+     * objects in m_unsaved again. */
+    void write_unsaved();
+    /** The instance of m_book with type and guid, or nullptr. */
+    QofInstance* lookup_instance(const std::string& type,
+                                 const GncGUID& guid) const noexcept;
+    /** Adds inst to m_unsaved, or removes it if unsaved is false. */
+    void note_unsaved(QofInstance* inst, bool unsaved);
+    void note_unsaved(const std::string& type, const GncGUID& guid,
+                      bool unsaved);
     bool write_account_tree(Account*);
     bool write_accounts();
     bool write_transactions();
@@ -286,6 +404,37 @@ private:
     };
     ObjectBackendRegistry m_backend_registry;
     std::vector<gnc_commodity*> m_postload_commodities;
+    /** Queued INSERTs by "INSERT INTO table(columns) VALUES". */
+    mutable std::unordered_map<std::string, InsertBatch> m_insert_batches;
+    mutable unsigned m_queued_inserts = 0;
+    /** The type and guid of each object whose last commit didn't reach the
+     * database. */
+    std::vector<std::pair<std::string, GncGUID>> m_unsaved;
+    /** Write-behind commits that didn't reach the database, in commit
+     * order.  The engine took them as written, so the statements are kept
+     * to be sent again. */
+    WriteGroupVec m_unsaved_writes;
+    /** Commodities known to be in the database, so that committing an
+     * object that refers to one needn't look it up. */
+    std::unordered_set<const gnc_commodity*> m_saved_commodities;
+    std::vector<const gnc_commodity*> m_new_commodities;
+
+    /* Write-behind: a commit collects its statements in m_deferred and
+     * queues them for m_writer, which sends what is queued in one
+     * transaction at a time on m_conn.  m_conn_mutex serializes the
+     * writer's use of the connection with quote_string.  The rest is
+     * guarded by m_write_mutex. */
+    mutable bool m_deferring = false;
+    mutable std::vector<std::string> m_deferred;
+    std::thread m_writer;
+    mutable std::mutex m_conn_mutex;
+    mutable std::mutex m_write_mutex;
+    mutable std::condition_variable m_write_cv;
+    WriteGroupVec m_write_queue;
+    bool m_writing = false;          /**< m_writer is sending a batch */
+    WriteGroupVec m_failed_writes;   /**< Commits m_writer couldn't write */
+    QofBackendError m_writer_error = ERR_BACKEND_NO_ERR;
+    bool m_stop_writer = false;
 };
 
 #endif //__GNC_SQL_BACKEND_HPP__
@@ -46,8 +46,10 @@
 #include "splint-defs.h"
 #endif
 
+#include <algorithm>
 #include <string>
 #include <sstream>
+#include <unordered_map>
 
 #include "escape.h"
 
@@ -718,11 +720,221 @@ GncSqlTransBackend::load_all (GncSqlBackend* sql_be)
     auto root = gnc_book_get_root_account (sql_be->book());
     gnc_account_foreach_descendant(root, (AccountCb)xaccAccountBeginEdit,
                                    nullptr);
-    query_transactions (sql_be, "");
+    if (all_loaded ())
+        query_transactions (sql_be, "");
+    else
+    {
+        load_before (sql_be, INT64_MIN);
+        set_starting_balances (sql_be);
+    }
     gnc_account_foreach_descendant(root, (AccountCb)xaccAccountCommitEdit,
                                    nullptr);
 }
 
+/* ----------------------------------------------------------------- */
+/* Lazy loading.  load_recent() loads the transactions posted since some
+ * date, and those in lots.  Older ones are loaded when a query asks for
+ * them, either for a whole date range or, when the query names accounts,
+ * only for those accounts, and an account's are loaded before the engine
+ * edits it or walks its splits back past that date.  Transactions
+ * referred to by other objects may be loaded regardless, so the starting
+ * balances that make up for the splits still in the database are
+ * computed from what is actually loaded. */
+
+static std::string
+post_date_condition (const char* op, time64 date)
+{
+    std::string cond (TRANSACTION_TABLE ".");
+    cond += tx_col_table[3]->name();
+    cond += std::string (" ") + op + " '" + GncDateTime(date).format_iso8601() + "'";
+    return cond;
+}
+
+void
+GncSqlTransBackend::load_recent (GncSqlBackend* sql_be, int days)
+{
+    g_return_if_fail (sql_be != NULL);
+
+    auto since = gnc_time64_get_day_start (gnc_time (nullptr) -
+                                           days * (time64)(24 * 60 * 60));
+    const std::string tpkey(tx_col_table[0]->name());    //guid
+    const std::string stkey(split_col_table[1]->name()); //txn_guid
+    const std::string slkey(split_col_table[9]->name()); //lot_guid
+    std::string cond (TRANSACTION_TABLE ".");
+    cond += tx_col_table[3]->name();
+    cond += " IS NULL OR " + post_date_condition (">=", since);
+    /* Lots are loaded whole, and with them the balances of invoices and
+     * owners, so all of their splits have to be too. */
+    cond += " OR " TRANSACTION_TABLE "." + tpkey + " IN (SELECT " + stkey +
+        " FROM " SPLIT_TABLE " WHERE " + slkey + " IS NOT NULL)";
+    query_transactions (sql_be, cond);
+    m_loaded_since = since;
+    m_account_loaded_since.clear();
+}
+
+/* Loads the transactions posted from start up to m_loaded_since. */
+void
+GncSqlTransBackend::load_before (GncSqlBackend* sql_be, time64 start)
+{
+    auto cond = post_date_condition ("<", m_loaded_since);
+    if (start != INT64_MIN)
+        cond += " AND " + post_date_condition (">=", start);
+    query_transactions (sql_be, cond);
+    m_loaded_since = start;
+}
+
+/* Loads the transactions with a split in acc posted from start up to
+ * before. */
+static void
+load_tx_for_account_between (GncSqlBackend* sql_be, Account* acc,
+                             time64 start, time64 before)
+{
+    const std::string tpkey(tx_col_table[0]->name());    //guid
+    const std::string stkey(split_col_table[1]->name()); //txn_guid
+    const std::string sakey(split_col_table[2]->name()); //account_guid
+    std::string sql("(SELECT DISTINCT " SPLIT_TABLE ".");
+    sql += stkey + " FROM " SPLIT_TABLE " INNER JOIN " TRANSACTION_TABLE
+        " ON " SPLIT_TABLE "." + stkey + " = " TRANSACTION_TABLE "." + tpkey;
+    sql += " WHERE " SPLIT_TABLE "." + sakey + " = '";
+    sql += gnc::GUID(*xaccAccountGetGUID (acc)).to_string() + "' AND ";
+    sql += post_date_condition ("<", before);
+    if (start != INT64_MIN)
+        sql += " AND " + post_date_condition (">=", start);
+    sql += ")";
+    query_transactions (sql_be, sql);
+}
+
+static bool
+term_has_path (QofQueryTerm* qt, const char* first, const char* second)
+{
+    auto path = qof_query_term_get_param_path (qt);
+    if (!path || g_strcmp0 (static_cast<const char*>(path->data), first))
+        return false;
+    if (!second)
+        return path->next == nullptr;
+    return path->next &&
+        !g_strcmp0 (static_cast<const char*>(path->next->data), second);
+}
+
+/* Finds the accounts and the earliest posted date that one ORed branch
+ * of a split or transaction query limits its matches to. */
+static void
+query_branch_limits (QofIdTypeConst search_for, GList* and_terms,
+                     GList** guids, time64* start)
+{
+    auto for_splits = !g_strcmp0 (search_for, GNC_ID_SPLIT);
+
+    for (; and_terms; and_terms = and_terms->next)
+    {
+        auto qt = static_cast<QofQueryTerm*>(and_terms->data);
+        auto pd = qof_query_term_get_pred_data (qt);
+
+        if (!pd || qof_query_term_is_inverted (qt))
+            continue;
+        if (for_splits && !*guids &&
+            term_has_path (qt, SPLIT_ACCOUNT, QOF_PARAM_GUID) &&
+            !g_strcmp0 (pd->type_name, QOF_TYPE_GUID) &&
+            ((query_guid_t) pd)->options == QOF_GUID_MATCH_ANY)
+        {
+            *guids = ((query_guid_t) pd)->guids;
+        }
+        else if ((for_splits ?
+                  term_has_path (qt, SPLIT_TRANS, TRANS_DATE_POSTED) :
+                  term_has_path (qt, TRANS_DATE_POSTED, nullptr)) &&
+                 !g_strcmp0 (pd->type_name, QOF_TYPE_DATE) &&
+                 (pd->how == QOF_COMPARE_GT || pd->how == QOF_COMPARE_GTE ||
+                  pd->how == QOF_COMPARE_EQUAL))
+        {
+            auto date = ((query_date_t) pd)->date;
+            if (((query_date_t) pd)->options == QOF_DATE_MATCH_DAY)
+                date = gnc_time64_get_day_start (date);
+            *start = std::max (*start, date);
+        }
+    }
+}
+
+void
+GncSqlTransBackend::load_for_query (GncSqlBackend* sql_be, QofQuery* query)
+{
+    g_return_if_fail (sql_be != NULL);
+    g_return_if_fail (query != NULL);
+
+    if (all_loaded ())
+        return;
+
+    auto search_for = qof_query_get_search_for (query);
+    if (g_strcmp0 (search_for, GNC_ID_SPLIT) &&
+        g_strcmp0 (search_for, GNC_ID_TRANS))
+        return;
+
+    auto since = m_loaded_since;
+    std::unordered_map<Account*, time64> account_starts;
+    auto or_terms = qof_query_get_terms (query);
+
+    if (!or_terms)
+        since = INT64_MIN;
+    for (auto node = or_terms; node; node = node->next)
+    {
+        GList* guids = nullptr;
+        time64 start = INT64_MIN;
+
+        query_branch_limits (search_for, static_cast<GList*>(node->data),
+                             &guids, &start);
+        if (!guids)
+        {
+            since = std::min (since, start);
+            continue;
+        }
+        for (; guids; guids = guids->next)
+        {
+            auto acc = xaccAccountLookup (static_cast<GncGUID*>(guids->data),
+                                          sql_be->book());
+            if (!acc)
+                continue;
+            auto it = account_starts.emplace (acc, start).first;
+            it->second = std::min (it->second, start);
+        }
+    }
+
+    auto loaded = false;
+    if (since < m_loaded_since)
+    {
+        load_before (sql_be, since);
+        loaded = true;
+    }
+    for (auto [acc, start] : account_starts)
+        if (load_account_from (sql_be, acc, start))
+            loaded = true;
+    if (loaded)
+        set_starting_balances (sql_be);
+}
+
+bool
+GncSqlTransBackend::load_account_from (GncSqlBackend* sql_be, Account* acc,
+                                       time64 start)
+{
+    auto before = m_loaded_since;
+    auto it = m_account_loaded_since.find (acc);
+    if (it != m_account_loaded_since.end ())
+        before = std::min (before, it->second);
+    if (start >= before)
+        return false;
+    load_tx_for_account_between (sql_be, acc, start, before);
+    m_account_loaded_since[acc] = start;
+    return true;
+}
+
+void
+GncSqlTransBackend::load_account_history (GncSqlBackend* sql_be, Account* acc,
+                                          time64 start)
+{
+    g_return_if_fail (sql_be != NULL);
+    g_return_if_fail (acc != NULL);
+
+    if (!all_loaded () && load_account_from (sql_be, acc, start))
+        set_starting_balances (sql_be);
+}
+
 typedef struct
 {
     GncSqlStatementPtr stmt;
@@ -782,6 +994,116 @@ static const EntryVec acct_balances_col_table
                                          (QofSetterFunc)set_acct_bal_balance),
 };
 
+void
+GncSqlTransBackend::set_starting_balances (GncSqlBackend* sql_be)
+{
+    g_return_if_fail (sql_be != NULL);
+
+    std::unordered_map<const Account*, acct_balances_t> totals;
+    std::unordered_map<const Account*, gnc_numeric> closing_totals;
+    if (!all_loaded ())
+    {
+        const std::string sakey(split_col_table[2]->name()); //account_guid
+        const std::string sum("SELECT " + sakey + ", reconcile_state, "
+                              "SUM(quantity_num) AS quantity_num, "
+                              "quantity_denom FROM " SPLIT_TABLE);
+        const std::string group(" GROUP BY " + sakey +
+                                ", reconcile_state, quantity_denom");
+        auto stmt = sql_be->create_statement_from_sql (sum + group);
+        auto result = sql_be->execute_select_statement (stmt);
+        for (auto row : *result)
+        {
+            single_acct_balance_t bal{sql_be, nullptr, NREC,
+                                      gnc_numeric_zero ()};
+            gnc_sql_load_object (sql_be, row, nullptr, &bal,
+                                 acct_balances_col_table);
+            if (bal.acct == nullptr)
+                continue;
+            auto zero = gnc_numeric_zero ();
+            auto& total = totals.emplace (bal.acct,
+                                          acct_balances_t{bal.acct, zero,
+                                                          zero, zero})
+                .first->second;
+            total.balance = gnc_numeric_add_fixed (total.balance, bal.balance);
+            if (bal.reconcile_state != NREC)
+                total.cleared_balance =
+                    gnc_numeric_add_fixed (total.cleared_balance, bal.balance);
+            if (bal.reconcile_state == YREC || bal.reconcile_state == FREC)
+                total.reconciled_balance =
+                    gnc_numeric_add_fixed (total.reconciled_balance,
+                                           bal.balance);
+        }
+
+        /* Closing transactions are the ones carrying the "book_closing"
+         * slot; they stay out of the noclosing balance. */
+        const std::string sskey(split_col_table[1]->name()); //tx_guid
+        stmt = sql_be->create_statement_from_sql (sum + " WHERE " + sskey +
+                                                  " IN (SELECT obj_guid FROM "
+                                                  "slots WHERE name = "
+                                                  "'book_closing')" + group);
+        result = sql_be->execute_select_statement (stmt);
+        for (auto row : *result)
+        {
+            single_acct_balance_t bal{sql_be, nullptr, NREC,
+                                      gnc_numeric_zero ()};
+            gnc_sql_load_object (sql_be, row, nullptr, &bal,
+                                 acct_balances_col_table);
+            if (bal.acct == nullptr)
+                continue;
+            auto& total = closing_totals.emplace (bal.acct,
+                                                  gnc_numeric_zero ())
+                .first->second;
+            total = gnc_numeric_add_fixed (total, bal.balance);
+        }
+    }
+
+    auto root = gnc_book_get_root_account (sql_be->book());
+    auto accounts = gnc_account_get_descendants (root);
+    for (auto node = accounts; node; node = node->next)
+    {
+        auto acc = static_cast<Account*>(node->data);
+        auto zero = gnc_numeric_zero ();
+        acct_balances_t start{acc, zero, zero, zero};
+        auto noclosing = zero;
+        auto it = totals.find (acc);
+
+        /* Whatever isn't loaded goes into the starting balances. */
+        if (it != totals.end ())
+        {
+            start = it->second;
+            noclosing = start.balance;
+            auto cit = closing_totals.find (acc);
+            if (cit != closing_totals.end ())
+                noclosing = gnc_numeric_sub_fixed (noclosing, cit->second);
+            for (auto snode = xaccAccountGetSplitList (acc); snode;
+                 snode = snode->next)
+            {
+                auto split = static_cast<Split*>(snode->data);
+                auto amount = xaccSplitGetAmount (split);
+                auto state = xaccSplitGetReconcile (split);
+
+                start.balance = gnc_numeric_sub_fixed (start.balance, amount);
+                if (!xaccTransGetIsClosingTxn (xaccSplitGetParent (split)))
+                    noclosing = gnc_numeric_sub_fixed (noclosing, amount);
+                if (state != NREC)
+                    start.cleared_balance =
+                        gnc_numeric_sub_fixed (start.cleared_balance, amount);
+                if (state == YREC || state == FREC)
+                    start.reconciled_balance =
+                        gnc_numeric_sub_fixed (start.reconciled_balance,
+                                               amount);
+            }
+        }
+        gnc_account_set_start_balance (acc, start.balance);
+        gnc_account_set_start_noclosing_balance (acc, noclosing);
+        gnc_account_set_start_cleared_balance (acc, start.cleared_balance);
+        gnc_account_set_start_reconciled_balance (acc,
+                                                  start.reconciled_balance);
+        xaccAccountRecomputeBalance (acc);
+    }
+    g_list_free (accounts);
+}
+
 /* ----------------------------------------------------------------- */
 template<> void
 GncSqlColumnTableEntryImpl<CT_TXREF>::load (const GncSqlBackend* sql_be,
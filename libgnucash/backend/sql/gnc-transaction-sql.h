@@ -33,6 +33,8 @@
 #include "qof.h"
 #include "Account.h"
 
+#include <unordered_map>
+
 class GncSqlTransBackend : public GncSqlObjectBackend
 {
 public:
@@ -40,6 +42,51 @@ public:
     void load_all(GncSqlBackend*) override;
     void create_tables(GncSqlBackend*) override;
     bool commit (GncSqlBackend* sql_be, QofInstance* inst) override;
+    /**
+     * Loads only the transactions posted in the last days days and those
+     * with a split in a lot, leaving the older ones in the database until
+     * load_for_query(), load_account_history() or load_all() needs them.
+     *
+     * @param sql_be SQL backend
+     * @param days Number of days to load
+     */
+    void load_recent (GncSqlBackend* sql_be, int days);
+    /**
+     * Loads the transactions that a split or transaction query might
+     * match and that load_recent() left in the database.
+     *
+     * @param sql_be SQL backend
+     * @param query The query about to be run
+     */
+    void load_for_query (GncSqlBackend* sql_be, QofQuery* query);
+    /**
+     * Loads the transactions of acc posted from start on that
+     * load_recent() left in the database.
+     *
+     * @param sql_be SQL backend
+     * @param acc The account
+     * @param start The earliest posted date to load
+     */
+    void load_account_history (GncSqlBackend* sql_be, Account* acc,
+                               time64 start);
+    /**
+     * Sets the starting balances of the accounts to the sum of their
+     * splits that are still in the database, so that account balances
+     * are right even though not all splits are loaded.
+     *
+     * @param sql_be SQL backend
+     */
+    void set_starting_balances (GncSqlBackend* sql_be);
+    bool all_loaded () const noexcept { return m_loaded_since == INT64_MIN; }
+private:
+    void load_before (GncSqlBackend* sql_be, time64 start);
+    /** Returns false if acc's transactions from start on were already loaded. */
+    bool load_account_from (GncSqlBackend* sql_be, Account* acc,
+                            time64 start);
+    /** Every transaction posted at or after this is loaded. */
+    time64 m_loaded_since = INT64_MIN;
+    /** Accounts with all transactions posted at or after the value loaded. */
+    std::unordered_map<const Account*, time64> m_account_loaded_since;
 };
 
 class GncSqlSplitBackend : public GncSqlObjectBackend
@@ -456,6 +456,44 @@ gnc_price_to_dom_tree (const xmlChar* tag, GNCPrice* price)
     return price_xml;
 }
 
+/* Text emitter matching the dump of gnc_price_to_dom_tree at level.
+ * Appends nothing and returns FALSE where that returns NULL. */
+gboolean
+gnc_price_xml_text_append (GString* buf, int level, GNCPrice* price)
+{
+    gsize start = buf->len;
+    gnc_commodity* commodity = gnc_price_get_commodity (price);
+    gnc_commodity* currency = gnc_price_get_currency (price);
+    const gchar* sourcestr = gnc_price_get_source_string (price);
+    const gchar* typestr = gnc_price_get_typestr (price);
+
+    if (! (commodity && currency)) return FALSE;
+
+    xml_text_append_open (buf, level, "price");
+    if (!xml_text_append_guid (buf, level + 1, "price:id",
+                               gnc_price_get_guid (price)) ||
+        !xml_text_append_commodity_ref (buf, level + 1, "price:commodity",
+                                        commodity) ||
+        !xml_text_append_commodity_ref (buf, level + 1, "price:currency",
+                                        currency) ||
+        !xml_text_append_time64 (buf, level + 1, "price:time",
+                                 gnc_price_get_time64 (price)))
+    {
+        g_string_truncate (buf, start);
+        return FALSE;
+    }
+    if (sourcestr && (strlen (sourcestr) != 0))
+        xml_text_append_element (buf, level + 1, "price:source", sourcestr,
+                                 TRUE);
+    if (typestr && (strlen (typestr) != 0))
+        xml_text_append_element (buf, level + 1, "price:type", typestr,
+                                 TRUE);
+    xml_text_append_numeric (buf, level + 1, "price:value",
+                             gnc_price_get_value (price));
+    xml_text_append_close (buf, level, "price");
+    return TRUE;
+}
+
 static gboolean
 xml_add_gnc_price_adapter (GNCPrice* p, gpointer data)
 {
@@ -25,6 +25,14 @@
 
 #include <config.h>
 #include <string.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
 #include "AccountP.h"
 #include "Transaction.h"
 #include "TransactionP.h"
@@ -191,6 +199,85 @@ gnc_transaction_dom_tree_create (Transaction* trn)
     return ret;
 }
 
+/* Text emitter matching xmlElemDump of gnc_transaction_dom_tree_create.
+ * Only the slot frames still go through the DOM generators.  Reads the
+ * transaction without modifying anything, so saves may run it on
+ * several threads at once. */
+
+static void
+split_to_xml_text (GString* buf, int level, Split* spl)
+{
+    const char* memo = xaccSplitGetMemo (spl);
+    const char* action = xaccSplitGetAction (spl);
+    char reconciled[2] = { xaccSplitGetReconcile (spl), '\0' };
+    Account* account = xaccSplitGetAccount (spl);
+    GNCLot* lot = xaccSplitGetLot (spl);
+    time64 reconciled_date = xaccSplitGetDateReconciled (spl);
+
+    xml_text_append_open (buf, level, "trn:split");
+    xml_text_append_guid (buf, level + 1, "split:id", xaccSplitGetGUID (spl));
+    if (memo && *memo)
+        xml_text_append_element (buf, level + 1, "split:memo", memo, TRUE);
+    if (action && *action)
+        xml_text_append_element (buf, level + 1, "split:action", action, TRUE);
+    xml_text_append_element (buf, level + 1, "split:reconciled-state",
+                             reconciled, TRUE);
+    if (reconciled_date)
+        xml_text_append_time64 (buf, level + 1, "split:reconcile-date",
+                                reconciled_date);
+    xml_text_append_numeric (buf, level + 1, "split:value",
+                             xaccSplitGetValue (spl));
+    xml_text_append_numeric (buf, level + 1, "split:quantity",
+                             xaccSplitGetAmount (spl));
+    xml_text_append_guid (buf, level + 1, "split:account",
+                          xaccAccountGetGUID (account));
+    if (lot)
+        xml_text_append_guid (buf, level + 1, "split:lot",
+                              gnc_lot_get_guid (lot));
+    xml_text_append_node (buf, level + 1,
+                          qof_instance_slots_to_dom_tree ("split:slots",
+                                                          QOF_INSTANCE (spl)));
+    xml_text_append_close (buf, level, "trn:split");
+}
+
+void
+gnc_transaction_xml_text_append (GString* buf, Transaction* trn)
+{
+    const char* num = xaccTransGetNum (trn);
+    const char* description = xaccTransGetDescription (trn);
+    GList* n = xaccTransGetSplitList (trn);
+
+    g_string_append_printf (buf, "<gnc:transaction version=\"%s\">\n",
+                            transaction_version_string);
+    xml_text_append_guid (buf, 1, "trn:id", xaccTransGetGUID (trn));
+    xml_text_append_commodity_ref (buf, 1, "trn:currency",
+                                   xaccTransGetCurrency (trn));
+    if (num && *num)
+        xml_text_append_element (buf, 1, "trn:num", num, TRUE);
+    xml_text_append_time64 (buf, 1, "trn:date-posted",
+                            xaccTransRetDatePosted (trn));
+    xml_text_append_time64 (buf, 1, "trn:date-entered",
+                            xaccTransRetDateEntered (trn));
+    if (description)
+        xml_text_append_element (buf, 1, "trn:description", description,
+                                 TRUE);
+    xml_text_append_node (buf, 1,
+                          qof_instance_slots_to_dom_tree ("trn:slots",
+                                                          QOF_INSTANCE (trn)));
+    if (!n)
+    {
+        g_string_append (buf, "  <trn:splits/>\n");
+    }
+    else
+    {
+        xml_text_append_open (buf, 1, "trn:splits");
+        for (; n; n = n->next)
+            split_to_xml_text (buf, 2, static_cast<Split*> (n->data));
+        xml_text_append_close (buf, 1, "trn:splits");
+    }
+    g_string_append (buf, "</gnc:transaction>\n");
+}
+
 /***********************************************************************/
 
 struct split_pdata
@@ -288,26 +375,46 @@ spl_quantity_handler (xmlNodePtr node, gpointer data)
 
 gboolean gnc_transaction_xml_v2_testing = FALSE;
 
-static gboolean
-spl_account_handler (xmlNodePtr node, gpointer data)
+/* Shared by the DOM and the streaming parsers below. */
+static void
+split_set_account_by_guid (Split* spl, QofBook* book, const GncGUID* id)
 {
-    struct split_pdata* pdata = static_cast<decltype (pdata)> (data);
-    GncGUID* id = dom_tree_to_guid (node);
-    Account* account;
-
-    g_return_val_if_fail (id, FALSE);
-
-    account = xaccAccountLookup (id, pdata->book);
+    Account* account = xaccAccountLookup (id, book);
     if (!account && gnc_transaction_xml_v2_testing &&
         !guid_equal (id, guid_null ()))
     {
-        account = xaccMallocAccount (pdata->book);
+        account = xaccMallocAccount (book);
         xaccAccountSetGUID (account, id);
         xaccAccountSetCommoditySCU (account,
-                                    xaccSplitGetAmount (pdata->split).denom);
+                                    xaccSplitGetAmount (spl).denom);
     }
 
-    xaccAccountInsertSplit (account, pdata->split);
+    xaccAccountInsertSplit (account, spl);
+}
+
+static void
+split_set_lot_by_guid (Split* spl, QofBook* book, const GncGUID* id)
+{
+    GNCLot* lot = gnc_lot_lookup (id, book);
+    if (!lot && gnc_transaction_xml_v2_testing &&
+        !guid_equal (id, guid_null ()))
+    {
+        lot = gnc_lot_new (book);
+        gnc_lot_set_guid (lot, *id);
+    }
+
+    gnc_lot_add_split (lot, spl);
+}
+
+static gboolean
+spl_account_handler (xmlNodePtr node, gpointer data)
+{
+    struct split_pdata* pdata = static_cast<decltype (pdata)> (data);
+    GncGUID* id = dom_tree_to_guid (node);
+
+    g_return_val_if_fail (id, FALSE);
+
+    split_set_account_by_guid (pdata->split, pdata->book, id);
 
     guid_free (id);
 
@@ -319,19 +426,10 @@ spl_lot_handler (xmlNodePtr node, gpointer data)
 {
     struct split_pdata* pdata = static_cast<decltype (pdata)> (data);
     GncGUID* id = dom_tree_to_guid (node);
-    GNCLot* lot;
 
     g_return_val_if_fail (id, FALSE);
 
-    lot = gnc_lot_lookup (id, pdata->book);
-    if (!lot && gnc_transaction_xml_v2_testing &&
-        !guid_equal (id, guid_null ()))
-    {
-        lot = gnc_lot_new (pdata->book);
-        gnc_lot_set_guid (lot, *id);
-    }
-
-    gnc_lot_add_split (lot, pdata->split);
+    split_set_lot_by_guid (pdata->split, pdata->book, id);
 
     guid_free (id);
 
@@ -555,42 +653,6 @@ struct dom_tree_handler trn_dom_handlers[] =
     { NULL, NULL, 0, 0 },
 };
 
-static gboolean
-gnc_transaction_end_handler (gpointer data_for_children,
-                             GSList* data_from_children, GSList* sibling_data,
-                             gpointer parent_data, gpointer global_data,
-                             gpointer* result, const gchar* tag)
-{
-    Transaction* trn = NULL;
-    xmlNodePtr tree = (xmlNodePtr)data_for_children;
-    gxpf_data* gdata = (gxpf_data*)global_data;
-
-    if (parent_data)
-    {
-        return TRUE;
-    }
-
-    /* OK.  For some messed up reason this is getting called again with a
-       NULL tag.  So we ignore those cases */
-    if (!tag)
-    {
-        return TRUE;
-    }
-
-    g_return_val_if_fail (tree, FALSE);
-
-    trn = dom_tree_to_transaction (tree,
-                                   static_cast<QofBook*> (gdata->bookdata));
-    if (trn != NULL)
-    {
-        gdata->cb (tag, gdata->parsedata, trn);
-    }
-
-    xmlFreeNode (tree);
-
-    return trn != NULL;
-}
-
 Transaction*
 dom_tree_to_transaction (xmlNodePtr node, QofBook* book)
 {
@@ -624,8 +686,976 @@ dom_tree_to_transaction (xmlNodePtr node, QofBook* book)
     return trn;
 }
 
+/***********************************************************************/
+/* Streaming transaction parser.
+ *
+ * A book is mostly transactions, so rather than collecting each
+ * <gnc:transaction> into a DOM subtree and walking it again with
+ * dom_tree_generic_parse, the SAX handlers below tokenise it into a flat
+ * TrnRecord of strings.  trn_record_decode then turns the strings into
+ * GUIDs, numerics and dates without touching the engine, and
+ * trn_record_commit builds the Transaction and its Splits.  Element
+ * names map to TrnSaxTag through a perfect hash, so each event costs one
+ * hash and one strcmp.  Only slot frames, which nest arbitrarily, are
+ * still collected into a small DOM subtree for the kvp converters.
+ *
+ * Errors are handled as the DOM handler tables did: an unknown element,
+ * a missing required one, an id with an unknown type or slots that don't
+ * parse fail the transaction and with it the parse, whether it is in the
+ * transaction or in one of its splits, while a value that doesn't decode
+ * is logged and skipped.
+ */
+
+enum class TrnSaxTag : uint8_t
+{
+    unknown,
+    ignored,
+    transaction,
+    trn_id,
+    trn_currency,
+    trn_num,
+    trn_date_posted,
+    trn_date_entered,
+    trn_description,
+    trn_slots,
+    trn_splits,
+    trn_split,
+    split_id,
+    split_memo,
+    split_action,
+    split_reconciled_state,
+    split_reconcile_date,
+    split_value,
+    split_quantity,
+    split_account,
+    split_lot,
+    split_slots,
+    cmdty_space,
+    cmdty_id,
+    ts_date,
+};
+
+struct TrnSaxTagName
+{
+    const char* name;
+    TrnSaxTag tag;
+};
+
+static constexpr TrnSaxTagName trn_sax_tag_names[] =
+{
+    { "gnc:transaction", TrnSaxTag::transaction },
+    { "trn:id", TrnSaxTag::trn_id },
+    { "trn:currency", TrnSaxTag::trn_currency },
+    { "trn:num", TrnSaxTag::trn_num },
+    { "trn:date-posted", TrnSaxTag::trn_date_posted },
+    { "trn:date-entered", TrnSaxTag::trn_date_entered },
+    { "trn:description", TrnSaxTag::trn_description },
+    { "trn:slots", TrnSaxTag::trn_slots },
+    { "trn:splits", TrnSaxTag::trn_splits },
+    { "trn:split", TrnSaxTag::trn_split },
+    { "split:id", TrnSaxTag::split_id },
+    { "split:memo", TrnSaxTag::split_memo },
+    { "split:action", TrnSaxTag::split_action },
+    { "split:reconciled-state", TrnSaxTag::split_reconciled_state },
+    { "split:reconcile-date", TrnSaxTag::split_reconcile_date },
+    { "split:value", TrnSaxTag::split_value },
+    { "split:quantity", TrnSaxTag::split_quantity },
+    { "split:account", TrnSaxTag::split_account },
+    { "split:lot", TrnSaxTag::split_lot },
+    { "split:slots", TrnSaxTag::split_slots },
+    { "cmdty:space", TrnSaxTag::cmdty_space },
+    { "cmdty:id", TrnSaxTag::cmdty_id },
+    { "ts:date", TrnSaxTag::ts_date },
+};
+
+/* FNV-1a followed by a multiply-shift into 64 buckets.  The multiplier
+ * was picked so that the names above don't collide; the static_assert
+ * below fails the build if a new name breaks that. */
+static constexpr unsigned TRN_SAX_HASH_BITS = 6;
+
+static constexpr uint32_t
+trn_sax_hash (const char* name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; ++name)
+    {
+        h ^= static_cast<unsigned char> (*name);
+        h *= 16777619u;
+    }
+    return (h * 0x9E377C7Bu) >> (32 - TRN_SAX_HASH_BITS);
+}
+
+struct TrnSaxTagTable
+{
+    int8_t slot[1 << TRN_SAX_HASH_BITS];
+    bool perfect;
+
+    constexpr TrnSaxTagTable () : slot{}, perfect{true}
+    {
+        for (auto& s : slot)
+            s = -1;
+        for (size_t i = 0; i < G_N_ELEMENTS (trn_sax_tag_names); ++i)
+        {
+            auto h = trn_sax_hash (trn_sax_tag_names[i].name);
+            if (slot[h] >= 0)
+                perfect = false;
+            slot[h] = static_cast<int8_t> (i);
+        }
+    }
+};
+
+static constexpr TrnSaxTagTable trn_sax_tag_table;
+static_assert (trn_sax_tag_table.perfect,
+               "transaction tag names collide in trn_sax_hash");
+
+static TrnSaxTag
+trn_sax_tag_lookup (const char* name)
+{
+    auto i = trn_sax_tag_table.slot[trn_sax_hash (name)];
+    if (i < 0 || strcmp (trn_sax_tag_names[i].name, name) != 0)
+        return TrnSaxTag::unknown;
+    return trn_sax_tag_names[i].tag;
+}
+
+/* Whether child may appear directly inside parent. */
+static bool
+trn_sax_tag_allowed (TrnSaxTag parent, TrnSaxTag child)
+{
+    switch (child)
+    {
+    case TrnSaxTag::trn_id:
+    case TrnSaxTag::trn_currency:
+    case TrnSaxTag::trn_num:
+    case TrnSaxTag::trn_date_posted:
+    case TrnSaxTag::trn_date_entered:
+    case TrnSaxTag::trn_description:
+    case TrnSaxTag::trn_slots:
+    case TrnSaxTag::trn_splits:
+        return parent == TrnSaxTag::transaction;
+    case TrnSaxTag::trn_split:
+        return parent == TrnSaxTag::trn_splits;
+    case TrnSaxTag::split_id:
+    case TrnSaxTag::split_memo:
+    case TrnSaxTag::split_action:
+    case TrnSaxTag::split_reconciled_state:
+    case TrnSaxTag::split_reconcile_date:
+    case TrnSaxTag::split_value:
+    case TrnSaxTag::split_quantity:
+    case TrnSaxTag::split_account:
+    case TrnSaxTag::split_lot:
+    case TrnSaxTag::split_slots:
+        return parent == TrnSaxTag::trn_split;
+    case TrnSaxTag::cmdty_space:
+    case TrnSaxTag::cmdty_id:
+        return parent == TrnSaxTag::trn_currency;
+    case TrnSaxTag::ts_date:
+        return parent == TrnSaxTag::trn_date_posted ||
+               parent == TrnSaxTag::trn_date_entered ||
+               parent == TrnSaxTag::split_reconcile_date;
+    default:
+        return false;
+    }
+}
+
+/* dom_tree_to_time64 skipped anything in a date but <ts:date>, and
+ * files with <ts:ns> next to it are around. */
+static bool
+trn_sax_tag_ignored_in (TrnSaxTag parent)
+{
+    return parent == TrnSaxTag::trn_date_posted ||
+           parent == TrnSaxTag::trn_date_entered ||
+           parent == TrnSaxTag::split_reconcile_date ||
+           parent == TrnSaxTag::ignored;
+}
+
+static constexpr uint32_t
+trn_sax_bit (TrnSaxTag tag)
+{
+    return 1u << static_cast<unsigned> (tag);
+}
+
+static constexpr uint32_t trn_sax_trn_required =
+    trn_sax_bit (TrnSaxTag::trn_id) |
+    trn_sax_bit (TrnSaxTag::trn_date_posted) |
+    trn_sax_bit (TrnSaxTag::trn_date_entered) |
+    trn_sax_bit (TrnSaxTag::trn_splits);
+
+static constexpr uint32_t trn_sax_split_required =
+    trn_sax_bit (TrnSaxTag::split_id) |
+    trn_sax_bit (TrnSaxTag::split_reconciled_state) |
+    trn_sax_bit (TrnSaxTag::split_value) |
+    trn_sax_bit (TrnSaxTag::split_quantity) |
+    trn_sax_bit (TrnSaxTag::split_account);
+
+struct TrnRecordGuid
+{
+    std::string text;
+    bool type_ok;
+    bool valid;                 /* set by trn_record_decode */
+    GncGUID guid;
+};
+
+struct TrnRecordDate
+{
+    std::string text;
+    int count;                  /* number of <ts:date> children */
+    time64 time;                /* set by trn_record_decode */
+};
+
+/* Memos and descriptions that arrive in one piece from mapped input
+ * are kept as a reference into the mapping, which outlives every record,
+ * rather than copied; anything else is copied into text. */
+struct TrnRecordText
+{
+    std::string text;
+    const char* ref;
+    std::size_t ref_len;
+};
+
+struct TrnSplitRecord
+{
+    uint32_t seen;
+    TrnRecordGuid id;
+    TrnRecordGuid account;
+    TrnRecordGuid lot;
+    TrnRecordText memo;
+    std::string action;
+    std::string reconciled_state;
+    TrnRecordDate reconcile_date;
+    std::string value;
+    std::string quantity;
+    xmlNodePtr slots;
+    gnc_numeric value_num;      /* set by trn_record_decode */
+    gnc_numeric quantity_num;
+};
+
+struct TrnRecord
+{
+    uint32_t seen;
+    bool ok;
+    bool decoded;               /* guarded by the pipeline mutex */
+    TrnRecordGuid id;
+    std::string cmdty_space;
+    std::string cmdty_id;
+    std::string num;
+    TrnRecordDate date_posted;
+    TrnRecordDate date_entered;
+    TrnRecordText description;
+    xmlNodePtr slots;
+    std::vector<TrnSplitRecord> splits;
+};
+
+static void
+trn_record_free (TrnRecord* record)
+{
+    if (record->slots)
+        xmlFreeNode (record->slots);
+    for (auto& split : record->splits)
+        if (split.slots)
+            xmlFreeNode (split.slots);
+    delete record;
+}
+
+/* Returns false if the id's type attribute was unusable, which fails
+ * the whole transaction.  Unreadable text only leaves the id unset. */
+static bool
+trn_record_decode_guid (TrnRecordGuid& field, const char* tag)
+{
+    field.valid = false;
+    if (!field.type_ok)
+        return false;
+    field.valid = xml_string_to_guid (field.text.c_str (), &field.guid);
+    if (!field.valid)
+        PERR ("Bad GUID in <%s>: %s", tag, field.text.c_str ());
+    return true;
+}
+
+static void
+trn_record_decode_date (TrnRecordDate& field, const char* tag)
+{
+    field.time = INT64_MAX;
+    if (field.count == 1)
+        field.time = xml_string_to_time64 (field.text.c_str ());
+    else if (!field.count)
+        PERR ("no ts:date node found.");
+    if (!dom_tree_valid_time64 (field.time, BAD_CAST tag))
+        field.time = 0;
+}
+
+static gnc_numeric
+trn_record_decode_numeric (const std::string& text)
+{
+    gnc_numeric num = xml_string_to_gnc_numeric (text.c_str ());
+    if (gnc_numeric_check (num))
+        num = gnc_numeric_zero ();
+    return num;
+}
+
+static bool
+trn_record_has (uint32_t seen, TrnSaxTag tag)
+{
+    return (seen & trn_sax_bit (tag)) != 0;
+}
+
+/* Converts the text fields of record.  Doesn't touch the engine, so
+ * records can be decoded on any thread. */
+static void
+trn_record_decode (TrnRecord* record)
+{
+    if (!record->ok)
+        return;
+    if (!trn_record_decode_guid (record->id, "trn:id"))
+        record->ok = false;
+    trn_record_decode_date (record->date_posted, "trn:date-posted");
+    trn_record_decode_date (record->date_entered, "trn:date-entered");
+
+    for (auto& split : record->splits)
+    {
+        if (!trn_record_decode_guid (split.id, "split:id") ||
+            !trn_record_decode_guid (split.account, "split:account") ||
+            (trn_record_has (split.seen, TrnSaxTag::split_lot) &&
+             !trn_record_decode_guid (split.lot, "split:lot")))
+        {
+            record->ok = false;
+            return;
+        }
+        if (trn_record_has (split.seen, TrnSaxTag::split_reconcile_date))
+            trn_record_decode_date (split.reconcile_date,
+                                    "split:reconcile-date");
+        split.value_num = trn_record_decode_numeric (split.value);
+        split.quantity_num = trn_record_decode_numeric (split.quantity);
+    }
+}
+
+/* The engine's setters want a terminated string to look up in the
+ * string cache; a referenced text is terminated in scratch. */
+static const char*
+trn_record_text (const TrnRecordText& field, std::string& scratch)
+{
+    if (!field.ref)
+        return field.text.c_str ();
+    scratch.assign (field.ref, field.ref_len);
+    return scratch.c_str ();
+}
+
+/* Builds a split of the decoded record into trn.  Returns FALSE if its
+ * slots couldn't be parsed. */
+static gboolean
+trn_record_commit_split (TrnSplitRecord& rec, Transaction* trn,
+                         QofBook* book, std::string& scratch)
+{
+    Split* spl = xaccMallocSplit (book);
+
+    if (rec.id.valid)
+        xaccSplitSetGUID (spl, &rec.id.guid);
+    if (trn_record_has (rec.seen, TrnSaxTag::split_memo))
+        xaccSplitSetMemo (spl, trn_record_text (rec.memo, scratch));
+    if (trn_record_has (rec.seen, TrnSaxTag::split_action))
+        xaccSplitSetAction (spl, rec.action.c_str ());
+    xaccSplitSetReconcile (spl, rec.reconciled_state.c_str ()[0]);
+    if (trn_record_has (rec.seen, TrnSaxTag::split_reconcile_date))
+        xaccSplitSetDateReconciledSecs (spl, rec.reconcile_date.time);
+    xaccSplitSetValue (spl, rec.value_num);
+    xaccSplitSetAmount (spl, rec.quantity_num);
+    if (rec.account.valid)
+        split_set_account_by_guid (spl, book, &rec.account.guid);
+    if (rec.lot.valid)
+        split_set_lot_by_guid (spl, book, &rec.lot.guid);
+    xaccTransAppendSplit (trn, spl);
+    if (rec.slots &&
+        !dom_tree_create_instance_slots (rec.slots, QOF_INSTANCE (spl)))
+    {
+        PERR ("failed to parse the split slots");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Builds the transaction described by a decoded record.  Returns NULL
+ * if the record was unusable, and also marks it so if its slots or
+ * those of one of its splits couldn't be parsed. */
+static Transaction*
+trn_record_commit (TrnRecord* record, QofBook* book)
+{
+    Transaction* trn;
+    std::string scratch;
+
+    if (!record->ok)
+        return NULL;
+
+    trn = xaccMallocTransaction (book);
+    xaccTransBeginEdit (trn);
+
+    if (record->id.valid)
+        xaccTransSetGUID (trn, &record->id.guid);
+    if (trn_record_has (record->seen, TrnSaxTag::trn_currency))
+    {
+        gnc_commodity_table* table = gnc_commodity_table_get_table (book);
+        gchar* space = g_strstrip (g_strdup (record->cmdty_space.c_str ()));
+        gchar* id = g_strstrip (g_strdup (record->cmdty_id.c_str ()));
+
+        xaccTransSetCurrency (trn, gnc_commodity_table_lookup (table, space,
+                                                               id));
+        g_free (space);
+        g_free (id);
+    }
+    if (trn_record_has (record->seen, TrnSaxTag::trn_num))
+        xaccTransSetNum (trn, record->num.c_str ());
+    xaccTransSetDatePostedSecs (trn, record->date_posted.time);
+    xaccTransSetDateEnteredSecs (trn, record->date_entered.time);
+    if (trn_record_has (record->seen, TrnSaxTag::trn_description))
+        xaccTransSetDescription (trn, trn_record_text (record->description,
+                                                       scratch));
+    if (record->slots &&
+        !dom_tree_create_instance_slots (record->slots, QOF_INSTANCE (trn)))
+    {
+        PERR ("failed to parse the transaction slots");
+        record->ok = false;
+    }
+
+    for (auto& split : record->splits)
+        if (record->ok &&
+            !trn_record_commit_split (split, trn, book, scratch))
+            record->ok = false;
+
+    if (!record->ok)
+    {
+        /* The slots may already have marked it read-only. */
+        xaccTransClearReadOnly (trn);
+        xaccTransDestroy (trn);
+        xaccTransCommitEdit (trn);
+        return NULL;
+    }
+    xaccTransCommitEdit (trn);
+    return trn;
+}
+
+/* Commits record, hands the transaction to the parse callback and frees
+ * the record. */
+static gboolean
+trn_record_deliver (TrnRecord* record, gxpf_data* gdata)
+{
+    Transaction* trn = trn_record_commit (record,
+                                          static_cast<QofBook*> (gdata->bookdata));
+    trn_record_free (record);
+    if (!trn)
+        return FALSE;
+    gdata->cb ("gnc:transaction", gdata->parsedata, trn);
+    return TRUE;
+}
+
+static gboolean trn_pipeline_submit (GncXmlTrnPipeline* pl, TrnRecord* record,
+                                     gxpf_data* gdata);
+
+struct trn_sax_data
+{
+    TrnRecord* record;
+    TrnSplitRecord* split;      /* the open <trn:split>, if any */
+    std::vector<TrnSaxTag> open; /* open elements, outermost first */
+    std::string text;           /* character data of the current leaf */
+    const char* text_ref;       /* or where it lies in mapped input */
+    std::size_t text_ref_len;
+    TrnRecordDate* date;        /* the open date element, if any */
+    xmlNodePtr slots_cur;       /* innermost open element of a slots frame */
+    guint slots_depth;
+};
+
+static bool
+trn_sax_guid_type_ok (gchar** attrs)
+{
+    if (!attrs || !attrs[0] || strcmp (attrs[0], "type") != 0)
+    {
+        PERR ("Unknown attribute for id tag: %s",
+              attrs && attrs[0] ? attrs[0] : "(null)");
+        return false;
+    }
+    /* handle new and guid the same for the moment */
+    if (g_strcmp0 (attrs[1], "guid") == 0 || g_strcmp0 (attrs[1], "new") == 0)
+        return true;
+    PERR ("Unknown type %s for attribute type for id tag",
+          attrs[1] ? attrs[1] : "(null)");
+    return false;
+}
+
+static TrnRecordGuid*
+trn_sax_guid_field (trn_sax_data* data, TrnSaxTag id)
+{
+    switch (id)
+    {
+    case TrnSaxTag::trn_id:
+        return &data->record->id;
+    case TrnSaxTag::split_id:
+        return &data->split->id;
+    case TrnSaxTag::split_account:
+        return &data->split->account;
+    case TrnSaxTag::split_lot:
+        return &data->split->lot;
+    default:
+        return nullptr;
+    }
+}
+
+static gboolean
+trn_sax_start_handler (GSList* sibling_data, gpointer parent_data,
+                       gpointer global_data, gpointer* data_for_children,
+                       gpointer* result, const gchar* tag, gchar** attrs)
+{
+    auto data = static_cast<trn_sax_data*> (parent_data);
+    auto id = TrnSaxTag::unknown;
+
+    *result = NULL;
+
+    if (!data)
+    {
+        data = new trn_sax_data {};
+        data->record = new TrnRecord {};
+        data->record->ok = true;
+        data->open.reserve (8);
+        data->open.push_back (TrnSaxTag::transaction);
+        *data_for_children = data;
+        return TRUE;
+    }
+
+    *data_for_children = data;
+
+    if (data->slots_depth)
+    {
+        data->slots_cur = xmlNewChild (data->slots_cur, NULL, BAD_CAST tag,
+                                       NULL);
+        for (gchar** atptr = attrs; atptr && *atptr; atptr += 2)
+            xmlSetProp (data->slots_cur, BAD_CAST atptr[0], BAD_CAST atptr[1]);
+        data->slots_depth++;
+        return TRUE;
+    }
+
+    id = trn_sax_tag_lookup (tag);
+    if (!trn_sax_tag_allowed (data->open.back (), id))
+    {
+        if (trn_sax_tag_ignored_in (data->open.back ()))
+        {
+            data->open.push_back (TrnSaxTag::ignored);
+            return TRUE;
+        }
+        PERR ("Unhandled tag: %s", tag ? tag : "(null)");
+        data->open.push_back (TrnSaxTag::unknown);
+        data->record->ok = false;
+        return TRUE;
+    }
+
+    data->open.push_back (id);
+    data->text.clear ();
+    data->text_ref = NULL;
+
+    switch (id)
+    {
+    case TrnSaxTag::trn_id:
+    case TrnSaxTag::split_id:
+    case TrnSaxTag::split_account:
+    case TrnSaxTag::split_lot:
+        trn_sax_guid_field (data, id)->type_ok = trn_sax_guid_type_ok (attrs);
+        break;
+    case TrnSaxTag::trn_date_posted:
+        data->date = &data->record->date_posted;
+        break;
+    case TrnSaxTag::trn_date_entered:
+        data->date = &data->record->date_entered;
+        break;
+    case TrnSaxTag::split_reconcile_date:
+        data->date = &data->split->reconcile_date;
+        break;
+    case TrnSaxTag::trn_split:
+        data->record->splits.emplace_back ();
+        data->split = &data->record->splits.back ();
+        break;
+    case TrnSaxTag::trn_slots:
+    case TrnSaxTag::split_slots:
+    {
+        xmlNodePtr& slots = id == TrnSaxTag::trn_slots ?
+            data->record->slots : data->split->slots;
+        if (slots)
+            xmlFreeNode (slots);
+        slots = xmlNewNode (NULL, BAD_CAST tag);
+        data->slots_cur = slots;
+        data->slots_depth = 1;
+        break;
+    }
+    default:
+        break;
+    }
+    return TRUE;
+}
+
+/* Whether text can be referenced in place rather than copied: only
+ * memos and descriptions are, and only when libxml2 hands them over
+ * straight from input that stays mapped until the records are
+ * committed. */
+static bool
+trn_sax_text_is_mapped (const trn_sax_data* data, const gxpf_data* gdata,
+                        const char* text, int length)
+{
+    if (!gdata || !gdata->input || data->open.empty ())
+        return false;
+    if (data->open.back () != TrnSaxTag::trn_description &&
+        data->open.back () != TrnSaxTag::split_memo)
+        return false;
+    return text >= gdata->input &&
+           text + length <= gdata->input + gdata->input_length;
+}
+
+static gboolean
+trn_sax_chars_handler (GSList* sibling_data, gpointer parent_data,
+                       gpointer global_data, gpointer* result,
+                       const char* text, int length)
+{
+    auto data = static_cast<trn_sax_data*> (parent_data);
+    auto gdata = static_cast<gxpf_data*> (global_data);
+
+    if (!data || length <= 0)
+        return TRUE;
+
+    if (data->slots_depth)
+        xmlNodeAddContentLen (data->slots_cur, BAD_CAST text, length);
+    else if (!data->text_ref && data->text.empty () &&
+             trn_sax_text_is_mapped (data, gdata, text, length))
+    {
+        data->text_ref = text;
+        data->text_ref_len = length;
+    }
+    else
+    {
+        if (data->text_ref)
+        {
+            data->text.assign (data->text_ref, data->text_ref_len);
+            data->text_ref = NULL;
+        }
+        data->text.append (text, length);
+    }
+    return TRUE;
+}
+
+/* Moves the current leaf's character data into field. */
+static void
+trn_sax_take_text (trn_sax_data* data, TrnRecordText& field)
+{
+    field.text.swap (data->text);
+    field.ref = data->text_ref;
+    field.ref_len = data->text_ref_len;
+    data->text_ref = NULL;
+}
+
+/* Records the end of an element nested in <gnc:transaction>. */
+static void
+trn_sax_end_element (trn_sax_data* data, TrnSaxTag id)
+{
+    TrnRecord* record = data->record;
+    TrnSplitRecord* split = data->split;
+
+    switch (id)
+    {
+    case TrnSaxTag::trn_id:
+    case TrnSaxTag::split_id:
+    case TrnSaxTag::split_account:
+    case TrnSaxTag::split_lot:
+        trn_sax_guid_field (data, id)->text.swap (data->text);
+        break;
+    case TrnSaxTag::trn_num:
+        record->num.swap (data->text);
+        break;
+    case TrnSaxTag::trn_description:
+        trn_sax_take_text (data, record->description);
+        break;
+    case TrnSaxTag::trn_date_posted:
+    case TrnSaxTag::trn_date_entered:
+    case TrnSaxTag::split_reconcile_date:
+        data->date = nullptr;
+        break;
+    case TrnSaxTag::trn_slots:
+    case TrnSaxTag::split_slots:
+        data->slots_cur = NULL;
+        break;
+    case TrnSaxTag::trn_split:
+        if ((split->seen & trn_sax_split_required) != trn_sax_split_required)
+        {
+            PERR ("didn't find all of the expected tags in the split");
+            record->ok = false;
+        }
+        data->split = nullptr;
+        break;
+    case TrnSaxTag::split_memo:
+        trn_sax_take_text (data, split->memo);
+        break;
+    case TrnSaxTag::split_action:
+        split->action.swap (data->text);
+        break;
+    case TrnSaxTag::split_reconciled_state:
+        split->reconciled_state.swap (data->text);
+        break;
+    case TrnSaxTag::split_value:
+        split->value.swap (data->text);
+        break;
+    case TrnSaxTag::split_quantity:
+        split->quantity.swap (data->text);
+        break;
+    case TrnSaxTag::cmdty_space:
+        record->cmdty_space.swap (data->text);
+        break;
+    case TrnSaxTag::cmdty_id:
+        record->cmdty_id.swap (data->text);
+        break;
+    case TrnSaxTag::ts_date:
+        data->date->text.swap (data->text);
+        data->date->count++;
+        break;
+    default:
+        break;
+    }
+
+    if (data->split)
+        data->split->seen |= trn_sax_bit (id);
+    else
+        record->seen |= trn_sax_bit (id);
+}
+
+static gboolean
+trn_sax_end_handler (gpointer data_for_children,
+                     GSList* data_from_children, GSList* sibling_data,
+                     gpointer parent_data, gpointer global_data,
+                     gpointer* result, const gchar* tag)
+{
+    auto data = static_cast<trn_sax_data*> (data_for_children);
+    gxpf_data* gdata = (gxpf_data*)global_data;
+    TrnRecord* record;
+    TrnSaxTag id;
+
+    /* OK.  For some messed up reason this is getting called again with a
+       NULL tag.  So we ignore those cases */
+    if (!tag || !data)
+    {
+        return TRUE;
+    }
+
+    if (data->slots_depth && --data->slots_depth)
+    {
+        data->slots_cur = data->slots_cur->parent;
+        return TRUE;
+    }
+
+    id = data->open.back ();
+    data->open.pop_back ();
+
+    if (id != TrnSaxTag::transaction)
+    {
+        if (id != TrnSaxTag::unknown && id != TrnSaxTag::ignored)
+            trn_sax_end_element (data, id);
+        return TRUE;
+    }
+
+    record = data->record;
+    delete data;
+
+    if ((record->seen & trn_sax_trn_required) != trn_sax_trn_required)
+    {
+        PERR ("didn't find all of the expected tags in the input");
+        record->ok = false;
+    }
+
+    if (gdata->trn_pipeline)
+        return trn_pipeline_submit (gdata->trn_pipeline, record, gdata);
+
+    trn_record_decode (record);
+    return trn_record_deliver (record, gdata);
+}
+
+static void
+trn_sax_fail_handler (gpointer data_for_children,
+                      GSList* data_from_children,
+                      GSList* sibling_data,
+                      gpointer parent_data,
+                      gpointer global_data,
+                      gpointer* result,
+                      const gchar* tag)
+{
+    /* Every frame below <gnc:transaction> shares its data; only the
+       outermost one, which has no parent data, owns it. */
+    if (data_for_children && !parent_data)
+    {
+        auto data = static_cast<trn_sax_data*> (data_for_children);
+        trn_record_free (data->record);
+        delete data;
+    }
+}
+
 sixtp*
 gnc_transaction_sixtp_parser_create (void)
 {
-    return sixtp_dom_parser_new (gnc_transaction_end_handler, NULL, NULL);
+    sixtp* top_level;
+
+    if (! (top_level =
+               sixtp_set_any (sixtp_new (), FALSE,
+                              SIXTP_START_HANDLER_ID, trn_sax_start_handler,
+                              SIXTP_CHARACTERS_HANDLER_ID, trn_sax_chars_handler,
+                              SIXTP_END_HANDLER_ID, trn_sax_end_handler,
+                              SIXTP_FAIL_HANDLER_ID, trn_sax_fail_handler,
+                              SIXTP_NO_MORE_HANDLERS)))
+    {
+        return NULL;
+    }
+
+    if (!sixtp_add_sub_parser (top_level, SIXTP_MAGIC_CATCHER, top_level))
+    {
+        sixtp_destroy (top_level);
+        return NULL;
+    }
+
+    return top_level;
+}
+
+/***********************************************************************/
+/* Pipelined loading.
+ *
+ * With a pipeline attached to the gxpf_data, a parsed transaction record
+ * is queued for a pool of worker threads that decode it while the
+ * parser moves on.  The parsing thread commits decoded records to the
+ * book strictly in file order, so it remains the only thread touching
+ * the engine.  Loaders must call gnc_xml_trn_pipeline_flush before
+ * anything that may refer to the transactions, e.g. the next
+ * non-transaction element.
+ */
+
+/* Records submitted but not yet committed before the parser waits. */
+static constexpr size_t TRN_PIPELINE_WINDOW = 4096;
+
+struct GncXmlTrnPipeline
+{
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable record_decoded;
+    std::deque<TrnRecord*> queue;  /* waiting for a worker */
+    std::deque<TrnRecord*> window; /* in file order, not yet committed */
+    std::vector<std::thread> workers;
+    bool stopping;
+    bool ok;                       /* no committed record failed */
+};
+
+static void
+trn_pipeline_worker (GncXmlTrnPipeline* pl)
+{
+    std::unique_lock<std::mutex> lock (pl->mutex);
+
+    while (true)
+    {
+        pl->work_ready.wait (lock, [pl]
+        {
+            return pl->stopping || !pl->queue.empty ();
+        });
+        if (pl->stopping)
+            return;
+
+        auto record = pl->queue.front ();
+        pl->queue.pop_front ();
+        lock.unlock ();
+        trn_record_decode (record);
+        lock.lock ();
+        record->decoded = true;
+        pl->record_decoded.notify_one ();
+    }
+}
+
+/* Commits the decoded records at the head of the window, waiting for
+ * the workers while more than keep records are outstanding. */
+static void
+trn_pipeline_commit (GncXmlTrnPipeline* pl, gxpf_data* gdata, size_t keep)
+{
+    std::unique_lock<std::mutex> lock (pl->mutex);
+
+    while (!pl->window.empty ())
+    {
+        auto record = pl->window.front ();
+
+        if (!record->decoded)
+        {
+            if (pl->window.size () <= keep)
+                break;
+            pl->record_decoded.wait (lock);
+            continue;
+        }
+
+        pl->window.pop_front ();
+        lock.unlock ();
+        if (!trn_record_deliver (record, gdata))
+            pl->ok = false;
+        lock.lock ();
+    }
+}
+
+static gboolean
+trn_pipeline_submit (GncXmlTrnPipeline* pl, TrnRecord* record,
+                     gxpf_data* gdata)
+{
+    if (pl->workers.empty ())
+    {
+        trn_record_decode (record);
+        return trn_record_deliver (record, gdata);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock (pl->mutex);
+        pl->window.push_back (record);
+        pl->queue.push_back (record);
+    }
+    pl->work_ready.notify_one ();
+
+    trn_pipeline_commit (pl, gdata, TRN_PIPELINE_WINDOW);
+    return pl->ok;
+}
+
+GncXmlTrnPipeline*
+gnc_xml_trn_pipeline_new (guint n_workers)
+{
+    auto pl = new GncXmlTrnPipeline {};
+
+    pl->ok = true;
+    try
+    {
+        for (guint i = 0; i < n_workers; ++i)
+            pl->workers.emplace_back (trn_pipeline_worker, pl);
+    }
+    catch (const std::system_error& err)
+    {
+        PWARN ("Started only %zu of %u transaction decoders: %s",
+               pl->workers.size (), n_workers, err.what ());
+    }
+    return pl;
+}
+
+gboolean
+gnc_xml_trn_pipeline_flush (gxpf_data* gdata)
+{
+    GncXmlTrnPipeline* pl = gdata->trn_pipeline;
+
+    if (!pl)
+        return TRUE;
+
+    trn_pipeline_commit (pl, gdata, 0);
+    return pl->ok;
+}
+
+void
+gnc_xml_trn_pipeline_destroy (GncXmlTrnPipeline* pl)
+{
+    if (!pl)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock (pl->mutex);
+        pl->stopping = true;
+    }
+    pl->work_ready.notify_all ();
+    for (auto& worker : pl->workers)
+        worker.join ();
+
+    /* Whatever is left was never committed, e.g. after a parse error. */
+    for (auto record : pl->window)
+        trn_record_free (record);
+    delete pl;
 }
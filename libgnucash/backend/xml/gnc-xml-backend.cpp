@@ -21,6 +21,7 @@
 #include <platform.h>
 #if PLATFORM(WINDOWS)
 #include <windows.h>
+#include <io.h>
 #endif
 #include <errno.h>
 #include <string.h>
@@ -35,6 +36,7 @@
 #include <gnc-engine.h> //for GNC_MOD_BACKEND
 #include <gnc-uri-utils.h>
 #include <TransLog.h>
+#include <Transaction.h>
 #include <gnc-prefs.h>
 
 #include <sstream>
@@ -43,14 +45,21 @@
 #include "gnc-backend-xml.h"
 #include "io-gncxml-v2.h"
 #include "io-gncxml.h"
+#include "gnc-xml-snapshot.h"
 
 #define XML_URI_PREFIX "xml://"
 #define FILE_URI_PREFIX "file://"
+#define JOURNAL_SUFFIX ".journal"
+/* Rewrite the data file once the journal holds this many records. */
+#define JOURNAL_MAX_RECORDS 5000
+#define SNAPSHOT_SUFFIX ".snapshot"
 static QofLogModule log_module = GNC_MOD_BACKEND;
 
 GncXmlBackend::~GncXmlBackend()
 {
     session_end();
+    if (m_journal_pending)
+        g_hash_table_destroy (m_journal_pending);
 };
 
 bool
@@ -140,7 +149,13 @@ GncXmlBackend::session_begin(QofSession* session, const char* new_uri,
     m_dirname = dirname;
     g_free (dirname);
 
-
+    m_journalfile = m_fullpath + JOURNAL_SUFFIX;
+    if (!m_journal_pending)
+        m_journal_pending = g_hash_table_new_full (guid_hash_to_guint,
+                                                   guid_g_hash_table_equal,
+                                                   (GDestroyNotify)guid_free,
+                                                   nullptr);
+    m_snapshotfile = m_fullpath + SNAPSHOT_SUFFIX;
 
     /* ---------------------------------------------------- */
     /* We should now have a fully resolved path name.
@@ -165,6 +180,25 @@ GncXmlBackend::session_end()
         return;
     }
 
+    if (m_journal)
+    {
+        fclose (m_journal);
+        m_journal = nullptr;
+    }
+    /* Fold the journal into the data file on close, unless that would also
+     * save changes the user chose not to save. */
+    if (m_journal_records > 0 && m_book && !m_fullpath.empty()
+        && !m_lockfile.empty() && !qof_book_session_not_saved (m_book))
+    {
+        if (write_to_file (false))
+            reset_journal();
+    }
+    /* Only if the book is still as it was saved. */
+    if (!m_snapshot_hash.empty() && m_book && !m_lockfile.empty()
+        && m_journal_records == 0 && !qof_book_session_not_saved (m_book))
+        write_snapshot (m_snapshot_hash.data());
+    m_snapshot_hash.clear();
+
     if (!m_linkfile.empty())
         g_unlink (m_linkfile.c_str());
 
@@ -194,6 +228,10 @@ GncXmlBackend::session_end()
     m_fullpath.clear();
     m_lockfile.clear();
     m_linkfile.clear();
+    m_journalfile.clear();
+    m_journal_records = 0;
+    m_journal_usable = false;
+    m_snapshotfile.clear();
 }
 
 static QofBookFileType
@@ -235,19 +273,40 @@ GncXmlBackend::load(QofBook* book, QofBackendLoadType loadType)
 
     error = ERR_BACKEND_NO_ERR;
     m_book = book;
+    m_journal_usable = false;
 
     int rc;
     switch (determine_file_type (m_fullpath))
     {
     case GNC_BOOK_XML2_FILE:
-        rc = qof_session_load_from_xml_file_v2 (this, book,
-                                                     GNC_BOOK_XML2_FILE);
+    {
+        auto snapshot = gnc_prefs_get_file_save_snapshot () ?
+                        gnc_xml_snapshot_open (m_snapshotfile.c_str(),
+                                               m_fullpath.c_str()) : nullptr;
+        auto from_snapshot = snapshot != nullptr;
+
+        if (from_snapshot)
+        {
+            rc = qof_session_load_from_xml_snapshot_v2 (this, book, snapshot);
+            gnc_xml_snapshot_free (snapshot);
+        }
+        else
+            rc = qof_session_load_from_xml_file_v2 (this, book,
+                                                    GNC_BOOK_XML2_FILE);
         if (rc == FALSE)
         {
             PWARN ("Syntax error in Xml File %s", m_fullpath.c_str());
             error = ERR_FILEIO_PARSE_ERROR;
+            break;
         }
+        /* The book must still match the data file, so before the
+         * journal. */
+        if (!from_snapshot && !m_lockfile.empty())
+            write_snapshot (nullptr);
+        replay_journal();
+        m_journal_usable = true;
         break;
+    }
 
     case GNC_BOOK_XML2_FILE_NO_ENCODING:
         error = ERR_FILEIO_NO_ENCODING;
@@ -295,6 +354,8 @@ GncXmlBackend::load(QofBook* book, QofBackendLoadType loadType)
 
     /* We just got done loading, it can't possibly be dirty !! */
     qof_book_mark_session_saved (book);
+    if (m_journal_pending)
+        g_hash_table_remove_all (m_journal_pending);
 }
 
 void
@@ -316,17 +377,238 @@ GncXmlBackend::sync(QofBook* book)
         return;
     }
 
-    write_to_file (true);
+    /* In journal mode only the changed transactions are appended to the
+     * journal; the whole book is written when anything else changed or
+     * the journal has grown long. */
+    if (gnc_prefs_get_file_save_journal () && m_journal_usable
+        && m_journal_records < JOURNAL_MAX_RECORDS && save_journal ())
+    {
+        qof_book_mark_session_saved (m_book);
+        return;
+    }
+
+    if (write_to_file (true))
+        reset_journal ();
     remove_old_files();
 }
 
 void
 GncXmlBackend::commit(QofInstance* instance)
 {
+    if (m_journal_usable && m_journal_pending
+        && qof_instance_get_book (instance) == m_book)
+    {
+        /* Remember which transactions to journal on the next save.  A
+         * split commit stands for its transaction, anything else can only
+         * be saved by writing the whole book. */
+        const GncGUID* guid = nullptr;
+        if (GNC_IS_TRANSACTION (instance))
+        {
+            if (qof_instance_is_dirty (instance)
+                || qof_instance_get_destroying (instance))
+                guid = qof_instance_get_guid (instance);
+        }
+        else if (GNC_IS_SPLIT (instance))
+        {
+            auto trans = xaccSplitGetParent (GNC_SPLIT (instance));
+            if (trans && qof_instance_is_dirty (instance))
+                guid = qof_instance_get_guid (QOF_INSTANCE (trans));
+        }
+        else if (qof_instance_is_dirty (instance))
+            m_journal_usable = false;
+
+        if (guid && !g_hash_table_contains (m_journal_pending, guid))
+            g_hash_table_add (m_journal_pending, guid_copy (guid));
+    }
+
     if (qof_instance_is_dirty(instance))
         qof_instance_mark_clean(instance);
 }
 
+/* The journal starts with a line identifying the data file it follows, so
+ * that a journal left behind by a crash right after the data file was
+ * rewritten isn't replayed on top of it. */
+std::string
+GncXmlBackend::journal_header()
+{
+    GStatBuf statbuf;
+    if (g_stat (m_fullpath.c_str(), &statbuf) != 0)
+        return {};
+
+    std::ostringstream header;
+    header << "gnc-journal 1 " << statbuf.st_size << " " << statbuf.st_mtime;
+    return header.str();
+}
+
+void
+GncXmlBackend::replay_journal()
+{
+    gchar* contents = nullptr;
+    gsize length = 0;
+
+    m_journal_records = 0;
+    if (!g_file_get_contents (m_journalfile.c_str(), &contents, &length,
+                              nullptr))
+        return;
+
+    auto end = contents + length;
+    auto line_end = static_cast<char*>(memchr (contents, '\n', length));
+    if (!line_end || journal_header() != std::string (contents, line_end))
+    {
+        PINFO ("Ignoring journal %s, it doesn't follow %s",
+               m_journalfile.c_str(), m_fullpath.c_str());
+        g_free (contents);
+        if (!m_lockfile.empty())
+            g_unlink (m_journalfile.c_str());
+        return;
+    }
+
+    auto pos = line_end + 1;
+    QofBook* scratch = nullptr;
+    while (pos < end)
+    {
+        char guidstr[GUID_ENCODING_LENGTH + 1];
+        gsize len;
+        int consumed = 0;
+        GncGUID guid;
+
+        line_end = static_cast<char*>(memchr (pos, '\n', end - pos));
+        if (!line_end)
+            break;
+        std::string line (pos, line_end);
+        if (sscanf (line.c_str(), "trn %32s %" G_GSIZE_FORMAT "%n", guidstr,
+                    &len, &consumed) != 2
+            || consumed != static_cast<int>(line.size())
+            || !string_to_guid (guidstr, &guid))
+            break;
+        auto body = line_end + 1;
+        if (static_cast<gsize>(end - body) <= len || body[len] != '\n')
+            break;
+
+        if (!scratch)
+            scratch = qof_book_new ();
+        if (!gnc_xml2_journal_replay_transaction (m_book, scratch, &guid,
+                                                  body, len))
+            PWARN ("Couldn't replay journal record for %s", guidstr);
+        ++m_journal_records;
+        pos = body + len + 1;
+    }
+
+    if (scratch)
+        qof_book_destroy (scratch);
+
+    /* A crash while saving leaves a partial record at the end. */
+    if (pos < end)
+    {
+        PWARN ("Dropping %" G_GSIZE_FORMAT " bytes of partial records from %s",
+               static_cast<gsize>(end - pos), m_journalfile.c_str());
+        if (!m_lockfile.empty()
+            && !g_file_set_contents (m_journalfile.c_str(), contents,
+                                     pos - contents, nullptr))
+            m_journal_records = JOURNAL_MAX_RECORDS;
+    }
+    PINFO ("Replayed %u records from %s", m_journal_records,
+           m_journalfile.c_str());
+    g_free (contents);
+}
+
+static int
+sync_file (FILE* file)
+{
+#if PLATFORM(WINDOWS)
+    return _commit (_fileno (file));
+#else
+    return fsync (fileno (file));
+#endif
+}
+
+bool
+GncXmlBackend::save_journal()
+{
+    GHashTableIter iter;
+    gpointer key;
+    bool success = true;
+
+    g_hash_table_iter_init (&iter, m_journal_pending);
+    while (g_hash_table_iter_next (&iter, &key, nullptr))
+        if (!gnc_xml2_journal_can_write_transaction (m_book,
+                                                     static_cast<GncGUID*>(key)))
+            return false;
+
+    if (!m_journal && m_journal_records > 0)
+        m_journal = g_fopen (m_journalfile.c_str(), "ab");
+    else if (!m_journal)
+    {
+        auto header = journal_header();
+        if (header.empty())
+            return false;
+        m_journal = g_fopen (m_journalfile.c_str(), "wb");
+        if (m_journal && fprintf (m_journal, "%s\n", header.c_str()) < 0)
+            success = false;
+    }
+    if (!m_journal)
+    {
+        PWARN ("Unable to open journal %s: %s", m_journalfile.c_str(),
+               g_strerror (errno));
+        return false;
+    }
+
+    g_hash_table_iter_init (&iter, m_journal_pending);
+    while (success && g_hash_table_iter_next (&iter, &key, nullptr))
+        success = gnc_xml2_journal_write_transaction (m_journal, m_book,
+                                                      static_cast<GncGUID*>(key));
+
+    if (!success || fflush (m_journal) != 0 || sync_file (m_journal) != 0)
+    {
+        /* The journal may now end in a partial record, so leave it for
+         * the data file rewrite to replace. */
+        PWARN ("Unable to write journal %s: %s", m_journalfile.c_str(),
+               g_strerror (errno));
+        fclose (m_journal);
+        m_journal = nullptr;
+        m_journal_usable = false;
+        return false;
+    }
+
+    m_journal_records += g_hash_table_size (m_journal_pending);
+    g_hash_table_remove_all (m_journal_pending);
+    return true;
+}
+
+/* The data file was just rewritten with everything in the book. */
+void
+GncXmlBackend::reset_journal()
+{
+    if (m_journal)
+    {
+        fclose (m_journal);
+        m_journal = nullptr;
+    }
+    if (m_journal_records > 0 || g_file_test (m_journalfile.c_str(),
+                                              G_FILE_TEST_EXISTS))
+        g_unlink (m_journalfile.c_str());
+    m_journal_records = 0;
+    if (m_journal_pending)
+        g_hash_table_remove_all (m_journal_pending);
+    m_journal_usable = true;
+}
+
+/* Writes the snapshot of the data file, which the book must match, or
+ * removes the one left from when snapshots were enabled.  xml_hash is
+ * the data file's SHA1 if it is known. */
+void
+GncXmlBackend::write_snapshot(const guint8* xml_hash)
+{
+    if (!gnc_prefs_get_file_save_snapshot ())
+    {
+        if (g_file_test (m_snapshotfile.c_str(), G_FILE_TEST_EXISTS))
+            g_unlink (m_snapshotfile.c_str());
+        return;
+    }
+    gnc_xml2_write_snapshot (m_book, m_fullpath.c_str(), xml_hash,
+                             m_snapshotfile.c_str());
+}
+
 bool
 GncXmlBackend::save_may_clobber_data()
 {
@@ -404,8 +686,16 @@ GncXmlBackend::write_to_file (bool make_backup)
         }
     }
 
-    if (gnc_book_write_to_xml_file_v2 (m_book, tmp_name,
-                                       gnc_prefs_get_file_save_compressed ()))
+    /* The data file's SHA1 keys its snapshot. */
+    auto checksum = g_checksum_new (G_CHECKSUM_SHA1);
+    auto written = gnc_book_write_to_xml_file_v2 (m_book, tmp_name,
+                                                  gnc_prefs_get_file_save_compressed (),
+                                                  checksum);
+    std::vector<guint8> xml_hash (GNC_SNAPSHOT_HASH_LENGTH);
+    gsize hash_length = xml_hash.size();
+    g_checksum_get_digest (checksum, xml_hash.data(), &hash_length);
+    g_checksum_free (checksum);
+    if (written)
     {
         /* Record the file's permissions before g_unlinking it */
         GStatBuf statbuf;
@@ -486,6 +776,11 @@ GncXmlBackend::write_to_file (bool make_backup)
         /* Since we successfully saved the book,
          * we should mark it clean. */
         qof_book_mark_session_saved (m_book);
+        /* The snapshot no longer matches.  The new one is written when
+         * the session ends rather than after every save. */
+        if (g_file_test (m_snapshotfile.c_str(), G_FILE_TEST_EXISTS))
+            g_unlink (m_snapshotfile.c_str());
+        m_snapshot_hash = std::move (xml_hash);
         LEAVE (" successful save of book=%p to file=%s", m_book,
                m_fullpath.c_str());
         return TRUE;
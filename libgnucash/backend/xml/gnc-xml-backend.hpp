@@ -20,7 +20,9 @@
 
 #include <qof.h>
 
+#include <cstdio>
 #include <string>
+#include <vector>
 #include <qof-backend.hpp>
 
 class GncXmlBackend : public QofBackend
@@ -53,6 +55,11 @@ private:
     void remove_old_files();
     void write_accounts(QofBook* book);
     bool check_path(const char* fullpath, bool create);
+    std::string journal_header();
+    void replay_journal();
+    bool save_journal();
+    void reset_journal();
+    void write_snapshot(const guint8* xml_hash);
 
     std::string m_dirname;
     std::string m_lockfile;
@@ -60,5 +67,19 @@ private:
     int m_lockfd = -1;
 
     QofBook* m_book = nullptr;  /* The primary, main open book */
+
+    /* Save journal: transactions changed since the last save, and the
+     * records appended to m_journalfile since the data file was written. */
+    std::string m_journalfile;
+    FILE* m_journal = nullptr;
+    GHashTable* m_journal_pending = nullptr;
+    unsigned m_journal_records = 0;
+    bool m_journal_usable = false; /* Nothing but transactions changed */
+
+    /* Binary copy of the data file for faster loading, see
+     * gnc-xml-snapshot.h.  After a save it is written when the session
+     * ends, from the SHA1 of the data file taken while writing it. */
+    std::string m_snapshotfile;
+    std::vector<guint8> m_snapshot_hash; /* Empty unless one is due */
 };
 #endif // __GNC_XML_BACKEND_HPP__
@@ -0,0 +1,1317 @@
+/********************************************************************
+ * gnc-xml-snapshot.cpp -- binary snapshots of XML books            *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+ *******************************************************************/
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <config.h>
+#include <string.h>
+#include <errno.h>
+#include <zlib.h>
+
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Account.h"
+#include "Transaction.h"
+#include "gnc-commodity.h"
+#include "gnc-lot.h"
+#include "gnc-pricedb-p.h"
+#include "qofinstance-p.h"
+#include <kvp-frame.hpp>
+
+#include "gnc-xml-helper.h"
+#include "sixtp.h"
+#include "sixtp-utils.h"
+#include "io-gncxml-gen.h"
+#include "gnc-xml-snapshot.h"
+
+static QofLogModule log_module = GNC_MOD_IO;
+
+/* File layout:
+ *
+ *   SnapshotHeader
+ *   skeleton_length bytes of XML, then a NUL
+ *   data_length bytes of sections
+ *
+ * A section is a guint32 kind and a guint64 length followed by that
+ * many bytes:
+ *
+ *   string table:    guint32 n, guint32 lengths[n], then the strings,
+ *                    each followed by a NUL
+ *   commodity table: guint32 n, guint32 namespaces[n], mnemonics[n]
+ *   reference table: guint32 n, GncGUID guids[n] (accounts and lots)
+ *   KVP frames:      guint32 length, then the encoded frames
+ *   columns:         guint32 n, then one array of n values per field
+ *
+ * Values are in host byte order; the header records it and snapshots
+ * written elsewhere are ignored.  Nothing is aligned, all reads go
+ * through memcpy. */
+
+#define SNAPSHOT_MAGIC "GNCSNAP1"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+/* Marks a missing string, commodity, reference or frame. */
+#define SNAPSHOT_NONE G_MAXUINT32
+/* Deeper KVP nesting than this means the snapshot is damaged. */
+#define SNAPSHOT_MAX_KVP_DEPTH 64
+
+enum SnapshotSectionKind : guint32
+{
+    SNAPSHOT_SECTION_TRANSACTIONS = 1,
+    SNAPSHOT_SECTION_PRICES = 2,
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    guint32 byte_order;
+    guint32 version;
+    guint64 xml_size;
+    gint64 xml_mtime;
+    guint8 xml_hash[GNC_SNAPSHOT_HASH_LENGTH];
+    guint32 crc;                /* of everything after the header */
+    guint64 skeleton_length;
+    guint64 data_length;
+};
+
+/* Takes the SHA1 from xml_hash if the caller has it already. */
+static bool
+snapshot_header_set_key (SnapshotHeader* header, const char* xml_filename,
+                         const guint8* xml_hash)
+{
+    GStatBuf statbuf;
+    std::vector<guchar> buf (1 << 16);
+    gsize hash_length = sizeof (header->xml_hash);
+    size_t n;
+
+    if (g_stat (xml_filename, &statbuf) != 0)
+        return false;
+    header->xml_size = statbuf.st_size;
+    header->xml_mtime = statbuf.st_mtime;
+    if (xml_hash)
+    {
+        memcpy (header->xml_hash, xml_hash, sizeof (header->xml_hash));
+        return true;
+    }
+
+    auto file = g_fopen (xml_filename, "rb");
+    if (!file)
+        return false;
+
+    auto checksum = g_checksum_new (G_CHECKSUM_SHA1);
+    while ((n = fread (buf.data (), 1, buf.size (), file)) > 0)
+        g_checksum_update (checksum, buf.data (), n);
+    auto ok = !ferror (file);
+    fclose (file);
+    g_checksum_get_digest (checksum, header->xml_hash, &hash_length);
+    g_checksum_free (checksum);
+    return ok && hash_length == sizeof (header->xml_hash);
+}
+
+static uLong
+snapshot_crc (uLong crc, const guint8* data, gsize length)
+{
+    while (length > 0)
+    {
+        uInt chunk = MIN (length, (gsize)1 << 30);
+
+        crc = crc32 (crc, data, chunk);
+        data += chunk;
+        length -= chunk;
+    }
+    return crc;
+}
+
+template <typename T> static void
+snapshot_put (std::string& out, T value)
+{
+    out.append (reinterpret_cast<const char*> (&value), sizeof value);
+}
+
+template <typename T> static void
+snapshot_patch (std::string& out, std::size_t pos, T value)
+{
+    memcpy (&out[pos], &value, sizeof value);
+}
+
+/***********************************************************************/
+/* Writing */
+
+/* The strings the XML writer passes through checked_char_cast are
+ * stored the way they would come back from the data file. */
+static bool
+snapshot_string_is_clean (const char* str)
+{
+    if (!g_utf8_validate (str, -1, NULL))
+        return false;
+    for (auto p = str; *p; ++p)
+        if (*p > 0 && *p < 0x20 && *p != 0x09 && *p != 0x0a && *p != 0x0d)
+            return false;
+    return true;
+}
+
+class SnapshotWriter
+{
+public:
+    guint32 string (const char* str, bool checked);
+    guint32 commodity (gnc_commodity* comm);
+    guint32 reference (QofInstance* inst);
+    guint32 slots (QofInstance* inst);
+    bool ok () const { return m_ok; }
+    void put_tables (std::string& out) const;
+
+private:
+    void put_frame (const KvpFrame* frame);
+    bool put_value (const KvpValue* value);
+
+    bool m_ok = true;
+    std::vector<std::string_view> m_strings;
+    std::unordered_map<std::string_view, guint32> m_string_index;
+    std::deque<std::string> m_cleaned;
+    std::vector<guint32> m_commodity_ns;
+    std::vector<guint32> m_commodity_mnemonic;
+    std::unordered_map<const gnc_commodity*, guint32> m_commodity_index;
+    std::vector<GncGUID> m_references;
+    std::unordered_map<const QofInstance*, guint32> m_reference_index;
+    std::string m_kvp;
+};
+
+guint32
+SnapshotWriter::string (const char* str, bool checked)
+{
+    if (!str)
+        return SNAPSHOT_NONE;
+
+    std::string_view view{str};
+    if (checked && !snapshot_string_is_clean (str))
+    {
+        m_cleaned.emplace_back (str);
+        checked_char_cast (&m_cleaned.back ()[0]);
+        view = m_cleaned.back ();
+    }
+    auto [it, inserted] = m_string_index.emplace (view, m_strings.size ());
+    if (inserted)
+        m_strings.push_back (view);
+    return it->second;
+}
+
+guint32
+SnapshotWriter::commodity (gnc_commodity* comm)
+{
+    if (!comm)
+        return SNAPSHOT_NONE;
+
+    auto [it, inserted] = m_commodity_index.emplace (comm,
+                                                     m_commodity_ns.size ());
+    if (inserted)
+    {
+        m_commodity_ns.push_back (string (gnc_commodity_get_namespace (comm),
+                                          true));
+        m_commodity_mnemonic.push_back (string (gnc_commodity_get_mnemonic (comm),
+                                                true));
+    }
+    return it->second;
+}
+
+guint32
+SnapshotWriter::reference (QofInstance* inst)
+{
+    if (!inst)
+        return SNAPSHOT_NONE;
+
+    auto [it, inserted] = m_reference_index.emplace (inst,
+                                                     m_references.size ());
+    if (inserted)
+        m_references.push_back (*qof_instance_get_guid (inst));
+    return it->second;
+}
+
+guint32
+SnapshotWriter::slots (QofInstance* inst)
+{
+    auto frame = qof_instance_get_slots (inst);
+
+    if (!frame || frame->empty ())
+        return SNAPSHOT_NONE;
+    if (m_kvp.size () >= SNAPSHOT_NONE)
+    {
+        m_ok = false;
+        return SNAPSHOT_NONE;
+    }
+
+    guint32 offset = m_kvp.size ();
+    put_frame (frame);
+    return offset;
+}
+
+/* Like the XML writer, drops the values it can't represent. */
+void
+SnapshotWriter::put_frame (const KvpFrame* frame)
+{
+    auto count_pos = m_kvp.size ();
+    guint32 count = 0;
+
+    snapshot_put<guint32> (m_kvp, 0);
+    if (frame)
+        frame->for_each_slot_temp ([this, &count] (const char* key,
+                                                   KvpValue* value)
+        {
+            auto start = m_kvp.size ();
+
+            snapshot_put (m_kvp, string (key, true));
+            if (put_value (value))
+                ++count;
+            else
+                m_kvp.resize (start);
+        });
+    snapshot_patch (m_kvp, count_pos, count);
+}
+
+bool
+SnapshotWriter::put_value (const KvpValue* value)
+{
+    auto type = value->get_type ();
+
+    snapshot_put<guint8> (m_kvp, type);
+    switch (type)
+    {
+    case KvpValue::Type::INT64:
+        snapshot_put (m_kvp, value->get<int64_t> ());
+        return true;
+    case KvpValue::Type::DOUBLE:
+        snapshot_put (m_kvp, value->get<double> ());
+        return true;
+    case KvpValue::Type::NUMERIC:
+    {
+        auto num = value->get<gnc_numeric> ();
+        snapshot_put (m_kvp, num.num);
+        snapshot_put (m_kvp, num.denom);
+        return true;
+    }
+    case KvpValue::Type::STRING:
+    {
+        auto str = value->get<const char*> ();
+        snapshot_put (m_kvp, string (str ? str : "", true));
+        return true;
+    }
+    case KvpValue::Type::GUID:
+    {
+        auto guid = value->get<GncGUID*> ();
+        if (!guid)
+            return false;
+        snapshot_put (m_kvp, *guid);
+        return true;
+    }
+    case KvpValue::Type::TIME64:
+        snapshot_put (m_kvp, value->get<Time64> ().t);
+        return true;
+    case KvpValue::Type::GLIST:
+    {
+        auto count_pos = m_kvp.size ();
+        guint32 count = 0;
+
+        snapshot_put<guint32> (m_kvp, 0);
+        for (auto node = value->get<GList*> (); node; node = node->next)
+        {
+            auto start = m_kvp.size ();
+            if (put_value (static_cast<KvpValue*> (node->data)))
+                ++count;
+            else
+                m_kvp.resize (start);
+        }
+        snapshot_patch (m_kvp, count_pos, count);
+        return true;
+    }
+    case KvpValue::Type::FRAME:
+        put_frame (value->get<KvpFrame*> ());
+        return true;
+    case KvpValue::Type::GDATE:
+    {
+        auto date = value->get<GDate> ();
+        snapshot_put<guint32> (m_kvp, g_date_valid (&date) ?
+                               g_date_get_julian (&date) : 0);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+void
+SnapshotWriter::put_tables (std::string& out) const
+{
+    snapshot_put<guint32> (out, m_strings.size ());
+    for (auto& str : m_strings)
+        snapshot_put<guint32> (out, str.size ());
+    for (auto& str : m_strings)
+    {
+        out.append (str);
+        out.push_back ('\0');
+    }
+
+    snapshot_put<guint32> (out, m_commodity_ns.size ());
+    for (auto idx : m_commodity_ns)
+        snapshot_put (out, idx);
+    for (auto idx : m_commodity_mnemonic)
+        snapshot_put (out, idx);
+
+    snapshot_put<guint32> (out, m_references.size ());
+    for (auto& guid : m_references)
+        snapshot_put (out, guid);
+
+    snapshot_put<guint32> (out, m_kvp.size ());
+    out.append (m_kvp);
+}
+
+static bool
+snapshot_append_section (GByteArray* data, SnapshotSectionKind kind,
+                         const SnapshotWriter& writer,
+                         const std::string& columns)
+{
+    std::string tables;
+
+    if (!writer.ok ())
+        return false;
+    writer.put_tables (tables);
+
+    guint64 length = tables.size () + columns.size ();
+    guint32 kind_value = kind;
+    g_byte_array_append (data, reinterpret_cast<const guint8*> (&kind_value),
+                         sizeof kind_value);
+    g_byte_array_append (data, reinterpret_cast<const guint8*> (&length),
+                         sizeof length);
+    g_byte_array_append (data, reinterpret_cast<const guint8*> (tables.data ()),
+                         tables.size ());
+    g_byte_array_append (data, reinterpret_cast<const guint8*> (columns.data ()),
+                         columns.size ());
+    return true;
+}
+
+bool
+gnc_xml_snapshot_append_transactions (GByteArray* data,
+                                      const std::vector<Transaction*>& trns)
+{
+    SnapshotWriter writer;
+    std::string guid, currency, num, description, posted, entered, slots,
+        n_splits;
+    std::string spl_guid, spl_account, spl_lot, spl_memo, spl_action,
+        spl_reconcile, spl_reconcile_date, spl_value_num, spl_value_denom,
+        spl_amount_num, spl_amount_denom, spl_slots;
+    guint32 split_count = 0;
+
+    for (auto trn : trns)
+    {
+        auto trn_num = xaccTransGetNum (trn);
+        guint32 trn_splits = 0;
+
+        snapshot_put (guid, *xaccTransGetGUID (trn));
+        snapshot_put (currency, writer.commodity (xaccTransGetCurrency (trn)));
+        snapshot_put (num, trn_num && *trn_num ? writer.string (trn_num, true)
+                      : SNAPSHOT_NONE);
+        snapshot_put (description,
+                      writer.string (xaccTransGetDescription (trn), true));
+        snapshot_put (posted, xaccTransRetDatePosted (trn));
+        snapshot_put (entered, xaccTransRetDateEntered (trn));
+        snapshot_put (slots, writer.slots (QOF_INSTANCE (trn)));
+
+        for (auto node = xaccTransGetSplitList (trn); node; node = node->next)
+        {
+            auto spl = static_cast<Split*> (node->data);
+            auto memo = xaccSplitGetMemo (spl);
+            auto action = xaccSplitGetAction (spl);
+            auto value = xaccSplitGetValue (spl);
+            auto amount = xaccSplitGetAmount (spl);
+
+            snapshot_put (spl_guid, *xaccSplitGetGUID (spl));
+            snapshot_put (spl_account,
+                          writer.reference (QOF_INSTANCE (xaccSplitGetAccount (spl))));
+            snapshot_put (spl_lot,
+                          writer.reference (QOF_INSTANCE (xaccSplitGetLot (spl))));
+            snapshot_put (spl_memo, memo && *memo ? writer.string (memo, true)
+                          : SNAPSHOT_NONE);
+            snapshot_put (spl_action, action && *action ?
+                          writer.string (action, true) : SNAPSHOT_NONE);
+            snapshot_put (spl_reconcile, xaccSplitGetReconcile (spl));
+            snapshot_put (spl_reconcile_date, xaccSplitGetDateReconciled (spl));
+            snapshot_put (spl_value_num, value.num);
+            snapshot_put (spl_value_denom, value.denom);
+            snapshot_put (spl_amount_num, amount.num);
+            snapshot_put (spl_amount_denom, amount.denom);
+            snapshot_put (spl_slots, writer.slots (QOF_INSTANCE (spl)));
+            ++trn_splits;
+        }
+        snapshot_put (n_splits, trn_splits);
+        split_count += trn_splits;
+    }
+
+    std::string columns;
+    snapshot_put<guint32> (columns, trns.size ());
+    for (auto col : {&guid, &currency, &num, &description, &posted, &entered,
+                     &slots, &n_splits})
+        columns.append (*col);
+    snapshot_put (columns, split_count);
+    for (auto col : {&spl_guid, &spl_account, &spl_lot, &spl_memo, &spl_action,
+                     &spl_reconcile, &spl_reconcile_date, &spl_value_num,
+                     &spl_value_denom, &spl_amount_num, &spl_amount_denom,
+                     &spl_slots})
+        columns.append (*col);
+
+    return snapshot_append_section (data, SNAPSHOT_SECTION_TRANSACTIONS,
+                                    writer, columns);
+}
+
+bool
+gnc_xml_snapshot_append_prices (GByteArray* data,
+                                const std::vector<GNCPrice*>& prices)
+{
+    SnapshotWriter writer;
+    std::string guid, commodity, currency, time, source, type, value_num,
+        value_denom;
+
+    for (auto price : prices)
+    {
+        auto comm = gnc_price_get_commodity (price);
+        auto curr = gnc_price_get_currency (price);
+        auto sourcestr = gnc_price_get_source_string (price);
+        auto typestr = gnc_price_get_typestr (price);
+        auto value = gnc_price_get_value (price);
+
+        /* The XML writer gives up on the whole price database then. */
+        if (!comm || !curr)
+            return false;
+        snapshot_put (guid, *gnc_price_get_guid (price));
+        snapshot_put (commodity, writer.commodity (comm));
+        snapshot_put (currency, writer.commodity (curr));
+        snapshot_put (time, gnc_price_get_time64 (price));
+        snapshot_put (source, sourcestr && *sourcestr ?
+                      writer.string (sourcestr, true) : SNAPSHOT_NONE);
+        snapshot_put (type, typestr && *typestr ?
+                      writer.string (typestr, true) : SNAPSHOT_NONE);
+        snapshot_put (value_num, value.num);
+        snapshot_put (value_denom, value.denom);
+    }
+
+    std::string columns;
+    snapshot_put<guint32> (columns, prices.size ());
+    for (auto col : {&guid, &commodity, &currency, &time, &source, &type,
+                     &value_num, &value_denom})
+        columns.append (*col);
+
+    return snapshot_append_section (data, SNAPSHOT_SECTION_PRICES, writer,
+                                    columns);
+}
+
+static bool
+snapshot_write_all (FILE* out, const void* data, gsize length)
+{
+    return length == 0 || fwrite (data, 1, length, out) == length;
+}
+
+/* Reads back what follows the header, which the skeleton writer wrote
+ * with plain stdio, to learn its length and checksum it. */
+static bool
+snapshot_scan_skeleton (FILE* file, SnapshotHeader* header, uLong* crc)
+{
+    std::vector<guint8> buf (1 << 16);
+    guint64 length = 0;
+    guint8 last = 1;
+    size_t n;
+
+    if (fflush (file) != 0 || fseek (file, sizeof *header, SEEK_SET) != 0)
+        return false;
+    while ((n = fread (buf.data (), 1, buf.size (), file)) > 0)
+    {
+        *crc = snapshot_crc (*crc, buf.data (), n);
+        length += n;
+        last = buf[n - 1];
+    }
+    if (ferror (file) || length == 0 || last != '\0')
+        return false;
+    header->skeleton_length = length - 1;
+    return fseek (file, 0, SEEK_END) == 0;
+}
+
+gboolean
+gnc_xml_snapshot_write (const char* filename, const char* xml_filename,
+                        const guint8* xml_hash,
+                        const GncXmlSnapshotWriteFn& write_skeleton)
+{
+    SnapshotHeader header;
+    uLong crc = crc32 (0L, Z_NULL, 0);
+
+    memset (&header, 0, sizeof header);
+    memcpy (header.magic, SNAPSHOT_MAGIC, sizeof header.magic);
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.version = SNAPSHOT_VERSION;
+    if (!snapshot_header_set_key (&header, xml_filename, xml_hash))
+    {
+        PWARN ("Unable to read %s for its snapshot", xml_filename);
+        return FALSE;
+    }
+
+    auto tmp_name = std::string{filename} + ".tmp";
+    auto file = g_fopen (tmp_name.c_str (), "w+b");
+    if (!file)
+    {
+        PWARN ("Unable to create snapshot %s: %s", tmp_name.c_str (),
+               g_strerror (errno));
+        return FALSE;
+    }
+
+    auto data = g_byte_array_new ();
+    auto ok = snapshot_write_all (file, &header, sizeof header)
+              && write_skeleton (file, data) && fputc ('\0', file) != EOF
+              && snapshot_scan_skeleton (file, &header, &crc)
+              && snapshot_write_all (file, data->data, data->len);
+    if (ok)
+    {
+        header.crc = snapshot_crc (crc, data->data, data->len);
+        header.data_length = data->len;
+        ok = fseek (file, 0, SEEK_SET) == 0
+             && snapshot_write_all (file, &header, sizeof header);
+    }
+    g_byte_array_free (data, TRUE);
+    if (fclose (file) != 0)
+        ok = false;
+
+    if (ok && g_rename (tmp_name.c_str (), filename) != 0)
+    {
+        /* Windows doesn't replace existing files. */
+        g_unlink (filename);
+        ok = g_rename (tmp_name.c_str (), filename) == 0;
+    }
+    if (!ok)
+    {
+        PWARN ("Unable to write snapshot %s", filename);
+        g_unlink (tmp_name.c_str ());
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/***********************************************************************/
+/* Reading */
+
+template <typename T> struct SnapshotColumn
+{
+    const guint8* data = nullptr;
+
+    T operator[] (gsize i) const
+    {
+        T value;
+        memcpy (&value, data + i * sizeof (T), sizeof value);
+        return value;
+    }
+};
+
+/* Bounds checked reads; once one fails the rest return zeroes. */
+class SnapshotReader
+{
+public:
+    SnapshotReader (const guint8* data, gsize length) :
+        m_pos{data}, m_end{data + length} {}
+
+    template <typename T> T get ()
+    {
+        T value{};
+        if (!m_ok || static_cast<gsize> (m_end - m_pos) < sizeof value)
+        {
+            m_ok = false;
+            return value;
+        }
+        memcpy (&value, m_pos, sizeof value);
+        m_pos += sizeof value;
+        return value;
+    }
+
+    const guint8* bytes (gsize length)
+    {
+        auto pos = m_pos;
+        if (!m_ok || static_cast<gsize> (m_end - m_pos) < length)
+        {
+            m_ok = false;
+            return nullptr;
+        }
+        m_pos += length;
+        return pos;
+    }
+
+    template <typename T> SnapshotColumn<T> column (gsize count)
+    {
+        if (count > G_MAXSIZE / sizeof (T))
+        {
+            m_ok = false;
+            return {};
+        }
+        return {bytes (count * sizeof (T))};
+    }
+
+    bool ok () const { return m_ok; }
+    bool at_end () const { return m_ok && m_pos == m_end; }
+
+private:
+    const guint8* m_pos;
+    const guint8* m_end;
+    bool m_ok = true;
+};
+
+struct SnapshotTables
+{
+    std::vector<const char*> strings;
+    guint32 n_commodities = 0;
+    SnapshotColumn<guint32> commodity_ns;
+    SnapshotColumn<guint32> commodity_mnemonic;
+    guint32 n_references = 0;
+    SnapshotColumn<GncGUID> references;
+    const guint8* kvp = nullptr;
+    guint32 kvp_length = 0;
+
+    const char* string (guint32 idx) const
+    {
+        return idx < strings.size () ? strings[idx] : nullptr;
+    }
+};
+
+struct SnapshotTransactions
+{
+    SnapshotTables tables;
+    guint32 count = 0;
+    SnapshotColumn<GncGUID> guid;
+    SnapshotColumn<guint32> currency, num, description;
+    SnapshotColumn<gint64> posted, entered;
+    SnapshotColumn<guint32> slots, n_splits;
+    guint32 split_count = 0;
+    SnapshotColumn<GncGUID> spl_guid;
+    SnapshotColumn<guint32> spl_account, spl_lot, spl_memo, spl_action;
+    SnapshotColumn<char> spl_reconcile;
+    SnapshotColumn<gint64> spl_reconcile_date, spl_value_num, spl_value_denom,
+        spl_amount_num, spl_amount_denom;
+    SnapshotColumn<guint32> spl_slots;
+};
+
+struct SnapshotPrices
+{
+    SnapshotTables tables;
+    guint32 count = 0;
+    SnapshotColumn<GncGUID> guid;
+    SnapshotColumn<guint32> commodity, currency;
+    SnapshotColumn<gint64> time;
+    SnapshotColumn<guint32> source, type;
+    SnapshotColumn<gint64> value_num, value_denom;
+};
+
+struct GncXmlSnapshot
+{
+    GMappedFile* file = nullptr;
+    const char* skeleton = nullptr;
+    gsize skeleton_length = 0;
+    bool has_transactions = false;
+    SnapshotTransactions transactions;
+    bool has_prices = false;
+    SnapshotPrices prices;
+};
+
+/* Decodes one value; with value NULL it only checks the encoding. */
+static bool
+snapshot_read_kvp_value (SnapshotReader& r, const SnapshotTables& t,
+                         int depth, KvpValue** value);
+
+static bool
+snapshot_read_kvp_frame (SnapshotReader& r, const SnapshotTables& t,
+                         int depth, KvpFrame* frame)
+{
+    auto count = r.get<guint32> ();
+
+    if (depth > SNAPSHOT_MAX_KVP_DEPTH)
+        return false;
+    for (guint32 i = 0; i < count && r.ok (); ++i)
+    {
+        auto key = t.string (r.get<guint32> ());
+        KvpValue* value = nullptr;
+
+        if (!key || !snapshot_read_kvp_value (r, t, depth + 1,
+                                              frame ? &value : nullptr))
+            return false;
+        if (frame)
+            delete frame->set ({key}, value);
+    }
+    return r.ok ();
+}
+
+static bool
+snapshot_read_kvp_value (SnapshotReader& r, const SnapshotTables& t,
+                         int depth, KvpValue** value)
+{
+    auto type = static_cast<KvpValue::Type> (r.get<guint8> ());
+    KvpValue* ret = nullptr;
+
+    if (depth > SNAPSHOT_MAX_KVP_DEPTH)
+        return false;
+    switch (type)
+    {
+    case KvpValue::Type::INT64:
+    {
+        auto v = r.get<int64_t> ();
+        if (value)
+            ret = new KvpValue {v};
+        break;
+    }
+    case KvpValue::Type::DOUBLE:
+    {
+        auto v = r.get<double> ();
+        if (value)
+            ret = new KvpValue {v};
+        break;
+    }
+    case KvpValue::Type::NUMERIC:
+    {
+        auto num = r.get<gint64> ();
+        auto denom = r.get<gint64> ();
+        if (value)
+            ret = new KvpValue {gnc_numeric_create (num, denom)};
+        break;
+    }
+    case KvpValue::Type::STRING:
+    {
+        auto str = t.string (r.get<guint32> ());
+        if (!str)
+            return false;
+        if (value)
+            ret = new KvpValue {g_strdup (str)};
+        break;
+    }
+    case KvpValue::Type::GUID:
+    {
+        auto guid = r.get<GncGUID> ();
+        if (value)
+            ret = new KvpValue {guid_copy (&guid)};
+        break;
+    }
+    case KvpValue::Type::TIME64:
+    {
+        Time64 t64{r.get<gint64> ()};
+        if (value)
+            ret = new KvpValue {t64};
+        break;
+    }
+    case KvpValue::Type::GLIST:
+    {
+        auto count = r.get<guint32> ();
+        GList* list = NULL;
+        bool ok = true;
+
+        for (guint32 i = 0; ok && i < count && r.ok (); ++i)
+        {
+            KvpValue* item = nullptr;
+            ok = snapshot_read_kvp_value (r, t, depth + 1,
+                                          value ? &item : nullptr);
+            if (ok && item)
+                list = g_list_prepend (list, item);
+        }
+        if (!ok || !r.ok ())
+        {
+            for (auto node = list; node; node = node->next)
+                delete static_cast<KvpValue*> (node->data);
+            g_list_free (list);
+            return false;
+        }
+        if (value)
+            ret = new KvpValue {g_list_reverse (list)};
+        break;
+    }
+    case KvpValue::Type::FRAME:
+    {
+        auto frame = value ? new KvpFrame : nullptr;
+        if (!snapshot_read_kvp_frame (r, t, depth, frame))
+        {
+            delete frame;
+            return false;
+        }
+        if (value)
+            ret = new KvpValue {frame};
+        break;
+    }
+    case KvpValue::Type::GDATE:
+    {
+        auto julian = r.get<guint32> ();
+        GDate date;
+
+        g_date_clear (&date, 1);
+        if (g_date_valid_julian (julian))
+            g_date_set_julian (&date, julian);
+        if (value)
+            ret = new KvpValue {date};
+        break;
+    }
+    default:
+        return false;
+    }
+
+    if (!r.ok ())
+    {
+        delete ret;
+        return false;
+    }
+    if (value)
+        *value = ret;
+    return true;
+}
+
+/* Adds the frame at offset to inst's slots. */
+static void
+snapshot_set_slots (const SnapshotTables& t, guint32 offset, QofInstance* inst)
+{
+    if (offset == SNAPSHOT_NONE)
+        return;
+
+    SnapshotReader r{t.kvp + offset, t.kvp_length - offset};
+    if (!snapshot_read_kvp_frame (r, t, 0, qof_instance_get_slots (inst)))
+        PERR ("failed to read the slots of a snapshot object");
+}
+
+static bool
+snapshot_read_tables (SnapshotReader& r, SnapshotTables& t)
+{
+    auto n_strings = r.get<guint32> ();
+    auto lengths = r.column<guint32> (n_strings);
+
+    if (!r.ok ())
+        return false;
+    t.strings.reserve (n_strings);
+    for (guint32 i = 0; i < n_strings; ++i)
+    {
+        auto length = lengths[i];
+        auto str = r.bytes (static_cast<gsize> (length) + 1);
+        if (!str || str[length] != '\0')
+            return false;
+        t.strings.push_back (reinterpret_cast<const char*> (str));
+    }
+
+    t.n_commodities = r.get<guint32> ();
+    t.commodity_ns = r.column<guint32> (t.n_commodities);
+    t.commodity_mnemonic = r.column<guint32> (t.n_commodities);
+    if (!r.ok ())
+        return false;
+    for (guint32 i = 0; i < t.n_commodities; ++i)
+        if (!t.string (t.commodity_ns[i]) || !t.string (t.commodity_mnemonic[i]))
+            return false;
+
+    t.n_references = r.get<guint32> ();
+    t.references = r.column<GncGUID> (t.n_references);
+
+    t.kvp_length = r.get<guint32> ();
+    t.kvp = r.bytes (t.kvp_length);
+    if (!r.ok ())
+        return false;
+
+    SnapshotReader kvp{t.kvp, t.kvp_length};
+    while (!kvp.at_end ())
+        if (!snapshot_read_kvp_frame (kvp, t, 0, nullptr))
+            return false;
+    return true;
+}
+
+/* Every entry of col is below limit, or SNAPSHOT_NONE if allowed. */
+static bool
+snapshot_check_indexes (SnapshotColumn<guint32> col, guint32 count,
+                        guint32 limit, bool allow_none)
+{
+    for (guint32 i = 0; i < count; ++i)
+    {
+        auto idx = col[i];
+        if (idx >= limit && !(allow_none && idx == SNAPSHOT_NONE))
+            return false;
+    }
+    return true;
+}
+
+static bool
+snapshot_read_transactions (SnapshotReader& r, SnapshotTransactions& s)
+{
+    if (!snapshot_read_tables (r, s.tables))
+        return false;
+
+    auto& t = s.tables;
+    guint32 n_strings = t.strings.size ();
+
+    s.count = r.get<guint32> ();
+    s.guid = r.column<GncGUID> (s.count);
+    s.currency = r.column<guint32> (s.count);
+    s.num = r.column<guint32> (s.count);
+    s.description = r.column<guint32> (s.count);
+    s.posted = r.column<gint64> (s.count);
+    s.entered = r.column<gint64> (s.count);
+    s.slots = r.column<guint32> (s.count);
+    s.n_splits = r.column<guint32> (s.count);
+    s.split_count = r.get<guint32> ();
+    s.spl_guid = r.column<GncGUID> (s.split_count);
+    s.spl_account = r.column<guint32> (s.split_count);
+    s.spl_lot = r.column<guint32> (s.split_count);
+    s.spl_memo = r.column<guint32> (s.split_count);
+    s.spl_action = r.column<guint32> (s.split_count);
+    s.spl_reconcile = r.column<char> (s.split_count);
+    s.spl_reconcile_date = r.column<gint64> (s.split_count);
+    s.spl_value_num = r.column<gint64> (s.split_count);
+    s.spl_value_denom = r.column<gint64> (s.split_count);
+    s.spl_amount_num = r.column<gint64> (s.split_count);
+    s.spl_amount_denom = r.column<gint64> (s.split_count);
+    s.spl_slots = r.column<guint32> (s.split_count);
+    if (!r.at_end ())
+        return false;
+
+    guint64 splits = 0;
+    for (guint32 i = 0; i < s.count; ++i)
+        splits += s.n_splits[i];
+    return splits == s.split_count
+           && snapshot_check_indexes (s.currency, s.count, t.n_commodities, true)
+           && snapshot_check_indexes (s.num, s.count, n_strings, true)
+           && snapshot_check_indexes (s.description, s.count, n_strings, true)
+           && snapshot_check_indexes (s.slots, s.count, t.kvp_length, true)
+           && snapshot_check_indexes (s.spl_account, s.split_count,
+                                      t.n_references, true)
+           && snapshot_check_indexes (s.spl_lot, s.split_count,
+                                      t.n_references, true)
+           && snapshot_check_indexes (s.spl_memo, s.split_count, n_strings, true)
+           && snapshot_check_indexes (s.spl_action, s.split_count, n_strings,
+                                      true)
+           && snapshot_check_indexes (s.spl_slots, s.split_count, t.kvp_length,
+                                      true);
+}
+
+static bool
+snapshot_read_prices (SnapshotReader& r, SnapshotPrices& s)
+{
+    if (!snapshot_read_tables (r, s.tables))
+        return false;
+
+    auto& t = s.tables;
+    guint32 n_strings = t.strings.size ();
+
+    s.count = r.get<guint32> ();
+    s.guid = r.column<GncGUID> (s.count);
+    s.commodity = r.column<guint32> (s.count);
+    s.currency = r.column<guint32> (s.count);
+    s.time = r.column<gint64> (s.count);
+    s.source = r.column<guint32> (s.count);
+    s.type = r.column<guint32> (s.count);
+    s.value_num = r.column<gint64> (s.count);
+    s.value_denom = r.column<gint64> (s.count);
+    return r.at_end ()
+           && snapshot_check_indexes (s.commodity, s.count, t.n_commodities,
+                                      false)
+           && snapshot_check_indexes (s.currency, s.count, t.n_commodities,
+                                      false)
+           && snapshot_check_indexes (s.source, s.count, n_strings, true)
+           && snapshot_check_indexes (s.type, s.count, n_strings, true);
+}
+
+static bool
+snapshot_read_sections (GncXmlSnapshot* snapshot, const guint8* data,
+                        gsize length)
+{
+    SnapshotReader r{data, length};
+
+    while (!r.at_end ())
+    {
+        auto kind = r.get<guint32> ();
+        auto section_length = r.get<guint64> ();
+        auto section = r.bytes (section_length);
+        SnapshotReader sr{section, section_length};
+
+        if (!r.ok ())
+            return false;
+        switch (kind)
+        {
+        case SNAPSHOT_SECTION_TRANSACTIONS:
+            if (snapshot->has_transactions
+                || !snapshot_read_transactions (sr, snapshot->transactions))
+                return false;
+            snapshot->has_transactions = true;
+            break;
+        case SNAPSHOT_SECTION_PRICES:
+            if (snapshot->has_prices
+                || !snapshot_read_prices (sr, snapshot->prices))
+                return false;
+            snapshot->has_prices = true;
+            break;
+        default:
+            return false;
+        }
+    }
+    return r.ok ();
+}
+
+GncXmlSnapshot*
+gnc_xml_snapshot_open (const char* filename, const char* xml_filename)
+{
+    SnapshotHeader header, key;
+
+    if (!g_file_test (filename, G_FILE_TEST_EXISTS))
+        return NULL;
+
+    auto file = g_mapped_file_new (filename, FALSE, NULL);
+    if (!file)
+    {
+        PINFO ("Unable to map snapshot %s", filename);
+        return NULL;
+    }
+
+    auto contents = reinterpret_cast<const guint8*> (g_mapped_file_get_contents (file));
+    auto length = g_mapped_file_get_length (file);
+    auto snapshot = new GncXmlSnapshot;
+    snapshot->file = file;
+
+    if (length < sizeof header)
+        goto bad_snapshot;
+    memcpy (&header, contents, sizeof header);
+    if (memcmp (header.magic, SNAPSHOT_MAGIC, sizeof header.magic) != 0
+        || header.byte_order != SNAPSHOT_BYTE_ORDER
+        || header.version != SNAPSHOT_VERSION
+        || header.skeleton_length >= length
+        || header.data_length > length
+        || length - sizeof header != header.skeleton_length + 1 + header.data_length
+        || header.skeleton_length > G_MAXINT
+        || contents[sizeof header + header.skeleton_length] != '\0')
+        goto bad_snapshot;
+
+    if (!snapshot_header_set_key (&key, xml_filename, nullptr)
+        || key.xml_size != header.xml_size || key.xml_mtime != header.xml_mtime
+        || memcmp (key.xml_hash, header.xml_hash, sizeof key.xml_hash) != 0)
+    {
+        PINFO ("Snapshot %s doesn't match %s", filename, xml_filename);
+        gnc_xml_snapshot_free (snapshot);
+        return NULL;
+    }
+
+    if (snapshot_crc (crc32 (0L, Z_NULL, 0), contents + sizeof header,
+                      length - sizeof header) != header.crc
+        || !snapshot_read_sections (snapshot, contents + sizeof header
+                                    + header.skeleton_length + 1,
+                                    header.data_length))
+        goto bad_snapshot;
+
+    snapshot->skeleton = reinterpret_cast<const char*> (contents + sizeof header);
+    snapshot->skeleton_length = header.skeleton_length;
+    return snapshot;
+
+bad_snapshot:
+    PWARN ("Ignoring damaged snapshot %s", filename);
+    gnc_xml_snapshot_free (snapshot);
+    return NULL;
+}
+
+void
+gnc_xml_snapshot_free (GncXmlSnapshot* snapshot)
+{
+    if (!snapshot)
+        return;
+    g_mapped_file_unref (snapshot->file);
+    delete snapshot;
+}
+
+const char*
+gnc_xml_snapshot_get_skeleton (const GncXmlSnapshot* snapshot, gsize* length)
+{
+    g_return_val_if_fail (snapshot && length, NULL);
+    *length = snapshot->skeleton_length;
+    return snapshot->skeleton;
+}
+
+/***********************************************************************/
+/* Building the book */
+
+static std::vector<gnc_commodity*>
+snapshot_lookup_commodities (const SnapshotTables& t, QofBook* book)
+{
+    auto table = gnc_commodity_table_get_table (book);
+    std::vector<gnc_commodity*> commodities (t.n_commodities);
+
+    for (guint32 i = 0; i < t.n_commodities; ++i)
+        commodities[i] = gnc_commodity_table_lookup (table,
+                                                     t.string (t.commodity_ns[i]),
+                                                     t.string (t.commodity_mnemonic[i]));
+    return commodities;
+}
+
+/* Builds the transactions the way trn_record_commit does. */
+static gboolean
+snapshot_transactions_end_handler (gpointer data_for_children,
+                                   GSList* data_from_children,
+                                   GSList* sibling_data,
+                                   gpointer parent_data, gpointer global_data,
+                                   gpointer* result, const gchar* tag)
+{
+    auto gdata = static_cast<gxpf_data*> (global_data);
+    auto book = static_cast<QofBook*> (gdata->bookdata);
+
+    *result = NULL;
+    if (!gdata->snapshot || !gdata->snapshot->has_transactions)
+    {
+        PERR ("<%s> without a snapshot to read it from", tag);
+        return FALSE;
+    }
+
+    auto& s = gdata->snapshot->transactions;
+    auto& t = s.tables;
+    auto commodities = snapshot_lookup_commodities (t, book);
+    std::vector<Account*> accounts (t.n_references);
+    std::vector<GNCLot*> lots (t.n_references);
+    guint32 spl = 0;
+
+    for (guint32 i = 0; i < t.n_references; ++i)
+    {
+        auto guid = t.references[i];
+        accounts[i] = xaccAccountLookup (&guid, book);
+        if (!accounts[i])
+            lots[i] = gnc_lot_lookup (&guid, book);
+    }
+
+    for (guint32 i = 0; i < s.count; ++i)
+    {
+        auto trn = xaccMallocTransaction (book);
+        auto guid = s.guid[i];
+
+        xaccTransBeginEdit (trn);
+        xaccTransSetGUID (trn, &guid);
+        if (s.currency[i] != SNAPSHOT_NONE)
+            xaccTransSetCurrency (trn, commodities[s.currency[i]]);
+        if (s.num[i] != SNAPSHOT_NONE)
+            xaccTransSetNum (trn, t.string (s.num[i]));
+        xaccTransSetDatePostedSecs (trn, s.posted[i]);
+        xaccTransSetDateEnteredSecs (trn, s.entered[i]);
+        if (s.description[i] != SNAPSHOT_NONE)
+            xaccTransSetDescription (trn, t.string (s.description[i]));
+        snapshot_set_slots (t, s.slots[i], QOF_INSTANCE (trn));
+
+        for (auto end = spl + s.n_splits[i]; spl < end; ++spl)
+        {
+            auto split = xaccMallocSplit (book);
+            auto spl_guid = s.spl_guid[spl];
+            auto account = s.spl_account[spl];
+            auto lot = s.spl_lot[spl];
+
+            xaccSplitSetGUID (split, &spl_guid);
+            if (s.spl_memo[spl] != SNAPSHOT_NONE)
+                xaccSplitSetMemo (split, t.string (s.spl_memo[spl]));
+            if (s.spl_action[spl] != SNAPSHOT_NONE)
+                xaccSplitSetAction (split, t.string (s.spl_action[spl]));
+            xaccSplitSetReconcile (split, s.spl_reconcile[spl]);
+            if (s.spl_reconcile_date[spl])
+                xaccSplitSetDateReconciledSecs (split,
+                                                s.spl_reconcile_date[spl]);
+            xaccSplitSetValue (split,
+                               gnc_numeric_create (s.spl_value_num[spl],
+                                                   s.spl_value_denom[spl]));
+            xaccSplitSetAmount (split,
+                                gnc_numeric_create (s.spl_amount_num[spl],
+                                                    s.spl_amount_denom[spl]));
+            if (account != SNAPSHOT_NONE && accounts[account])
+                xaccAccountInsertSplit (accounts[account], split);
+            if (lot != SNAPSHOT_NONE && lots[lot])
+                gnc_lot_add_split (lots[lot], split);
+            snapshot_set_slots (t, s.spl_slots[spl], QOF_INSTANCE (split));
+            xaccTransAppendSplit (trn, split);
+        }
+
+        xaccTransCommitEdit (trn);
+        gdata->cb ("gnc:transaction", gdata->parsedata, trn);
+    }
+    return TRUE;
+}
+
+/* Fills the price database the way the <gnc:pricedb> parser does. */
+static gboolean
+snapshot_prices_end_handler (gpointer data_for_children,
+                             GSList* data_from_children, GSList* sibling_data,
+                             gpointer parent_data, gpointer global_data,
+                             gpointer* result, const gchar* tag)
+{
+    auto gdata = static_cast<gxpf_data*> (global_data);
+    auto gd = static_cast<sixtp_gdv2*> (gdata->parsedata);
+    auto book = static_cast<QofBook*> (gdata->bookdata);
+    auto db = gnc_pricedb_get_db (book);
+
+    *result = NULL;
+    g_return_val_if_fail (db, FALSE);
+    if (!gdata->snapshot || !gdata->snapshot->has_prices)
+    {
+        PERR ("<%s> without a snapshot to read it from", tag);
+        return FALSE;
+    }
+
+    auto& s = gdata->snapshot->prices;
+    auto& t = s.tables;
+    auto commodities = snapshot_lookup_commodities (t, book);
+
+    gnc_pricedb_set_bulk_update (db, TRUE);
+    for (guint32 i = 0; i < s.count; ++i)
+    {
+        auto price = gnc_price_create (book);
+        auto guid = s.guid[i];
+
+        gnc_price_begin_edit (price);
+        gnc_price_set_guid (price, &guid);
+        gnc_price_set_commodity (price, commodities[s.commodity[i]]);
+        gnc_price_set_currency (price, commodities[s.currency[i]]);
+        gnc_price_set_time64 (price, s.time[i]);
+        if (s.source[i] != SNAPSHOT_NONE)
+            gnc_price_set_source_string (price, t.string (s.source[i]));
+        if (s.type[i] != SNAPSHOT_NONE)
+            gnc_price_set_typestr (price, t.string (s.type[i]));
+        gnc_price_set_value (price, gnc_numeric_create (s.value_num[i],
+                                                        s.value_denom[i]));
+        gnc_price_commit_edit (price);
+
+        gnc_pricedb_add_price (db, price);
+        gnc_price_unref (price);
+        gd->counter.prices_loaded++;
+        sixtp_run_callback (gd, "prices");
+    }
+
+    gdata->cb ("gnc:pricedb", gdata->parsedata, db);
+    gnc_pricedb_set_bulk_update (db, FALSE);
+    return TRUE;
+}
+
+sixtp*
+gnc_xml_snapshot_transactions_parser_create (void)
+{
+    return sixtp_set_any (sixtp_new (), FALSE,
+                          SIXTP_END_HANDLER_ID,
+                          snapshot_transactions_end_handler,
+                          SIXTP_CHARACTERS_HANDLER_ID,
+                          allow_and_ignore_only_whitespace,
+                          SIXTP_NO_MORE_HANDLERS);
+}
+
+sixtp*
+gnc_xml_snapshot_prices_parser_create (void)
+{
+    return sixtp_set_any (sixtp_new (), FALSE,
+                          SIXTP_END_HANDLER_ID, snapshot_prices_end_handler,
+                          SIXTP_CHARACTERS_HANDLER_ID,
+                          allow_and_ignore_only_whitespace,
+                          SIXTP_NO_MORE_HANDLERS);
+}
@@ -0,0 +1,89 @@
+/********************************************************************
+ * gnc-xml-snapshot.h -- binary snapshots of XML books              *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+ *******************************************************************/
+/** @file gnc-xml-snapshot.h
+ * A snapshot holds the same book as an XML data file in a form that
+ * loads much faster.  Transactions and prices, which make up nearly all
+ * of a large book, are stored as columns of fixed size values with
+ * interned strings and encoded KVP frames.  Everything else stays XML:
+ * the snapshot carries a "skeleton" of the data file in which the
+ * transactions and prices are replaced by empty marker elements, and
+ * loading parses the skeleton with parsers that build the objects from
+ * the binary sections when they reach a marker.
+ *
+ * A snapshot records the size, modification time and SHA-1 hash of the
+ * data file it was made from and is only used while those match.
+ */
+#ifndef GNC_XML_SNAPSHOT_H
+#define GNC_XML_SNAPSHOT_H
+
+#include <glib.h>
+
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "gnc-engine.h"
+#include "gnc-pricedb.h"
+#include "sixtp.h"
+
+#define GNC_SNAPSHOT_TRANSACTIONS_TAG "gnc:snapshot-transactions"
+#define GNC_SNAPSHOT_PRICES_TAG "gnc:snapshot-prices"
+/** The snapshot is keyed by the SHA1 of the data file. */
+#define GNC_SNAPSHOT_HASH_LENGTH 20
+
+typedef struct GncXmlSnapshot GncXmlSnapshot;
+
+/** Appends a section holding trns or prices to data.  Returns false,
+ * leaving data as it was, if something can't be represented. */
+bool gnc_xml_snapshot_append_transactions (GByteArray* data,
+                                           const std::vector<Transaction*>& trns);
+bool gnc_xml_snapshot_append_prices (GByteArray* data,
+                                     const std::vector<GNCPrice*>& prices);
+
+/** Writes the snapshot of xml_filename to filename.  xml_hash is the
+ * SHA1 of xml_filename if the caller took it while writing the file,
+ * or NULL to read the file for it.  write_skeleton writes the skeleton
+ * to its FILE* and the sections its markers refer to to its
+ * GByteArray*. */
+using GncXmlSnapshotWriteFn = std::function<bool (FILE*, GByteArray*)>;
+gboolean gnc_xml_snapshot_write (const char* filename,
+                                 const char* xml_filename,
+                                 const guint8* xml_hash,
+                                 const GncXmlSnapshotWriteFn& write_skeleton);
+
+/** Maps and checks the snapshot in filename, returning NULL unless it
+ * is intact and was made from xml_filename as it is now. */
+GncXmlSnapshot* gnc_xml_snapshot_open (const char* filename,
+                                       const char* xml_filename);
+void gnc_xml_snapshot_free (GncXmlSnapshot* snapshot);
+
+/** The skeleton, followed by a NUL so that it can be parsed in place. */
+const char* gnc_xml_snapshot_get_skeleton (const GncXmlSnapshot* snapshot,
+                                           gsize* length);
+
+/** Parsers for the marker elements.  They read the snapshot from the
+ * gxpf_data and hand the objects to its callback like the parsers of
+ * <gnc:transaction> and <gnc:pricedb> do. */
+sixtp* gnc_xml_snapshot_transactions_parser_create (void);
+sixtp* gnc_xml_snapshot_prices_parser_create (void);
+
+#endif /* GNC_XML_SNAPSHOT_H */
@@ -32,6 +32,7 @@
 
 #include "gnc-xml-helper.h"
 #include "sixtp.h"
+#include "io-gncxml-gen.h"
 
 xmlNodePtr gnc_account_dom_tree_create (Account* act, gboolean exporting,
                                         gboolean allow_incompat);
@@ -51,6 +52,7 @@ xmlNodePtr gnc_lot_dom_tree_create (GNCLot*);
 sixtp* gnc_lot_sixtp_parser_create (void);
 
 xmlNodePtr gnc_pricedb_dom_tree_create (GNCPriceDB* db);
+gboolean gnc_price_xml_text_append (GString* buf, int level, GNCPrice* price);
 sixtp* gnc_pricedb_sixtp_parser_create (void);
 
 xmlNodePtr gnc_schedXaction_dom_tree_create (SchedXaction* sx);
@@ -60,8 +62,18 @@ xmlNodePtr gnc_budget_dom_tree_create (GncBudget* bgt);
 sixtp* gnc_budget_sixtp_parser_create (void);
 
 xmlNodePtr gnc_transaction_dom_tree_create (Transaction* txn);
+void gnc_transaction_xml_text_append (GString* buf, Transaction* txn);
 sixtp* gnc_transaction_sixtp_parser_create (void);
 
+/** Decode transactions on n_workers threads while the file is parsed.
+ *  Attach the pipeline to the gxpf_data passed to the parser; the
+ *  transactions are committed, in file order, by the parsing thread. */
+GncXmlTrnPipeline* gnc_xml_trn_pipeline_new (guint n_workers);
+/** Commit every transaction parsed so far.  Returns FALSE if any of them
+ *  failed to load.  Does nothing without a pipeline. */
+gboolean gnc_xml_trn_pipeline_flush (gxpf_data* gdata);
+void gnc_xml_trn_pipeline_destroy (GncXmlTrnPipeline* pipeline);
+
 sixtp* gnc_template_transaction_sixtp_parser_create (void);
 
 #endif /* GNC_XML_H */
@@ -29,6 +29,9 @@
 
 #include "sixtp.h"
 
+typedef struct GncXmlTrnPipeline GncXmlTrnPipeline;
+typedef struct GncXmlSnapshot GncXmlSnapshot;
+
 typedef gboolean (*gxpf_callback) (const char* tag, gpointer parsedata,
                                    gpointer data);
 
@@ -37,6 +40,13 @@ struct gxpf_data_struct
     gxpf_callback cb;
     gpointer parsedata;
     gpointer bookdata;
+    GncXmlTrnPipeline* trn_pipeline; /* NULL to load transactions serially */
+    /* The parser's input if it stays mapped until every transaction is
+     * committed, else NULL. */
+    const char* input;
+    gsize input_length;
+    /* The snapshot the skeleton being parsed belongs to, if any. */
+    const GncXmlSnapshot* snapshot;
 };
 
 typedef struct gxpf_data_struct gxpf_data;
@@ -43,9 +43,22 @@
 # include <unistd.h>
 #endif
 #include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 #include <errno.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
 #include "gnc-engine.h"
+#include "gnc-prefs.h"
 #include "gnc-pricedb-p.h"
 #include "Scrub.h"
 #include "SX-book.h"
@@ -53,6 +66,7 @@
 #include "Transaction.h"
 #include "TransactionP.h"
 #include "TransLog.h"
+#include "gncInvoice.h"
 #if PLATFORM(WINDOWS)
 #ifdef __STRICT_ANSI_UNSET__
 #undef __STRICT_ANSI_UNSET__
@@ -72,15 +86,26 @@
 #include "sixtp-dom-parsers.h"
 #include "io-gncxml-v2.h"
 #include "io-gncxml-gen.h"
+#include "gnc-xml-snapshot.h"
 
 static QofLogModule log_module = GNC_MOD_IO;
 
+enum class XmlCompression
+{
+    NONE,
+    GZIP,
+    ZSTD,
+};
+
 typedef struct
 {
     gint fd;
     gchar* filename;
     gchar* perms;
     gboolean write;
+    XmlCompression compression;
+    gint level;
+    GChecksum* checksum;        /* of the file as written, if not NULL */
 } gz_thread_params_t;
 
 /* Callback structure */
@@ -111,9 +136,9 @@ gnc_v2_book_version_string;        /* see gnc-book-xml-v2 */
 /* Forward declarations */
 static std::pair<FILE*, GThread*> try_gz_open (const char* filename,
                                                const char* perms,
-                                               gboolean compress,
+                                               XmlCompression compression,
                                                gboolean write);
-static bool is_gzipped_file (const gchar* name);
+static XmlCompression file_compression (const gchar* name);
 
 static void
 clear_up_account_commodity (
@@ -620,6 +645,47 @@ generic_callback (const char* tag, gpointer globaldata, gpointer data)
     return TRUE;
 }
 
+/* Transactions may still be in the load pipeline when their parent's
+ * next child starts or the parent ends; commit them first so that the
+ * records that follow can refer to them. */
+static gboolean
+flush_transactions_before_child (gpointer data_for_children,
+                                 GSList* data_from_children,
+                                 GSList* sibling_data,
+                                 gpointer parent_data, gpointer global_data,
+                                 gpointer* result, const gchar* tag,
+                                 const gchar* child_tag)
+{
+    if (g_strcmp0 (child_tag, TRANSACTION_TAG) == 0)
+        return TRUE;
+    return gnc_xml_trn_pipeline_flush ((gxpf_data*)global_data);
+}
+
+static gboolean
+flush_transactions_end_handler (gpointer data_for_children,
+                                GSList* data_from_children,
+                                GSList* sibling_data,
+                                gpointer parent_data, gpointer global_data,
+                                gpointer* result, const gchar* tag)
+{
+    return gnc_xml_trn_pipeline_flush ((gxpf_data*)global_data);
+}
+
+/* The parsing thread commits everything and the gzip thread, if any,
+ * inflates; leave them a core and don't bother with more decoders than
+ * the committer can keep up with. */
+#define MAX_TRN_DECODERS 4
+
+static GncXmlTrnPipeline*
+load_pipeline_new (void)
+{
+    gint n_workers = MIN (g_get_num_processors () - 1, MAX_TRN_DECODERS);
+
+    if (n_workers < 1)
+        return NULL;
+    return gnc_xml_trn_pipeline_new (n_workers);
+}
+
 static void
 add_parser(const GncXmlDataType_t& data, struct file_backend* be_data)
 {
@@ -677,11 +743,53 @@ gnc_sixtp_gdv2_new (
     return gd;
 }
 
+static gsize
+page_size (void)
+{
+#ifdef G_OS_WIN32
+    SYSTEM_INFO info;
+
+    GetSystemInfo (&info);
+    return info.dwPageSize;
+#else
+    return sysconf (_SC_PAGESIZE);
+#endif
+}
+
+/* Maps an uncompressed file so that libxml2 can parse it in place.
+ * libxml2 reads a byte past the end of its input, and the mapping only
+ * provides one, zero-filled, when the file doesn't end on a page
+ * boundary; returns NULL in that case or if the file can't be mapped,
+ * and the caller reads it instead. */
+static GMappedFile*
+map_xml_file (const char* filename)
+{
+    GError* error = NULL;
+    GMappedFile* mapped = g_mapped_file_new (filename, FALSE, &error);
+    gsize length;
+
+    if (!mapped)
+    {
+        PINFO ("Unable to map file %s: %s", filename, error->message);
+        g_error_free (error);
+        return NULL;
+    }
+    length = g_mapped_file_get_length (mapped);
+    if (length == 0 || length > G_MAXINT || length % page_size () == 0)
+    {
+        g_mapped_file_unref (mapped);
+        return NULL;
+    }
+    return mapped;
+}
+
+/* Reads the book from push_handler if given, else from snapshot's
+ * skeleton if given, else from the backend's file. */
 static gboolean
 qof_session_load_from_xml_file_v2_full (
     GncXmlBackend* xml_be, QofBook* book,
     sixtp_push_handler push_handler, gpointer push_user_data,
-    QofBookFileType type)
+    const GncXmlSnapshot* snapshot, QofBookFileType type)
 {
     Account* root;
     Account* template_root;
@@ -692,6 +800,8 @@ qof_session_load_from_xml_file_v2_full (
     struct file_backend be_data;
     gboolean retval;
     char* v2type = NULL;
+    gxpf_data gpdata;
+    GMappedFile* mapped = NULL;
 
     gd = gnc_sixtp_gdv2_new (book, FALSE, file_rw_feedback,
                              xml_be->get_percentage());
@@ -757,22 +867,50 @@ qof_session_load_from_xml_file_v2_full (
     if (be_data.ok == FALSE)
         goto bail;
 
+    if (snapshot &&
+        !sixtp_add_some_sub_parsers (
+            book_parser, TRUE,
+            GNC_SNAPSHOT_TRANSACTIONS_TAG,
+            gnc_xml_snapshot_transactions_parser_create (),
+            GNC_SNAPSHOT_PRICES_TAG, gnc_xml_snapshot_prices_parser_create (),
+            NULL, NULL))
+        goto bail;
+
+    sixtp_set_before_child (main_parser, flush_transactions_before_child);
+    sixtp_set_end (main_parser, flush_transactions_end_handler);
+    sixtp_set_before_child (book_parser, flush_transactions_before_child);
+    sixtp_set_end (book_parser, flush_transactions_end_handler);
+
     /* stop logging while we load */
     xaccLogDisable ();
     xaccDisableDataScrubbing ();
 
+    gpdata.cb = generic_callback;
+    gpdata.parsedata = gd;
+    gpdata.bookdata = book;
+    gpdata.trn_pipeline = load_pipeline_new ();
+    gpdata.input = NULL;
+    gpdata.input_length = 0;
+    gpdata.snapshot = snapshot;
+
     if (push_handler)
     {
         gpointer parse_result = NULL;
-        gxpf_data gpdata;
-
-        gpdata.cb = generic_callback;
-        gpdata.parsedata = gd;
-        gpdata.bookdata = book;
 
         retval = sixtp_parse_push (top_parser, push_handler, push_user_data,
                                    NULL, &gpdata, &parse_result);
     }
+    else if (snapshot)
+    {
+        gpointer parse_result = NULL;
+
+        /* The caller keeps the snapshot mapped until we return. */
+        gpdata.input = gnc_xml_snapshot_get_skeleton (snapshot,
+                                                      &gpdata.input_length);
+        retval = sixtp_parse_static_buffer (top_parser, gpdata.input,
+                                            gpdata.input_length, NULL,
+                                            &gpdata, &parse_result);
+    }
     else
     {
         /* Even though libxml2 knows how to decompress zipped files, we
@@ -782,23 +920,47 @@ qof_session_load_from_xml_file_v2_full (
          * info.
          */
         auto filename = xml_be->get_filename();
-        auto [file, thread] = try_gz_open (filename, "r",
-                                           is_gzipped_file (filename), FALSE);
-        if (!file)
+        auto compression = file_compression (filename);
+
+        if (compression == XmlCompression::NONE)
+            mapped = map_xml_file (filename);
+        if (mapped)
         {
-            PWARN ("Unable to open file %s", filename);
-            retval = false;
+            gpointer parse_result = NULL;
+
+            gpdata.input = g_mapped_file_get_contents (mapped);
+            gpdata.input_length = g_mapped_file_get_length (mapped);
+            retval = sixtp_parse_static_buffer (top_parser, gpdata.input,
+                                                gpdata.input_length, NULL,
+                                                &gpdata, &parse_result);
         }
         else
         {
-            retval = gnc_xml_parse_fd (top_parser, file,
-                                       generic_callback, gd, book);
-            fclose (file);
-            if (thread)
-                g_thread_join (thread);
+            auto [file, thread] = try_gz_open (filename, "r", compression,
+                                               FALSE);
+            if (!file)
+            {
+                PWARN ("Unable to open file %s", filename);
+                retval = false;
+            }
+            else
+            {
+                gpointer parse_result = NULL;
+
+                retval = sixtp_parse_fd (top_parser, file, NULL, &gpdata,
+                                         &parse_result);
+                fclose (file);
+                if (thread)
+                    g_thread_join (thread);
+            }
         }
     }
 
+    /* Committed transactions may refer to the mapping until here. */
+    gnc_xml_trn_pipeline_destroy (gpdata.trn_pipeline);
+    if (mapped)
+        g_mapped_file_unref (mapped);
+
     if (!retval)
     {
         sixtp_destroy (top_parser);
@@ -863,7 +1025,18 @@ gboolean
 qof_session_load_from_xml_file_v2 (GncXmlBackend* xml_be, QofBook* book,
                                    QofBookFileType type)
 {
-    return qof_session_load_from_xml_file_v2_full (xml_be, book, NULL, NULL, type);
+    return qof_session_load_from_xml_file_v2_full (xml_be, book, NULL, NULL,
+                                                   NULL, type);
+}
+
+gboolean
+qof_session_load_from_xml_snapshot_v2 (GncXmlBackend* xml_be, QofBook* book,
+                                       const GncXmlSnapshot* snapshot)
+{
+    g_return_val_if_fail (snapshot, FALSE);
+    return qof_session_load_from_xml_file_v2_full (xml_be, book, NULL, NULL,
+                                                   snapshot,
+                                                   GNC_BOOK_XML2_FILE);
 }
 
 /***********************************************************************/
@@ -1086,109 +1259,257 @@ write_commodities (FILE* out, QofBook* book, sixtp_gdv2* gd)
     return success;
 }
 
+/* Records are rendered to text in chunks of RENDER_CHUNK_SIZE, on up to
+ * MAX_RENDER_WORKERS threads plus the writing one, and written back in
+ * their original order.  Workers stay at most RENDER_LOOKAHEAD chunks ahead
+ * of the writer so memory use is bounded.  Rendering only reads the book. */
+#define RENDER_CHUNK_SIZE 256
+#define RENDER_LOOKAHEAD 64
+#define MAX_RENDER_WORKERS 4
+
+struct render_chunk
+{
+    GString* text;
+    bool ok;
+    bool done;
+};
+
+/* render (GString*, T) appends one record and returns false on failure;
+ * emit (const GString*, first, count) is called on this thread for each
+ * chunk in order and returns false to stop. */
+template <typename T, typename Render, typename Emit> static bool
+render_in_order (const std::vector<T>& items, Render render, Emit emit)
+{
+    size_t n_chunks = (items.size () + RENDER_CHUNK_SIZE - 1) / RENDER_CHUNK_SIZE;
+    std::vector<render_chunk> chunks (n_chunks, render_chunk {nullptr, true, false});
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable chunk_done, window_moved;
+    size_t next_claim = 0, next_write = 0;
+    bool stopping = false, ok = true;
+
+    auto render_chunk_at = [&] (size_t i)
+    {
+        auto& chunk = chunks[i];
+        auto last = std::min (items.size (), (i + 1) * RENDER_CHUNK_SIZE);
+
+        chunk.text = g_string_sized_new (RENDER_CHUNK_SIZE * 1024);
+        for (auto j = i * RENDER_CHUNK_SIZE; j < last && chunk.ok; ++j)
+            chunk.ok = render (chunk.text, items[j]);
+    };
+    auto worker = [&] ()
+    {
+        std::unique_lock<std::mutex> lock (mutex);
+        while (true)
+        {
+            window_moved.wait (lock, [&] ()
+            {
+                return stopping || next_claim >= n_chunks
+                       || next_claim < next_write + RENDER_LOOKAHEAD;
+            });
+            if (stopping || next_claim >= n_chunks)
+                return;
+            auto i = next_claim++;
+            lock.unlock ();
+            render_chunk_at (i);
+            lock.lock ();
+            chunks[i].done = true;
+            chunk_done.notify_all ();
+        }
+    };
+
+    if (n_chunks == 0)
+        return true;
+
+    size_t n_workers = std::min ({(size_t)g_get_num_processors () - 1,
+                                  n_chunks - 1, (size_t)MAX_RENDER_WORKERS});
+    if (n_workers > 0)
+    {
+        /* libxml2 sets up its globals lazily; do it before the workers
+         * start building slot nodes. */
+        xmlInitParser ();
+        try
+        {
+            for (size_t i = 0; i < n_workers; ++i)
+                workers.emplace_back (worker);
+        }
+        catch (const std::system_error& err)
+        {
+            PWARN ("Started only %zu of %zu render threads: %s",
+                   workers.size (), n_workers, err.what ());
+        }
+    }
+
+    for (size_t i = 0; i < n_chunks && ok; ++i)
+    {
+        std::unique_lock<std::mutex> lock (mutex);
+        if (next_claim == i)
+        {
+            /* No worker got to this one yet, render it here. */
+            next_claim++;
+            lock.unlock ();
+            render_chunk_at (i);
+            lock.lock ();
+            chunks[i].done = true;
+        }
+        else
+            chunk_done.wait (lock, [&] () { return chunks[i].done; });
+        lock.unlock ();
+
+        auto first = i * RENDER_CHUNK_SIZE;
+        auto count = std::min (items.size () - first, (size_t)RENDER_CHUNK_SIZE);
+        ok = chunks[i].ok && emit (chunks[i].text, first, count);
+        g_string_free (chunks[i].text, TRUE);
+        chunks[i].text = nullptr;
+
+        lock.lock ();
+        next_write = i + 1;
+        window_moved.notify_all ();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        stopping = true;
+    }
+    window_moved.notify_all ();
+    for (auto& thread : workers)
+        thread.join ();
+    for (auto& chunk : chunks)
+        if (chunk.text)
+            g_string_free (chunk.text, TRUE);
+    return ok;
+}
+
+static gboolean
+add_price_to_vector (GNCPrice* price, gpointer data)
+{
+    if (price)
+        static_cast<std::vector<GNCPrice*>*> (data)->push_back (price);
+    return TRUE;
+}
+
 static gboolean
 write_pricedb (FILE* out, QofBook* book, sixtp_gdv2* gd)
 {
-    xmlNodePtr node;
-    xmlNodePtr parent;
-    xmlOutputBufferPtr outbuf;
+    std::vector<GNCPrice*> prices;
+    GString* text;
+    bool rendered;
 
-    parent = gnc_pricedb_dom_tree_create (gnc_pricedb_get_db (book));
+    gnc_pricedb_foreach_price (gnc_pricedb_get_db (book), add_price_to_vector,
+                               &prices, TRUE);
+    if (prices.empty ())
+        return TRUE;
 
-    if (!parent)
+    if (gd->snapshot)
     {
+        if (gnc_xml_snapshot_append_prices (gd->snapshot, prices)
+            && fprintf (out, "<%s/>\n", GNC_SNAPSHOT_PRICES_TAG) < 0)
+            return FALSE;
         return TRUE;
     }
 
-    /* Write out the parent pricedb tag then loop to write out each price.
-       We do it this way instead of just calling xmlElemDump so that we can
-       increment the progress bar as we go. */
-
-    if (fprintf (out, "<%s version=\"%s\">\n", parent->name,
-                 xmlGetProp (parent, BAD_CAST "version")) < 0)
-        return FALSE;
+    /* Like gnc_pricedb_dom_tree_create, write nothing at all if any price
+       can't be rendered.  Otherwise write the prices one by one so that we
+       can increment the progress bar as we go. */
+    text = g_string_new (NULL);
+    rendered = render_in_order (prices, [] (GString* buf, GNCPrice* price)
+    {
+        return gnc_price_xml_text_append (buf, 1, price) != FALSE;
+    },
+    [text] (const GString* chunk, size_t, size_t)
+    {
+        g_string_append_len (text, chunk->str, chunk->len);
+        return true;
+    });
+    if (!rendered)
+    {
+        g_string_free (text, TRUE);
+        return TRUE;
+    }
 
-    /* We create our own output buffer so we can call xmlNodeDumpOutput to get
-       the indentation correct. */
-    outbuf = xmlOutputBufferCreateFile (out, NULL);
-    if (outbuf == NULL)
+    if (fprintf (out, "<%s version=\"%s\">\n", "gnc:pricedb", "1") < 0
+        || fwrite (text->str, 1, text->len, out) != text->len)
     {
-        xmlFreeNode (parent);
+        g_string_free (text, TRUE);
         return FALSE;
     }
+    g_string_free (text, TRUE);
 
-    for (node = parent->children; node; node = node->next)
+    for (size_t i = 0; i < prices.size (); ++i)
     {
-        /* Write two spaces since xmlNodeDumpOutput doesn't indent the first line */
-        xmlOutputBufferWrite (outbuf, 2, "  ");
-        xmlNodeDumpOutput (outbuf, NULL, node, 1, 1, NULL);
-        /* It also doesn't terminate the last line */
-        xmlOutputBufferWrite (outbuf, 1, "\n");
-        if (ferror (out))
-            break;
         gd->counter.prices_loaded += 1;
         sixtp_run_callback (gd, "prices");
     }
 
-    xmlOutputBufferClose (outbuf);
-
-    if (ferror (out) || fprintf (out, "</%s>\n", parent->name) < 0)
-    {
-        xmlFreeNode (parent);
+    if (ferror (out) || fprintf (out, "</%s>\n", "gnc:pricedb") < 0)
         return FALSE;
-    }
 
-    xmlFreeNode (parent);
     return TRUE;
 }
 
 static int
-xml_add_trn_data (Transaction* t, gpointer data)
+add_trn_to_vector (Transaction* t, gpointer data)
 {
-    struct file_backend* be_data = static_cast<decltype (be_data)> (data);
-    xmlNodePtr node;
-
-    node = gnc_transaction_dom_tree_create (t);
-
-    xmlElemDump (be_data->out, NULL, node);
-    xmlFreeNode (node);
+    static_cast<std::vector<Transaction*>*> (data)->push_back (t);
+    return 0;
+}
 
-    if (ferror (be_data->out) || fprintf (be_data->out, "\n") < 0)
-        return -1;
+static gboolean
+write_account_transactions (FILE* out, Account* root, sixtp_gdv2* gd)
+{
+    std::vector<Transaction*> transactions;
 
-    be_data->gd->counter.transactions_loaded++;
-    sixtp_run_callback (be_data->gd, "transaction");
-    return 0;
+    xaccAccountTreeForEachTransaction (root, add_trn_to_vector, &transactions);
+    return render_in_order (transactions, [] (GString* buf, Transaction* t)
+    {
+        gnc_transaction_xml_text_append (buf, t);
+        return true;
+    },
+    [out, gd] (const GString* chunk, size_t, size_t count)
+    {
+        if (fwrite (chunk->str, 1, chunk->len, out) != chunk->len
+            || ferror (out))
+            return false;
+        for (size_t i = 0; i < count; ++i)
+        {
+            gd->counter.transactions_loaded++;
+            sixtp_run_callback (gd, "transaction");
+        }
+        return true;
+    });
 }
 
 static gboolean
 write_transactions (FILE* out, QofBook* book, sixtp_gdv2* gd)
 {
-    struct file_backend be_data;
+    auto root = gnc_book_get_root_account (book);
 
-    be_data.out = out;
-    be_data.gd = gd;
-    return 0 ==
-           xaccAccountTreeForEachTransaction (gnc_book_get_root_account (book),
-                                              xml_add_trn_data,
-                                              (gpointer) &be_data);
+    if (gd->snapshot)
+    {
+        std::vector<Transaction*> transactions;
+
+        xaccAccountTreeForEachTransaction (root, add_trn_to_vector,
+                                           &transactions);
+        if (transactions.empty ())
+            return TRUE;
+        return gnc_xml_snapshot_append_transactions (gd->snapshot,
+                                                     transactions)
+               && fprintf (out, "<%s/>\n", GNC_SNAPSHOT_TRANSACTIONS_TAG) >= 0;
+    }
+    return write_account_transactions (out, root, gd);
 }
 
 static gboolean
 write_template_transaction_data (FILE* out, QofBook* book, sixtp_gdv2* gd)
 {
     Account* ra;
-    struct file_backend be_data;
-
-    be_data.out = out;
-    be_data.gd = gd;
 
     ra = gnc_book_get_template_root (book);
     if (gnc_account_n_descendants (ra) > 0)
     {
         if (fprintf (out, "<%s>\n", TEMPLATE_TRANSACTION_TAG) < 0
             || !write_account_tree (out, ra, gd)
-            || xaccAccountTreeForEachTransaction (ra, xml_add_trn_data, (gpointer)&be_data)
+            || !write_account_transactions (out, ra, gd)
             || fprintf (out, "</%s>\n", TEMPLATE_TRANSACTION_TAG) < 0)
 
             return FALSE;
@@ -1297,8 +1618,10 @@ write_v2_header (FILE* out)
     return TRUE;
 }
 
-gboolean
-gnc_book_write_to_xml_filehandle_v2 (QofBook* book, FILE* out)
+/* Writes the data file, or with snapshot set the skeleton of its
+ * snapshot, which doesn't report progress. */
+static gboolean
+write_book_to_filehandle (QofBook* book, FILE* out, GByteArray* snapshot)
 {
     QofBackend* qof_be;
     sixtp_gdv2* gd;
@@ -1312,7 +1635,8 @@ gnc_book_write_to_xml_filehandle_v2 (QofBook* book, FILE* out)
 
     qof_be = qof_book_get_backend (book);
     gd = gnc_sixtp_gdv2_new (book, FALSE, file_rw_feedback,
-                             qof_be->get_percentage());
+                             snapshot ? NULL : qof_be->get_percentage());
+    gd->snapshot = snapshot;
     gd->counter.commodities_total =
         gnc_commodity_table_get_size (gnc_commodity_table_get_table (book));
     gd->counter.accounts_total = 1 +
@@ -1333,6 +1657,12 @@ gnc_book_write_to_xml_filehandle_v2 (QofBook* book, FILE* out)
     return success;
 }
 
+gboolean
+gnc_book_write_to_xml_filehandle_v2 (QofBook* book, FILE* out)
+{
+    return write_book_to_filehandle (book, out, NULL);
+}
+
 /*
  * This function is called by the "export" code.
  */
@@ -1401,41 +1731,305 @@ do_gzopen (const char* filename, const char* perms)
 #endif
 }
 
-constexpr uint32_t BUFLEN{4096};
+constexpr uint32_t BUFLEN{65536};
 
-static inline bool
-gz_thread_write (gzFile file, gz_thread_params_t* params)
+/* Block-parallel gzip, the way pigz does it.  The input is cut into
+ * blocks that are deflated on worker threads, each primed with the last
+ * 32K of the input before it so little ratio is lost.  Every block but the
+ * last ends with a sync flush, which leaves it on a byte boundary, so the
+ * blocks concatenate into the deflate stream of a single gzip member that
+ * any zlib can read. */
+constexpr size_t GZ_BLOCK_SIZE{128 * 1024};
+constexpr size_t GZ_DICT_SIZE{32 * 1024};
+#define MAX_GZ_WORKERS 8
+
+struct gz_block
 {
-    bool success = true;
-    gchar buffer[BUFLEN];
+    std::vector<unsigned char> in;  /* dictionary followed by the data */
+    size_t dict_len;
+    std::vector<unsigned char> out;
+    uLong crc;
+    bool last;
+    bool done;
+    bool ok;
+};
 
-    while (success)
+static void
+gz_deflate_block (gz_block* block, int level)
+{
+    z_stream stream{};
+    auto data_len = block->in.size () - block->dict_len;
+
+    block->ok = false;
+    block->crc = crc32 (crc32 (0L, Z_NULL, 0),
+                        block->in.data () + block->dict_len, data_len);
+    if (deflateInit2 (&stream, level, Z_DEFLATED, -MAX_WBITS, 8,
+                      Z_DEFAULT_STRATEGY) != Z_OK)
+        return;
+    if (block->dict_len
+        && deflateSetDictionary (&stream, block->in.data (),
+                                 block->dict_len) != Z_OK)
     {
-        auto bytes = read (params->fd, buffer, BUFLEN);
-        if (bytes > 0)
+        deflateEnd (&stream);
+        return;
+    }
+
+    /* Room for the worst case plus the flush markers. */
+    block->out.resize (deflateBound (&stream, data_len) + 16);
+    stream.next_in = block->in.data () + block->dict_len;
+    stream.avail_in = data_len;
+    stream.next_out = block->out.data ();
+    stream.avail_out = block->out.size ();
+    auto zval = deflate (&stream, block->last ? Z_FINISH : Z_SYNC_FLUSH);
+    if ((block->last ? zval == Z_STREAM_END : zval == Z_OK)
+        && stream.avail_in == 0)
+    {
+        block->out.resize (stream.total_out);
+        block->ok = true;
+    }
+    deflateEnd (&stream);
+}
+
+/* Writes to the file, adding what was written to the checksum. */
+static bool
+thread_write (FILE* out, const void* data, size_t len,
+              gz_thread_params_t* params)
+{
+    if (params->checksum)
+        g_checksum_update (params->checksum,
+                           static_cast<const guchar*> (data), len);
+    return fwrite (data, 1, len, out) == len;
+}
+
+static bool
+gz_write_le32 (FILE* out, uLong value, gz_thread_params_t* params)
+{
+    unsigned char bytes[4] = {(unsigned char)(value & 0xff),
+                              (unsigned char)((value >> 8) & 0xff),
+                              (unsigned char)((value >> 16) & 0xff),
+                              (unsigned char)((value >> 24) & 0xff)};
+    return thread_write (out, bytes, 4, params);
+}
+
+/* Reads up to len bytes from fd, less only at the end of input. */
+static gssize
+read_full (int fd, unsigned char* buf, size_t len)
+{
+    size_t total = 0;
+    while (total < len)
+    {
+        auto bytes = read (fd, buf + total, len - total);
+        if (bytes == 0)
+            break;
+        if (bytes < 0)
         {
-            if (gzwrite (file, buffer, bytes) <= 0)
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        total += bytes;
+    }
+    return total;
+}
+
+static bool
+gz_thread_write (FILE* out, gz_thread_params_t* params)
+{
+    static const unsigned char header[10] =
+        {037, 0213, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 3};
+    std::deque<std::unique_ptr<gz_block>> blocks;
+    std::deque<gz_block*> queue;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_ready, block_done;
+    bool stopping = false, eof = false, success = true;
+    uLong crc = crc32 (0L, Z_NULL, 0), isize = 0;
+    std::vector<unsigned char> tail;
+    size_t n_workers = std::min<size_t> (g_get_num_processors (),
+                                         MAX_GZ_WORKERS);
+
+    auto worker = [&] ()
+    {
+        std::unique_lock<std::mutex> lock (mutex);
+        while (true)
+        {
+            work_ready.wait (lock, [&] () { return stopping || !queue.empty (); });
+            if (queue.empty ())
+                return;
+            auto block = queue.front ();
+            queue.pop_front ();
+            lock.unlock ();
+            gz_deflate_block (block, params->level);
+            lock.lock ();
+            block->done = true;
+            block_done.notify_all ();
+        }
+    };
+
+    if (n_workers > 1)
+    {
+        try
+        {
+            for (size_t i = 0; i < n_workers; ++i)
+                workers.emplace_back (worker);
+        }
+        catch (const std::system_error& err)
+        {
+            g_warning ("Started only %zu of %zu compression threads: %s",
+                       workers.size (), n_workers, err.what ());
+        }
+    }
+
+    success = thread_write (out, header, sizeof (header), params);
+    while (success && !(eof && blocks.empty ()))
+    {
+        /* Keep a few blocks per worker in flight. */
+        if (!eof && blocks.size () < 2 * workers.size () + 1)
+        {
+            auto block = std::make_unique<gz_block> ();
+            block->in.resize (tail.size () + GZ_BLOCK_SIZE);
+            std::copy (tail.begin (), tail.end (), block->in.begin ());
+            block->dict_len = tail.size ();
+            auto bytes = read_full (params->fd,
+                                    block->in.data () + block->dict_len,
+                                    GZ_BLOCK_SIZE);
+            if (bytes < 0)
             {
-                gint errnum;
-                auto error = gzerror (file, &errnum);
-                g_warning ("Could not write the compressed file '%s'. The error is: '%s' (%d)",
-                           params->filename, error, errnum);
+                g_warning ("Could not read from pipe. The error is '%s' (errno %d)",
+                           g_strerror (errno) ? g_strerror (errno) : "", errno);
                 success = false;
+                break;
+            }
+            block->in.resize (block->dict_len + bytes);
+            eof = block->last = (size_t)bytes < GZ_BLOCK_SIZE;
+            auto keep = std::min (block->in.size (), GZ_DICT_SIZE);
+            tail.assign (block->in.end () - keep, block->in.end ());
+
+            std::lock_guard<std::mutex> lock (mutex);
+            block->done = workers.empty ();
+            if (workers.empty ())
+                gz_deflate_block (block.get (), params->level);
+            else
+            {
+                queue.push_back (block.get ());
+                work_ready.notify_one ();
             }
+            blocks.push_back (std::move (block));
+            continue;
         }
-        else if (bytes == 0)
+
+        /* Write the oldest block once it is compressed. */
+        auto block = blocks.front ().get ();
         {
-            break;
+            std::unique_lock<std::mutex> lock (mutex);
+            block_done.wait (lock, [&] () { return block->done; });
         }
-        else
+        auto data_len = block->in.size () - block->dict_len;
+        success = block->ok
+                  && thread_write (out, block->out.data (), block->out.size (),
+                                   params);
+        if (!success)
+            g_warning ("Could not write the compressed file '%s'",
+                       params->filename);
+        crc = crc32_combine (crc, block->crc, data_len);
+        isize += data_len;
+        blocks.pop_front ();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        stopping = true;
+        queue.clear ();
+    }
+    work_ready.notify_all ();
+    for (auto& thread : workers)
+        thread.join ();
+
+    return success && gz_write_le32 (out, crc, params)
+           && gz_write_le32 (out, isize & 0xffffffffUL, params);
+}
+
+/* Copies the uncompressed file, which only goes through a thread when
+ * its checksum is wanted. */
+static bool
+plain_thread_write (FILE* out, gz_thread_params_t* params)
+{
+    std::vector<unsigned char> buffer (BUFLEN);
+    gssize bytes;
+
+    do
+    {
+        bytes = read_full (params->fd, buffer.data (), buffer.size ());
+        if (bytes < 0)
+        {
+            g_warning ("Could not read from pipe. The error is '%s' (errno %d)",
+                       g_strerror (errno) ? g_strerror (errno) : "", errno);
+            return false;
+        }
+        if (!thread_write (out, buffer.data (), bytes, params))
+        {
+            g_warning ("Could not write the file '%s'. The error is: '%s'",
+                       params->filename, g_strerror (errno));
+            return false;
+        }
+    }
+    while ((size_t)bytes == buffer.size ());
+    return true;
+}
+
+#ifdef HAVE_ZSTD
+static bool
+zstd_thread_write (FILE* out, gz_thread_params_t* params)
+{
+    std::vector<unsigned char> in (ZSTD_CStreamInSize ());
+    std::vector<unsigned char> buffer (ZSTD_CStreamOutSize ());
+    auto cctx = ZSTD_createCCtx ();
+    bool success = cctx != nullptr, last = false;
+
+    if (success)
+    {
+        ZSTD_CCtx_setParameter (cctx, ZSTD_c_compressionLevel, params->level);
+        /* Only has an effect if libzstd was built with threads. */
+        ZSTD_CCtx_setParameter (cctx, ZSTD_c_nbWorkers,
+                                MIN (g_get_num_processors (), MAX_GZ_WORKERS));
+    }
+
+    while (success && !last)
+    {
+        auto bytes = read_full (params->fd, in.data (), in.size ());
+        if (bytes < 0)
         {
             g_warning ("Could not read from pipe. The error is '%s' (errno %d)",
                        g_strerror (errno) ? g_strerror (errno) : "", errno);
             success = false;
+            break;
         }
+        last = (size_t)bytes < in.size ();
+
+        ZSTD_inBuffer input{in.data (), (size_t)bytes, 0};
+        size_t remaining;
+        do
+        {
+            ZSTD_outBuffer output{buffer.data (), buffer.size (), 0};
+            remaining = ZSTD_compressStream2 (cctx, &output, &input,
+                                              last ? ZSTD_e_end : ZSTD_e_continue);
+            if (ZSTD_isError (remaining)
+                || !thread_write (out, buffer.data (), output.pos, params))
+            {
+                g_warning ("Could not write the compressed file '%s'. The error is: '%s'",
+                           params->filename, ZSTD_isError (remaining) ?
+                           ZSTD_getErrorName (remaining) : g_strerror (errno));
+                success = false;
+                break;
+            }
+        }
+        while (last ? remaining != 0 : input.pos < input.size);
     }
+
+    ZSTD_freeCCtx (cctx);
     return success;
 }
+#endif
 
 #if COMPILER(MSVC)
 #define WRITE_FN _write
@@ -1477,6 +2071,60 @@ gz_thread_read (gzFile file, gz_thread_params_t* params)
     return success;
 }
 
+#ifdef HAVE_ZSTD
+static bool
+zstd_thread_read (FILE* in, gz_thread_params_t* params)
+{
+    std::vector<unsigned char> buffer (ZSTD_DStreamInSize ());
+    std::vector<unsigned char> out (ZSTD_DStreamOutSize ());
+    auto dctx = ZSTD_createDCtx ();
+    bool success = dctx != nullptr;
+    size_t pending = 0;
+
+    while (success)
+    {
+        auto bytes = fread (buffer.data (), 1, buffer.size (), in);
+        if (bytes == 0)
+        {
+            if (ferror (in))
+            {
+                g_warning ("Could not read from compressed file '%s'. The error is: '%s'",
+                           params->filename, g_strerror (errno));
+                success = false;
+            }
+            break;
+        }
+
+        ZSTD_inBuffer input{buffer.data (), bytes, 0};
+        while (success && input.pos < input.size)
+        {
+            ZSTD_outBuffer output{out.data (), out.size (), 0};
+            pending = ZSTD_decompressStream (dctx, &output, &input);
+            if (ZSTD_isError (pending))
+            {
+                g_warning ("Could not read from compressed file '%s'. The error is: '%s'",
+                           params->filename, ZSTD_getErrorName (pending));
+                success = false;
+            }
+            else if (WRITE_FN (params->fd, out.data (), output.pos) < 0)
+            {
+                g_warning ("Could not write to pipe. The error is '%s' (%d)",
+                           g_strerror (errno) ? g_strerror (errno) : "", errno);
+                success = false;
+            }
+        }
+    }
+    if (success && pending != 0)
+    {
+        g_warning ("The compressed file '%s' is truncated", params->filename);
+        success = false;
+    }
+
+    ZSTD_freeDCtx (dctx);
+    return success;
+}
+#endif
+
 /* Compress or decompress function that is to be run in a separate thread.
  * Returns 1 on success or 0 otherwise, stuffed into a pointer type. */
 static gpointer
@@ -1485,29 +2133,56 @@ gz_thread_func (gz_thread_params_t* params)
     gint gzval;
     bool success = true;
 
-    auto file = do_gzopen (params->filename, params->perms);
-
-    if (!file)
+    if (params->compression == XmlCompression::ZSTD || params->write)
     {
-        g_warning ("Child threads gzopen failed");
-        success = 0;
+        /* These write the compressed format, or the checksummed plain
+         * file, themselves. */
+        auto mode = params->compression == XmlCompression::NONE ?
+                    params->perms : params->write ? "wb" : "rb";
+        auto file = g_fopen (params->filename, mode);
+        if (!file)
+        {
+            g_warning ("Child threads fopen failed");
+            success = false;
+            goto cleanup_gz_thread_func;
+        }
+#ifdef HAVE_ZSTD
+        if (params->compression == XmlCompression::ZSTD)
+            success = params->write ? zstd_thread_write (file, params)
+                      : zstd_thread_read (file, params);
+        else
+#endif
+        if (params->compression == XmlCompression::NONE)
+            success = plain_thread_write (file, params);
+        else
+            success = gz_thread_write (file, params);
+        if (fclose (file) != 0)
+        {
+            g_warning ("Could not close the compressed file '%s' (errno %d)",
+                       params->filename, errno);
+            success = false;
+        }
         goto cleanup_gz_thread_func;
     }
 
-    if (params->write)
-    {
-        success = gz_thread_write (file, params);
-    }
-    else
     {
+        auto file = do_gzopen (params->filename, params->perms);
+
+        if (!file)
+        {
+            g_warning ("Child threads gzopen failed");
+            success = 0;
+            goto cleanup_gz_thread_func;
+        }
+
         success = gz_thread_read (file, params);
-    }
 
-    if ((gzval = gzclose (file)) != Z_OK)
-    {
-        g_warning ("Could not close the compressed file '%s' (errnum %d)",
-                   params->filename, gzval);
-        success = false;
+        if ((gzval = gzclose (file)) != Z_OK)
+        {
+            g_warning ("Could not close the compressed file '%s' (errnum %d)",
+                       params->filename, gzval);
+            success = false;
+        }
     }
 
 cleanup_gz_thread_func:
@@ -1519,14 +2194,25 @@ cleanup_gz_thread_func:
     return GINT_TO_POINTER (success);
 }
 
+/* When writing, checksum if not NULL is updated with the file as written
+ * by the thread; without a thread the caller has to take it. */
 static std::pair<FILE*, GThread*>
-try_gz_open (const char* filename, const char* perms, gboolean compress,
-             gboolean write)
+try_gz_open (const char* filename, const char* perms,
+             XmlCompression compression, gboolean write,
+             GChecksum* checksum = nullptr)
 {
-    if (strstr (filename, ".gz.") != NULL) /* its got a temp extension */
-        compress = TRUE;
+    if (compression == XmlCompression::NONE
+        && strstr (filename, ".gz.") != NULL) /* its got a temp extension */
+        compression = XmlCompression::GZIP;
 
-    if (!compress)
+#ifndef HAVE_ZSTD
+    if (compression == XmlCompression::ZSTD)
+    {
+        g_warning ("Can't open '%s', zstd support was not built in", filename);
+        return std::pair<FILE*, GThread*>(nullptr, nullptr);
+    }
+#endif
+    if (compression == XmlCompression::NONE && !(write && checksum))
         return std::pair<FILE*, GThread*>(g_fopen (filename, perms),
                                           nullptr);
 
@@ -1534,7 +2220,7 @@ try_gz_open (const char* filename, const char* perms, gboolean compress,
         int filedes[2]{};
 
 #ifdef G_OS_WIN32
-        if (_pipe (filedes, 4096, _O_BINARY) < 0)
+        if (_pipe (filedes, BUFLEN, _O_BINARY) < 0)
         {
 #else
         /* Set CLOEXEC on the pipe FDs so that if the user runs a
@@ -1564,6 +2250,16 @@ try_gz_open (const char* filename, const char* perms, gboolean compress,
         params->filename = g_strdup (filename);
         params->perms = g_strdup (perms);
         params->write = write;
+        params->compression = compression;
+        params->checksum = write ? checksum : nullptr;
+        params->level = gnc_prefs_get_file_compression_level ();
+#ifdef HAVE_ZSTD
+        if (compression == XmlCompression::ZSTD)
+            params->level = CLAMP (params->level, ZSTD_minCLevel (),
+                                   ZSTD_maxCLevel ());
+        else
+#endif
+            params->level = CLAMP (params->level, 1, 9);
 
         auto thread = g_thread_new ("xml_thread", (GThreadFunc) gz_thread_func,
                                     params);
@@ -1592,13 +2288,44 @@ try_gz_open (const char* filename, const char* perms, gboolean compress,
     }
 }
 
+/* Takes the checksum of filename by reading it back, for when the
+ * writer had no thread to take it. */
+static bool
+checksum_file (const char* filename, GChecksum* checksum)
+{
+    std::vector<guchar> buffer (BUFLEN);
+    size_t n;
+
+    auto file = g_fopen (filename, "rb");
+    if (!file)
+        return false;
+    while ((n = fread (buffer.data (), 1, buffer.size (), file)) > 0)
+        g_checksum_update (checksum, buffer.data (), n);
+    auto ok = !ferror (file);
+    fclose (file);
+    return ok;
+}
+
 gboolean
 gnc_book_write_to_xml_file_v2 (QofBook* book, const char* filename,
-                               gboolean compress)
+                               gboolean compress, GChecksum* checksum)
 {
     bool success = true;
 
-    auto [file, thread] = try_gz_open (filename, "w", compress, TRUE);
+    auto compression = XmlCompression::NONE;
+    if (compress)
+        compression = gnc_prefs_get_file_compression_zstd () ?
+                      XmlCompression::ZSTD : XmlCompression::GZIP;
+#ifndef HAVE_ZSTD
+    if (compression == XmlCompression::ZSTD)
+    {
+        PWARN ("zstd support was not built in, saving %s with gzip", filename);
+        compression = XmlCompression::GZIP;
+    }
+#endif
+
+    auto [file, thread] = try_gz_open (filename, "w", compression, TRUE,
+                                       checksum);
     if (!file)
         return false;
 
@@ -1616,10 +2343,126 @@ gnc_book_write_to_xml_file_v2 (QofBook* book, const char* filename,
         if (g_thread_join (thread) == nullptr)
             success = false;
     }
+    else if (checksum && success)
+        success = checksum_file (filename, checksum);
+
+    return success;
+}
+
+gboolean
+gnc_xml2_write_snapshot (QofBook* book, const char* xml_filename,
+                         const guint8* xml_hash, const char* filename)
+{
+    return gnc_xml_snapshot_write (filename, xml_filename, xml_hash,
+                                   [book] (FILE* out, GByteArray* data)
+    {
+        return write_book_to_filehandle (book, out, data) != FALSE;
+    });
+}
+
+/* Journal records.  A record holds a transaction's guid and, unless the
+ * transaction was destroyed, its <gnc:transaction> element as written to
+ * the data file:
+ *
+ *   trn <guid> <length>\n<length bytes>\n
+ */
+gboolean
+gnc_xml2_journal_can_write_transaction (QofBook* book, const GncGUID* guid)
+{
+    Transaction* trn = xaccTransLookup (guid, book);
 
+    /* Replaying destroys and rebuilds the transaction, which would leave
+     * invoices pointing at the old one. */
+    return !trn || (!xaccTransGetReadOnly (trn)
+                    && !gncInvoiceGetInvoiceFromTxn (trn));
+}
+
+gboolean
+gnc_xml2_journal_write_transaction (FILE* out, QofBook* book,
+                                    const GncGUID* guid)
+{
+    char guidstr[GUID_ENCODING_LENGTH + 1];
+    Transaction* trn = xaccTransLookup (guid, book);
+    GString* text = g_string_new (NULL);
+    gboolean success;
+
+    if (trn)
+        gnc_transaction_xml_text_append (text, trn);
+    guid_to_string_buff (guid, guidstr);
+    success = fprintf (out, "trn %s %" G_GSIZE_FORMAT "\n", guidstr,
+                       text->len) >= 0
+              && fwrite (text->str, 1, text->len, out) == text->len
+              && fputc ('\n', out) != EOF;
+    g_string_free (text, TRUE);
     return success;
 }
 
+static void
+journal_destroy_transaction (Transaction* trn)
+{
+    xaccTransBeginEdit (trn);
+    xaccTransClearReadOnly (trn);
+    xaccTransDestroy (trn);
+    xaccTransCommitEdit (trn);
+}
+
+gboolean
+gnc_xml2_journal_replay_transaction (QofBook* book, QofBook* scratch,
+                                     const GncGUID* guid,
+                                     const char* text, gsize len)
+{
+    Transaction* old_trn = xaccTransLookup (guid, book);
+    Transaction* trn;
+    xmlDocPtr doc;
+    xmlNodePtr node;
+
+    if (len == 0)
+    {
+        if (old_trn)
+            journal_destroy_transaction (old_trn);
+        return TRUE;
+    }
+
+    /* A record that can't be read leaves the transaction as it was. */
+    doc = xmlReadMemory (text, (int)len, NULL, NULL, XML_PARSE_HUGE);
+    node = doc ? xmlDocGetRootElement (doc) : NULL;
+    if (!node || g_strcmp0 ((char*)node->name, "gnc:transaction") != 0)
+    {
+        char guidstr[GUID_ENCODING_LENGTH + 1];
+        guid_to_string_buff (guid, guidstr);
+        PERR ("Bad journal record for transaction %s", guidstr);
+        if (doc)
+            xmlFreeDoc (doc);
+        return FALSE;
+    }
+    /* The decoded transaction takes the guids of the one it replaces and
+     * its splits, so it is decoded into scratch first to make sure that
+     * it can be before that one goes. */
+    trn = dom_tree_to_transaction (node, scratch);
+    if (!trn)
+    {
+        xmlFreeDoc (doc);
+        return FALSE;
+    }
+    journal_destroy_transaction (trn);
+
+    if (old_trn)
+        journal_destroy_transaction (old_trn);
+    trn = dom_tree_to_transaction (node, book);
+    xmlFreeDoc (doc);
+    if (!trn)
+        return FALSE;
+
+    xaccTransBeginEdit (trn);
+    clear_up_transaction_commodity (gnc_commodity_table_get_table (book), trn,
+                                    xaccTransGetCurrency,
+                                    xaccTransSetCurrency);
+    xaccTransScrubCurrency (trn);
+    xaccTransScrubPostedDate (trn);
+    xaccTransCommitEdit (trn);
+    return TRUE;
+}
+
 /*
  * Have to pass in the backend as this routine needs the temporary
  * backend for file export, not the real backend which could be
@@ -1654,37 +2497,90 @@ gnc_book_write_accounts_to_xml_file_v2 (QofBackend* qof_be, QofBook* book,
 }
 
 /***********************************************************************/
-static bool
-is_gzipped_file (const gchar* name)
+static XmlCompression
+file_compression (const gchar* name)
 {
-    unsigned char buf[2];
+    unsigned char buf[4];
     int fd = g_open (name, O_RDONLY, 0);
 
     if (fd == -1)
     {
-        return false;
+        return XmlCompression::NONE;
     }
 
-    if (read (fd, buf, 2) != 2)
-    {
-        close (fd);
-        return false;
-    }
+    auto bytes = read (fd, buf, 4);
     close (fd);
 
     /* 037 0213 are the header id bytes for a gzipped file. */
-    if (buf[0] == 037 && buf[1] == 0213)
+    if (bytes >= 2 && buf[0] == 037 && buf[1] == 0213)
     {
-        return true;
+        return XmlCompression::GZIP;
+    }
+    /* And 28 B5 2F FD, little endian, the zstd frame magic number. */
+    if (bytes == 4 && buf[0] == 0x28 && buf[1] == 0xb5 && buf[2] == 0x2f
+        && buf[3] == 0xfd)
+    {
+        return XmlCompression::ZSTD;
     }
 
-    return false;
+    return XmlCompression::NONE;
 }
 
+#ifdef HAVE_ZSTD
+/* Decompresses the start of a zstd file into chunk, returns its length. */
+static int
+zstd_read_first_chunk (const gchar* name, char* chunk, size_t len)
+{
+    unsigned char buffer[4096];
+    auto file = g_fopen (name, "rb");
+    if (!file)
+        return -1;
+
+    auto dctx = ZSTD_createDCtx ();
+    ZSTD_outBuffer output{chunk, len, 0};
+    while (dctx && output.pos < output.size)
+    {
+        auto bytes = fread (buffer, 1, sizeof (buffer), file);
+        if (bytes == 0)
+            break;
+        ZSTD_inBuffer input{buffer, bytes, 0};
+        while (input.pos < input.size && output.pos < output.size)
+            if (ZSTD_isError (ZSTD_decompressStream (dctx, &output, &input)))
+            {
+                output.pos = 0;
+                output.size = 0;
+                break;
+            }
+    }
+    ZSTD_freeDCtx (dctx);
+    fclose (file);
+    return output.pos;
+}
+#endif
+
 QofBookFileType
 gnc_is_xml_data_file_v2 (const gchar* name, gboolean* with_encoding)
 {
-    if (is_gzipped_file (name))
+    auto compression = file_compression (name);
+
+    if (compression == XmlCompression::ZSTD)
+    {
+#ifdef HAVE_ZSTD
+        char first_chunk[256];
+        auto num_read = zstd_read_first_chunk (name, first_chunk,
+                                               sizeof (first_chunk) - 1);
+        if (num_read < 1)
+            return GNC_BOOK_NOT_OURS;
+        first_chunk[num_read] = '\0';
+
+        return gnc_is_our_first_xml_chunk (first_chunk, with_encoding);
+#else
+        PWARN ("%s is compressed with zstd, which this build can't read", name);
+        return GNC_BOOK_NOT_OURS;
+#endif
+    }
+
+    if (compression == XmlCompression::GZIP)
     {
         gzFile file = NULL;
         char first_chunk[256];
@@ -1800,7 +2696,7 @@ gnc_xml2_find_ambiguous (const gchar* filename, GList* encodings,
     gboolean clean_return = FALSE;
 
     auto [file, thread] = try_gz_open (filename, "r",
-                                       is_gzipped_file (filename), FALSE);
+                                       file_compression (filename), FALSE);
     if (file == NULL)
     {
         PWARN ("Unable to open file %s", filename);
@@ -2006,7 +2902,7 @@ parse_with_subst_push_handler (xmlParserCtxtPtr xml_context,
 
     auto filename = push_data->filename;
     auto [file, thread] = try_gz_open (filename, "r",
-                                       is_gzipped_file (filename), FALSE);
+                                       file_compression (filename), FALSE);
     if (!file)
     {
         PWARN ("Unable to open file %s", filename);
@@ -2137,7 +3033,7 @@ gnc_xml2_parse_with_subst (GncXmlBackend* xml_be, QofBook* book, GHashTable* sub
 
     success = qof_session_load_from_xml_file_v2_full (
                   xml_be, book, (sixtp_push_handler) parse_with_subst_push_handler,
-                  push_data, GNC_BOOK_XML2_FILE);
+                  push_data, NULL, GNC_BOOK_XML2_FILE);
     g_free (push_data);
 
     if (success)
@@ -41,6 +41,7 @@
 #include <vector>
 
 class GncXmlBackend;
+typedef struct GncXmlSnapshot GncXmlSnapshot;
 
 /**
  * Struct used to pass in a new data type for XML storage.  This contains
@@ -84,11 +85,37 @@ typedef struct
 /** read in an account group from a file */
 gboolean qof_session_load_from_xml_file_v2 (GncXmlBackend*, QofBook*,
                                             QofBookFileType);
+/** read in the book from a snapshot of the backend's file, see
+ * gnc-xml-snapshot.h */
+gboolean qof_session_load_from_xml_snapshot_v2 (GncXmlBackend*, QofBook*,
+                                                const GncXmlSnapshot*);
 
 /* write all book info to a file */
 gboolean gnc_book_write_to_xml_filehandle_v2 (QofBook* book, FILE* fh);
+/** checksum, if not NULL, is updated with the file as written */
 gboolean gnc_book_write_to_xml_file_v2 (QofBook* book, const char* filename,
-                                        gboolean compress);
+                                        gboolean compress,
+                                        GChecksum* checksum = nullptr);
+/** write a snapshot of the book, which must be as it was last written to
+ * or read from xml_filename; xml_hash is the SHA1 of xml_filename if it
+ * was taken while writing it, otherwise NULL */
+gboolean gnc_xml2_write_snapshot (QofBook* book, const char* xml_filename,
+                                  const guint8* xml_hash,
+                                  const char* filename);
+
+/** Transaction records for GncXmlBackend's save journal.  Writing records
+ * the transaction's current state, or its destruction if the guid no
+ * longer resolves; replaying a record replaces the transaction in book,
+ * unless the record can't be decoded into scratch, a book of no further
+ * use. */
+gboolean gnc_xml2_journal_can_write_transaction (QofBook* book,
+                                                 const GncGUID* guid);
+gboolean gnc_xml2_journal_write_transaction (FILE* out, QofBook* book,
+                                             const GncGUID* guid);
+gboolean gnc_xml2_journal_replay_transaction (QofBook* book,
+                                              QofBook* scratch,
+                                              const GncGUID* guid,
+                                              const char* text, gsize len);
 
 /** write just the commodities and accounts to a file */
 gboolean gnc_book_write_accounts_to_xml_filehandle_v2 (QofBackend* be,
@@ -26,6 +26,8 @@
 
 #include <config.h>
 
+#include <string.h>
+
 #include <gnc-date.h>
 
 #include "gnc-xml-helper.h"
@@ -330,3 +332,176 @@ qof_instance_slots_to_dom_tree (const char* tag, const QofInstance* inst)
     frame->for_each_slot_temp (&add_kvp_slot, ret);
     return ret;
 }
+
+/***********************************************************************/
+
+static void
+xml_text_append_indent (GString* buf, int level)
+{
+    for (int i = 0; i < level; ++i)
+        g_string_append (buf, "  ");
+}
+
+void
+xml_text_append_open (GString* buf, int level, const char* tag)
+{
+    xml_text_append_indent (buf, level);
+    g_string_append_printf (buf, "<%s>\n", tag);
+}
+
+void
+xml_text_append_close (GString* buf, int level, const char* tag)
+{
+    xml_text_append_indent (buf, level);
+    g_string_append_printf (buf, "</%s>\n", tag);
+}
+
+/* Escapes character data the way libxml2 does when saving without an
+ * encoding. */
+static void
+xml_text_append_escaped (GString* buf, const char* str)
+{
+    while (*str)
+    {
+        size_t run = strcspn (str, "&<>\r");
+
+        g_string_append_len (buf, str, run);
+        str += run;
+        switch (*str)
+        {
+        case '&':
+            g_string_append (buf, "&amp;");
+            break;
+        case '<':
+            g_string_append (buf, "&lt;");
+            break;
+        case '>':
+            g_string_append (buf, "&gt;");
+            break;
+        case '\r':
+            g_string_append (buf, "&#13;");
+            break;
+        default:
+            return;
+        }
+        ++str;
+    }
+}
+
+/* Whether checked_char_cast would leave str alone. */
+static gboolean
+xml_text_is_clean (const char* str)
+{
+    if (!g_utf8_validate (str, -1, NULL))
+        return FALSE;
+    for (; *str; ++str)
+        if (*str > 0 && *str < 0x20 && *str != 0x09 &&
+            *str != 0x0a && *str != 0x0d)
+            return FALSE;
+    return TRUE;
+}
+
+void
+xml_text_append_element (GString* buf, int level, const char* tag,
+                         const char* str, gboolean checked)
+{
+    xml_text_append_indent (buf, level);
+    g_string_append_printf (buf, "<%s", tag);
+    if (!*str && !checked)
+    {
+        /* xmlNodeAddContent doesn't add an empty text node */
+        g_string_append (buf, "/>\n");
+        return;
+    }
+    g_string_append_c (buf, '>');
+    if (checked && !xml_text_is_clean (str))
+    {
+        gchar* copy = g_strdup (str);
+        xml_text_append_escaped (buf, (const char*)checked_char_cast (copy));
+        g_free (copy);
+    }
+    else
+        xml_text_append_escaped (buf, str);
+    g_string_append_printf (buf, "</%s>\n", tag);
+}
+
+gboolean
+xml_text_append_guid (GString* buf, int level, const char* tag,
+                      const GncGUID* gid)
+{
+    char guid_str[GUID_ENCODING_LENGTH + 1];
+
+    if (!guid_to_string_buff (gid, guid_str))
+    {
+        PERR ("guid_to_string_buff failed\n");
+        return FALSE;
+    }
+    xml_text_append_indent (buf, level);
+    g_string_append_printf (buf, "<%s type=\"guid\">%s</%s>\n",
+                            tag, guid_str, tag);
+    return TRUE;
+}
+
+gboolean
+xml_text_append_commodity_ref (GString* buf, int level, const char* tag,
+                               const gnc_commodity* c)
+{
+    g_return_val_if_fail (c, FALSE);
+
+    if (!gnc_commodity_get_namespace (c) || !gnc_commodity_get_mnemonic (c))
+        return FALSE;
+
+    xml_text_append_open (buf, level, tag);
+    xml_text_append_element (buf, level + 1, "cmdty:space",
+                             gnc_commodity_get_namespace (c), TRUE);
+    xml_text_append_element (buf, level + 1, "cmdty:id",
+                             gnc_commodity_get_mnemonic (c), TRUE);
+    xml_text_append_close (buf, level, tag);
+    return TRUE;
+}
+
+gboolean
+xml_text_append_time64 (GString* buf, int level, const char* tag,
+                        time64 time)
+{
+    g_return_val_if_fail (time != INT64_MAX, FALSE);
+    auto date_str = GncDateTime(time).format_iso8601();
+    if (date_str.empty())
+        return FALSE;
+    date_str += " +0000"; //Tack on a UTC offset to mollify GnuCash for Android
+
+    xml_text_append_open (buf, level, tag);
+    xml_text_append_element (buf, level + 1, "ts:date", date_str.c_str (),
+                             TRUE);
+    xml_text_append_close (buf, level, tag);
+    return TRUE;
+}
+
+void
+xml_text_append_numeric (GString* buf, int level, const char* tag,
+                         gnc_numeric num)
+{
+    gchar* numstr = gnc_numeric_to_string (num);
+
+    g_return_if_fail (numstr);
+    xml_text_append_element (buf, level, tag, numstr, FALSE);
+    g_free (numstr);
+}
+
+void
+xml_text_append_node (GString* buf, int level, xmlNodePtr node)
+{
+    xmlBufferPtr xmlbuf;
+
+    if (!node)
+        return;
+
+    xmlbuf = xmlBufferCreate ();
+    xmlNodeDump (xmlbuf, NULL, node, level, 1);
+    xml_text_append_indent (buf, level);
+    g_string_append_len (buf, (const char*)xmlBufferContent (xmlbuf),
+                         xmlBufferLength (xmlbuf));
+    g_string_append_c (buf, '\n');
+    xmlBufferFree (xmlbuf);
+    xmlFreeNode (node);
+}
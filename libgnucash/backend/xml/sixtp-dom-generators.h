@@ -47,4 +47,28 @@ xmlNodePtr recurrence_to_dom_tree (const gchar* tag, const Recurrence* r);
 
 gchar* double_to_string (double value);
 
+/* Text emitters.  Each appends to buf exactly what xmlElemDump prints for
+ * the node the matching *_to_dom_tree generator builds, indented as a
+ * child at the given level and followed by a newline, without building
+ * the node.  The ones that can fail append nothing and return FALSE when
+ * the generator would have returned NULL.
+ *
+ * xml_text_append_element with checked stands for xmlNewTextChild on
+ * checked_char_cast text, otherwise for text_to_dom_tree. */
+void xml_text_append_open (GString* buf, int level, const char* tag);
+void xml_text_append_close (GString* buf, int level, const char* tag);
+void xml_text_append_element (GString* buf, int level, const char* tag,
+                              const char* str, gboolean checked);
+gboolean xml_text_append_guid (GString* buf, int level, const char* tag,
+                               const GncGUID* gid);
+gboolean xml_text_append_commodity_ref (GString* buf, int level,
+                                        const char* tag,
+                                        const gnc_commodity* c);
+gboolean xml_text_append_time64 (GString* buf, int level, const char* tag,
+                                 time64 time);
+void xml_text_append_numeric (GString* buf, int level, const char* tag,
+                              gnc_numeric num);
+/* Appends node, e.g. from qof_instance_slots_to_dom_tree, and frees it. */
+void xml_text_append_node (GString* buf, int level, xmlNodePtr node);
+
 #endif /* _SIXTP_DOM_GENERATORS_H_ */
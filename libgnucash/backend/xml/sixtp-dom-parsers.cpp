@@ -35,6 +35,17 @@
 
 static QofLogModule log_module = GNC_MOD_IO;
 
+/* The text of a node list that is a single text node, as the v2 writer
+ * produces for the content of leaf elements and attributes, without
+ * copying it; NULL if the list is anything else. */
+static const char*
+dom_tree_single_text (xmlNodePtr list)
+{
+    if (list && !list->next && list->type == XML_TEXT_NODE && list->content)
+        return (const char*)list->content;
+    return NULL;
+}
+
 GncGUID*
 dom_tree_to_guid (xmlNodePtr node)
 {
@@ -52,20 +63,29 @@ dom_tree_to_guid (xmlNodePtr node)
     }
 
     {
-        char* type;
+        xmlNodePtr value = node->properties->xmlAttrPropertyValue;
+        const char* type = dom_tree_single_text (value);
+        char* type_copy = NULL;
 
-        type = (char*)xmlNodeGetContent (node->properties->xmlAttrPropertyValue);
+        if (!type)
+            type = type_copy = (char*)xmlNodeGetContent (value);
 
         /* handle new and guid the same for the moment */
         if ((g_strcmp0 ("guid", type) == 0) || (g_strcmp0 ("new", type) == 0))
         {
             auto gid = guid_new ();
-            char* guid_str;
+            xmlNodePtr text = node->xmlChildrenNode;
 
-            guid_str = (char*)xmlNodeGetContent (node->xmlChildrenNode);
-            string_to_guid (guid_str, gid);
-            xmlFree (guid_str);
-            xmlFree (type);
+            if (text && text->type == XML_TEXT_NODE && text->content)
+                xml_string_to_guid ((const char*)text->content, gid);
+            else
+            {
+                char* guid_str = (char*)xmlNodeGetContent (text);
+                xml_string_to_guid (guid_str, gid);
+                xmlFree (guid_str);
+            }
+            if (type_copy)
+                xmlFree (type_copy);
             return gid;
         }
         else
@@ -74,7 +94,8 @@ dom_tree_to_guid (xmlNodePtr node)
                   type ? type : "(null)",
                   node->properties->name ?
                   (char*) node->properties->name : "(null)");
-            xmlFree (type);
+            if (type_copy)
+                xmlFree (type_copy);
             return NULL;
         }
     }
@@ -505,15 +526,23 @@ dom_tree_to_text (xmlNodePtr tree)
 gnc_numeric
 dom_tree_to_gnc_numeric (xmlNodePtr node)
 {
-    gchar* content = dom_tree_to_text (node);
-    if (!content)
-        return gnc_numeric_zero ();
+    gnc_numeric num;
+    const char* text = dom_tree_single_text (node->xmlChildrenNode);
+
+    if (text)
+        num = xml_string_to_gnc_numeric (text);
+    else
+    {
+        gchar* content = dom_tree_to_text (node);
+        if (!content)
+            return gnc_numeric_zero ();
+
+        num = xml_string_to_gnc_numeric (content);
+        g_free (content);
+    }
 
-    gnc_numeric num = gnc_numeric_from_string (content);
     if (gnc_numeric_check (num))
         num = gnc_numeric_zero ();
-
-    g_free (content);
     return num;
 }
 
@@ -552,14 +581,22 @@ dom_tree_to_time64 (xmlNodePtr node)
                 }
                 else
                 {
-                    gchar* content = dom_tree_to_text (n);
-                    if (!content)
+                    const char* text = dom_tree_single_text (n->xmlChildrenNode);
+                    if (text)
                     {
-                        return INT64_MAX;
+                        ret = xml_string_to_time64 (text);
                     }
+                    else
+                    {
+                        gchar* content = dom_tree_to_text (n);
+                        if (!content)
+                        {
+                            return INT64_MAX;
+                        }
 
-                    ret = gnc_iso8601_to_time64_gmt (content);
-                    g_free (content);
+                        ret = xml_string_to_time64 (content);
+                        g_free (content);
+                    }
                     seen = TRUE;
                 }
             }
@@ -285,6 +285,146 @@ hex_string_to_binary (const gchar* str,  void** v, guint64* data_len)
     return (TRUE);
 }
 
+/***************************************************************************/
+/* Decoders for the guid, numeric and date formats that the v2 writer
+   emits: 32 hex digits, num/denom and "YYYY-MM-DD HH:MM:SS +HHMM".
+   They don't allocate or run regular expressions, and they hand
+   anything else to the general parsers so that they return the same
+   values for any input.
+ */
+
+gboolean
+xml_string_to_guid (const gchar* str, GncGUID* guid)
+{
+    guchar bytes[GUID_DATA_SIZE];
+
+    if (!str || !guid)
+        return string_to_guid (str, guid);
+
+    for (int i = 0; i < GUID_DATA_SIZE; i++)
+    {
+        int high = g_ascii_xdigit_value (str[2 * i]);
+        int low = high < 0 ? -1 : g_ascii_xdigit_value (str[2 * i + 1]);
+
+        if (low < 0)
+            return string_to_guid (str, guid);
+        bytes[i] = (high << 4) | low;
+    }
+    if (str[2 * GUID_DATA_SIZE] != '\0')
+        return string_to_guid (str, guid);
+
+    memcpy (guid->reserved, bytes, GUID_DATA_SIZE);
+    return TRUE;
+}
+
+/* Reads up to 18 digits, which can't overflow a gint64. */
+static gboolean
+scan_decimal (const gchar** cursor, gint64* value)
+{
+    const gchar* start = *cursor;
+
+    *value = 0;
+    while (g_ascii_isdigit (**cursor))
+    {
+        if (*cursor - start == 18)
+            return FALSE;
+        *value = *value * 10 + (**cursor - '0');
+        (*cursor)++;
+    }
+    return *cursor != start;
+}
+
+gnc_numeric
+xml_string_to_gnc_numeric (const gchar* str)
+{
+    const gchar* cursor = str;
+    gboolean negative;
+    gint64 num, denom;
+
+    if (!str)
+        return gnc_numeric_from_string (str);
+
+    negative = (*cursor == '-');
+    if (negative)
+        cursor++;
+    if (!scan_decimal (&cursor, &num) || *cursor != '/')
+        return gnc_numeric_from_string (str);
+    cursor++;
+    if (!scan_decimal (&cursor, &denom) || *cursor != '\0' || denom == 0)
+        return gnc_numeric_from_string (str);
+
+    return gnc_numeric_create (negative ? -num : num, denom);
+}
+
+/* Reads exactly width digits. */
+static gboolean
+scan_fixed (const gchar* str, int width, int* value)
+{
+    *value = 0;
+    for (int i = 0; i < width; i++)
+    {
+        if (!g_ascii_isdigit (str[i]))
+            return FALSE;
+        *value = *value * 10 + (str[i] - '0');
+    }
+    return TRUE;
+}
+
+/* Days from 1970-01-01 to a proleptic Gregorian date in year 1400 or
+   later, counted in 400-year eras that start on March 1st. */
+static gint64
+days_from_civil (int year, int month, int day)
+{
+    if (month <= 2)
+        year--;
+    int era = year / 400;
+    int year_of_era = year - era * 400;
+    int day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5
+                      + day - 1;
+    int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100
+                     + day_of_year;
+    return (gint64) era * 146097 + day_of_era - 719468;
+}
+
+time64
+xml_string_to_time64 (const gchar* str)
+{
+    int year, month, day, hour, minute, second;
+    int tz_hour = 0, tz_minute = 0;
+    gint64 offset = 0;
+
+    if (!str ||
+        !(scan_fixed (str, 4, &year) && str[4] == '-' &&
+          scan_fixed (str + 5, 2, &month) && str[7] == '-' &&
+          scan_fixed (str + 8, 2, &day) && str[10] == ' ' &&
+          scan_fixed (str + 11, 2, &hour) && str[13] == ':' &&
+          scan_fixed (str + 14, 2, &minute) && str[16] == ':' &&
+          scan_fixed (str + 17, 2, &second)))
+        return gnc_iso8601_to_time64_gmt (str);
+
+    if (str[19] == ' ' && (str[20] == '+' || str[20] == '-') &&
+        scan_fixed (str + 21, 2, &tz_hour) &&
+        scan_fixed (str + 23, 2, &tz_minute) && str[25] == '\0')
+    {
+        offset = tz_hour * 3600 + tz_minute * 60;
+        if (str[20] == '-')
+            offset = -offset;
+    }
+    else if (str[19] != '\0')
+        return gnc_iso8601_to_time64_gmt (str);
+
+    /* Leave out-of-range fields to the general parser to reject, and
+     * offsets of less than an hour to its workaround for bug 767824. */
+    if (year < 1400 || month < 1 || month > 12 || day < 1 ||
+        day > g_date_get_days_in_month ((GDateMonth) month, year) ||
+        hour > 23 || minute > 59 || second > 59 ||
+        tz_hour > 23 || tz_minute > 59 || (tz_hour == 0 && tz_minute != 0))
+        return gnc_iso8601_to_time64_gmt (str);
+
+    return days_from_civil (year, month, day) * 86400
+           + hour * 3600 + minute * 60 + second - offset;
+}
+
 /***************************************************************************/
 /* simple chars only parser - just grabs all it's contained chars and
    does what you specify in the end handler - if you pass NULL as the
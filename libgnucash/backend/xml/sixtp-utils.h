@@ -67,6 +67,15 @@ gboolean string_to_gint32 (const gchar* str, gint32* v);
 
 gboolean hex_string_to_binary (const gchar* str,  void** v, guint64* data_len);
 
+/* Like string_to_guid, gnc_numeric_from_string and
+ * gnc_iso8601_to_time64_gmt, but quick for the formats the v2 writer
+ * emits. */
+gboolean xml_string_to_guid (const gchar* str, GncGUID* guid);
+
+gnc_numeric xml_string_to_gnc_numeric (const gchar* str);
+
+time64 xml_string_to_time64 (const gchar* str);
+
 gboolean generic_return_chars_end_handler (gpointer data_for_children,
                                            GSList* data_from_children,
                                            GSList* sibling_data,
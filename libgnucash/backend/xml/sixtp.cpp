@@ -810,6 +810,45 @@ sixtp_parse_buffer (sixtp* sixtp,
     return ret;
 }
 
+/* Parses bufp in place, without copying it into the parser's buffers.
+ * bufp must stay unchanged until the parse is done and, as libxml2 reads
+ * a byte beyond the end of the input, bufp[bufsz] must be NUL. */
+gboolean
+sixtp_parse_static_buffer (sixtp* sixtp,
+                           const char* bufp,
+                           int bufsz,
+                           gpointer data_for_top_level,
+                           gpointer global_data,
+                           gpointer* parse_result)
+{
+    xmlParserCtxtPtr context = xmlNewParserCtxt ();
+    xmlParserInputBufferPtr buffer;
+    xmlParserInputPtr input;
+
+    if (!context)
+        return FALSE;
+    /* The whole file is one input, so without this libxml2 gives up on
+     * books of more than about 10 MB. */
+    xmlCtxtUseOptions (context, XML_PARSE_HUGE);
+    buffer = xmlParserInputBufferCreateStatic (bufp, bufsz,
+                                               XML_CHAR_ENCODING_NONE);
+    if (!buffer)
+    {
+        xmlFreeParserCtxt (context);
+        return FALSE;
+    }
+    input = xmlNewIOInputStream (context, buffer, XML_CHAR_ENCODING_NONE);
+    if (!input)
+    {
+        xmlFreeParserInputBuffer (buffer);
+        xmlFreeParserCtxt (context);
+        return FALSE;
+    }
+    inputPush (context, input);
+    return sixtp_parse_file_common (sixtp, context, data_for_top_level,
+                                    global_data, parse_result);
+}
+
 gboolean
 sixtp_parse_push (sixtp* sixtp,
                   sixtp_push_handler push_handler,
@@ -68,6 +68,9 @@ struct sixtp_gdv2
     countCallbackFn countCallback;
     QofBePercentageFunc gui_display_fn;
     gboolean exporting;
+    /* When writing a snapshot, the sections that transactions and prices
+     * are written to instead of the XML. */
+    GByteArray* snapshot;
 };
 typedef struct _sixtp_child_result sixtp_child_result;
 
@@ -227,6 +230,10 @@ gboolean sixtp_parse_fd (sixtp* sixtp, FILE* fd,
 gboolean sixtp_parse_buffer (sixtp* sixtp, char* bufp, int bufsz,
                              gpointer data_for_top_level, gpointer global_data,
                              gpointer* parse_result);
+gboolean sixtp_parse_static_buffer (sixtp* sixtp, const char* bufp, int bufsz,
+                                    gpointer data_for_top_level,
+                                    gpointer global_data,
+                                    gpointer* parse_result);
 gboolean sixtp_parse_push (sixtp* sixtp, sixtp_push_handler push_handler,
                            gpointer push_user_data, gpointer data_for_top_level,
                            gpointer global_data, gpointer* parse_result);
@@ -34,6 +34,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include <cashobjects.h>
@@ -275,6 +276,44 @@ TEST_P(LoadSaveFiles, test_file)
 
     if (!compare_files (filename, new_uncompressed_file))
         return;
+
+#ifdef HAVE_ZSTD
+    /* Verify that a file saved with zstd reads back to the original content. */
+    auto new_zstd_file = filename + "-test-zstd~";
+    auto new_from_zstd_file = filename + "-test-from-zstd~";
+
+    for (auto [from, to, compress] : {std::make_tuple (filename, new_zstd_file, TRUE),
+                                      std::make_tuple (new_zstd_file, new_from_zstd_file, FALSE)})
+    {
+        auto load_session = std::shared_ptr<QofSession>{qof_session_new (qof_book_new ()), qof_session_destroy};
+
+        QOF_SESSION_CHECKED_CALL(qof_session_begin, load_session, from.c_str (), SESSION_READ_ONLY);
+        QOF_SESSION_CHECKED_CALL(qof_session_load, load_session, nullptr);
+
+        auto save_session = std::shared_ptr<QofSession>{qof_session_new (nullptr), qof_session_destroy};
+
+        g_unlink (to.c_str ());
+        g_unlink ((to + ".LCK").c_str ());
+        QOF_SESSION_CHECKED_CALL(qof_session_begin, save_session, to.c_str (), SESSION_NEW_OVERWRITE);
+
+        qof_event_suspend ();
+        qof_session_swap_data (load_session.get (), save_session.get ());
+        qof_book_mark_session_dirty (qof_session_get_book (save_session.get ()));
+        qof_event_resume ();
+
+        qof_session_end (load_session.get ());
+
+        gnc_prefs_set_file_save_compressed (compress);
+        gnc_prefs_set_file_compression_zstd (compress);
+        QOF_SESSION_CHECKED_CALL(qof_session_save, save_session, nullptr);
+
+        qof_session_end (save_session.get ());
+    }
+    gnc_prefs_set_file_compression_zstd (FALSE);
+
+    if (!compare_files (filename, new_from_zstd_file))
+        return;
+#endif
 }
 
 std::vector<std::string> ListTestCases ();
@@ -0,0 +1,115 @@
+/********************************************************************\
+ * gtest-xml-helpers.hpp -- common setup of the XML backend gtests   *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+#ifndef __GTEST_XML_HELPERS_HPP__
+#define __GTEST_XML_HELPERS_HPP__
+
+#include <glib.h>
+
+#include <memory>
+#include <string>
+
+#include <cashobjects.h>
+#include <TransLog.h>
+#include <Transaction.h>
+#include <gncInvoice.h>
+#include <gnc-engine.h>
+
+#include <gtest/gtest.h>
+
+#define GNC_LIB_NAME "gncmod-backend-xml"
+#define GNC_LIB_REL_PATH "xml"
+
+#define QOF_SESSION_CHECKED_CALL(_function, _session, ...) \
+    do { \
+        _function (_session.get (), ## __VA_ARGS__); \
+        ASSERT_EQ (qof_session_get_error (_session.get ()), 0) << #_function \
+            << " (" << #_session << ".get (), " << #__VA_ARGS__ << "): " << qof_session_get_error (_session.get ()) \
+            << " \"" << qof_session_get_error_message (_session.get ()) << "\""; \
+    } while (0)
+
+using SessionPtr = std::shared_ptr<QofSession>;
+
+/* Returns the contents of filename, or an empty string if it can't be
+ * read. */
+inline std::string
+read_file (const std::string& filename)
+{
+    gchar* contents = nullptr;
+    gsize length = 0;
+
+    if (!g_file_get_contents (filename.c_str (), &contents, &length, nullptr))
+        return {};
+    std::string data (contents, length);
+    g_free (contents);
+    return data;
+}
+
+/* Reads one of the files in GNC_TEST_FILES. */
+inline std::string
+read_test_file (const char* name)
+{
+    const char* location = g_getenv ("GNC_TEST_FILES");
+    std::shared_ptr<gchar> path{g_build_filename (location ? location : "test-files/load-save",
+                                                  name, (gchar*)nullptr), g_free};
+    return read_file (path.get ());
+}
+
+/* qof_collection_foreach callback that picks the first transaction which
+ * can be edited freely: neither read only nor posted from an invoice. */
+inline void
+pick_transaction (QofInstance* inst, gpointer data)
+{
+    auto trans = GNC_TRANSACTION (inst);
+    auto picked = static_cast<Transaction**> (data);
+
+    if (*picked || xaccTransGetReadOnly (trans)
+        || gncInvoiceGetInvoiceFromTxn (trans))
+        return;
+    *picked = trans;
+}
+
+/* Loads the XML backend once for the test suite. */
+class XmlBackendTest : public testing::Test
+{
+public:
+    static void SetUpTestSuite ()
+    {
+        g_setenv ("GNC_UNINSTALLED", "1", TRUE);
+        qof_init ();
+        cashobjects_register ();
+        ASSERT_TRUE(qof_load_backend_library (GNC_LIB_REL_PATH, GNC_LIB_NAME)) << "loading gnc-backend-xml GModule failed";
+        xaccLogDisable ();
+    }
+
+    static void TearDownTestSuite ()
+    {
+        qof_close ();
+    }
+
+protected:
+    static SessionPtr new_session ()
+    {
+        return SessionPtr{qof_session_new (qof_book_new ()), qof_session_destroy};
+    }
+};
+
+#endif /* __GTEST_XML_HELPERS_HPP__ */
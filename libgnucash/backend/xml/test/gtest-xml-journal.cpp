@@ -0,0 +1,210 @@
+/********************************************************************\
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <config.h>
+
+#include <string>
+
+#include <Transaction.h>
+#include <gnc-prefs.h>
+
+#include "gtest-xml-helpers.hpp"
+
+class XmlJournal : public XmlBackendTest
+{
+protected:
+    void SetUp () override
+    {
+        m_original = read_test_file ("sample1.gnucash");
+        ASSERT_FALSE (m_original.empty ());
+        m_filename = "test-xml-journal.gnucash~";
+        TearDown ();
+        ASSERT_TRUE (g_file_set_contents (m_filename.c_str (), m_original.data (),
+                                          m_original.size (), nullptr));
+        gnc_prefs_set_file_save_compressed (FALSE);
+        gnc_prefs_set_file_save_journal (TRUE);
+    }
+
+    void TearDown () override
+    {
+        g_unlink (m_filename.c_str ());
+        g_unlink ((m_filename + ".LCK").c_str ());
+        g_unlink ((m_filename + ".journal").c_str ());
+        gnc_prefs_set_file_save_journal (FALSE);
+    }
+
+    std::string m_original;
+    std::string m_filename;
+};
+
+static void
+set_description (Transaction* trans, const char* description)
+{
+    xaccTransBeginEdit (trans);
+    xaccTransSetDescription (trans, description);
+    xaccTransCommitEdit (trans);
+}
+
+TEST_F(XmlJournal, save_and_replay)
+{
+    GncGUID changed_guid;
+    auto journal = m_filename + ".journal";
+
+    {
+        auto session = new_session ();
+        QOF_SESSION_CHECKED_CALL(qof_session_begin, session, m_filename.c_str (), SESSION_NORMAL_OPEN);
+        QOF_SESSION_CHECKED_CALL(qof_session_load, session, nullptr);
+        auto book = qof_session_get_book (session.get ());
+
+        Transaction* trans = nullptr;
+        qof_collection_foreach (qof_book_get_collection (book, GNC_ID_TRANS),
+                                pick_transaction, &trans);
+        ASSERT_NE (trans, nullptr);
+        changed_guid = *xaccTransGetGUID (trans);
+
+        set_description (trans, "Journaled");
+        QOF_SESSION_CHECKED_CALL(qof_session_save, session, nullptr);
+
+        /* Only the journal was written. */
+        EXPECT_EQ (read_file (m_filename), m_original);
+        EXPECT_TRUE (g_file_test (journal.c_str (), G_FILE_TEST_EXISTS));
+
+        /* An unsaved change keeps the journal from being folded in on close. */
+        set_description (trans, "Not saved");
+        qof_session_end (session.get ());
+        EXPECT_EQ (read_file (m_filename), m_original);
+    }
+
+    {
+        auto session = new_session ();
+        QOF_SESSION_CHECKED_CALL(qof_session_begin, session, m_filename.c_str (), SESSION_NORMAL_OPEN);
+        QOF_SESSION_CHECKED_CALL(qof_session_load, session, nullptr);
+        auto book = qof_session_get_book (session.get ());
+
+        auto trans = xaccTransLookup (&changed_guid, book);
+        ASSERT_NE (trans, nullptr);
+        EXPECT_STREQ (xaccTransGetDescription (trans), "Journaled");
+        EXPECT_FALSE (qof_book_session_not_saved (book));
+
+        /* Closing folds the journal into the data file. */
+        qof_session_end (session.get ());
+        EXPECT_NE (read_file (m_filename), m_original);
+        EXPECT_FALSE (g_file_test (journal.c_str (), G_FILE_TEST_EXISTS));
+    }
+
+    {
+        auto session = new_session ();
+        QOF_SESSION_CHECKED_CALL(qof_session_begin, session, m_filename.c_str (), SESSION_READ_ONLY);
+        QOF_SESSION_CHECKED_CALL(qof_session_load, session, nullptr);
+        auto trans = xaccTransLookup (&changed_guid, qof_session_get_book (session.get ()));
+        ASSERT_NE (trans, nullptr);
+        EXPECT_STREQ (xaccTransGetDescription (trans), "Journaled");
+    }
+}
+
+TEST_F(XmlJournal, partial_record_is_dropped)
+{
+    GncGUID changed_guid;
+    auto journal = m_filename + ".journal";
+
+    {
+        auto session = new_session ();
+        QOF_SESSION_CHECKED_CALL(qof_session_begin, session, m_filename.c_str (), SESSION_NORMAL_OPEN);
+        QOF_SESSION_CHECKED_CALL(qof_session_load, session, nullptr);
+        auto book = qof_session_get_book (session.get ());
+
+        Transaction* trans = nullptr;
+        qof_collection_foreach (qof_book_get_collection (book, GNC_ID_TRANS),
+                                pick_transaction, &trans);
+        ASSERT_NE (trans, nullptr);
+        changed_guid = *xaccTransGetGUID (trans);
+
+        set_description (trans, "First");
+        QOF_SESSION_CHECKED_CALL(qof_session_save, session, nullptr);
+        set_description (trans, "Second");
+        QOF_SESSION_CHECKED_CALL(qof_session_save, session, nullptr);
+
+        /* Cut the last record short, as a crash while saving would. */
+        auto contents = read_file (journal);
+        ASSERT_TRUE (g_file_set_contents (journal.c_str (), contents.data (),
+                                          contents.size () - 10, nullptr));
+        set_description (trans, "Not saved");
+        qof_session_end (session.get ());
+    }
+
+    {
+        auto session = new_session ();
+        QOF_SESSION_CHECKED_CALL(qof_session_begin, session, m_filename.c_str (), SESSION_READ_ONLY);
+        QOF_SESSION_CHECKED_CALL(qof_session_load, session, nullptr);
+        auto trans = xaccTransLookup (&changed_guid, qof_session_get_book (session.get ()));
+        ASSERT_NE (trans, nullptr);
+        EXPECT_STREQ (xaccTransGetDescription (trans), "First");
+    }
+}
+
+TEST_F(XmlJournal, undecodable_record_keeps_transaction)
+{
+    GncGUID changed_guid;
+    std::string description;
+    int n_splits = 0;
+    auto journal = m_filename + ".journal";
+
+    {
+        auto session = new_session ();
+        QOF_SESSION_CHECKED_CALL(qof_session_begin, session, m_filename.c_str (), SESSION_NORMAL_OPEN);
+        QOF_SESSION_CHECKED_CALL(qof_session_load, session, nullptr);
+        auto book = qof_session_get_book (session.get ());
+
+        Transaction* trans = nullptr;
+        qof_collection_foreach (qof_book_get_collection (book, GNC_ID_TRANS),
+                                pick_transaction, &trans);
+        ASSERT_NE (trans, nullptr);
+        changed_guid = *xaccTransGetGUID (trans);
+        description = xaccTransGetDescription (trans);
+        n_splits = xaccTransCountSplits (trans);
+
+        set_description (trans, "Journaled");
+        QOF_SESSION_CHECKED_CALL(qof_session_save, session, nullptr);
+
+        /* Still well-formed XML, and the same length, but not a
+         * transaction that can be decoded. */
+        auto contents = read_file (journal);
+        std::string from{"split:value"}, to{"split:bogus"};
+        for (auto pos = contents.find (from); pos != std::string::npos;
+             pos = contents.find (from, pos))
+            contents.replace (pos, from.size (), to);
+        ASSERT_TRUE (g_file_set_contents (journal.c_str (), contents.data (),
+                                          contents.size (), nullptr));
+        set_description (trans, "Not saved");
+        qof_session_end (session.get ());
+    }
+
+    {
+        auto session = new_session ();
+        QOF_SESSION_CHECKED_CALL(qof_session_begin, session, m_filename.c_str (), SESSION_READ_ONLY);
+        QOF_SESSION_CHECKED_CALL(qof_session_load, session, nullptr);
+        auto trans = xaccTransLookup (&changed_guid, qof_session_get_book (session.get ()));
+        ASSERT_NE (trans, nullptr);
+        EXPECT_EQ (xaccTransGetDescription (trans), description);
+        EXPECT_EQ (xaccTransCountSplits (trans), n_splits);
+    }
+}
@@ -0,0 +1,175 @@
+/********************************************************************\
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <config.h>
+#include <zlib.h>
+
+#include <string>
+
+#include <Account.h>
+#include <Transaction.h>
+#include <gnc-commodity.h>
+#include <gnc-prefs.h>
+
+#include "../io-gncxml-v2.h"
+#include "gtest-xml-helpers.hpp"
+
+static std::string
+read_gz_file (const std::string& filename)
+{
+    std::string data;
+    auto file = gzopen (filename.c_str (), "rb");
+    if (!file)
+        return {};
+
+    char buf[8192];
+    int bytes;
+    while ((bytes = gzread (file, buf, sizeof buf)) > 0)
+        data.append (buf, bytes);
+    if (bytes < 0)
+        data.clear ();
+    gzclose (file);
+    return data;
+}
+
+static Account*
+make_account (QofBook* book, const char* name, gnc_commodity* currency)
+{
+    auto account = xaccMallocAccount (book);
+    xaccAccountBeginEdit (account);
+    xaccAccountSetName (account, name);
+    xaccAccountSetType (account, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (account, currency);
+    gnc_account_append_child (gnc_book_get_root_account (book), account);
+    xaccAccountCommitEdit (account);
+    return account;
+}
+
+static void
+add_transactions (QofBook* book, int count)
+{
+    auto table = gnc_commodity_table_get_table (book);
+    auto usd = gnc_commodity_table_lookup (table, GNC_COMMODITY_NS_CURRENCY, "USD");
+    auto from = make_account (book, "Round Trip From", usd);
+    auto to = make_account (book, "Round Trip To", usd);
+    auto posted = gnc_time (nullptr);
+
+    for (int i = 0; i < count; ++i)
+    {
+        auto trans = xaccMallocTransaction (book);
+        auto description = "Round trip " + std::to_string (i);
+        auto value = gnc_numeric_create (i + 1, 100);
+
+        xaccTransBeginEdit (trans);
+        xaccTransSetCurrency (trans, usd);
+        xaccTransSetDatePostedSecsNormalized (trans, posted - i * 86400);
+        xaccTransSetDescription (trans, description.c_str ());
+        for (auto account : {from, to})
+        {
+            auto split = xaccMallocSplit (book);
+            xaccSplitSetParent (split, trans);
+            xaccSplitSetAccount (split, account);
+            xaccSplitSetAmount (split, value);
+            xaccSplitSetValue (split, value);
+            value = gnc_numeric_neg (value);
+        }
+        xaccTransCommitEdit (trans);
+    }
+}
+
+class XmlLargeFiles : public XmlBackendTest
+{
+protected:
+    void SetUp () override
+    {
+        m_sample = read_test_file ("sample1.gnucash");
+        ASSERT_FALSE (m_sample.empty ());
+        m_filename = "test-xml-large-files.gnucash~";
+        TearDown ();
+    }
+
+    void TearDown () override
+    {
+        g_unlink (m_filename.c_str ());
+        g_unlink ((m_filename + ".LCK").c_str ());
+    }
+
+    std::string m_sample;
+    std::string m_filename;
+};
+
+/* libxml2 refuses inputs of more than 10 MB unless it's told to expect
+ * them, and an uncompressed book is parsed as one input. */
+TEST_F(XmlLargeFiles, load_huge_uncompressed_file)
+{
+    const std::string end_tag{"</gnc-v2>"};
+    const std::string padding{"<!-- " + std::string (1000, '.') + " -->\n"};
+    auto contents = m_sample;
+    auto pos = contents.rfind (end_tag);
+    ASSERT_NE (pos, std::string::npos);
+
+    std::string comments;
+    while (comments.size () < 12 * 1024 * 1024)
+        comments += padding;
+    contents.insert (pos, comments);
+    /* The file is only mapped if it doesn't end on a page boundary. */
+    if (contents.size () % 65536 == 0)
+        contents += "\n";
+    ASSERT_TRUE (g_file_set_contents (m_filename.c_str (), contents.data (),
+                                      contents.size (), nullptr));
+
+    auto session = new_session ();
+    QOF_SESSION_CHECKED_CALL(qof_session_begin, session, m_filename.c_str (), SESSION_READ_ONLY);
+    QOF_SESSION_CHECKED_CALL(qof_session_load, session, nullptr);
+    auto book = qof_session_get_book (session.get ());
+    EXPECT_NE (gnc_book_count_transactions (book), 0u);
+}
+
+/* The compressed writer deflates 128K blocks on separate threads and
+ * joins them, so the book has to span several blocks for the dictionary
+ * priming, the sync flush joins and the combined checksum to be used. */
+TEST_F(XmlLargeFiles, gzip_round_trip_across_blocks)
+{
+    const auto plain{m_filename + ".xml"};
+    const auto compressed{m_filename + ".gz"};
+    ASSERT_TRUE (g_file_set_contents (m_filename.c_str (), m_sample.data (),
+                                      m_sample.size (), nullptr));
+
+    auto session = new_session ();
+    QOF_SESSION_CHECKED_CALL(qof_session_begin, session, m_filename.c_str (), SESSION_READ_ONLY);
+    QOF_SESSION_CHECKED_CALL(qof_session_load, session, nullptr);
+    auto book = qof_session_get_book (session.get ());
+    add_transactions (book, 1000);
+
+    gnc_prefs_set_file_compression_zstd (FALSE);
+    EXPECT_TRUE (gnc_book_write_to_xml_file_v2 (book, plain.c_str (), FALSE));
+    EXPECT_TRUE (gnc_book_write_to_xml_file_v2 (book, compressed.c_str (), TRUE));
+
+    auto expected = read_file (plain);
+    auto actual = read_gz_file (compressed);
+    g_unlink (plain.c_str ());
+    g_unlink (compressed.c_str ());
+
+    ASSERT_GT (expected.size (), 3 * 128 * 1024u);
+    EXPECT_EQ (actual.size (), expected.size ());
+    EXPECT_TRUE (actual == expected);
+}
@@ -0,0 +1,275 @@
+/********************************************************************\
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <config.h>
+
+#include <string>
+
+#include <Transaction.h>
+#include <gnc-pricedb.h>
+#include <gnc-prefs.h>
+#include <qofinstance-p.h>
+#include <kvp-frame.hpp>
+
+#include "gtest-xml-helpers.hpp"
+
+struct CompareData
+{
+    QofBook* other;
+    int count;
+    int mismatches;
+};
+
+/* xaccTransEqual would compare the commodities' guids, which differ
+ * between books. */
+static bool
+same_commodity (gnc_commodity* a, gnc_commodity* b)
+{
+    return g_strcmp0 (gnc_commodity_get_unique_name (a),
+                      gnc_commodity_get_unique_name (b)) == 0;
+}
+
+static bool
+same_instance (QofInstance* a, QofInstance* b)
+{
+    if (!a || !b)
+        return a == b;
+    return guid_equal (qof_instance_get_guid (a), qof_instance_get_guid (b));
+}
+
+static bool
+same_slots (QofInstance* a, QofInstance* b)
+{
+    return compare (qof_instance_get_slots (a), qof_instance_get_slots (b)) == 0;
+}
+
+static bool
+same_split (Split* a, Split* b)
+{
+    return guid_equal (xaccSplitGetGUID (a), xaccSplitGetGUID (b))
+           && g_strcmp0 (xaccSplitGetMemo (a), xaccSplitGetMemo (b)) == 0
+           && g_strcmp0 (xaccSplitGetAction (a), xaccSplitGetAction (b)) == 0
+           && xaccSplitGetReconcile (a) == xaccSplitGetReconcile (b)
+           && xaccSplitGetDateReconciled (a) == xaccSplitGetDateReconciled (b)
+           && gnc_numeric_equal (xaccSplitGetValue (a), xaccSplitGetValue (b))
+           && gnc_numeric_equal (xaccSplitGetAmount (a), xaccSplitGetAmount (b))
+           && same_instance (QOF_INSTANCE (xaccSplitGetAccount (a)),
+                             QOF_INSTANCE (xaccSplitGetAccount (b)))
+           && same_instance (QOF_INSTANCE (xaccSplitGetLot (a)),
+                             QOF_INSTANCE (xaccSplitGetLot (b)))
+           && same_slots (QOF_INSTANCE (a), QOF_INSTANCE (b));
+}
+
+static bool
+same_transaction (Transaction* a, Transaction* b)
+{
+    if (g_strcmp0 (xaccTransGetDescription (a), xaccTransGetDescription (b)) != 0
+        || g_strcmp0 (xaccTransGetNum (a), xaccTransGetNum (b)) != 0
+        || xaccTransRetDatePosted (a) != xaccTransRetDatePosted (b)
+        || xaccTransRetDateEntered (a) != xaccTransRetDateEntered (b)
+        || !same_commodity (xaccTransGetCurrency (a), xaccTransGetCurrency (b))
+        || !same_slots (QOF_INSTANCE (a), QOF_INSTANCE (b))
+        || xaccTransCountSplits (a) != xaccTransCountSplits (b))
+        return false;
+    for (auto na = xaccTransGetSplitList (a), nb = xaccTransGetSplitList (b);
+         na && nb; na = na->next, nb = nb->next)
+        if (!same_split (static_cast<Split*> (na->data),
+                         static_cast<Split*> (nb->data)))
+            return false;
+    return true;
+}
+
+static void
+compare_transaction (QofInstance* inst, gpointer data)
+{
+    auto cmp = static_cast<CompareData*> (data);
+    auto trans = GNC_TRANSACTION (inst);
+    auto other = xaccTransLookup (xaccTransGetGUID (trans), cmp->other);
+
+    ++cmp->count;
+    if (!other || !same_transaction (trans, other))
+        ++cmp->mismatches;
+}
+
+static gboolean
+compare_price (GNCPrice* price, gpointer data)
+{
+    auto cmp = static_cast<CompareData*> (data);
+    auto other = gnc_price_lookup (gnc_price_get_guid (price), cmp->other);
+
+    ++cmp->count;
+    if (!other
+        || gnc_price_get_time64 (price) != gnc_price_get_time64 (other)
+        || !gnc_numeric_equal (gnc_price_get_value (price),
+                               gnc_price_get_value (other))
+        || g_strcmp0 (gnc_price_get_typestr (price),
+                      gnc_price_get_typestr (other)) != 0
+        || g_strcmp0 (gnc_price_get_source_string (price),
+                      gnc_price_get_source_string (other)) != 0
+        || !same_commodity (gnc_price_get_commodity (price),
+                            gnc_price_get_commodity (other))
+        || !same_commodity (gnc_price_get_currency (price),
+                            gnc_price_get_currency (other)))
+        ++cmp->mismatches;
+    return TRUE;
+}
+
+class XmlSnapshot : public XmlBackendTest
+{
+protected:
+    void SetUp () override
+    {
+        auto original = read_test_file ("sample1.gnucash");
+        ASSERT_FALSE (original.empty ());
+        m_filename = "test-xml-snapshot.gnucash~";
+        m_snapshot = m_filename + ".snapshot";
+        TearDown ();
+        ASSERT_TRUE (g_file_set_contents (m_filename.c_str (), original.data (),
+                                          original.size (), nullptr));
+        gnc_prefs_set_file_save_compressed (FALSE);
+        gnc_prefs_set_file_save_snapshot (TRUE);
+    }
+
+    void TearDown () override
+    {
+        g_unlink (m_filename.c_str ());
+        g_unlink ((m_filename + ".LCK").c_str ());
+        g_unlink (m_snapshot.c_str ());
+        gnc_prefs_set_file_save_snapshot (FALSE);
+    }
+
+    SessionPtr open_session (SessionOpenMode mode)
+    {
+        auto session = new_session ();
+        qof_session_begin (session.get (), m_filename.c_str (), mode);
+        if (qof_session_get_error (session.get ()) == 0)
+            qof_session_load (session.get (), nullptr);
+        return session;
+    }
+
+    /* Opens the file read only, with or without the snapshot, and
+     * expects the same book as in session. */
+    void expect_same_book (const SessionPtr& session, bool use_snapshot)
+    {
+        auto book = qof_session_get_book (session.get ());
+
+        gnc_prefs_set_file_save_snapshot (use_snapshot);
+        auto reopened = open_session (SESSION_READ_ONLY);
+        gnc_prefs_set_file_save_snapshot (TRUE);
+        ASSERT_EQ (qof_session_get_error (reopened.get ()), 0);
+
+        auto other = qof_session_get_book (reopened.get ());
+        CompareData trans_cmp{other, 0, 0};
+        qof_collection_foreach (qof_book_get_collection (book, GNC_ID_TRANS),
+                                compare_transaction, &trans_cmp);
+        EXPECT_GT (trans_cmp.count, 0);
+        EXPECT_EQ (trans_cmp.mismatches, 0);
+        EXPECT_EQ (gnc_book_count_transactions (other),
+                   gnc_book_count_transactions (book));
+
+        CompareData price_cmp{other, 0, 0};
+        gnc_pricedb_foreach_price (gnc_pricedb_get_db (book), compare_price,
+                                   &price_cmp, FALSE);
+        EXPECT_EQ (price_cmp.mismatches, 0);
+        EXPECT_EQ (gnc_pricedb_get_num_prices (gnc_pricedb_get_db (other)),
+                   gnc_pricedb_get_num_prices (gnc_pricedb_get_db (book)));
+
+        EXPECT_EQ (gnc_account_n_descendants (gnc_book_get_root_account (other)),
+                   gnc_account_n_descendants (gnc_book_get_root_account (book)));
+    }
+
+    std::string m_filename;
+    std::string m_snapshot;
+};
+
+TEST_F(XmlSnapshot, load_and_save)
+{
+    auto session = open_session (SESSION_NORMAL_OPEN);
+    ASSERT_EQ (qof_session_get_error (session.get ()), 0);
+
+    /* Loading the XML wrote the snapshot. */
+    ASSERT_TRUE (g_file_test (m_snapshot.c_str (), G_FILE_TEST_EXISTS));
+    expect_same_book (session, true);
+
+    /* Saving removes it and ending the session writes it again, once
+     * however often the book was saved. */
+    auto book = qof_session_get_book (session.get ());
+    Transaction* trans = nullptr;
+    qof_collection_foreach (qof_book_get_collection (book, GNC_ID_TRANS),
+                            pick_transaction, &trans);
+    ASSERT_NE (trans, nullptr);
+    auto before = read_file (m_snapshot);
+    for (auto description : {"Snapshot 1", "Snapshot"})
+    {
+        xaccTransBeginEdit (trans);
+        xaccTransSetDescription (trans, description);
+        xaccTransCommitEdit (trans);
+        QOF_SESSION_CHECKED_CALL(qof_session_save, session, nullptr);
+        EXPECT_FALSE (g_file_test (m_snapshot.c_str (), G_FILE_TEST_EXISTS));
+    }
+    qof_session_end (session.get ());
+    ASSERT_TRUE (g_file_test (m_snapshot.c_str (), G_FILE_TEST_EXISTS));
+    EXPECT_NE (read_file (m_snapshot), before);
+    expect_same_book (session, true);
+    expect_same_book (session, false);
+}
+
+TEST_F(XmlSnapshot, stale_or_damaged_snapshot_is_ignored)
+{
+    auto session = open_session (SESSION_NORMAL_OPEN);
+    ASSERT_EQ (qof_session_get_error (session.get ()), 0);
+    auto stale = read_file (m_snapshot);
+    ASSERT_FALSE (stale.empty ());
+
+    auto book = qof_session_get_book (session.get ());
+    Transaction* trans = nullptr;
+    qof_collection_foreach (qof_book_get_collection (book, GNC_ID_TRANS),
+                            pick_transaction, &trans);
+    ASSERT_NE (trans, nullptr);
+    xaccTransBeginEdit (trans);
+    xaccTransSetDescription (trans, "Snapshot");
+    xaccTransCommitEdit (trans);
+    QOF_SESSION_CHECKED_CALL(qof_session_save, session, nullptr);
+    qof_session_end (session.get ());
+    auto current = read_file (m_snapshot);
+    ASSERT_FALSE (current.empty ());
+
+    /* The snapshot of the file before the save. */
+    ASSERT_TRUE (g_file_set_contents (m_snapshot.c_str (), stale.data (),
+                                      stale.size (), nullptr));
+    expect_same_book (session, true);
+
+    /* Damage in the binary part. */
+    current[current.size () - 5] ^= 0x55;
+    ASSERT_TRUE (g_file_set_contents (m_snapshot.c_str (), current.data (),
+                                      current.size (), nullptr));
+    expect_same_book (session, true);
+
+    /* Without the preference, the snapshot isn't written again. */
+    gnc_prefs_set_file_save_snapshot (FALSE);
+    auto unsnapped = open_session (SESSION_NORMAL_OPEN);
+    ASSERT_EQ (qof_session_get_error (unsnapped.get ()), 0);
+    qof_book_mark_session_dirty (qof_session_get_book (unsnapped.get ()));
+    QOF_SESSION_CHECKED_CALL(qof_session_save, unsnapped, nullptr);
+    qof_session_end (unsnapped.get ());
+    EXPECT_FALSE (g_file_test (m_snapshot.c_str (), G_FILE_TEST_EXISTS));
+}
@@ -241,6 +241,76 @@ test_dom_tree_to_guid (void)
     }
 }
 
+/* The quick decoders must agree with the general parsers, whether they
+ * handle the input themselves or pass it on. */
+static void
+test_xml_string_decoders (void)
+{
+    const char* guids[] =
+    {
+        "0123456789abcdef0123456789ABCDEF",
+        "0123456789abcdef0123456789abcde",
+        "0123456789abcdef0123456789abcdef0",
+        "01234567-89ab-cdef-0123-456789abcdef",
+        "0123456789abcdef0123456789abcdeg",
+        "",
+        NULL
+    };
+    const char* numerics[] =
+    {
+        "123/100", "-5/1", "0/1", "-0/100", "18768786810/100000",
+        "0/0", "5", "/5", "1/-2", " 1/2", "1 / 2", "1.5",
+        "1234567890123456789/1", "999999999999999999/1",
+        "0x10/0x2", "",
+        NULL
+    };
+    const char* dates[] =
+    {
+        "1970-01-01 00:00:00 +0000", "2020-11-07 06:21:19 -0500",
+        "2000-02-29 12:34:56 +0000", "1400-01-01 00:00:00 +0000",
+        "9999-12-31 23:59:59 +0000", "2012-07-04 19:27:44 +0840",
+        "2012-07-04 19:27:44 +0030", "2012-07-04 19:27:44 -0045",
+        "1989-03-27 13:43:27", "2012-07-04 19:27:44.0+08:40",
+        "2061-01-25 23:21:19.0 -05:00", "2020-11-07 06:21:19 -05",
+        "2100-02-29 00:00:00 +0000", "1399-12-31 23:59:59 +0000",
+        "2020-13-01 00:00:00 +0000", "2020-11-07 06:21:19 +0000 ",
+        "",
+        NULL
+    };
+
+    for (int i = 0; guids[i]; i++)
+    {
+        GncGUID quick, general;
+        gboolean quick_ok, general_ok;
+
+        guid_replace (&quick);
+        general = quick;
+        quick_ok = xml_string_to_guid (guids[i], &quick);
+        general_ok = string_to_guid (guids[i], &general);
+        do_test_args (quick_ok == general_ok && guid_equal (&quick, &general),
+                      "xml_string_to_guid", __FILE__, __LINE__,
+                      "with string %s", guids[i]);
+    }
+
+    for (int i = 0; numerics[i]; i++)
+    {
+        gnc_numeric quick = xml_string_to_gnc_numeric (numerics[i]);
+        gnc_numeric general = gnc_numeric_from_string (numerics[i]);
+
+        do_test_args (quick.num == general.num && quick.denom == general.denom,
+                      "xml_string_to_gnc_numeric", __FILE__, __LINE__,
+                      "with string %s", numerics[i]);
+    }
+
+    for (int i = 0; dates[i]; i++)
+    {
+        do_test_args (xml_string_to_time64 (dates[i]) ==
+                      gnc_iso8601_to_time64_gmt (dates[i]),
+                      "xml_string_to_time64", __FILE__, __LINE__,
+                      "with string %s", dates[i]);
+    }
+}
+
 int
 main (int argc, char** argv)
 {
@@ -256,6 +326,8 @@ main (int argc, char** argv)
     fflush (stdout);
     test_dom_tree_to_gnc_numeric ();
     fflush (stdout);
+    test_xml_string_decoders ();
+    fflush (stdout);
     print_test_results ();
     qof_close ();
     exit (get_rv ());
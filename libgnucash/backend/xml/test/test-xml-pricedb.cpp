@@ -64,6 +64,12 @@ test_add_pricedb (const char* tag, gpointer globaldata, gpointer data)
     return TRUE;
 }
 
+static gboolean
+append_price_text (GNCPrice* price, gpointer data)
+{
+    return gnc_price_xml_text_append (static_cast<GString*> (data), 1, price);
+}
+
 static void
 test_db (GNCPriceDB* db)
 {
@@ -84,6 +90,26 @@ test_db (GNCPriceDB* db)
     if (!db)
         return;
 
+    {
+        /* The text emitter must write what the dom tree dumps to. */
+        xmlBufferPtr dumped = xmlBufferCreate ();
+        GString* text = g_string_new (NULL);
+
+        for (xmlNodePtr node = test_node->children; node; node = node->next)
+        {
+            xmlBufferCCat (dumped, "  ");
+            xmlNodeDump (dumped, NULL, node, 1, 1);
+            xmlBufferCCat (dumped, "\n");
+        }
+        gnc_pricedb_foreach_price (db, append_price_text, text, TRUE);
+        do_test_args (g_strcmp0 ((const char*)xmlBufferContent (dumped),
+                                 text->str) == 0,
+                      "gnc_price_xml_text_append",
+                      __FILE__, __LINE__, "%d", iter);
+        g_string_free (text, TRUE);
+        xmlBufferFree (dumped);
+    }
+
     filename1 = g_strdup_printf ("test_file_XXXXXX");
 
     fd = g_mkstemp (filename1);
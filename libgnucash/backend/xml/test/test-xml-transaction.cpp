@@ -27,12 +27,15 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <sys/types.h>
 #include <dirent.h>
 #include <sys/stat.h>
 
+#include <string>
+
 #include <gnc-engine.h>
 #include <cashobjects.h>
 #include <TransLog.h>
@@ -433,6 +436,22 @@ test_transaction (void)
             success_args ("transaction_xml", __FILE__, __LINE__, "%d", i);
         }
 
+        {
+            /* The text emitter must write what the dom tree dumps to. */
+            xmlBufferPtr dumped = xmlBufferCreate ();
+            GString* text = g_string_new (NULL);
+
+            xmlNodeDump (dumped, NULL, test_node, 0, 1);
+            xmlBufferCCat (dumped, "\n");
+            gnc_transaction_xml_text_append (text, ran_trn);
+            do_test_args (g_strcmp0 ((const char*)xmlBufferContent (dumped),
+                                     text->str) == 0,
+                          "gnc_transaction_xml_text_append",
+                          __FILE__, __LINE__, "%d", i);
+            g_string_free (text, TRUE);
+            xmlBufferFree (dumped);
+        }
+
         filename1 = g_strdup_printf ("test_file_XXXXXX");
 
         fd = g_mkstemp (filename1);
@@ -487,6 +506,78 @@ test_transaction (void)
         /* no handling of circular data structures.  We'll do that later */
         /* sixtp_destroy(parser); */
 
+        {
+            /* Same again, decoding through the load pipeline. */
+            tran_data data;
+            gxpf_data gpdata;
+            gpointer parse_result = NULL;
+
+            data.trn = ran_trn;
+            data.com = com;
+            data.value = i;
+            data.new_trn = NULL;
+            gpdata.cb = test_add_transaction;
+            gpdata.parsedata = &data;
+            gpdata.bookdata = book;
+            gpdata.trn_pipeline = gnc_xml_trn_pipeline_new (2);
+            gpdata.input = NULL;
+            gpdata.input_length = 0;
+            gpdata.snapshot = NULL;
+
+            if (!sixtp_parse_file (gnc_transaction_sixtp_parser_create (),
+                                   filename1, NULL, &gpdata, &parse_result)
+                || !gnc_xml_trn_pipeline_flush (&gpdata) || !data.new_trn)
+            {
+                failure_args ("pipelined parse returned FALSE",
+                              __FILE__, __LINE__, "%d", i);
+            }
+            else
+                really_get_rid_of_transaction (data.new_trn);
+            gnc_xml_trn_pipeline_destroy (gpdata.trn_pipeline);
+        }
+
+        {
+            /* And parsed in place, with memos and descriptions referring
+             * to the input. */
+            tran_data data;
+            gxpf_data gpdata;
+            gpointer parse_result = NULL;
+            gchar* contents = NULL;
+            gsize length = 0;
+
+            data.trn = ran_trn;
+            data.com = com;
+            data.value = i;
+            data.new_trn = NULL;
+            gpdata.cb = test_add_transaction;
+            gpdata.parsedata = &data;
+            gpdata.bookdata = book;
+            gpdata.trn_pipeline = NULL;
+            gpdata.snapshot = NULL;
+
+            if (!g_file_get_contents (filename1, &contents, &length, NULL))
+            {
+                failure_args ("g_file_get_contents returned FALSE",
+                              __FILE__, __LINE__, "%d", i);
+            }
+            else
+            {
+                gpdata.input = contents;
+                gpdata.input_length = length;
+                if (!sixtp_parse_static_buffer (gnc_transaction_sixtp_parser_create (),
+                                                contents, length, NULL,
+                                                &gpdata, &parse_result)
+                    || !data.new_trn)
+                {
+                    failure_args ("in-place parse returned FALSE",
+                                  __FILE__, __LINE__, "%d", i);
+                }
+                else
+                    really_get_rid_of_transaction (data.new_trn);
+            }
+            g_free (contents);
+        }
+
 
         g_unlink (filename1);
         g_free (filename1);
@@ -495,6 +586,194 @@ test_transaction (void)
     }
 }
 
+static gboolean
+count_transaction (const char* tag, gpointer globaldata, gpointer data)
+{
+    (*static_cast<int*> (globaldata))++;
+    really_get_rid_of_transaction (static_cast<Transaction*> (data));
+    return TRUE;
+}
+
+static void
+ignore_log (const gchar* log_domain, GLogLevelFlags log_level,
+            const gchar* message, gpointer user_data)
+{
+}
+
+/* Parses text in place, with or without the decoding pipeline, handing
+ * the transactions to cb. */
+static gboolean
+parse_transaction_text (const std::string& text, guint n_workers,
+                        gxpf_callback cb, gpointer parsedata)
+{
+    gxpf_data gpdata;
+    gpointer parse_result = NULL;
+    gboolean ok;
+
+    gpdata.cb = cb;
+    gpdata.parsedata = parsedata;
+    gpdata.bookdata = book;
+    gpdata.trn_pipeline = n_workers ? gnc_xml_trn_pipeline_new (n_workers)
+                                    : NULL;
+    gpdata.input = text.c_str ();
+    gpdata.input_length = text.size ();
+    gpdata.snapshot = NULL;
+
+    ok = sixtp_parse_static_buffer (gnc_transaction_sixtp_parser_create (),
+                                    text.c_str (), text.size (), NULL,
+                                    &gpdata, &parse_result);
+    if (gpdata.trn_pipeline)
+    {
+        ok = gnc_xml_trn_pipeline_flush (&gpdata) && ok;
+        gnc_xml_trn_pipeline_destroy (gpdata.trn_pipeline);
+    }
+    return ok;
+}
+
+/* Checks that the parse fails without delivering a transaction. */
+static void
+check_parse_fails (const std::string& text, const char* what,
+                   guint n_workers)
+{
+    int delivered = 0;
+    auto ok = parse_transaction_text (text, n_workers, count_transaction,
+                                      &delivered);
+    do_test_args (!ok && delivered == 0, "malformed split",
+                  __FILE__, __LINE__, "%s, %u workers", what, n_workers);
+}
+
+/* A split that can't be read must fail the transaction, as it did when
+ * the splits were parsed from a DOM tree, rather than be dropped and
+ * leave the transaction unbalanced. */
+static void
+test_malformed_split (void)
+{
+    const struct
+    {
+        const char* what;
+        const char* find;
+        const char* replace;
+    } cases[] =
+    {
+        { "unknown element", "<trn:split>", "<trn:split><split:bogus>1</split:bogus>" },
+        { "unknown id type", "<split:id type=\"guid\">", "<split:id type=\"bogus\">" },
+        { "missing value", "<split:value>", "" },
+    };
+    guint handler = g_log_set_handler ("gnc.backend.xml", G_LOG_LEVEL_CRITICAL,
+                                       ignore_log, NULL);
+    Transaction* ran_trn;
+    GString* text;
+
+    get_random_account_tree (book);
+    ran_trn = get_random_transaction (book);
+    if (!ran_trn || !xaccTransGetSplitList (ran_trn))
+    {
+        failure_args ("malformed split", __FILE__, __LINE__,
+                      "get_random_transaction returned no splits");
+        g_log_remove_handler ("gnc.backend.xml", handler);
+        return;
+    }
+    text = g_string_new (NULL);
+    gnc_transaction_xml_text_append (text, ran_trn);
+
+    for (auto& c : cases)
+    {
+        std::string bad{text->str};
+        auto pos = bad.find (c.find);
+        if (pos == std::string::npos)
+        {
+            failure_args ("malformed split", __FILE__, __LINE__,
+                          "%s not found", c.find);
+            continue;
+        }
+        if (*c.replace)
+            bad.replace (pos, strlen (c.find), c.replace);
+        else
+        {
+            /* Drop the whole element. */
+            const char* close = "</split:value>";
+            auto end = bad.find (close, pos) + strlen (close);
+            bad.erase (pos, end - pos);
+        }
+        check_parse_fails (bad, c.what, 0);
+        check_parse_fails (bad, c.what, 2);
+    }
+
+    g_string_free (text, TRUE);
+    really_get_rid_of_transaction (ran_trn);
+    g_log_remove_handler ("gnc.backend.xml", handler);
+}
+
+struct DateCheck
+{
+    time64 posted;
+    time64 entered;
+    int delivered;
+    int matched;
+};
+
+static gboolean
+check_dates (const char* tag, gpointer globaldata, gpointer data)
+{
+    auto check = static_cast<DateCheck*> (globaldata);
+    auto trn = static_cast<Transaction*> (data);
+
+    check->delivered++;
+    if (xaccTransGetDate (trn) == check->posted &&
+        xaccTransGetDateEntered (trn) == check->entered)
+        check->matched++;
+    really_get_rid_of_transaction (trn);
+    return TRUE;
+}
+
+/* Elements in a date other than <ts:date>, like the <ts:ns> of older
+ * files, are skipped as dom_tree_to_time64 did. */
+static void
+test_date_extra_children (void)
+{
+    Transaction* ran_trn;
+    GString* text;
+
+    get_random_account_tree (book);
+    ran_trn = get_random_transaction (book);
+    if (!ran_trn)
+    {
+        failure_args ("date extra children", __FILE__, __LINE__,
+                      "get_random_transaction returned NULL");
+        return;
+    }
+    text = g_string_new (NULL);
+    gnc_transaction_xml_text_append (text, ran_trn);
+
+    std::string with_ns{text->str};
+    for (auto date : {"<trn:date-posted>", "<trn:date-entered>"})
+    {
+        auto pos = with_ns.find (date);
+        if (pos == std::string::npos)
+        {
+            failure_args ("date extra children", __FILE__, __LINE__,
+                          "%s not found", date);
+            continue;
+        }
+        pos = with_ns.find ("</ts:date>", pos) + strlen ("</ts:date>");
+        with_ns.insert (pos, "\n  <ts:ns>123456</ts:ns><ts:extra><a/></ts:extra>");
+    }
+
+    for (guint n_workers : {0u, 2u})
+    {
+        DateCheck check{xaccTransGetDate (ran_trn),
+                        xaccTransGetDateEntered (ran_trn), 0, 0};
+        auto ok = parse_transaction_text (with_ns, n_workers, check_dates,
+                                          &check);
+        do_test_args (ok && check.delivered == 1 && check.matched == 1,
+                      "date extra children", __FILE__, __LINE__,
+                      "%u workers", n_workers);
+    }
+
+    g_string_free (text, TRUE);
+    really_get_rid_of_transaction (ran_trn);
+}
+
 static gboolean
 test_real_transaction (const char* tag, gpointer global_data, gpointer data)
 {
@@ -528,6 +807,8 @@ main (int argc, char** argv)
     else
     {
         test_transaction ();
+        test_malformed_split ();
+        test_date_extra_children ();
     }
 
     print_test_results ();
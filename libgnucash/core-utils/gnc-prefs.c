@@ -32,6 +32,12 @@ static gchar *namespace_regexp    = NULL;
 static gboolean is_debugging      = FALSE;
 static gboolean extras_enabled    = FALSE;
 static gboolean use_compression   = TRUE; // This is also the default in the prefs backend
+static gboolean use_journal       = FALSE; // This is also the default in the prefs backend
+static gint compression_level     = 6;    // This is also the default in the prefs backend
+static gboolean use_zstd          = FALSE; // This is also the default in the prefs backend
+static gboolean use_snapshot      = FALSE; // This is also the default in the prefs backend
+static gint sql_load_days         = 0;    // This is also the default in the prefs backend
+static gint sql_write_behind      = 0;    // This is also the default in the prefs backend
 static gint file_retention_policy = 1;    // 1 = "days", the default in the prefs backend
 static gint file_retention_days   = 30;   // This is also the default in the prefs backend
 
@@ -95,6 +101,78 @@ gnc_prefs_set_file_save_compressed(gboolean compressed)
     use_compression = compressed;
 }
 
+gint
+gnc_prefs_get_file_compression_level(void)
+{
+    return compression_level;
+}
+
+void
+gnc_prefs_set_file_compression_level(gint level)
+{
+    compression_level = level;
+}
+
+gboolean
+gnc_prefs_get_file_compression_zstd(void)
+{
+    return use_zstd;
+}
+
+void
+gnc_prefs_set_file_compression_zstd(gboolean zstd)
+{
+    use_zstd = zstd;
+}
+
+gboolean
+gnc_prefs_get_file_save_journal(void)
+{
+    return use_journal;
+}
+
+void
+gnc_prefs_set_file_save_journal(gboolean journal)
+{
+    use_journal = journal;
+}
+
+gboolean
+gnc_prefs_get_file_save_snapshot(void)
+{
+    return use_snapshot;
+}
+
+void
+gnc_prefs_set_file_save_snapshot(gboolean snapshot)
+{
+    use_snapshot = snapshot;
+}
+
+gint
+gnc_prefs_get_sql_load_days(void)
+{
+    return sql_load_days;
+}
+
+void
+gnc_prefs_set_sql_load_days(gint days)
+{
+    sql_load_days = days;
+}
+
+gint
+gnc_prefs_get_sql_write_behind(void)
+{
+    return sql_write_behind;
+}
+
+void
+gnc_prefs_set_sql_write_behind(gint depth)
+{
+    sql_write_behind = depth;
+}
+
 gint
 gnc_prefs_get_file_retention_policy(void)
 {
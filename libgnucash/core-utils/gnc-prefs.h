@@ -113,6 +113,24 @@ void gnc_prefs_set_extra(gboolean enabled);
 gboolean gnc_prefs_get_file_save_compressed(void);
 void gnc_prefs_set_file_save_compressed(gboolean compressed);
 
+gint gnc_prefs_get_file_compression_level(void);
+void gnc_prefs_set_file_compression_level(gint level);
+
+gboolean gnc_prefs_get_file_compression_zstd(void);
+void gnc_prefs_set_file_compression_zstd(gboolean zstd);
+
+gboolean gnc_prefs_get_file_save_journal(void);
+void gnc_prefs_set_file_save_journal(gboolean journal);
+
+gboolean gnc_prefs_get_file_save_snapshot(void);
+void gnc_prefs_set_file_save_snapshot(gboolean snapshot);
+
+gint gnc_prefs_get_sql_load_days(void);
+void gnc_prefs_set_sql_load_days(gint days);
+
+gint gnc_prefs_get_sql_write_behind(void);
+void gnc_prefs_set_sql_write_behind(gint depth);
+
 gint gnc_prefs_get_file_retention_policy(void);
 void gnc_prefs_set_file_retention_policy(gint policy);
 
@@ -42,10 +42,13 @@
 #include "gnc-lot.h"
 #include "gnc-pricedb.h"
 #include "qofinstance-p.h"
+#include "qof-backend.hpp"
 #include "gnc-features.h"
 #include "guid.hpp"
 
+#include <algorithm>
 #include <numeric>
+#include <vector>
 #include <map>
 #include <unordered_set>
 
@@ -292,6 +295,21 @@ mark_account (Account *acc)
 /********************************************************************\
 \********************************************************************/
 
+/* Contiguous index over the nodes of AccountPrivate::splits, kept in the
+ * same order as the list. It gives O(1) positional access to the list
+ * and, while the list is sorted, O(log n) lookup of a split's node by
+ * binary search on xaccSplitOrder. */
+struct SplitIndexEntry
+{
+    Split *split;
+    GList *node;
+};
+
+struct SplitIndex
+{
+    std::vector<SplitIndexEntry> entries;
+};
+
 /* GObject Initialization */
 G_DEFINE_TYPE_WITH_PRIVATE(Account, gnc_account, QOF_TYPE_INSTANCE)
 
@@ -328,6 +346,7 @@ gnc_account_init(Account* acc)
     priv->starting_cleared_balance = gnc_numeric_zero();
     priv->starting_reconciled_balance = gnc_numeric_zero();
     priv->balance_dirty = FALSE;
+    priv->balance_clean_count = 0;
 
     priv->higher_balance_limit = gnc_numeric_create (1,0);
     priv->higher_balance_cached = false;
@@ -336,6 +355,7 @@ gnc_account_init(Account* acc)
     priv->include_sub_account_balances = TriState::Unset;
 
     priv->splits = NULL;
+    priv->split_index = new SplitIndex;
     priv->sort_dirty = FALSE;
 }
 
@@ -348,6 +368,9 @@ gnc_account_dispose (GObject *acctp)
 static void
 gnc_account_finalize(GObject* acctp)
 {
+    AccountPrivate *priv = GET_PRIVATE(acctp);
+    delete priv->split_index;
+    priv->split_index = nullptr;
     G_OBJECT_CLASS(gnc_account_parent_class)->finalize(acctp);
 }
 
@@ -1422,6 +1445,7 @@ xaccFreeAccount (Account *acc)
     priv->commodity = NULL;
 
     priv->balance_dirty = FALSE;
+    priv->balance_clean_count = 0;
     priv->sort_dirty = FALSE;
 
     /* qof_instance_release (&acc->inst); */
@@ -1516,6 +1540,7 @@ xaccAccountCommitEdit (Account *acc)
         {
             g_list_free(priv->splits);
             priv->splits = NULL;
+            priv->split_index->entries.clear();
         }
 
         /* It turns out there's a case where this assertion does not hold:
@@ -1898,6 +1923,74 @@ gnc_account_set_balance_dirty (Account *acc)
 
     priv = GET_PRIVATE(acc);
     priv->balance_dirty = TRUE;
+    priv->balance_clean_count = 0;
+}
+
+/* Only the splits before position pos keep valid running balances. */
+static inline void
+account_balance_dirty_from (AccountPrivate *priv, guint pos)
+{
+    if (pos < priv->balance_clean_count)
+        priv->balance_clean_count = pos;
+    priv->balance_dirty = TRUE;
+}
+
+/* Position at which split is (or would be inserted) in a sorted split
+ * list. */
+static std::vector<SplitIndexEntry>::iterator
+split_index_lower_bound (AccountPrivate *priv, const Split *split)
+{
+    auto& entries = priv->split_index->entries;
+    return std::lower_bound (entries.begin(), entries.end(), split,
+                             [](const SplitIndexEntry& entry, const Split *s)
+                             { return xaccSplitOrder (entry.split, s) < 0; });
+}
+
+/* Position of split in the split list, or -1 if it isn't there. */
+static gint
+split_index_find (AccountPrivate *priv, const Split *split)
+{
+    auto& entries = priv->split_index->entries;
+    if (!priv->sort_dirty)
+    {
+        auto iter = split_index_lower_bound (priv, split);
+        if (iter != entries.end() && iter->split == split)
+            return iter - entries.begin();
+    }
+    /* Unsorted, or the split's sort key changed without the account
+     * being told: fall back to scanning the array. */
+    auto iter = std::find_if (entries.begin(), entries.end(),
+                              [split](const SplitIndexEntry& entry)
+                              { return entry.split == split; });
+    return iter == entries.end() ? -1 : iter - entries.begin();
+}
+
+static void
+split_index_rebuild (AccountPrivate *priv)
+{
+    auto& entries = priv->split_index->entries;
+    entries.clear();
+    for (auto node = priv->splits; node; node = node->next)
+        entries.push_back ({static_cast<Split*>(node->data), node});
+}
+
+void
+gnc_account_set_balance_dirty_from_split (Account *acc, const Split *split)
+{
+    AccountPrivate *priv;
+    gint pos;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+
+    if (qof_instance_get_destroying(acc))
+        return;
+
+    priv = GET_PRIVATE(acc);
+    /* A split that isn't in the list yet will lower the count when it
+     * is inserted. */
+    pos = split_index_find (priv, split);
+    account_balance_dirty_from (priv, pos < 0 ? priv->balance_clean_count
+                                : static_cast<guint>(pos));
 }
 
 void gnc_account_set_defer_bal_computation (Account *acc, gboolean defer)
@@ -1936,27 +2029,42 @@ gnc_account_insert_split (Account *acc, Split *s)
     g_return_val_if_fail(GNC_IS_SPLIT(s), FALSE);
 
     priv = GET_PRIVATE(acc);
-    node = g_list_find(priv->splits, s);
-    if (node)
+    if (split_index_find (priv, s) >= 0)
         return FALSE;
 
-    if (qof_instance_get_editlevel(acc) == 0)
+    auto& entries = priv->split_index->entries;
+    auto iter = entries.end();
+    if (qof_instance_get_editlevel(acc) == 0 && !priv->sort_dirty)
+        iter = split_index_lower_bound (priv, s);
+    else
+        /* Appending keeps the positions of the splits already in the
+         * list; the next xaccAccountSortSplits puts it in its place. */
+        priv->sort_dirty = TRUE;
+
+    guint pos = iter - entries.begin();
+    if (iter != entries.end())
+    {
+        priv->splits = g_list_insert_before(priv->splits, iter->node, s);
+        node = iter->node->prev;
+    }
+    else if (entries.empty())
     {
-        priv->splits = g_list_insert_sorted(priv->splits, s,
-                                            (GCompareFunc)xaccSplitOrder);
+        priv->splits = g_list_append(priv->splits, s);
+        node = priv->splits;
     }
     else
     {
-        priv->splits = g_list_prepend(priv->splits, s);
-        priv->sort_dirty = TRUE;
+        /* Append to the last node without walking the list. */
+        node = g_list_append(entries.back().node, s)->next;
     }
+    entries.insert (iter, {s, node});
 
     //FIXME: find better event
     qof_event_gen (&acc->inst, QOF_EVENT_MODIFY, NULL);
     /* Also send an event based on the account */
     qof_event_gen(&acc->inst, GNC_EVENT_ITEM_ADDED, s);
 
-    priv->balance_dirty = TRUE;
+    account_balance_dirty_from (priv, pos);
 //  DRH: Should the below be added? It is present in the delete path.
 //  xaccAccountRecomputeBalance(acc);
     return TRUE;
@@ -1966,23 +2074,26 @@ gboolean
 gnc_account_remove_split (Account *acc, Split *s)
 {
     AccountPrivate *priv;
-    GList *node;
+    gint pos;
 
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), FALSE);
     g_return_val_if_fail(GNC_IS_SPLIT(s), FALSE);
 
     priv = GET_PRIVATE(acc);
-    node = g_list_find(priv->splits, s);
-    if (NULL == node)
+    pos = split_index_find (priv, s);
+    if (pos < 0)
         return FALSE;
 
-    priv->splits = g_list_delete_link(priv->splits, node);
+    auto& entries = priv->split_index->entries;
+    priv->splits = g_list_delete_link(priv->splits, entries[pos].node);
+    entries.erase (entries.begin() + pos);
     //FIXME: find better event type
     qof_event_gen(&acc->inst, QOF_EVENT_MODIFY, NULL);
     // And send the account-based event, too
     qof_event_gen(&acc->inst, GNC_EVENT_ITEM_REMOVED, s);
 
-    priv->balance_dirty = TRUE;
+    /* Only the splits after the removed one need new running balances. */
+    account_balance_dirty_from (priv, static_cast<guint>(pos));
     xaccAccountRecomputeBalance(acc);
     return TRUE;
 }
@@ -1999,7 +2110,18 @@ xaccAccountSortSplits (Account *acc, gboolean force)
         return;
     priv->splits = g_list_sort(priv->splits, (GCompareFunc)xaccSplitOrder);
     priv->sort_dirty = FALSE;
-    priv->balance_dirty = TRUE;
+
+    /* The index still has the old order: the running balances stay
+     * valid up to the first split that moved. */
+    auto& entries = priv->split_index->entries;
+    guint pos = 0;
+    for (auto node = priv->splits;
+         node && pos < MIN(priv->balance_clean_count, entries.size());
+         node = node->next, ++pos)
+        if (node->data != entries[pos].split)
+            break;
+    account_balance_dirty_from (priv, pos);
+    split_index_rebuild (priv);
 }
 
 static void
@@ -2273,6 +2395,7 @@ xaccAccountRecomputeBalance (Account * acc)
     gnc_numeric  cleared_balance;
     gnc_numeric  reconciled_balance;
     GList *lp;
+    guint pos = 0;
 
     if (NULL == acc) return;
 
@@ -2286,10 +2409,29 @@ xaccAccountRecomputeBalance (Account * acc)
     noclosing_balance  = priv->starting_noclosing_balance;
     cleared_balance    = priv->starting_cleared_balance;
     reconciled_balance = priv->starting_reconciled_balance;
+    lp = priv->splits;
 
-    PINFO ("acct=%s starting baln=%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT,
-           priv->accountName, balance.num, balance.denom);
-    for (lp = priv->splits; lp; lp = lp->next)
+    /* Resume from the last split whose running balances are still
+     * valid instead of re-accumulating the whole list. */
+    if (priv->balance_clean_count > 0)
+    {
+        auto& entries = priv->split_index->entries;
+        if (priv->balance_clean_count <= entries.size())
+        {
+            GList *last_clean = entries[priv->balance_clean_count - 1].node;
+            Split *split = (Split *) last_clean->data;
+            balance            = split->balance;
+            noclosing_balance  = split->noclosing_balance;
+            cleared_balance    = split->cleared_balance;
+            reconciled_balance = split->reconciled_balance;
+            lp = last_clean->next;
+            pos = priv->balance_clean_count;
+        }
+    }
+
+    PINFO ("acct=%s starting baln=%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT
+           " at split %u", priv->accountName, balance.num, balance.denom, pos);
+    for (; lp; lp = lp->next, ++pos)
     {
         Split *split = (Split *) lp->data;
         gnc_numeric amt = xaccSplitGetAmount (split);
@@ -2323,6 +2465,7 @@ xaccAccountRecomputeBalance (Account * acc)
     priv->cleared_balance = cleared_balance;
     priv->reconciled_balance = reconciled_balance;
     priv->balance_dirty = FALSE;
+    priv->balance_clean_count = pos;
 }
 
 /********************************************************************\
@@ -2423,7 +2566,8 @@ xaccAccountSetType (Account *acc, GNCAccountType tip)
 
     xaccAccountBeginEdit(acc);
     priv->type = tip;
-    priv->balance_dirty = TRUE; /* new type may affect balance computation */
+    /* new type may affect balance computation */
+    gnc_account_set_balance_dirty (acc);
     mark_account(acc);
     xaccAccountCommitEdit(acc);
 }
@@ -2613,7 +2757,7 @@ xaccAccountSetCommodity (Account * acc, gnc_commodity * com)
     }
 
     priv->sort_dirty = TRUE;  /* Not needed. */
-    priv->balance_dirty = TRUE;
+    gnc_account_set_balance_dirty (acc);
     mark_account (acc);
 
     xaccAccountCommitEdit(acc);
@@ -3442,6 +3586,21 @@ gnc_account_set_start_balance (Account *acc, const gnc_numeric start_baln)
     priv = GET_PRIVATE(acc);
     priv->starting_balance = start_baln;
     priv->balance_dirty = TRUE;
+    priv->balance_clean_count = 0;
+}
+
+void
+gnc_account_set_start_noclosing_balance (Account *acc,
+                                         const gnc_numeric start_baln)
+{
+    AccountPrivate *priv;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+
+    priv = GET_PRIVATE(acc);
+    priv->starting_noclosing_balance = start_baln;
+    priv->balance_dirty = TRUE;
+    priv->balance_clean_count = 0;
 }
 
 void
@@ -3455,6 +3614,7 @@ gnc_account_set_start_cleared_balance (Account *acc,
     priv = GET_PRIVATE(acc);
     priv->starting_cleared_balance = start_baln;
     priv->balance_dirty = TRUE;
+    priv->balance_clean_count = 0;
 }
 
 void
@@ -3468,6 +3628,7 @@ gnc_account_set_start_reconciled_balance (Account *acc,
     priv = GET_PRIVATE(acc);
     priv->starting_reconciled_balance = start_baln;
     priv->balance_dirty = TRUE;
+    priv->balance_clean_count = 0;
 }
 
 gnc_numeric
@@ -3529,36 +3690,124 @@ xaccAccountGetProjectedMinimumBalance (const Account *acc)
 /********************************************************************\
 \********************************************************************/
 
+/* Position of the first split posted on or after date. The sorted split
+ * list is ordered by posted date first, so this is a binary search. */
+static size_t
+split_index_date_bound (AccountPrivate *priv, size_t first, time64 date)
+{
+    auto& entries = priv->split_index->entries;
+    auto iter = std::partition_point (entries.begin() + first, entries.end(),
+                                      [date](const SplitIndexEntry& entry)
+                                      {
+                                          auto trans = xaccSplitGetParent (entry.split);
+                                          return trans && xaccTransGetDate (trans) < date;
+                                      });
+    return iter - entries.begin();
+}
+
+/* Lets a backend that left older transactions in the database load the
+ * ones of acc posted from start on before its splits are walked. */
+static void
+account_load_history (const Account *acc, time64 start)
+{
+    auto be = qof_book_get_backend (qof_instance_get_book (acc));
+    if (be)
+        be->load_history (QOF_INSTANCE (acc), start);
+}
+
 static gnc_numeric
 GetBalanceAsOfDate (Account *acc, time64 date, gboolean ignclosing)
 {
-    /* Ideally this could use xaccAccountForEachSplit, but
-     * it doesn't exist yet and I'm uncertain of exactly how
-     * it would work at this time, since it differs from
-     * xaccAccountForEachTransaction by using gpointer return
-     * values rather than gints.
-     */
-    Split *latest = nullptr;
+    AccountPrivate *priv;
+    size_t pos;
+    Split *latest;
 
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), gnc_numeric_zero());
 
+    account_load_history (acc, date);
     xaccAccountSortSplits (acc, TRUE); /* just in case, normally a noop */
     xaccAccountRecomputeBalance (acc); /* just in case, normally a noop */
 
-    for (GList *lp = GET_PRIVATE(acc)->splits; lp; lp = lp->next)
+    priv = GET_PRIVATE(acc);
+    pos = split_index_date_bound (priv, 0, date);
+    /* Whatever is older than the loaded splits is in the starting
+     * balances. */
+    if (!pos)
+        return ignclosing ? priv->starting_noclosing_balance
+            : priv->starting_balance;
+
+    latest = priv->split_index->entries[pos - 1].split;
+    if (ignclosing)
+        return xaccSplitGetNoclosingBalance (latest);
+    else
+        return xaccSplitGetBalance (latest);
+}
+
+void
+xaccAccountGetBalancesAsOfDates (Account *acc, const time64 *dates,
+                                 gsize n_dates, gnc_numeric *balances)
+{
+    AccountPrivate *priv;
+    size_t pos = 0;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+    g_return_if_fail(n_dates == 0 || (dates && balances));
+
+    if (n_dates)
+        account_load_history (acc, *std::min_element (dates, dates + n_dates));
+    xaccAccountSortSplits (acc, TRUE);
+    xaccAccountRecomputeBalance (acc);
+
+    priv = GET_PRIVATE(acc);
+    for (gsize i = 0; i < n_dates; ++i)
     {
-        if (xaccTransGetDate (xaccSplitGetParent ((Split *)lp->data)) >= date)
-            break;
-        latest = (Split *)lp->data;
+        /* Ascending dates only need to search past the previous one. */
+        pos = split_index_date_bound (priv,
+                                      i && dates[i] >= dates[i - 1] ? pos : 0,
+                                      dates[i]);
+        balances[i] = pos ? xaccSplitGetBalance (priv->split_index->entries[pos - 1].split)
+            : priv->starting_balance;
     }
+}
 
-    if (!latest)
-        return gnc_numeric_zero();
+void
+gnc_account_foreach_split_posted_between (const Account *acc,
+                                          time64 start, time64 end,
+                                          GFunc func, gpointer user_data)
+{
+    g_return_if_fail (GNC_IS_ACCOUNT(acc));
+    g_return_if_fail (func);
 
-    if (ignclosing)
-        return xaccSplitGetNoclosingBalance (latest);
+    account_load_history (acc, start);
+    auto priv = GET_PRIVATE(acc);
+    std::vector<Split*> splits;
+    if (priv->sort_dirty || qof_instance_get_editlevel (acc) > 0)
+    {
+        /* The index may not be in order yet, so check every split. */
+        for (auto node = priv->splits; node; node = node->next)
+        {
+            auto split = GNC_SPLIT (node->data);
+            auto trans = xaccSplitGetParent (split);
+            if (!trans || (xaccTransGetDate (trans) >= start &&
+                           xaccTransGetDate (trans) <= end))
+                splits.push_back (split);
+        }
+    }
     else
-        return xaccSplitGetBalance (latest);
+    {
+        auto& entries = priv->split_index->entries;
+        size_t first = 0, last = entries.size();
+        if (start != INT64_MIN)
+            first = split_index_date_bound (priv, 0, start);
+        if (end != INT64_MAX)
+            last = split_index_date_bound (priv, first, end + 1);
+        splits.reserve (last - first);
+        for (auto i = first; i < last; ++i)
+            splits.push_back (entries[i].split);
+    }
+    /* func may add splits to the account or remove them. */
+    for (auto split : splits)
+        func (split, user_data);
 }
 
 gnc_numeric
@@ -3580,6 +3829,8 @@ xaccAccountGetReconciledBalanceAsOfDate (Account *acc, time64 date)
 
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), gnc_numeric_zero());
 
+    /* Any split may have been reconciled by date. */
+    account_load_history (acc, INT64_MIN);
     for (GList *node = GET_PRIVATE(acc)->splits; node; node = node->next)
     {
         Split *split = (Split*) node->data;
@@ -335,6 +335,14 @@ typedef enum
     void gnc_account_set_start_balance (Account *acc,
                                         const gnc_numeric start_baln);
 
+    /** This function will set the starting commodity balance for this
+     *  account, leaving out closing transactions.  This routine is
+     *  intended for use with backends that do not return the complete
+     *  list of splits for an account, like
+     *  gnc_account_set_start_balance(). */
+    void gnc_account_set_start_noclosing_balance (Account *acc,
+                                                  const gnc_numeric start_baln);
+
     /** This function will set the starting cleared commodity balance for
      *  this account.  This routine is intended for use with backends that
      *  do not return the complete list of splits for an account, but
@@ -565,6 +573,15 @@ typedef enum
     gnc_numeric xaccAccountGetBalanceAsOfDate (Account *account,
             time64 date);
 
+    /** Get the balances of the account at the end of the day before each of
+     *  the n_dates dates, as xaccAccountGetBalanceAsOfDate() would, storing
+     *  them in the caller-allocated balances array.  The split list is only
+     *  brought up to date once, and each lookup is a binary search, so this
+     *  is the preferred way to get many balances of one account; passing the
+     *  dates in ascending order narrows each search further. */
+    void xaccAccountGetBalancesAsOfDates (Account *account, const time64 *dates,
+                                          gsize n_dates, gnc_numeric *balances);
+
     /** Get the reconciled balance of the account at the end of the day of the date specified. */
     gnc_numeric xaccAccountGetReconciledBalanceAsOfDate (Account *account, time64 date);
 
@@ -128,8 +128,11 @@ typedef struct AccountPrivate
     TriState    include_sub_account_balances;
  
     gboolean balance_dirty;     /* balances in splits incorrect */
+    guint balance_clean_count;  /* number of leading splits whose
+                                 * running balances are still correct */
 
     GList *splits;              /* list of split pointers */
+    struct SplitIndex *split_index; /* array over the nodes of splits */
     gboolean sort_dirty;        /* sort order of splits is bad */
 
     LotList   *lots;		/* list of lot pointers */
@@ -162,6 +165,23 @@ struct account_s
  * call this on an existing account! */
 void xaccAccountSetGUID (Account *account, const GncGUID *guid);
 
+/* Mark the running balances of the account dirty from the position of
+ * split onward. The splits sorted before it keep their cached balances,
+ * so the next xaccAccountRecomputeBalance only re-accumulates the tail
+ * of the split list. */
+void gnc_account_set_balance_dirty_from_split (Account *acc,
+                                               const Split *split);
+
+/* Call func on the account's splits whose transactions are posted
+ * between start and end inclusive, in split order, finding them by
+ * binary search.  While the split list is waiting to be sorted or the
+ * account is in an edit each split's date is checked instead.  Splits
+ * without a transaction are passed too.  The splits are gathered before
+ * func is called, so func may change the account's split list. */
+void gnc_account_foreach_split_posted_between (const Account *acc,
+                                               time64 start, time64 end,
+                                               GFunc func, gpointer user_data);
+
 /* Register Accounts with the engine */
 gboolean xaccAccountRegister (void);
 
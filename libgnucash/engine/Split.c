@@ -56,6 +56,8 @@
 #include "gnc-lot.h"
 #include "gnc-event.h"
 #include "qofinstance-p.h"
+#include "qofquery-p.h"
+#include "qofquerycore-p.h"
 
 const char *void_former_amt_str = "void-former-amount";
 const char *void_former_val_str = "void-former-value";
@@ -730,7 +732,8 @@ void mark_split (Split *s)
 {
     if (s->acc)
     {
-        g_object_set(s->acc, "sort-dirty", TRUE, "balance-dirty", TRUE, NULL);
+        g_object_set(s->acc, "sort-dirty", TRUE, NULL);
+        gnc_account_set_balance_dirty_from_split (s->acc, s);
     }
 
     /* set dirty flag on lot too. */
@@ -1031,7 +1034,8 @@ xaccSplitCommitEdit(Split *s)
 
     if (acc)
     {
-        g_object_set(acc, "sort-dirty", TRUE, "balance-dirty", TRUE, NULL);
+        g_object_set(acc, "sort-dirty", TRUE, NULL);
+        gnc_account_set_balance_dirty_from_split (acc, s);
         xaccAccountRecomputeBalance(acc);
     }
 }
@@ -2192,6 +2196,145 @@ xaccSplitUnvoid(Split *split)
 #else
 # define DI(x) x
 #endif
+/* Query planning: a query whose every ORed branch restricts splits to
+ * some accounts, as the register and import matcher queries do, only
+ * needs to look at those accounts' splits, and a posted-date range in
+ * the branch narrows that to a binary search of each account's sorted
+ * splits.  The query still checks every split passed, so this only
+ * has to find a superset of the matches. */
+
+static gboolean
+split_term_has_path (QofQueryTerm *qt, const char *first, const char *second)
+{
+    GSList *path = qof_query_term_get_param_path (qt);
+    return path && path->next && !path->next->next &&
+        !g_strcmp0 (path->data, first) && !g_strcmp0 (path->next->data, second);
+}
+
+static gboolean
+split_query_branch_plan (GList *and_terms, GList **guids,
+                         time64 *start, time64 *end)
+{
+    *guids = NULL;
+    *start = INT64_MIN;
+    *end = INT64_MAX;
+
+    for (; and_terms; and_terms = and_terms->next)
+    {
+        QofQueryTerm *qt = and_terms->data;
+        QofQueryPredData *pd = qof_query_term_get_pred_data (qt);
+
+        if (!pd || qof_query_term_is_inverted (qt))
+            continue;
+
+        if (!*guids && split_term_has_path (qt, SPLIT_ACCOUNT, QOF_PARAM_GUID) &&
+            !g_strcmp0 (pd->type_name, QOF_TYPE_GUID) &&
+            ((query_guid_t) pd)->options == QOF_GUID_MATCH_ANY)
+        {
+            *guids = ((query_guid_t) pd)->guids;
+        }
+        else if (split_term_has_path (qt, SPLIT_TRANS, TRANS_DATE_POSTED) &&
+                 !g_strcmp0 (pd->type_name, QOF_TYPE_DATE) &&
+                 ((query_date_t) pd)->options == QOF_DATE_MATCH_NORMAL)
+        {
+            time64 date = ((query_date_t) pd)->date;
+            if ((pd->how == QOF_COMPARE_GT || pd->how == QOF_COMPARE_GTE ||
+                 pd->how == QOF_COMPARE_EQUAL) && date > *start)
+                *start = date;
+            if ((pd->how == QOF_COMPARE_LT || pd->how == QOF_COMPARE_LTE ||
+                 pd->how == QOF_COMPARE_EQUAL) && date < *end)
+                *end = date;
+        }
+    }
+    return *guids != NULL;
+}
+
+typedef struct
+{
+    GHashTable *seen;   /* splits already passed, when there are ORed branches */
+    QofInstanceForeachCB cb;
+    gpointer data;
+} SplitQueryVisit;
+
+static void
+split_query_visit (gpointer data, gpointer user_data)
+{
+    SplitQueryVisit *visit = user_data;
+
+    if (visit->seen)
+    {
+        if (g_hash_table_contains (visit->seen, data))
+            return;
+        g_hash_table_add (visit->seen, data);
+    }
+    visit->cb (data, visit->data);
+}
+
+static void
+split_query_check_open (QofInstance *inst, gpointer data)
+{
+    if (qof_instance_get_editlevel (inst) > 0)
+        *(gboolean*) data = TRUE;
+}
+
+static gboolean
+split_foreach_query (QofBook *book, QofQuery *q,
+                     QofInstanceForeachCB cb, gpointer data)
+{
+    GList *or_terms = qof_query_get_terms (q);
+    SplitQueryVisit visit = { NULL, cb, data };
+    GList *guids, *node;
+    time64 start, end;
+    gboolean trans_open = FALSE;
+
+    if (!or_terms)
+        return FALSE;
+
+    /* A branch that doesn't name accounts means scanning every split, and
+     * so does an account or a transaction in an edit: their changes may
+     * not be in the accounts' indexes yet. A transaction's splits only
+     * move to their new accounts when it is committed. */
+    qof_collection_foreach (qof_book_get_collection (book, GNC_ID_TRANS),
+                            split_query_check_open, &trans_open);
+    if (trans_open)
+        return FALSE;
+    for (node = or_terms; node; node = node->next)
+    {
+        if (!split_query_branch_plan (node->data, &guids, &start, &end))
+            return FALSE;
+        for (; guids; guids = guids->next)
+        {
+            Account *acc = xaccAccountLookup (guids->data, book);
+            if (acc && qof_instance_get_editlevel (acc) > 0)
+                return FALSE;
+        }
+    }
+
+    if (or_terms->next)
+        visit.seen = g_hash_table_new (NULL, NULL);
+
+    for (node = or_terms; node; node = node->next)
+    {
+        GHashTable *accounts = g_hash_table_new (NULL, NULL);
+
+        split_query_branch_plan (node->data, &guids, &start, &end);
+        for (; guids; guids = guids->next)
+        {
+            Account *acc = xaccAccountLookup (guids->data, book);
+            if (!acc || g_hash_table_contains (accounts, acc))
+                continue;
+            g_hash_table_add (accounts, acc);
+            gnc_account_foreach_split_posted_between (acc, start, end,
+                                                      split_query_visit, &visit);
+        }
+        g_hash_table_destroy (accounts);
+    }
+
+    if (visit.seen)
+        g_hash_table_destroy (visit.seen);
+    return TRUE;
+}
+
 static QofObject split_object_def =
 {
     DI(.interface_version = ) QOF_OBJECT_VERSION,
@@ -2205,6 +2348,7 @@ static QofObject split_object_def =
     DI(.foreach           = ) qof_collection_foreach,
     DI(.printable         = ) (const char * (*)(gpointer)) xaccSplitGetMemo,
     DI(.version_cmp       = ) (int (*)(gpointer, gpointer)) qof_instance_version_cmp,
+    DI(.foreach_query     = ) split_foreach_query,
 };
 
 static gpointer
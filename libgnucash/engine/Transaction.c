@@ -1774,6 +1774,8 @@ xaccTransRollbackEdit (Transaction *trans)
             s->gains_split = so->gains_split;
             //SET_GAINS_A_VDIRTY(s);
             s->date_reconciled = so->date_reconciled;
+            /* The account may have accumulated the edited amount. */
+            mark_split(s);
             qof_instance_mark_clean(QOF_INSTANCE(s));
         }
         else
@@ -2397,16 +2399,9 @@ xaccTransGetIsClosingTxn (const Transaction *trans)
 {
     if (!trans) return FALSE;
 
-    GValue v = G_VALUE_INIT;
-    gboolean rv;
-    qof_instance_get_kvp (QOF_INSTANCE (trans), &v, 1, trans_is_closing_str);
-    if (G_VALUE_HOLDS_INT64 (&v))
-        rv = (g_value_get_int64 (&v) ? 1 : 0);
-    else
-        rv = 0;
-    g_value_unset (&v);
-
-    return rv;
+    return qof_instance_get_kvp_int64_cached
+        (QOF_INSTANCE (trans),
+         &((Transaction*)trans)->is_closing_cache, trans_is_closing_str) ? 1 : 0;
 }
 
 /********************************************************************\
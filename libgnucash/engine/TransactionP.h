@@ -51,6 +51,7 @@
 #include "gnc-engine.h"   /* for typedefs */
 #include "SplitP.h"
 #include "qof.h"
+#include "qofinstance-p.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -120,6 +121,9 @@ struct transaction_s
      */
     char txn_type;
 
+    /* Cached copy of the trans_is_closing_str slot, which is read for
+     * every comparison when sorting splits. */
+    QofInstanceKvpCache is_closing_cache;
 };
 
 struct _TransactionClass
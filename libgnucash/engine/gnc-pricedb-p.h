@@ -60,8 +60,8 @@ struct gnc_price_db_s
 {
     QofInstance inst;              /* globally unique object identifier */
     GHashTable *commodity_hash;
+    struct PriceIndex *price_index; /* time-sorted view of commodity_hash */
     gboolean bulk_update;		 /* TRUE while reading XML file, etc. */
-    gboolean reset_nth_price_cache;
 };
 
 struct _GncPriceDBClass
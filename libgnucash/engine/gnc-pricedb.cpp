@@ -32,6 +32,12 @@
 #include "gnc-pricedb-p.h"
 #include <qofinstance-p.h>
 
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 /* This static indicates the debugging module that this .o belongs to.  */
 static QofLogModule log_module = GNC_MOD_PRICE;
 
@@ -44,6 +50,7 @@ static gboolean
 pricedb_pricelist_traversal(GNCPriceDB *db,
                             gboolean (*f)(GList *p, gpointer user_data),
                             gpointer user_data);
+static void price_index_changed(GNCPriceDB *db, const gnc_commodity *commodity);
 
 enum
 {
@@ -561,6 +568,7 @@ gnc_price_set_value(GNCPrice *p, gnc_numeric value)
         p->value = value;
         gnc_price_set_dirty(p);
         gnc_price_commit_edit (p);
+        price_index_changed (p->db, p->commodity);
     }
 }
 
@@ -766,6 +774,229 @@ gnc_price_list_equal(PriceList *prices1, PriceList *prices2)
     return TRUE;
 }
 
+/* ==================================================================== */
+/* Price index
+
+   Alongside each (commodity, currency) price list the db keeps a
+   contiguous array of the same prices sorted oldest first, i.e. the
+   reverse of compare_prices_by_date().  Keeping it oldest first makes
+   the common case of adding a new latest quote an append.  Each entry
+   remembers the price's node in the GList so that the list can be
+   maintained without walking it, and the lookup functions can binary
+   search the array instead of copying and scanning the lists.
+
+   The index also holds the per-commodity views used by
+   gnc_pricedb_nth_price(): every price of a commodity, in any currency,
+   in one array.  They are built on demand and dropped whenever a price
+   of that commodity is added or removed.
+
+   Finally it memoizes the exchange rates worked out by
+   get_nearest_price().  Any change to a price can alter any number of
+   rates, so the whole rate cache is dropped then.  Rates are cached
+   under the exact time asked for, so the cache is also dropped when it
+   reaches PRICE_RATE_CACHE_MAX entries.
+ */
+
+struct PriceIndexEntry
+{
+    GNCPrice *price;
+    GList *node;
+};
+
+using PriceIndexVec = std::vector<PriceIndexEntry>;
+using PriceIndexKey = std::pair<const gnc_commodity*, const gnc_commodity*>;
+
+static inline size_t
+hash_combine (size_t seed, size_t hash) noexcept
+{
+    return seed ^ (hash + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+struct PriceIndexKeyHash
+{
+    size_t operator() (const PriceIndexKey& key) const noexcept
+    {
+        return hash_combine (std::hash<const void*>{} (key.first),
+                             std::hash<const void*>{} (key.second));
+    }
+};
+
+struct PriceRateKey
+{
+    const gnc_commodity *from;
+    const gnc_commodity *to;
+    time64 t;
+    gboolean before_date;
+
+    bool operator== (const PriceRateKey& other) const noexcept
+    {
+        return from == other.from && to == other.to && t == other.t &&
+            before_date == other.before_date;
+    }
+};
+
+struct PriceRateKeyHash
+{
+    size_t operator() (const PriceRateKey& key) const noexcept
+    {
+        auto seed = hash_combine (std::hash<const void*>{} (key.from),
+                                  std::hash<const void*>{} (key.to));
+        seed = hash_combine (seed, std::hash<time64>{} (key.t));
+        return hash_combine (seed, key.before_date ? 1 : 0);
+    }
+};
+
+using PriceView = std::vector<GNCPrice*>;
+
+#define PRICE_RATE_CACHE_MAX 4096
+
+struct PriceIndex
+{
+    std::unordered_map<PriceIndexKey, PriceIndexVec, PriceIndexKeyHash> pairs;
+    std::unordered_map<const gnc_commodity*, PriceView> views;
+    std::unordered_map<PriceRateKey, gnc_numeric, PriceRateKeyHash> rates;
+    std::mutex mutex;           /* guards views and rates */
+};
+
+/* Drops the cached data that a change to one of commodity's prices
+ * makes stale. */
+static void
+price_index_changed (GNCPriceDB *db, const gnc_commodity *commodity)
+{
+    if (!db || !db->price_index) return;
+    std::lock_guard<std::mutex> lock (db->price_index->mutex);
+    db->price_index->views.erase (commodity);
+    if (!db->price_index->rates.empty ())
+        db->price_index->rates.clear ();
+}
+
+static PriceIndexVec*
+price_index_lookup (const GNCPriceDB *db, const gnc_commodity *commodity,
+                    const gnc_commodity *currency)
+{
+    if (!db->price_index) return nullptr;
+    auto iter = db->price_index->pairs.find ({commodity, currency});
+    return iter == db->price_index->pairs.end () ? nullptr : &iter->second;
+}
+
+static bool
+price_index_entry_less (const PriceIndexEntry& a, const PriceIndexEntry& b)
+{
+    return compare_prices_by_date (a.price, b.price) > 0;
+}
+
+/* Returns the first entry later than t. */
+static PriceIndexVec::const_iterator
+price_index_time_bound (const PriceIndexVec& vec, time64 t)
+{
+    return std::partition_point (vec.begin (), vec.end (),
+                                 [t](const PriceIndexEntry& e)
+                                 { return gnc_price_get_time64 (e.price) <= t; });
+}
+
+/* Finds the prices on either side of t: before is the newest price no
+ * later than t and after the oldest one later than t.  When prices from
+ * two arrays are combined the choice follows the merged list order, so
+ * the results are the same as scanning the merged price list. */
+static void
+price_index_bracket (const PriceIndexVec *vec, time64 t,
+                     GNCPrice **before, GNCPrice **after)
+{
+    if (!vec || vec->empty ()) return;
+    auto bound = price_index_time_bound (*vec, t);
+    if (bound != vec->begin ())
+    {
+        auto p = std::prev (bound)->price;
+        if (!*before || compare_prices_by_date (p, *before) < 0)
+            *before = p;
+    }
+    if (bound != vec->end ())
+    {
+        auto p = bound->price;
+        if (!*after || compare_prices_by_date (p, *after) > 0)
+            *after = p;
+    }
+}
+
+static PriceIndexVec::iterator
+price_index_find (PriceIndexVec& vec, const GNCPrice *p)
+{
+    PriceIndexEntry key {const_cast<GNCPrice*>(p), nullptr};
+    auto iter = std::lower_bound (vec.begin (), vec.end (), key,
+                                  price_index_entry_less);
+    if (iter != vec.end () && iter->price == p)
+        return iter;
+    /* Something changed the price's sort key behind our back. */
+    return std::find_if (vec.begin (), vec.end (),
+                         [p](const PriceIndexEntry& e){ return e.price == p; });
+}
+
+static gboolean
+price_index_has_duplicate (const PriceIndexVec& vec, const GNCPrice *p)
+{
+    /* All of the prices on p's day are adjacent in the array. */
+    auto day = time64CanonicalDayTime (gnc_price_get_time64 (p));
+    auto iter = std::partition_point (vec.begin (), vec.end (),
+                                      [day](const PriceIndexEntry& e)
+                                      { return time64CanonicalDayTime (gnc_price_get_time64 (e.price)) < day; });
+    for (; iter != vec.end (); ++iter)
+    {
+        if (time64CanonicalDayTime (gnc_price_get_time64 (iter->price)) != day)
+            break;
+        if (!price_is_duplicate (iter->price, p))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Inserts p into both the price list and the index, taking a reference
+ * like gnc_price_list_insert(). */
+static gboolean
+price_index_insert (PriceIndexVec& vec, PriceList **prices, GNCPrice *p,
+                    gboolean check_dupl)
+{
+    gnc_price_ref (p);
+
+    if (check_dupl && price_index_has_duplicate (vec, p))
+        return TRUE;
+
+    PriceIndexEntry entry {p, nullptr};
+    auto pos = std::lower_bound (vec.begin (), vec.end (), entry,
+                                 price_index_entry_less);
+    if (vec.empty ())
+    {
+        *prices = g_list_prepend (*prices, p);
+        entry.node = *prices;
+    }
+    else if (pos == vec.begin ())
+    {
+        /* Oldest price, goes at the end of the list. */
+        entry.node = g_list_append (vec.front ().node, p)->next;
+    }
+    else
+    {
+        /* The list is newest first, so p goes in front of the next
+         * older price. */
+        auto older = std::prev (pos)->node;
+        *prices = g_list_insert_before (*prices, older, p);
+        entry.node = older->prev;
+    }
+    vec.insert (pos, entry);
+    return TRUE;
+}
+
+/* Removes p from both the price list and the index, dropping the
+ * reference that the list held. */
+static void
+price_index_remove (PriceIndexVec& vec, PriceList **prices, GNCPrice *p)
+{
+    auto iter = price_index_find (vec, p);
+    if (iter == vec.end ()) return;
+    *prices = g_list_delete_link (*prices, iter->node);
+    vec.erase (iter);
+    gnc_price_unref (p);
+}
+
 /* ==================================================================== */
 /* GNCPriceDB functions
 
@@ -783,7 +1014,6 @@ QOF_GOBJECT_IMPL(gnc_pricedb, GNCPriceDB, QOF_TYPE_INSTANCE)
 static void
 gnc_pricedb_init(GNCPriceDB* pdb)
 {
-    pdb->reset_nth_price_cache = FALSE;
 }
 
 static void
@@ -826,6 +1056,7 @@ gnc_pricedb_create(QofBook * book)
 
     result->commodity_hash = g_hash_table_new(NULL, NULL);
     g_return_val_if_fail (result->commodity_hash, NULL);
+    result->price_index = new PriceIndex;
     return result;
 }
 
@@ -873,6 +1104,8 @@ gnc_pricedb_destroy(GNCPriceDB *db)
     }
     g_hash_table_destroy (db->commodity_hash);
     db->commodity_hash = NULL;
+    delete db->price_index;
+    db->price_index = NULL;
     /* qof_instance_release (&db->inst); */
     g_object_unref(db);
 }
@@ -1076,9 +1309,10 @@ add_price(GNCPriceDB *db, GNCPrice *p)
     }
 
     price_list = static_cast<GList*>(g_hash_table_lookup(currency_hash, currency));
-    if (!gnc_price_list_insert(&price_list, p, !db->bulk_update))
+    auto& prices_by_time = db->price_index->pairs[{commodity, currency}];
+    if (!price_index_insert(prices_by_time, &price_list, p, !db->bulk_update))
     {
-        LEAVE ("gnc_price_list_insert failed");
+        LEAVE ("price_index_insert failed");
         return FALSE;
     }
 
@@ -1089,6 +1323,7 @@ add_price(GNCPriceDB *db, GNCPrice *p)
     }
 
     g_hash_table_insert(currency_hash, currency, price_list);
+    price_index_changed(db, commodity);
     p->db = db;
 
     qof_event_gen (&p->inst, QOF_EVENT_ADD, NULL);
@@ -1177,12 +1412,9 @@ remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup)
     qof_event_gen (&p->inst, QOF_EVENT_REMOVE, NULL);
     price_list = static_cast<GList*>(g_hash_table_lookup(currency_hash, currency));
     gnc_price_ref(p);
-    if (!gnc_price_list_remove(&price_list, p))
-    {
-        gnc_price_unref(p);
-        LEAVE (" cannot remove price list");
-        return FALSE;
-    }
+    if (auto prices_by_time = price_index_lookup(db, commodity, currency))
+        price_index_remove(*prices_by_time, &price_list, p);
+    price_index_changed(db, commodity);
 
     /* if the price list is empty, then remove this currency from the
        commodity hash */
@@ -1193,6 +1425,7 @@ remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup)
     else
     {
         g_hash_table_remove(currency_hash, currency);
+        db->price_index->pairs.erase({commodity, currency});
 
         if (cleanup)
         {
@@ -1734,20 +1967,18 @@ GNCPrice *gnc_pricedb_lookup_latest(GNCPriceDB *db,
                           const gnc_commodity *commodity,
                           const gnc_commodity *currency)
 {
-    GList *price_list;
-    GNCPrice *result;
+    GNCPrice *result = NULL, *unused = NULL;
 
     if (!db || !commodity || !currency) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, commodity, currency);
 
-    price_list = pricedb_get_prices_internal(db, commodity, currency, TRUE);
-    if (!price_list) return NULL;
-    /* This works magically because prices are inserted in date-sorted
-     * order, and the latest date always comes first. So return the
-     * first in the list.  */
-    result = static_cast<GNCPrice*>(price_list->data);
+    /* The latest price is the newest one no later than the end of time. */
+    price_index_bracket (price_index_lookup (db, commodity, currency),
+                         INT64_MAX, &result, &unused);
+    price_index_bracket (price_index_lookup (db, currency, commodity),
+                         INT64_MAX, &result, &unused);
+    if (!result) return NULL;
     gnc_price_ref(result);
-    g_list_free (price_list);
     LEAVE("price is %p", result);
     return result;
 }
@@ -2090,31 +2321,23 @@ gnc_pricedb_num_prices(GNCPriceDB *db,
     return result;
 }
 
-/* Helper function for combining the price lists in gnc_pricedb_nth_price. */
+/* Helper function for building the price view in gnc_pricedb_nth_price. */
 static void
-list_combine (gpointer element, gpointer data)
+view_append (gpointer key, gpointer value, gpointer data)
 {
-    GList *list = *(GList**)data;
-    auto lst = static_cast<GList*>(element);
-    if (list == NULL)
-        *(GList**)data = g_list_copy (lst);
-    else
-    {
-        GList *new_list = g_list_concat (list, g_list_copy (lst));
-        *(GList**)data = new_list;
-    }
+    auto view = static_cast<PriceView*>(data);
+    for (auto node = static_cast<GList*>(value); node; node = g_list_next (node))
+        view->push_back (static_cast<GNCPrice*>(node->data));
 }
 
 /* This function is used by gnc-tree-model-price.c for iterating through the
  * prices when building or filtering the pricedb dialog's
  * GtkTreeView. gtk-tree-view-price.c sorts the results after it has obtained
- * the values so there's nothing gained by sorting. However, for very large
- * collections of prices in multiple currencies (here commodity is the one being
- * priced and currency the one in which the price is denominated; note that they
- * may both be currencies or not) just concatenating the price lists together
- * can be expensive because the receiving list must be traversed to obtain its
- * end. To avoid that cost n times we cache the commodity and merged price list.
- * Since this is a GUI-driven function there is no concern about concurrency.
+ * the values so there's nothing gained by sorting. The tree model asks for
+ * every row in turn, so the commodity's price lists are concatenated once
+ * into an array owned by the pricedb's index, making each call a lookup.
+ * The array is dropped by add_price and remove_price when one of the
+ * commodity's prices changes.
  */
 
 GNCPrice *
@@ -2122,41 +2345,31 @@ gnc_pricedb_nth_price (GNCPriceDB *db,
                        const gnc_commodity *c,
                        const int n)
 {
-    static const gnc_commodity *last_c = NULL;
-    static GList *prices = NULL;
-
     GNCPrice *result = NULL;
-    GHashTable *currency_hash;
     g_return_val_if_fail (GNC_IS_COMMODITY (c), NULL);
 
-    if (!db || !c || n < 0) return NULL;
+    if (!db || !c || n < 0 || !db->price_index) return NULL;
     ENTER ("db=%p commodity=%s index=%d", db, gnc_commodity_get_mnemonic(c), n);
 
-    if (last_c && prices && last_c == c && db->reset_nth_price_cache == FALSE)
+    std::lock_guard<std::mutex> lock (db->price_index->mutex);
+    auto& views = db->price_index->views;
+    auto iter = views.find (c);
+    if (iter == views.end ())
     {
-        result = static_cast<GNCPrice*>(g_list_nth_data (prices, n));
-        LEAVE ("price=%p", result);
-        return result;
-    }
-
-    last_c = c;
-
-    if (prices)
-    {
-        g_list_free (prices);
-        prices = NULL;
+        auto currency_hash = static_cast<GHashTable*>(g_hash_table_lookup (db->commodity_hash, c));
+        if (!currency_hash)
+        {
+            LEAVE ("no prices");
+            return NULL;
+        }
+        PriceView view;
+        view.reserve (gnc_pricedb_num_prices (db, c));
+        g_hash_table_foreach (currency_hash, view_append, &view);
+        iter = views.emplace (c, std::move (view)).first;
     }
 
-    db->reset_nth_price_cache = FALSE;
-
-    currency_hash = static_cast<GHashTable*>(g_hash_table_lookup (db->commodity_hash, c));
-    if (currency_hash)
-    {
-        GList *currencies = g_hash_table_get_values (currency_hash);
-        g_list_foreach (currencies, list_combine, &prices);
-        result = static_cast<GNCPrice*>(g_list_nth_data (prices, n));
-        g_list_free (currencies);
-    }
+    if (static_cast<size_t>(n) < iter->second.size ())
+        result = iter->second[n];
 
     LEAVE ("price=%p", result);
     return result;
@@ -2165,8 +2378,9 @@ gnc_pricedb_nth_price (GNCPriceDB *db,
 void
 gnc_pricedb_nth_price_reset_cache (GNCPriceDB *db)
 {
-    if (db)
-        db->reset_nth_price_cache = TRUE;
+    if (!db || !db->price_index) return;
+    std::lock_guard<std::mutex> lock (db->price_index->mutex);
+    db->price_index->views.clear ();
 }
 
 GNCPrice *
@@ -2178,31 +2392,23 @@ gnc_pricedb_lookup_day_t64(GNCPriceDB *db,
     return lookup_nearest_in_time(db, c, currency, t, TRUE);
 }
 
-// return 0 if price's time matches exactly
-static int price_same_time (GNCPrice *p, time64 time)
-{
-    return !(gnc_price_get_time64 (p) == time);
-}
-
 GNCPrice *
 gnc_pricedb_lookup_at_time64(GNCPriceDB *db,
                              const gnc_commodity *c,
                              const gnc_commodity *currency,
                              time64 t)
 {
-    GNCPrice *rv = nullptr;
+    GNCPrice *before = nullptr, *after = nullptr;
     if (!db || !c || !currency) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, c, currency);
-    auto price_list = pricedb_get_prices_internal (db, c, currency, TRUE);
-    auto p = g_list_find_custom (price_list, GUINT_TO_POINTER(t), (GCompareFunc) price_same_time);
-    if (p)
-    {
-        rv = GNC_PRICE (p->data);
-        gnc_price_ref (rv);
-    }
-    g_list_free (price_list);
+    price_index_bracket (price_index_lookup (db, c, currency), t, &before, &after);
+    price_index_bracket (price_index_lookup (db, currency, c), t, &before, &after);
+    /* If any price is at t exactly the newest price no later than t is. */
+    if (before && gnc_price_get_time64 (before) != t)
+        before = nullptr;
+    gnc_price_ref (before);
     LEAVE (" ");
-    return rv;
+    return before;
 }
 
 static GNCPrice *
@@ -2212,7 +2418,6 @@ lookup_nearest_in_time(GNCPriceDB *db,
                        time64 t,
                        gboolean sameday)
 {
-    GList *price_list;
     GNCPrice *current_price = NULL;
     GNCPrice *next_price = NULL;
     GNCPrice *result = NULL;
@@ -2220,25 +2425,17 @@ lookup_nearest_in_time(GNCPriceDB *db,
     if (!db || !c || !currency) return NULL;
     if (t == INT64_MAX) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, c, currency);
-    price_list = pricedb_get_prices_internal (db, c, currency, TRUE);
-    if (!price_list) return NULL;
 
-    /* default answer */
-    current_price = static_cast<GNCPrice*>(price_list->data);
-
-    /* find the first candidate past the one we want.  Remember that
-       prices are in most-recent-first order. */
-    for (auto item = price_list; item; item = g_list_next (item))
-    {
-        auto p = static_cast<GNCPrice*>(item->data);
-        time64 price_time = gnc_price_get_time64(p);
-        if (price_time <= t)
-        {
-            next_price = static_cast<GNCPrice*>(item->data);
-            break;
-        }
-        current_price = static_cast<GNCPrice*>(item->data);
-    }
+    /* next_price is the newest price no later than t and current_price
+       the oldest one after it.  If there is no price after t then
+       current_price and next_price are the same. */
+    price_index_bracket (price_index_lookup (db, c, currency), t,
+                         &next_price, &current_price);
+    price_index_bracket (price_index_lookup (db, currency, c), t,
+                         &next_price, &current_price);
+    if (!current_price)
+        current_price = next_price;
+    if (!current_price) return NULL;
 
     if (current_price)      /* How can this be null??? */
     {
@@ -2310,7 +2507,6 @@ lookup_nearest_in_time(GNCPriceDB *db,
     }
 
     gnc_price_ref(result);
-    g_list_free (price_list);
     LEAVE (" ");
     return result;
 }
@@ -2324,30 +2520,20 @@ gnc_pricedb_lookup_nearest_in_time64(GNCPriceDB *db,
     return lookup_nearest_in_time(db, c, currency, t, FALSE);
 }
 
-// return 0 if price's time is less or equal to time
-static int price_time64_less_or_equal (GNCPrice *p, time64 time)
-{
-    return !(gnc_price_get_time64 (p) <= time);
-}
-
 GNCPrice *
 gnc_pricedb_lookup_nearest_before_t64 (GNCPriceDB *db,
                                        const gnc_commodity *c,
                                        const gnc_commodity *currency,
                                        time64 t)
 {
-    GNCPrice *current_price = NULL;
+    GNCPrice *current_price = NULL, *later_price = NULL;
     if (!db || !c || !currency) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, c, currency);
-    auto price_list = pricedb_get_prices_internal (db, c, currency, TRUE);
-    if (!price_list) return NULL;
-    auto p = g_list_find_custom (price_list, GUINT_TO_POINTER(t), (GCompareFunc)price_time64_less_or_equal);
-    if (p)
-    {
-        current_price = GNC_PRICE (p->data);
-        gnc_price_ref (current_price);
-    }
-    g_list_free (price_list);
+    price_index_bracket (price_index_lookup (db, c, currency), t,
+                         &current_price, &later_price);
+    price_index_bracket (price_index_lookup (db, currency, c), t,
+                         &current_price, &later_price);
+    gnc_price_ref (current_price);
     LEAVE (" ");
     return current_price;
 }
@@ -2504,6 +2690,72 @@ direct_price_conversion (GNCPriceDB *db, const gnc_commodity *from,
     return retval;
 }
 
+/* Last resort when neither a direct price nor a price through one shared
+ * commodity exists: a breadth-first search over the commodities that
+ * have prices between them, multiplying the direct rates along the
+ * shortest chain that reaches the target. */
+static gnc_numeric
+multi_hop_price_conversion (GNCPriceDB *db, const gnc_commodity *from,
+                            const gnc_commodity *to, time64 t, gboolean before_date)
+{
+    int no_round = GNC_HOW_DENOM_EXACT | GNC_HOW_RND_NEVER;
+    std::unordered_map<const gnc_commodity*,
+                       std::vector<const gnc_commodity*>> neighbours;
+    std::unordered_map<const gnc_commodity*, gnc_numeric> reached;
+    std::deque<const gnc_commodity*> queue;
+
+    if (!db || !from || !to || !db->price_index)
+        return gnc_numeric_zero ();
+
+    for (const auto& [key, prices] : db->price_index->pairs)
+    {
+        neighbours[key.first].push_back (key.second);
+        neighbours[key.second].push_back (key.first);
+    }
+    /* The index is hashed on addresses; visiting the neighbours by name
+     * makes the chain chosen between equally short ones the same from
+     * run to run. */
+    auto by_name = [](const gnc_commodity* a, const gnc_commodity* b)
+    {
+        auto cmp = g_strcmp0 (gnc_commodity_get_namespace (a),
+                              gnc_commodity_get_namespace (b));
+        if (cmp == 0)
+            cmp = g_strcmp0 (gnc_commodity_get_mnemonic (a),
+                             gnc_commodity_get_mnemonic (b));
+        return cmp < 0 || (cmp == 0 && a < b);
+    };
+    for (auto& [com, next] : neighbours)
+    {
+        std::sort (next.begin (), next.end (), by_name);
+        next.erase (std::unique (next.begin (), next.end ()), next.end ());
+    }
+
+    reached.emplace (from, gnc_numeric_create (1, 1));
+    queue.push_back (from);
+    while (!queue.empty ())
+    {
+        auto com = queue.front ();
+        auto rate = reached[com];
+        queue.pop_front ();
+        for (auto next : neighbours[com])
+        {
+            if (reached.count (next))
+                continue;
+            auto step = direct_price_conversion (db, com, next, t, before_date);
+            if (gnc_numeric_zero_p (step) || gnc_numeric_check (step))
+                continue;
+            auto next_rate = gnc_numeric_mul (rate, step, GNC_DENOM_AUTO, no_round);
+            if (gnc_numeric_check (next_rate))
+                continue;
+            if (next == to)
+                return next_rate;
+            reached.emplace (next, next_rate);
+            queue.push_back (next);
+        }
+    }
+    return gnc_numeric_zero ();
+}
+
 static gnc_numeric
 get_nearest_price (GNCPriceDB *pdb,
                    const gnc_commodity *orig_curr,
@@ -2516,6 +2768,17 @@ get_nearest_price (GNCPriceDB *pdb,
     if (gnc_commodity_equiv (orig_curr, new_curr))
         return gnc_numeric_create (1, 1);
 
+    /* Rates depend on the exact time asked for, not just the day, so that
+     * is what they're cached under. */
+    PriceRateKey key {orig_curr, new_curr, t, before};
+    if (pdb && pdb->price_index)
+    {
+        std::lock_guard<std::mutex> lock (pdb->price_index->mutex);
+        auto iter = pdb->price_index->rates.find (key);
+        if (iter != pdb->price_index->rates.end ())
+            return iter->second;
+    }
+
     /* Look for a direct price. */
     price = direct_price_conversion (pdb, orig_curr, new_curr, t, before);
 
@@ -2525,7 +2788,20 @@ get_nearest_price (GNCPriceDB *pdb,
     if (gnc_numeric_zero_p (price))
         price = indirect_price_conversion (pdb, orig_curr, new_curr, t, before);
 
-    return gnc_numeric_reduce (price);
+    /* or through a chain of them */
+    if (gnc_numeric_zero_p (price))
+        price = multi_hop_price_conversion (pdb, orig_curr, new_curr, t, before);
+
+    price = gnc_numeric_reduce (price);
+    if (pdb && pdb->price_index)
+    {
+        std::lock_guard<std::mutex> lock (pdb->price_index->mutex);
+        auto& rates = pdb->price_index->rates;
+        if (rates.size () >= PRICE_RATE_CACHE_MAX)
+            rates.clear ();
+        rates.emplace (key, price);
+    }
+    return price;
 }
 
 gnc_numeric
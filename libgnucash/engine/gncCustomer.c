@@ -323,7 +323,14 @@ GncCustomer *gncCustomerCreate (QofBook *book)
     cust->shipaddr = gncAddressCreate (book, &cust->inst);
 
     if (cust_qof_event_handler_id == 0)
-        cust_qof_event_handler_id = qof_event_register_handler (cust_handle_qof_events, NULL);
+    {
+        /* Only address changes and lots concern us. */
+        cust_qof_event_handler_id =
+            qof_event_register_filtered_handler (cust_handle_qof_events, NULL,
+                                                 GNC_ID_ADDRESS, QOF_EVENT_MODIFY);
+        qof_event_register_filtered_handler (cust_handle_qof_events, NULL,
+                                             GNC_ID_LOT, QOF_EVENT_ANY);
+    }
 
     qof_event_gen (&cust->inst, QOF_EVENT_CREATE, NULL);
 
@@ -445,7 +445,14 @@ GncEmployee *gncEmployeeCreate (QofBook *book)
     employee->balance = NULL;
 
     if (empl_qof_event_handler_id == 0)
-        empl_qof_event_handler_id = qof_event_register_handler (empl_handle_qof_events, NULL);
+    {
+        /* Only address changes and lots concern us. */
+        empl_qof_event_handler_id =
+            qof_event_register_filtered_handler (empl_handle_qof_events, NULL,
+                                                 GNC_ID_ADDRESS, QOF_EVENT_MODIFY);
+        qof_event_register_filtered_handler (empl_handle_qof_events, NULL,
+                                             GNC_ID_LOT, QOF_EVENT_ANY);
+    }
 
     qof_event_gen (&employee->inst, QOF_EVENT_CREATE, NULL);
 
@@ -469,7 +469,14 @@ GncVendor *gncVendorCreate (QofBook *book)
     vendor->balance = NULL;
 
     if (vend_qof_event_handler_id == 0)
-        vend_qof_event_handler_id = qof_event_register_handler (vend_handle_qof_events, NULL);
+    {
+        /* Only address changes and lots concern us. */
+        vend_qof_event_handler_id =
+            qof_event_register_filtered_handler (vend_handle_qof_events, NULL,
+                                                 GNC_ID_ADDRESS, QOF_EVENT_MODIFY);
+        qof_event_register_filtered_handler (vend_handle_qof_events, NULL,
+                                             GNC_ID_LOT, QOF_EVENT_ANY);
+    }
 
     qof_event_gen (&vendor->inst, QOF_EVENT_CREATE, NULL);
 
@@ -96,10 +96,18 @@ KvpFrame::get_child_frame_or_create (Path const & path) noexcept
 }
 
 
+uint64_t
+KvpFrameImpl::next_generation() noexcept
+{
+    static std::atomic<uint64_t> last_generation {0};
+    return ++last_generation;
+}
+
 KvpValue *
 KvpFrame::set_impl (std::string const & key, KvpValue * value) noexcept
 {
     KvpValue * ret {};
+    m_generation = next_generation();
     auto spot = m_valuemap.find (key.c_str ());
     if (spot != m_valuemap.end ())
     {
@@ -90,6 +90,8 @@
 #include <vector>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <iostream>
 using Path = std::vector<std::string>;
 using KvpEntry = std::pair <std::vector <std::string>, KvpValue*>;
@@ -224,6 +226,15 @@ struct KvpFrameImpl
      * @return true if the frame contains nothing.
      */
     bool empty() const noexcept { return m_valuemap.empty(); }
+
+    /** A number that changes whenever a value is set or removed in this
+     * frame's immediate slots. Values derived from those slots can be cached
+     * together with the generation they were read at and re-read when it
+     * differs. Generations are never reused, even across frames, so replacing
+     * an instance's frame also invalidates such caches. It is never 0.
+     * @return The current generation of the frame.
+     */
+    uint64_t generation() const noexcept { return m_generation; }
     friend int compare(const KvpFrameImpl&, const KvpFrameImpl&) noexcept;
 
     map_type::iterator begin() { return m_valuemap.begin(); }
@@ -231,6 +242,9 @@ struct KvpFrameImpl
 
     private:
     map_type m_valuemap;
+    uint64_t m_generation {next_generation()};
+
+    static uint64_t next_generation() noexcept;
 
     KvpFrame * get_child_frame_or_nullptr (Path const &) noexcept;
     KvpFrame * get_child_frame_or_create (Path const &) noexcept;
@@ -210,6 +210,18 @@ public:
  *    better to wait for the query).
  */
     virtual void load (QofBook*, QofBackendLoadType) = 0;
+/**
+ *    Called by qof_query_run() before it examines the book's objects. A
+ *    backend that loaded only part of the book at startup loads whatever
+ *    else the query might match.
+ */
+    virtual void load_for_query (QofQuery*) {}
+/**
+ *    Called before the engine walks the splits of an account for the dates
+ *    from start on. A backend that loaded only part of the book at startup
+ *    loads the rest of that part of the account's history.
+ */
+    virtual void load_history (QofInstance*, time64 start) {}
 /**
  *    Called when the engine is about to make a change to a data structure. It
  *    could provide an advisory lock on data, but no backend does this.
@@ -250,7 +262,7 @@ public:
     virtual void export_coa(QofBook *) {}
 /** Set the error value only if there isn't already an error already.
  */
-    void set_error(QofBackendError err);
+    virtual void set_error(QofBackendError err);
 /** Retrieve the currently-stored error and clear it.
  */
     QofBackendError get_error();
@@ -34,6 +34,8 @@ typedef struct
     gpointer user_data;
 
     gint handler_id;
+    QofEventId event_mask;
+    gchar *entity_type;         /* NULL for all types */
 } HandlerInfo;
 
 /* generates an event even when events are suspended! */
@@ -33,7 +33,11 @@ static guint   suspend_counter   = 0;
 static gint    next_handler_id   = 1;
 static guint   handler_run_level = 0;
 static guint   pending_deletes   = 0;
-static GList   *handlers  =   NULL;
+/* The handlers for all entity types, and those for each type, newest
+ * first.  Both hold HandlerInfos that are also in handlers_by_id. */
+static GList      *handlers       = NULL;
+static GHashTable *typed_handlers = NULL;
+static GHashTable *handlers_by_id = NULL;
 
 /* This static indicates the debugging module that this .o belongs to.  */
 static QofLogModule log_module = QOF_MOD_ENGINE;
@@ -43,39 +47,60 @@ static QofLogModule log_module = QOF_MOD_ENGINE;
 static gint
 find_next_handler_id(void)
 {
-    HandlerInfo *hi;
     gint handler_id;
-    GList *node;
 
     /* look for a free handler id */
     handler_id = next_handler_id;
-    node = handlers;
-
-    while (node)
-    {
-        hi = static_cast<HandlerInfo*>(node->data);
-
-        if (hi->handler_id == handler_id)
-        {
-            handler_id++;
-            node = handlers;
-            continue;
-        }
+    while (handlers_by_id &&
+           g_hash_table_contains (handlers_by_id, GINT_TO_POINTER (handler_id)))
+        handler_id++;
 
-        node = node->next;
-    }
     /* Update id for next registration */
     next_handler_id = handler_id + 1;
     return handler_id;
 }
 
+static GList *
+get_handler_list (const char *entity_type)
+{
+    if (!entity_type)
+        return handlers;
+    if (!typed_handlers)
+        return NULL;
+    return static_cast<GList*>(g_hash_table_lookup (typed_handlers, entity_type));
+}
+
+static void
+set_handler_list (const char *entity_type, GList *list)
+{
+    if (!entity_type)
+        handlers = list;
+    else if (list)
+        g_hash_table_replace (typed_handlers, g_strdup (entity_type), list);
+    else
+        g_hash_table_remove (typed_handlers, entity_type);
+}
+
+static void
+free_handler (HandlerInfo *hi)
+{
+    set_handler_list (hi->entity_type,
+                      g_list_remove (get_handler_list (hi->entity_type), hi));
+    g_hash_table_remove (handlers_by_id, GINT_TO_POINTER (hi->handler_id));
+    g_free (hi->entity_type);
+    g_free (hi);
+}
+
 gint
-qof_event_register_handler (QofEventHandler handler, gpointer user_data)
+qof_event_register_filtered_handler (QofEventHandler handler, gpointer user_data,
+                                     QofIdTypeConst entity_type,
+                                     QofEventId event_mask)
 {
     HandlerInfo *hi;
     gint handler_id;
 
-    ENTER ("(handler=%p, data=%p)", handler, user_data);
+    ENTER ("(handler=%p, data=%p, type=%s, mask=%x)", handler, user_data,
+           entity_type ? entity_type : "(all)", event_mask);
 
     /* sanity check */
     if (!handler)
@@ -84,6 +109,12 @@ qof_event_register_handler (QofEventHandler handler, gpointer user_data)
         return 0;
     }
 
+    if (!handlers_by_id)
+        handlers_by_id = g_hash_table_new (g_direct_hash, g_direct_equal);
+    if (entity_type && !typed_handlers)
+        typed_handlers = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                g_free, NULL);
+
     /* look for a free handler id */
     handler_id = find_next_handler_id();
 
@@ -93,52 +124,54 @@ qof_event_register_handler (QofEventHandler handler, gpointer user_data)
     hi->handler = handler;
     hi->user_data = user_data;
     hi->handler_id = handler_id;
+    hi->event_mask = event_mask;
+    hi->entity_type = g_strdup (entity_type);
 
-    handlers = g_list_prepend (handlers, hi);
+    set_handler_list (entity_type,
+                      g_list_prepend (get_handler_list (entity_type), hi));
+    g_hash_table_insert (handlers_by_id, GINT_TO_POINTER (handler_id), hi);
     LEAVE ("(handler=%p, data=%p) handler_id=%d", handler, user_data, handler_id);
     return handler_id;
 }
 
+gint
+qof_event_register_handler (QofEventHandler handler, gpointer user_data)
+{
+    return qof_event_register_filtered_handler (handler, user_data, NULL,
+                                                QOF_EVENT_ANY);
+}
+
 void
 qof_event_unregister_handler (gint handler_id)
 {
-    GList *node;
+    HandlerInfo *hi = NULL;
 
     ENTER ("(handler_id=%d)", handler_id);
-    for (node = handlers; node; node = node->next)
+    if (handlers_by_id)
+        hi = static_cast<HandlerInfo*>(g_hash_table_lookup (handlers_by_id,
+                                                            GINT_TO_POINTER (handler_id)));
+    if (!hi)
     {
-        HandlerInfo *hi = static_cast<HandlerInfo*>(node->data);
-
-        if (hi->handler_id != handler_id)
-            continue;
-
-        /* Normally, we could actually remove the handler's node from the
-           list, but we may be unregistering the event handler as a result
-           of a generated event, such as QOF_EVENT_DESTROY.  In that case,
-           we're in the middle of walking the GList and it is wrong to
-           modify the list. So, instead, we just NULL the handler. */
-        if (hi->handler)
-            LEAVE ("(handler_id=%d) handler=%p data=%p", handler_id,
-                   hi->handler, hi->user_data);
-
-        /* safety -- clear the handler in case we're running events now */
-        hi->handler = NULL;
-
-        if (handler_run_level == 0)
-        {
-            handlers = g_list_remove_link (handlers, node);
-            g_list_free_1 (node);
-            g_free (hi);
-        }
-        else
-        {
-            pending_deletes++;
-        }
-
+        PERR ("no such handler: %d", handler_id);
         return;
     }
 
-    PERR ("no such handler: %d", handler_id);
+    /* Normally, we could actually remove the handler's node from the
+       list, but we may be unregistering the event handler as a result
+       of a generated event, such as QOF_EVENT_DESTROY.  In that case,
+       we're in the middle of walking the GList and it is wrong to
+       modify the list. So, instead, we just NULL the handler. */
+    if (hi->handler)
+        LEAVE ("(handler_id=%d) handler=%p data=%p", handler_id,
+               hi->handler, hi->user_data);
+
+    /* safety -- clear the handler in case we're running events now */
+    hi->handler = NULL;
+
+    if (handler_run_level == 0)
+        free_handler (hi);
+    else
+        pending_deletes++;
 }
 
 void
@@ -169,7 +202,8 @@ qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
                              gpointer event_data)
 {
     GList *node;
-    GList *next_node = NULL;
+    GList *any_node;
+    GList *typed_node = NULL;
 
     g_return_if_fail(entity);
 
@@ -182,13 +216,33 @@ qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
     }
     }
 
+    any_node = handlers;
+    if (typed_handlers && g_hash_table_size (typed_handlers) > 0 &&
+        entity->e_type)
+        typed_node = get_handler_list (entity->e_type);
+
+    /* Both lists are newest first, so merging them by handler id calls
+     * the handlers in the same order as if they were in one list. */
     handler_run_level++;
-    for (node = handlers; node; node = next_node)
+    while (any_node || typed_node)
     {
-        HandlerInfo *hi = static_cast<HandlerInfo*>(node->data);
+        HandlerInfo *hi;
+
+        if (!typed_node ||
+            (any_node && static_cast<HandlerInfo*>(any_node->data)->handler_id >
+             static_cast<HandlerInfo*>(typed_node->data)->handler_id))
+        {
+            node = any_node;
+            any_node = any_node->next;
+        }
+        else
+        {
+            node = typed_node;
+            typed_node = typed_node->next;
+        }
 
-        next_node = node->next;
-        if (hi->handler)
+        hi = static_cast<HandlerInfo*>(node->data);
+        if (hi->handler && (hi->event_mask & event_id))
         {
             PINFO("id=%d hi=%p han=%p data=%p", hi->handler_id, hi,
                   hi->handler, event_data);
@@ -202,18 +256,17 @@ qof_event_generate_internal (QofInstance *entity, QofEventId event_id,
      */
     if (handler_run_level == 0 && pending_deletes)
     {
-        for (node = handlers; node; node = next_node)
-        {
-            HandlerInfo *hi = static_cast<HandlerInfo*>(node->data);
-            next_node = node->next;
-            if (hi->handler == NULL)
-            {
-                /* remove this node from the list, then free this node */
-                handlers = g_list_remove_link (handlers, node);
-                g_list_free_1 (node);
-                g_free (hi);
-            }
-        }
+        GList *doomed = NULL;
+        GHashTableIter iter;
+        gpointer value;
+
+        g_hash_table_iter_init (&iter, handlers_by_id);
+        while (g_hash_table_iter_next (&iter, NULL, &value))
+            if (static_cast<HandlerInfo*>(value)->handler == NULL)
+                doomed = g_list_prepend (doomed, value);
+        for (node = doomed; node; node = node->next)
+            free_handler (static_cast<HandlerInfo*>(node->data));
+        g_list_free (doomed);
         pending_deletes = 0;
     }
 }
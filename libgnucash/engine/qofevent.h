@@ -77,6 +77,8 @@ for future libqof1 or libqof2 usage.
 #define QOF_EVENT_REMOVE   QOF_MAKE_EVENT(4)
 #define QOF_EVENT__LAST    QOF_MAKE_EVENT(QOF_EVENT_BASE-1)
 #define QOF_EVENT_ALL      (0xff)
+/** An event mask that selects every event, including application events. */
+#define QOF_EVENT_ANY      (~0)
 
 /** \brief Handler invoked when an event is generated.
  *
@@ -98,6 +100,26 @@ typedef void (*QofEventHandler) (QofInstance *ent,  QofEventId event_type,
  */
 gint qof_event_register_handler (QofEventHandler handler, gpointer handler_data);
 
+/** \brief Register a handler for some of the events of one type of entity.
+ *
+ * Generating an event only looks at the handlers for the type of the
+ * entity and at those for all types, so a handler that ignores most
+ * events is better registered this way than with
+ * qof_event_register_handler.
+ *
+ * @param handler:   handler to register
+ * @param handler_data: data provided when handler is invoked
+ * @param entity_type: the type of entity whose events are wanted, or
+ *   NULL for all types
+ * @param event_mask: the events wanted, or QOF_EVENT_ANY for all of them
+ *
+ * @return id identifying handler
+ */
+gint qof_event_register_filtered_handler (QofEventHandler handler,
+                                          gpointer handler_data,
+                                          QofIdTypeConst entity_type,
+                                          QofEventId event_mask);
+
 /** \brief Unregister an event handler.
  *
  * @param handler_id: the id of the handler to unregister
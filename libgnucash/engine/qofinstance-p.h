@@ -134,6 +134,36 @@ void qof_instance_set_kvp (QofInstance *, GValue const * value, unsigned count,
  */
 void qof_instance_get_kvp (QofInstance *, GValue * value, unsigned count, ...);
 
+/** A cached copy of an int64 slot at the top level of an instance's KVP
+ * frame, for flags that are read far more often than they are written.
+ * Zero-initialize it; it is refreshed whenever the frame has changed.
+ */
+typedef struct
+{
+    guint64 generation;
+    gint64 value;
+} QofInstanceKvpCache;
+
+/** Retrieves the int64 value of a top-level KVP slot through a cache,
+ * only looking it up again if the instance's frame changed since the
+ * cache was filled.
+ * @param inst: The QofInstance
+ * @param cache: The cache belonging to this instance and key.
+ * @param key: The name of the slot.
+ * @return The value of the slot, or 0 if it is missing or isn't an int64.
+ */
+gint64 qof_instance_get_kvp_int64_cached (const QofInstance *inst,
+                                          QofInstanceKvpCache *cache,
+                                          const char *key);
+
+/** Makes qof_instance_get_kvp_int64_cached on the calling thread look
+ * stale values up without refreshing the cache, for threads that read
+ * instances alongside others, like query workers.  Nothing may change
+ * the instances while they run.
+ * @param read_only: TRUE to stop refreshing caches, FALSE to resume.
+ */
+void qof_instance_set_kvp_cache_read_only (gboolean read_only);
+
 /** @} Close out the DOxygen ingroup */
 /* Functions to isolate the KVP mechanism inside QOF for cases where
 GValue * operations won't work.
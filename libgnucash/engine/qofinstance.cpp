@@ -1080,6 +1080,35 @@ qof_instance_get_kvp (QofInstance * inst, GValue * value, unsigned count, ...)
     gvalue_from_kvp_value (inst->kvp_data->get_slot (path), value);
 }
 
+/* Set on threads that may share an instance with other readers. */
+static thread_local bool kvp_cache_read_only = false;
+
+void
+qof_instance_set_kvp_cache_read_only (gboolean read_only)
+{
+    kvp_cache_read_only = read_only;
+}
+
+gint64
+qof_instance_get_kvp_int64_cached (const QofInstance *inst,
+                                   QofInstanceKvpCache *cache, const char *key)
+{
+    auto frame = inst->kvp_data;
+    if (cache->generation == frame->generation ())
+        return cache->value;
+
+    auto slot = frame->get_slot ({key});
+    gint64 value = 0;
+    if (slot && slot->get_type () == KvpValue::Type::INT64)
+        value = slot->get<int64_t> ();
+    if (!kvp_cache_read_only)
+    {
+        cache->value = value;
+        cache->generation = frame->generation ();
+    }
+    return value;
+}
+
 void
 qof_instance_copy_kvp (QofInstance *to, const QofInstance *from)
 {
@@ -212,6 +212,23 @@ qof_object_foreach (QofIdTypeConst type_name, QofBook *book,
     return;
 }
 
+gboolean
+qof_object_foreach_query (QofIdTypeConst type_name, QofBook *book,
+                          QofQuery *query,
+                          QofInstanceForeachCB cb, gpointer user_data)
+{
+    const QofObject *obj;
+
+    if (!book || !type_name || !query)
+        return FALSE;
+
+    obj = qof_object_lookup (type_name);
+    if (!obj || !obj->foreach_query)
+        return FALSE;
+
+    return obj->foreach_query (book, query, cb, user_data);
+}
+
 static void
 do_prepend (QofInstance *qof_p, gpointer list_p)
 {
@@ -124,6 +124,16 @@ struct _QofObject
      *  to or later than than 'instance_right'.
      */
     int                 (*version_cmp)(gpointer instance_left, gpointer instance_right);
+
+    /** Traverse over just those items in the book that might match the
+     *  query, calling the callback on each item.  Items that don't match
+     *  may be passed too, because the query still checks every one, but
+     *  every item that does match must be.  Returns FALSE without
+     *  calling the callback if the query can't be narrowed down that
+     *  way, in which case (*foreach) is used instead.  May be NULL.
+     */
+    gboolean            (*foreach_query)(QofBook *, struct _QofQuery *,
+                                         QofInstanceForeachCB, gpointer);
 };
 
 /* -------------------------------------------------------------- */
@@ -167,6 +177,15 @@ void qof_object_foreach_type (QofForeachTypeCB cb, gpointer user_data);
 void qof_object_foreach (QofIdTypeConst type_name, QofBook *book,
                          QofInstanceForeachCB cb, gpointer user_data);
 
+/** Invoke the callback 'cb' on the instances of a particular object
+ *  type in the book that might match the query, using the type's
+ *  (*foreach_query) routine.  Returns FALSE if the type can't narrow
+ *  the query down, and the caller should use qof_object_foreach().
+ */
+gboolean qof_object_foreach_query (QofIdTypeConst type_name, QofBook *book,
+                                   struct _QofQuery *query,
+                                   QofInstanceForeachCB cb, gpointer user_data);
+
 /** Invoke callback 'cb' on each instance in guid orted order */
 void qof_object_foreach_sorted (QofIdTypeConst type_name, QofBook *book,
                                 QofInstanceForeachCB cb, gpointer user_data);
@@ -33,9 +33,15 @@
 #include "qof-backend.hpp"
 #include "qofbook-p.h"
 #include "qofclass-p.h"
+#include "qofinstance-p.h"
 #include "qofquery-p.h"
 #include "qofquerycore-p.h"
 
+#include <algorithm>
+#include <system_error>
+#include <thread>
+#include <vector>
+
 static QofLogModule log_module = QOF_MOD_QUERY;
 
 struct _QofQueryTerm
@@ -90,6 +96,9 @@ struct _QofQuery
     /* The maximum number of results to return */
     gint              max_results;
 
+    /* The number of threads to check objects on, 0 or 1 for serial */
+    gint              n_workers;
+
     /* list of books that will be participating in the query */
     GList *           books;
 
@@ -103,11 +112,17 @@ struct _QofQuery
     GList *           results;
 };
 
+struct QueryTopMatches;
+
 typedef struct _QofQueryCB
 {
     QofQuery *        query;
     GList *           list;
     gint              count;
+    QueryTopMatches * top;          /* keep only the best matches */
+    QofQueryMatchCB   match_cb;     /* hand matches over as they're found */
+    gpointer          match_data;
+    gboolean          done;         /* match_cb has had enough */
 } QofQueryCB;
 
 /* initial_term will be owned by the new Query */
@@ -564,18 +579,151 @@ static void compile_terms (QofQuery *q)
     LEAVE (" query=%p", q);
 }
 
+/* When a sorted query only wants its last max_results matches, just those
+ * are kept in a bounded heap instead of sorting every match.  seq is the
+ * order the matches were found in, so that ties come out in that order,
+ * the same as from the stable sort of the match list.
+ */
+struct QueryMatch
+{
+    gpointer object;
+    gint seq;
+};
+
+struct QueryTopMatches
+{
+    QofQuery *query;
+    size_t limit;
+    std::vector<QueryMatch> heap;
+
+    /* Whether a comes before b in the sorted results. */
+    bool before (const QueryMatch& a, const QueryMatch& b) const
+    {
+        int cmp = sort_func (a.object, b.object, query);
+        return cmp < 0 || (cmp == 0 && a.seq < b.seq);
+    }
+};
+
+static void
+top_matches_add (QueryTopMatches *top, gpointer object, gint seq)
+{
+    QueryMatch match {object, seq};
+    /* Keeps the earliest of the kept matches at the front of the heap. */
+    auto later = [top](const QueryMatch& a, const QueryMatch& b)
+                 { return top->before (b, a); };
+
+    if (top->heap.size () < top->limit)
+    {
+        top->heap.push_back (match);
+        std::push_heap (top->heap.begin (), top->heap.end (), later);
+    }
+    else if (top->before (top->heap.front (), match))
+    {
+        std::pop_heap (top->heap.begin (), top->heap.end (), later);
+        top->heap.back () = match;
+        std::push_heap (top->heap.begin (), top->heap.end (), later);
+    }
+}
+
+static GList *
+top_matches_to_list (QueryTopMatches *top)
+{
+    GList *list = NULL;
+
+    std::sort (top->heap.begin (), top->heap.end (),
+               [top](const QueryMatch& a, const QueryMatch& b)
+               { return top->before (a, b); });
+    for (auto iter = top->heap.rbegin (); iter != top->heap.rend (); ++iter)
+        list = g_list_prepend (list, iter->object);
+    return list;
+}
+
+static void query_cb_add_match (QofQueryCB *ql, gpointer object)
+{
+    if (ql->match_cb)
+    {
+        ql->count++;
+        if (!ql->match_cb (object, ql->match_data) ||
+            (ql->query->max_results > 0 &&
+             ql->count >= ql->query->max_results))
+            ql->done = TRUE;
+        return;
+    }
+    if (ql->top)
+        top_matches_add (ql->top, object, ql->count);
+    else
+        ql->list = g_list_prepend (ql->list, object);
+    ql->count++;
+}
+
 static void check_item_cb (gpointer object, gpointer user_data)
 {
     QofQueryCB* ql = static_cast<QofQueryCB*>(user_data);
 
-    if (!object || !ql) return;
+    if (!object || !ql || ql->done) return;
 
     if (check_object (ql->query, object))
+        query_cb_add_match (ql, object);
+    return;
+}
+
+/* Below this many objects per thread it isn't worth starting threads. */
+#define QUERY_MIN_OBJECTS_PER_WORKER 512
+
+static void collect_item_cb (gpointer object, gpointer user_data)
+{
+    static_cast<std::vector<gpointer>*>(user_data)->push_back (object);
+}
+
+/* Checks the objects on the query's worker threads, then adds the
+ * matches in the order the objects were collected, so that the results
+ * don't depend on how the threads were scheduled. */
+static void check_items_parallel (QofQueryCB *qcb,
+                                  const std::vector<gpointer>& objects)
+{
+    const QofQuery *q = qcb->query;
+    size_t n_objects = objects.size ();
+    size_t n_workers = std::min<size_t> (q->n_workers,
+                                         n_objects / QUERY_MIN_OBJECTS_PER_WORKER);
+
+    if (n_workers < 2)
     {
-        ql->list = g_list_prepend (ql->list, object);
-        ql->count++;
+        for (auto object : objects)
+            check_item_cb (object, qcb);
+        return;
     }
-    return;
+
+    std::vector<char> matched (n_objects, 0);
+    auto check_range = [q, &objects, &matched](size_t first, size_t last)
+    {
+        /* Other workers may be reading the same instances' caches. */
+        qof_instance_set_kvp_cache_read_only (TRUE);
+        for (auto i = first; i < last; ++i)
+            matched[i] = objects[i] && check_object (q, objects[i]);
+        qof_instance_set_kvp_cache_read_only (FALSE);
+    };
+
+    std::vector<std::thread> workers;
+    size_t chunk = (n_objects + n_workers - 1) / n_workers;
+    for (size_t first = 0; first < n_objects; first += chunk)
+    {
+        size_t last = std::min (n_objects, first + chunk);
+        try
+        {
+            workers.emplace_back (check_range, first, last);
+        }
+        catch (const std::system_error& err)
+        {
+            PWARN ("Can't start query worker: %s", err.what ());
+            check_range (first, last);
+        }
+    }
+    for (auto& worker : workers)
+        worker.join ();
+
+    for (size_t i = 0; i < n_objects; ++i)
+        if (matched[i])
+            query_cb_add_match (qcb, objects[i]);
 }
 
 static int param_list_cmp (const QofQueryParamList *l1, const QofQueryParamList *l2)
@@ -721,6 +869,30 @@ void qof_query_purge_terms (QofQuery *q, QofQueryParamList *param_list)
     }
 }
 
+static gboolean
+query_is_sorted (const QofQuery *q)
+{
+    return q->primary_sort.comp_fcn || q->primary_sort.obj_cmp ||
+        (q->primary_sort.use_default && q->defaultSort);
+}
+
+static void
+query_prepare (QofQuery *q)
+{
+    /* XXX: Prioritize the query terms? */
+
+    /* prepare the Query for processing */
+    if (q->changed)
+    {
+        query_clear_compiles (q);
+        compile_terms (q);
+    }
+
+    /* Maybe log this sucker */
+    if (qof_log_check (log_module, QOF_LOG_DEBUG))
+        qof_query_print (q);
+}
+
 static GList * qof_query_run_internal (QofQuery *q,
                                        void(*run_cb)(QofQueryCB*, gpointer),
                                        gpointer cb_arg)
@@ -734,18 +906,30 @@ static GList * qof_query_run_internal (QofQuery *q,
     g_return_val_if_fail (run_cb, NULL);
     ENTER (" q=%p", q);
 
-    /* XXX: Prioritize the query terms? */
+    query_prepare (q);
 
-    /* prepare the Query for processing */
-    if (q->changed)
+    /* A sorted query that only wants a few results keeps just those. */
+    if (q->max_results > 0 && query_is_sorted (q))
     {
-        query_clear_compiles (q);
-        compile_terms (q);
-    }
+        QofQueryCB qcb;
+        QueryTopMatches top {q, static_cast<size_t>(q->max_results), {}};
 
-    /* Maybe log this sucker */
-    if (qof_log_check (log_module, QOF_LOG_DEBUG))
-        qof_query_print (q);
+        memset (&qcb, 0, sizeof (qcb));
+        qcb.query = q;
+        qcb.top = &top;
+
+        run_cb(&qcb, cb_arg);
+
+        matching_objects = top_matches_to_list (&top);
+        PINFO ("matching objects=%p count=%d kept=%zu", matching_objects,
+               qcb.count, top.heap.size ());
+
+        q->changed = 0;
+        g_list_free(q->results);
+        q->results = matching_objects;
+        LEAVE (" q=%p", q);
+        return matching_objects;
+    }
 
     /* Now run the query over all the objects and save the results */
     {
@@ -771,8 +955,7 @@ static GList * qof_query_run_internal (QofQuery *q,
     matching_objects = g_list_reverse(matching_objects);
 
     /* Now sort the matching objects based on the search criteria */
-    if (q->primary_sort.comp_fcn || q->primary_sort.obj_cmp ||
-            (q->primary_sort.use_default && q->defaultSort))
+    if (query_is_sorted (q))
     {
         matching_objects = g_list_sort_with_data(matching_objects, sort_func, q);
     }
@@ -822,6 +1005,9 @@ static void qof_query_run_cb(QofQueryCB* qcb, gpointer cb_arg)
     for (node = qcb->query->books; node; node = node->next)
     {
         QofBook* book = static_cast<QofBook*>(node->data);
+
+        if (book->backend)
+            book->backend->load_for_query (qcb->query);
 #ifdef QOF_BACKEND_QUERY
         QofBackend* be = book->backend;
 
@@ -837,9 +1023,22 @@ static void qof_query_run_cb(QofQueryCB* qcb, gpointer cb_arg)
             }
         }
 #endif
-        /* And then iterate over all the objects */
-        qof_object_foreach (qcb->query->search_for, book,
-                            (QofInstanceForeachCB) check_item_cb, qcb);
+        /* And then iterate over the objects that might match, or all of
+         * them if the object type can't narrow the query down. */
+        if (qcb->query->n_workers > 1 && !qcb->match_cb)
+        {
+            std::vector<gpointer> objects;
+            if (!qof_object_foreach_query (qcb->query->search_for, book, qcb->query,
+                                           (QofInstanceForeachCB) collect_item_cb,
+                                           &objects))
+                qof_object_foreach (qcb->query->search_for, book,
+                                    (QofInstanceForeachCB) collect_item_cb, &objects);
+            check_items_parallel (qcb, objects);
+        }
+        else if (!qof_object_foreach_query (qcb->query->search_for, book, qcb->query,
+                                            (QofInstanceForeachCB) check_item_cb, qcb))
+            qof_object_foreach (qcb->query->search_for, book,
+                                (QofInstanceForeachCB) check_item_cb, qcb);
     }
 }
 
@@ -849,12 +1048,44 @@ GList * qof_query_run (QofQuery *q)
     return qof_query_run_internal(q, qof_query_run_cb, NULL);
 }
 
+void
+qof_query_run_foreach (QofQuery *q, QofQueryMatchCB cb, gpointer user_data)
+{
+    QofQueryCB qcb;
+
+    if (!q || !cb) return;
+    g_return_if_fail (q->search_for);
+    g_return_if_fail (q->books);
+    ENTER (" q=%p", q);
+
+    query_prepare (q);
+    q->changed = 0;
+
+    memset (&qcb, 0, sizeof (qcb));
+    qcb.query = q;
+    qcb.match_cb = cb;
+    qcb.match_data = user_data;
+    qcb.done = (q->max_results == 0);
+
+    qof_query_run_cb (&qcb, NULL);
+
+    LEAVE (" q=%p matches=%d", q, qcb.count);
+}
+
 static void qof_query_run_subq_cb(QofQueryCB* qcb, gpointer cb_arg)
 {
     QofQuery* pq = static_cast<QofQuery*>(cb_arg);
 
     g_return_if_fail(pq);
-    g_list_foreach(qof_query_last_run(pq), check_item_cb, qcb);
+    if (qcb->query->n_workers > 1)
+    {
+        std::vector<gpointer> objects;
+        for (auto node = qof_query_last_run(pq); node; node = node->next)
+            objects.push_back (node->data);
+        check_items_parallel (qcb, objects);
+    }
+    else
+        g_list_foreach(qof_query_last_run(pq), check_item_cb, qcb);
 }
 
 GList *
@@ -1273,6 +1504,12 @@ void qof_query_set_max_results (QofQuery *q, int n)
     q->max_results = n;
 }
 
+void qof_query_set_parallel (QofQuery *q, gint n_workers)
+{
+    if (!q) return;
+    q->n_workers = n_workers < 0 ? g_get_num_processors () : n_workers;
+}
+
 void qof_query_add_guid_list_match (QofQuery *q, QofQueryParamList *param_list,
                                     GList *guid_list, QofGuidMatch options,
                                     QofQueryOp op)
@@ -221,6 +221,19 @@ void qof_query_add_boolean_match (QofQuery *q,
  */
 GList * qof_query_run (QofQuery *query);
 
+/** Callback for qof_query_run_foreach().  Return FALSE to stop the
+ *  query from looking for further matches. */
+typedef gboolean (*QofQueryMatchCB) (gpointer object, gpointer user_data);
+
+/** Perform the query, passing each match to cb as it is found instead
+ *  of building a result list.  Matches arrive unsorted, in the order
+ *  the book's collections are walked, and no more objects are checked
+ *  once cb returns FALSE or max_results matches have been passed.
+ *  qof_query_last_run() is not affected.
+ */
+void qof_query_run_foreach (QofQuery *query, QofQueryMatchCB cb,
+                            gpointer user_data);
+
 /** Return the results of the last query, without causing the query to
  *  be re-run.  Do NOT free the resulting list.  This list is managed
  *  internally by QofQuery.
@@ -360,6 +373,16 @@ void qof_query_set_sort_increasing (QofQuery *q, gboolean prim_inc,
  */
 void qof_query_set_max_results (QofQuery *q, int n);
 
+/**
+ * Check the objects on up to n_workers threads when the query is run;
+ * a negative value means one per processor and 0 or 1, the default,
+ * checks them serially.  The matches and their order are the same
+ * either way.  Only use this when every parameter getter and predicate
+ * in the query just reads the objects, and nothing changes the book
+ * while the query runs.
+ */
+void qof_query_set_parallel (QofQuery *q, gint n_workers);
+
 /** Compare two queries for equality.
  * Query terms are compared each to each.
  * This is a simplistic
@@ -28,6 +28,7 @@
 #include "../qofevent.h"
 #include "../qofevent-p.h"
 #include <gtest/gtest.h>
+#include <vector>
 
 static void
 easy_handler (QofInstance *ent,  QofEventId event_type,
@@ -134,3 +135,57 @@ TEST (qofevent, compound_events)
     qof_event_unregister_handler (id5);
 }
 
+
+static void
+order_handler (QofInstance *ent,  QofEventId event_type,
+               gpointer handler_data, gpointer event_data)
+{
+    auto calls = static_cast<std::vector<int>*>(event_data);
+    calls->push_back (GPOINTER_TO_INT(handler_data));
+}
+
+TEST (qofevent, filtered_events)
+{
+    QofInstance account{};
+    QofInstance trans{};
+    std::vector<int> calls;
+
+    account.e_type = "Account";
+    trans.e_type = "Trans";
+
+    // handlers are called newest first, whether they're filtered or not.
+    int id_any = qof_event_register_handler (order_handler, GINT_TO_POINTER(1));
+    int id_acct = qof_event_register_filtered_handler (order_handler, GINT_TO_POINTER(2),
+                                                       "Account", QOF_EVENT_MODIFY);
+    int id_trans = qof_event_register_filtered_handler (order_handler, GINT_TO_POINTER(3),
+                                                        "Trans", QOF_EVENT_ANY);
+    int id_acct2 = qof_event_register_filtered_handler (order_handler, GINT_TO_POINTER(4),
+                                                        "Account",
+                                                        QOF_EVENT_MODIFY | QOF_EVENT_ADD);
+
+    qof_event_gen (&account, QOF_EVENT_MODIFY, &calls);
+    EXPECT_EQ (calls, std::vector<int>({4, 2, 1}));
+
+    // only the handlers that asked for it get an ADD.
+    calls.clear ();
+    qof_event_gen (&account, QOF_EVENT_ADD, &calls);
+    EXPECT_EQ (calls, std::vector<int>({4, 1}));
+
+    // QOF_EVENT_ANY includes application events.
+    calls.clear ();
+    qof_event_gen (&trans, QOF_MAKE_EVENT(QOF_EVENT_BASE + 1), &calls);
+    EXPECT_EQ (calls, std::vector<int>({3, 1}));
+
+    calls.clear ();
+    qof_event_unregister_handler (id_acct2);
+    qof_event_unregister_handler (id_any);
+    qof_event_gen (&account, QOF_EVENT_MODIFY, &calls);
+    EXPECT_EQ (calls, std::vector<int>({2}));
+
+    calls.clear ();
+    qof_event_unregister_handler (id_acct);
+    qof_event_unregister_handler (id_trans);
+    qof_event_gen (&account, QOF_EVENT_MODIFY, &calls);
+    qof_event_gen (&trans, QOF_EVENT_MODIFY, &calls);
+    EXPECT_TRUE (calls.empty ());
+}
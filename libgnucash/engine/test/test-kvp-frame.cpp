@@ -189,6 +189,23 @@ TEST_F (KvpFrameTest, Empty)
     EXPECT_FALSE(f2.empty());
 }
 
+TEST_F (KvpFrameTest, Generation)
+{
+    KvpFrameImpl f1;
+    auto gen = f1.generation ();
+    EXPECT_NE (0u, gen);
+    EXPECT_NE (gen, t_root.generation ());
+    f1.set ({"value"}, new KvpValue {INT64_C(2)});
+    EXPECT_NE (gen, f1.generation ());
+    gen = f1.generation ();
+    f1.get_slot ({"value"});
+    EXPECT_EQ (gen, f1.generation ());
+    delete f1.set ({"value"}, nullptr);
+    EXPECT_NE (gen, f1.generation ());
+    KvpFrameImpl f2 {f1};
+    EXPECT_NE (f1.generation (), f2.generation ());
+}
+
 TEST (KvpFrameTestForEachPrefix, for_each_prefix_1)
 {
     KvpFrame fr;
@@ -25,6 +25,7 @@
 #include <config.h>
 #include "qof.h"
 #include "cashobjects.h"
+#include "Account.h"
 #include "Transaction.h"
 #include "TransLog.h"
 #include "gnc-engine.h"
@@ -64,6 +65,238 @@ test_trans_query (Transaction *trans, gpointer data)
     return 0;
 }
 
+static gboolean
+count_match (gpointer object, gpointer data)
+{
+    ++*static_cast<int*>(data);
+    return TRUE;
+}
+
+static void
+test_max_results (QofBook *book)
+{
+    QofQuery *q = qof_query_create_for (GNC_ID_SPLIT);
+    GList *all, *last, *node, *tail;
+    guint n_all;
+    int max = 5, streamed = 0;
+
+    qof_query_set_book (q, book);
+    xaccQueryAddClearedMatch (q, CLEARED_ALL, QOF_QUERY_AND);
+    all = g_list_copy (qof_query_run (q));
+    n_all = g_list_length (all);
+
+    /* The bounded top-N run must keep exactly the tail of the full run. */
+    qof_query_set_max_results (q, max);
+    last = qof_query_run (q);
+    tail = g_list_nth (all, n_all > (guint)max ? n_all - max : 0);
+    for (node = last; node && tail; node = node->next, tail = tail->next)
+        if (node->data != tail->data)
+            break;
+    if (node || tail)
+        failure ("max_results run differs from the tail of the full run");
+    else
+        success ("max_results run is the tail of the full run");
+
+    qof_query_run_foreach (q, count_match, &streamed);
+    if (streamed != MIN (max, (int)n_all))
+        failure_args ("streamed matches", __FILE__, __LINE__,
+                      "got %d matches, expected %d", streamed,
+                      MIN (max, (int)n_all));
+    else
+        success ("streaming stops at max_results");
+
+    g_list_free (all);
+    qof_query_destroy (q);
+}
+
+static Account *
+make_tie_account (QofBook *book, gnc_commodity *currency)
+{
+    Account *acc = xaccMallocAccount (book);
+    xaccAccountBeginEdit (acc);
+    xaccAccountSetCommodity (acc, currency);
+    gnc_account_append_child (gnc_book_get_root_account (book), acc);
+    xaccAccountCommitEdit (acc);
+    return acc;
+}
+
+/* Matches that sort equal must be cut at the max_results boundary just
+ * where the full run's stable sort would cut them. */
+static void
+test_max_results_ties (QofBook *book)
+{
+    gnc_commodity_table *table = gnc_commodity_table_get_table (book);
+    gnc_commodity *usd = gnc_commodity_table_insert (
+        table, gnc_commodity_new (book, "US Dollar", GNC_COMMODITY_NS_CURRENCY,
+                                  "USD", "840", 100));
+    Account *from = make_tie_account (book, usd);
+    Account *to = make_tie_account (book, usd);
+    time64 posted = gnc_time (NULL);
+    QofQuery *q;
+    GList *all, *last, *node, *tail;
+    guint n_all;
+    int max = 5, i;
+
+    for (i = 0; i < 4 * max; i++)
+    {
+        Transaction *trans = xaccMallocTransaction (book);
+        xaccTransBeginEdit (trans);
+        xaccTransSetCurrency (trans, usd);
+        xaccTransSetDatePostedSecsNormalized (trans, posted);
+        for (Account *acc : {from, to})
+        {
+            Split *split = xaccMallocSplit (book);
+            xaccSplitSetParent (split, trans);
+            xaccSplitSetAccount (split, acc);
+            xaccSplitSetMemo (split, "max results tie");
+            xaccSplitSetAmount (split, gnc_numeric_zero ());
+            xaccSplitSetValue (split, gnc_numeric_zero ());
+        }
+        xaccTransCommitEdit (trans);
+    }
+
+    q = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (q, book);
+    xaccQueryAddMemoMatch (q, "max results tie", TRUE, FALSE,
+                           QOF_COMPARE_EQUAL, QOF_QUERY_AND);
+    qof_query_set_sort_order (q, qof_query_build_param_list (SPLIT_MEMO, NULL),
+                              NULL, NULL);
+    all = g_list_copy (qof_query_run (q));
+    n_all = g_list_length (all);
+
+    qof_query_set_max_results (q, max);
+    last = qof_query_run (q);
+    tail = g_list_nth (all, n_all - max);
+    for (node = last; node && tail; node = node->next, tail = tail->next)
+        if (node->data != tail->data)
+            break;
+    if (n_all != 8 * (guint)max || node || tail)
+        failure ("tied max_results run differs from the tail of the full run");
+    else
+        success ("tied max_results run is the tail of the full run");
+
+    g_list_free (all);
+    qof_query_destroy (q);
+}
+
+/* An account and date query is answered from the account's own splits;
+ * check it finds exactly the splits a scan of them would. */
+static void
+test_account_date_query (Account *root, QofBook *book)
+{
+    GList *accounts = gnc_account_get_descendants (root);
+    Account *acc = NULL;
+    GList *node, *splits;
+    time64 start, end;
+    int expected = 0;
+
+    for (node = accounts; node && !acc; node = node->next)
+        if (g_list_length (xaccAccountGetSplitList (GNC_ACCOUNT (node->data))) > 2)
+            acc = GNC_ACCOUNT (node->data);
+    g_list_free (accounts);
+    if (!acc)
+        return;
+
+    splits = xaccAccountGetSplitList (acc);
+    start = xaccTransGetDate (xaccSplitGetParent (GNC_SPLIT (splits->data)));
+    end = xaccTransGetDate (xaccSplitGetParent (GNC_SPLIT (g_list_last (splits)->data)));
+    start += (end - start) / 3;
+    end -= (end - start) / 3;
+    for (node = splits; node; node = node->next)
+    {
+        time64 t = xaccTransGetDate (xaccSplitGetParent (GNC_SPLIT (node->data)));
+        if (t >= start && t <= end)
+            ++expected;
+    }
+
+    QofQuery *q = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (q, book);
+    xaccQueryAddSingleAccountMatch (q, acc, QOF_QUERY_AND);
+    xaccQueryAddDateMatchTT (q, TRUE, start, TRUE, end, QOF_QUERY_AND);
+    int found = g_list_length (qof_query_run (q));
+    qof_query_destroy (q);
+
+    if (found != expected)
+        failure_args ("account and date query", __FILE__, __LINE__,
+                      "found %d splits, expected %d", found, expected);
+    else
+        success ("account and date query finds the account's splits");
+}
+
+/* A parallel run must give the same matches, in the same order, as a
+ * serial one. */
+static void
+test_parallel_query (void)
+{
+    QofSession *session = get_random_session ();
+    QofBook *book = qof_session_get_book (session);
+    QofQuery *q;
+    GList *serial, *parallel, *n1, *n2;
+
+    add_random_transactions_to_book (book, 1000);
+
+    q = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (q, book);
+    xaccQueryAddClearedMatch (q, (cleared_match_t)(CLEARED_NO | CLEARED_CLEARED),
+                              QOF_QUERY_AND);
+    serial = g_list_copy (qof_query_run (q));
+    qof_query_set_parallel (q, 4);
+    parallel = qof_query_run (q);
+
+    for (n1 = serial, n2 = parallel; n1 && n2; n1 = n1->next, n2 = n2->next)
+        if (n1->data != n2->data)
+            break;
+    if (n1 || n2)
+        failure ("parallel query results differ from serial ones");
+    else
+        success ("parallel query matches serial query");
+
+    g_list_free (serial);
+    qof_query_destroy (q);
+    qof_session_destroy (session);
+}
+
+/* A split moved by a transaction still in its edit isn't in the new
+ * account's index; an account query has to find it there all the same. */
+static void
+test_open_trans_query (Account *root, QofBook *book)
+{
+    GList *accounts = gnc_account_get_descendants (root);
+    Account *acc = NULL, *other = NULL;
+    GList *node;
+
+    for (node = accounts; node && !(acc && other); node = node->next)
+    {
+        Account *a = GNC_ACCOUNT (node->data);
+        if (!acc && xaccAccountGetSplitList (a))
+            acc = a;
+        else if (!other)
+            other = a;
+    }
+    g_list_free (accounts);
+    if (!acc || !other)
+        return;
+
+    int expected = g_list_length (xaccAccountGetSplitList (other)) + 1;
+    Split *split = GNC_SPLIT (xaccAccountGetSplitList (acc)->data);
+    Transaction *trans = xaccSplitGetParent (split);
+    xaccTransBeginEdit (trans);
+    xaccSplitSetAccount (split, other);
+
+    QofQuery *q = qof_query_create_for (GNC_ID_SPLIT);
+    qof_query_set_book (q, book);
+    xaccQueryAddSingleAccountMatch (q, other, QOF_QUERY_AND);
+    int found = g_list_length (qof_query_run (q));
+    qof_query_destroy (q);
+    xaccTransRollbackEdit (trans);
+
+    if (found != expected)
+        failure_args ("open transaction query", __FILE__, __LINE__,
+                      "found %d splits, expected %d", found, expected);
+    else
+        success ("account query finds a split moved in an open transaction");
+}
+
 static void
 run_test (void)
 {
@@ -78,6 +311,10 @@ run_test (void)
     add_random_transactions_to_book (book, 20);
 
     xaccAccountTreeForEachTransaction (root, test_trans_query, book);
+    test_max_results (book);
+    test_max_results_ties (book);
+    test_account_date_query (root, book);
+    test_open_trans_query (root, book);
 
     qof_session_destroy (session);
 }
@@ -105,6 +342,7 @@ main (int argc, char **argv)
     {
         run_test ();
     }
+    test_parallel_query ();
     success("queries seem to work");
 
 cleanup:
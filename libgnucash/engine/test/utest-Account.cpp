@@ -1624,6 +1624,55 @@ test_xaccAccountRecomputeBalance (Fixture *fixture, gconstpointer pData)
     g_assert_true (!priv->balance_dirty);
 }
 
+static void
+check_running_balances (AccountPrivate *priv)
+{
+    gnc_numeric bal = priv->starting_balance;
+    for (auto node = priv->splits; node; node = node->next)
+    {
+        auto split = static_cast<Split*>(node->data);
+        bal = gnc_numeric_add_fixed (bal, xaccSplitGetAmount (split));
+        g_assert_true (gnc_numeric_eq (xaccSplitGetBalance (split), bal));
+    }
+    g_assert_true (gnc_numeric_eq (priv->balance, bal));
+}
+
+static void
+test_xaccAccountRecomputeBalance_incremental (Fixture *fixture,
+                                              gconstpointer pData)
+{
+    AccountPrivate *priv = fixture->func->get_private (fixture->acct);
+    gnc_account_set_balance_dirty (fixture->acct);
+    xaccAccountRecomputeBalance (fixture->acct);
+    g_assert_cmpuint (priv->balance_clean_count, ==,
+                      g_list_length (priv->splits));
+    check_running_balances (priv);
+
+    /* Removing a split recomputes only the splits after it. */
+    auto split = static_cast<Split*>(g_list_nth_data (priv->splits, 2));
+    g_assert_true (gnc_account_remove_split (fixture->acct, split));
+    g_assert_true (!priv->balance_dirty);
+    g_assert_cmpuint (priv->balance_clean_count, ==,
+                      g_list_length (priv->splits));
+    check_running_balances (priv);
+
+    /* Putting it back invalidates the balances from its position on. */
+    g_assert_true (gnc_account_insert_split (fixture->acct, split));
+    g_assert_true (g_list_nth_data (priv->splits, 2) == split);
+    g_assert_true (!gnc_account_insert_split (fixture->acct, split));
+    g_assert_true (priv->balance_dirty);
+    g_assert_cmpuint (priv->balance_clean_count, ==, 2);
+    xaccAccountRecomputeBalance (fixture->acct);
+    g_assert_cmpuint (priv->balance_clean_count, ==,
+                      g_list_length (priv->splits));
+    check_running_balances (priv);
+
+    gnc_account_set_balance_dirty_from_split (fixture->acct, split);
+    g_assert_cmpuint (priv->balance_clean_count, ==, 2);
+    xaccAccountRecomputeBalance (fixture->acct);
+    check_running_balances (priv);
+}
+
 /* xaccAccountOrder
 int
 xaccAccountOrder (const Account *aa, const Account *ab)// C: 11 in 3 */
@@ -2245,6 +2294,31 @@ test_xaccAccountGetBalanceAsOfDate (Fixture *fixture, gconstpointer pData)
     dval = gnc_numeric_to_double (val);
     g_assert_cmpfloat (dval, == , dbal);
 }
+/* xaccAccountGetBalancesAsOfDates
+void
+xaccAccountGetBalancesAsOfDates (Account *acc, const time64 *dates,
+                                 gsize n_dates, gnc_numeric *balances)*/
+static void
+test_xaccAccountGetBalancesAsOfDates (Fixture *fixture, gconstpointer pData)
+{
+    const time64 day = 24 * 3600;
+    auto now = gnc_time (NULL);
+    /* Before all, between each of the transactions, after all, and one
+     * out of order. */
+    time64 dates[] = {now - 10 * day, now - 8 * day, now - 3 * day,
+                      now, now + 4 * day, now + 6 * day, now - 8 * day};
+    const gsize n_dates = G_N_ELEMENTS (dates);
+    gnc_numeric balances[n_dates];
+
+    xaccAccountGetBalancesAsOfDates (fixture->acct, dates, n_dates, balances);
+    for (gsize i = 0; i < n_dates; ++i)
+        g_assert_true (gnc_numeric_eq (balances[i],
+                                       xaccAccountGetBalanceAsOfDate (fixture->acct,
+                                                                      dates[i])));
+    g_assert_true (gnc_numeric_zero_p (balances[0]));
+    g_assert_true (gnc_numeric_eq (balances[5],
+                                   xaccAccountGetBalance (fixture->acct)));
+}
 /* xaccAccountGetPresentBalance
 gnc_numeric
 xaccAccountGetPresentBalance (const Account *acc)// C: 4 in 2 */
@@ -2854,6 +2928,7 @@ test_suite_account (void)
     GNC_TEST_ADD (suitename, "gnc account insert & remove split", Fixture, NULL, setup, test_gnc_account_insert_remove_split,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccount Insert and Remove Lot", Fixture, &good_data, setup, test_xaccAccountInsertRemoveLot,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccountRecomputeBalance", Fixture, &some_data, setup, test_xaccAccountRecomputeBalance,  teardown );
+    GNC_TEST_ADD (suitename, "xaccAccountRecomputeBalance incremental", Fixture, &some_data, setup, test_xaccAccountRecomputeBalance_incremental,  teardown );
     GNC_TEST_ADD_FUNC (suitename, "xaccAccountOrder", test_xaccAccountOrder );
     GNC_TEST_ADD (suitename, "qofAccountSetParent", Fixture, &some_data, setup, test_qofAccountSetParent,  teardown );
     GNC_TEST_ADD (suitename, "gnc account append/remove child", Fixture, NULL, setup, test_gnc_account_append_remove_child,  teardown );
@@ -2873,6 +2948,7 @@ test_suite_account (void)
     GNC_TEST_ADD (suitename, "gnc account get full name", Fixture, &good_data, setup, test_gnc_account_get_full_name,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccountGetProjectedMinimumBalance", Fixture, &some_data, setup, test_xaccAccountGetProjectedMinimumBalance,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccountGetBalanceAsOfDate", Fixture, &some_data, setup, test_xaccAccountGetBalanceAsOfDate,  teardown );
+    GNC_TEST_ADD (suitename, "xaccAccountGetBalancesAsOfDates", Fixture, &some_data, setup, test_xaccAccountGetBalancesAsOfDates,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccountGetPresentBalance", Fixture, &some_data, setup, test_xaccAccountGetPresentBalance,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccountFindOpenLots", Fixture, &complex_data, setup, test_xaccAccountFindOpenLots,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccountForEachLot", Fixture, &complex_data, setup, test_xaccAccountForEachLot,  teardown );
@@ -1118,6 +1118,37 @@ test_gnc_pricedb_get_prices (PriceDBFixture *fixture, gconstpointer pData)
     g_assert_cmpint(g_list_length(prices), ==, 5);
     gnc_price_list_destroy(prices);
 }
+/* gnc_pricedb_nth_price
+GNCPrice *
+gnc_pricedb_nth_price (GNCPriceDB *db,// C: 4 in 1  Local: 0:0:0
+*/
+static void
+test_gnc_pricedb_nth_price (PriceDBFixture *fixture, gconstpointer pData)
+{
+    GNCPriceDB *db = fixture->pricedb;
+    QofBook *book = qof_instance_get_book(QOF_INSTANCE(db));
+    gnc_commodity *gbp = fixture->com->gbp;
+    int n = gnc_pricedb_num_prices(db, gbp);
+    GNCPrice *price;
+    int i;
+
+    g_assert_cmpint(n, ==, 23);
+    for (i = 0; i < n; ++i)
+    {
+        price = gnc_pricedb_nth_price(db, gbp, i);
+        g_assert_nonnull(price);
+        g_assert_true(gnc_price_get_commodity(price) == gbp);
+    }
+    g_assert_null(gnc_pricedb_nth_price(db, gbp, n));
+
+    /* Adding a price drops the commodity's view. */
+    gnc_pricedb_add_price(db, construct_price(book, gbp, fixture->com->usd,
+                                              gnc_dmy2time64(2, 1, 2015),
+                                              PRICE_SOURCE_FQ,
+                                              gnc_numeric_create(155000, 100000)));
+    g_assert_nonnull(gnc_pricedb_nth_price(db, gbp, n));
+    g_assert_null(gnc_pricedb_nth_price(db, gbp, n + 1));
+}
 /* gnc_pricedb_lookup_day_t64
 GNCPrice *
 gnc_pricedb_lookup_day_t64(GNCPriceDB *db,// C: 4 in 2 SCM: 2 in 1 Local: 1:0:0
@@ -1149,11 +1180,50 @@ test_gnc_pricedb_lookup_day_t64 (PriceDBFixture *fixture, gconstpointer pData)
     g_log_set_default_handler (hdlr, 0);
 }
 
-// Not Used
 /* gnc_pricedb_lookup_at_time64
 GNCPrice *
 gnc_pricedb_lookup_at_time64(GNCPriceDB *db,// Local: 0:0:0
 */
+static void
+test_gnc_pricedb_lookup_at_time64 (PriceDBFixture *fixture, gconstpointer pData)
+{
+    /* The 13-10-2012 price was added after the 17-11-2012 one. */
+    time64 t = gnc_dmy2time64(13, 10, 2012);
+    GNCPrice *price =
+        gnc_pricedb_lookup_at_time64(fixture->pricedb,
+                                     fixture->com->usd,
+                                     fixture->com->gbp, t);
+    PriceList *prices, *node;
+    gnc_numeric result = gnc_price_get_value (price);
+    g_assert_cmpint(result.num, ==, 160705);
+    g_assert_cmpstr(GET_COM_NAME(price), ==, "GBP");
+    g_assert_true(gnc_pricedb_lookup_at_time64(fixture->pricedb,
+                                               fixture->com->usd,
+                                               fixture->com->gbp,
+                                               t + 1) == NULL);
+
+    gnc_pricedb_remove_price(fixture->pricedb, price);
+    gnc_price_unref(price);
+    g_assert_true(gnc_pricedb_lookup_at_time64(fixture->pricedb,
+                                               fixture->com->gbp,
+                                               fixture->com->usd, t) == NULL);
+    price = gnc_pricedb_lookup_nearest_before_t64(fixture->pricedb,
+                                                  fixture->com->gbp,
+                                                  fixture->com->usd, t);
+    result = gnc_price_get_value (price);
+    g_assert_cmpint(result.num, ==, 161643);
+    gnc_price_unref(price);
+
+    /* The price lists stay newest first however the prices arrived. */
+    prices = gnc_pricedb_get_prices(fixture->pricedb, fixture->com->gbp,
+                                    fixture->com->eur);
+    g_assert_cmpint(g_list_length(prices), ==, 16);
+    for (node = prices; node && node->next; node = node->next)
+        g_assert_cmpint(gnc_price_get_time64(node->data), >,
+                        gnc_price_get_time64(node->next->data));
+    gnc_price_list_destroy(prices);
+}
+
 /* lookup_nearest_in_time
 static GNCPrice *
 lookup_nearest_in_time(GNCPriceDB *db,// Local: 2:0:0
@@ -1380,6 +1450,7 @@ static void
 test_gnc_pricedb_get_latest_price (PriceDBFixture *fixture, gconstpointer pData)
 {
     gnc_numeric result;
+    GNCPrice *price;
 
     result = gnc_pricedb_get_latest_price (fixture->pricedb,
                                            fixture->com->usd,
@@ -1410,6 +1481,28 @@ test_gnc_pricedb_get_latest_price (PriceDBFixture *fixture, gconstpointer pData)
                                            fixture->com->aud);
     g_assert_cmpint(result.num, ==, 111738637);
     g_assert_cmpint(result.denom, ==, 312500);
+
+    /* No price of AMZN shares a commodity with a price of EUR, so this
+     * goes AMZN -> USD -> GBP -> EUR. */
+    result = gnc_pricedb_get_latest_price (fixture->pricedb,
+                                           fixture->com->amzn,
+                                           fixture->com->eur);
+    g_assert_true(gnc_numeric_equal(result,
+                                    gnc_numeric_create(31151LL * 126836,
+                                                       100LL * 157658)));
+
+    /* Changing a price on the way drops the memoized rate. */
+    price = gnc_pricedb_lookup_latest (fixture->pricedb,
+                                       fixture->com->gbp,
+                                       fixture->com->eur);
+    gnc_price_set_value (price, gnc_numeric_create(130000, 100000));
+    gnc_price_unref (price);
+    result = gnc_pricedb_get_latest_price (fixture->pricedb,
+                                           fixture->com->amzn,
+                                           fixture->com->eur);
+    g_assert_true(gnc_numeric_equal(result,
+                                    gnc_numeric_create(31151LL * 130000,
+                                                       100LL * 157658)));
 }
 
 static void
@@ -1771,7 +1864,9 @@ GNC_TEST_ADD (suitename, "gnc price list equal", PriceDBFixture, NULL, setup, te
 // GNC_TEST_ADD (suitename, "hash values helper", PriceDBFixture, NULL, setup, test_hash_values_helper, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb has prices", PriceDBFixture, NULL, setup, test_gnc_pricedb_has_prices, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb get prices", PriceDBFixture, NULL, setup, test_gnc_pricedb_get_prices, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb nth price", PriceDBFixture, NULL, setup, test_gnc_pricedb_nth_price, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb lookup day", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_day_t64, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb lookup at time", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_at_time64, teardown);
 // GNC_TEST_ADD (suitename, "lookup nearest in time", Fixture, NULL, setup, test_lookup_nearest_in_time, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb lookup nearest in time", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_nearest_in_time64, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb lookup nearest before in time", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_nearest_before_t64, teardown);